@@ -8,6 +8,7 @@
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include "../_common/dxcommon.h"
+#include "../_common/DDSTexture.h"
 
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3d12.lib")
@@ -202,15 +203,16 @@ public:
 		ps->Release();
 
 		{
-			// Read DDS file
-			vector<char> texData(4 * 256 * 256);
-			ifstream ifs("d3d12.dds", ios::binary);
-			if (!ifs)
+			// Read DDS file (mip 0 only)
+			DDS::File texFile;
+			if (!texFile.open("d3d12.dds"))
 				throw runtime_error("Texture not found.");
-			ifs.seekg(128, ios::beg); // Skip DDS header
-			ifs.read(texData.data(), texData.size());
+			const DDS::TextureDesc& texDesc = texFile.desc();
+			const DDS::Subresource& texData = texFile.subresource(0);
+			if (texDesc.dimension != DDS::DimensionTexture2D)
+				throw runtime_error("Texture format is not supported.");
 			D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-				DXGI_FORMAT_B8G8R8A8_UNORM, 256, 256, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_NONE,
+				static_cast<DXGI_FORMAT>(texDesc.format), texDesc.width, texDesc.height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_NONE,
 				D3D12_TEXTURE_LAYOUT_UNKNOWN, 0);
 			CHK(mDev->CreateCommittedResource(
 				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
@@ -222,13 +224,13 @@ public:
 				IID_PPV_ARGS(mTex.ReleaseAndGetAddressOf())));
 			mTex->SetName(L"Texure");
 			D3D12_BOX box = {};
-			box.right = 256;
-			box.bottom = 256;
+			box.right = texData.width;
+			box.bottom = texData.height;
 			box.back = 1;
-			CHK(mTex->WriteToSubresource(0, &box, texData.data(), 4 * 256, 4 * 256 * 256));
+			CHK(mTex->WriteToSubresource(0, &box, texData.data, texData.rowSize, static_cast<UINT>(texData.slicePitch)));
 		}
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		srvDesc.Format = mTex->GetDesc().Format;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 		srvDesc.Texture2D.MipLevels = 1;
@@ -7,10 +7,14 @@
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include "../_common/dxcommon.h"
+#include "../_common/FrameAllocator.h"
+#include "../_common/InstanceTransform.h"
+#include "../_common/UploadRing.h"
 
 #include <DirectXMath.h>
 using DirectX::XMFLOAT3; // for WaveFrontReader
 #include "../Mesh/WaveFrontReader.h"
+#include "../Mesh/MeshletBuilder.h"
 
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3d12.lib")
@@ -21,6 +25,8 @@ using namespace concurrency;
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
+#define USE_MESHLET_CULLING 1 // one indirect draw per visible meshlet instead of per instance
+
 namespace
 {
 	const int WINDOW_WIDTH = 400;
@@ -57,7 +63,7 @@ class D3D
 	ComPtr<ID3D12DescriptorHeap> mDescHeapRtv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapDsv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapCbvSrvUav[MaxFrameLatency];
-	void* mCBUploadPtr = nullptr;
+	FrameAllocator mCBAllocator; // Constants of every frame in flight
 
 	ComPtr<ID3D12RootSignature> mRootSignature;
 	ComPtr<ID3D12PipelineState> mPso;
@@ -70,10 +76,17 @@ class D3D
 	ComPtr<ID3D12Resource> mCB;
 
 	ComPtr<ID3D12CommandSignature> mCmdSignature;
-	ComPtr<ID3D12Resource> mIndirectCmdBuf;
+	UploadRing<ID3D12Resource*> mUploadRing; // Staging memory, released by fence value
 	ComPtr<ID3D12Resource> mIndirectCmdBufOnDefaultHeap;
-	void* mIndirectCmdBufUploadPtr = nullptr;
 	UINT mIndirectCmdBufStride = 0;
+	UINT mMaxCommandCount = 0; // per frame
+	UINT mCommandCount = 0;
+	vector<MeshletBuilder::Meshlet> mMeshlets;
+	vector<uint32_t> mVisibleMeshlets;
+	vector<XMFLOAT4X4> mInstanceWorldViewProj;
+	vector<XMFLOAT3> mInstanceCameraPosition;
+	InstanceTransform::Instances mInstances;
+	D3D12_GPU_VIRTUAL_ADDRESS mInstanceCB = 0; // this frame's constants, CB_ALIGNED_SIZE per instance
 
 public:
 	D3D(int width, int height, HWND hWnd)
@@ -233,6 +246,23 @@ public:
 
 		WaveFrontReader<uint16_t> mesh;
 		CHK(mesh.Load(L"../Mesh/teapot.obj"));
+#if USE_MESHLET_CULLING
+		mMeshlets = MeshletBuilder::build(mesh.indices.data(), mesh.indices.size(), mesh.attributes.data(),
+			mesh.vertices.data(), sizeof(mesh.vertices[0]), mesh.vertices.size());
+		mVisibleMeshlets.resize(mMeshlets.size());
+		mInstanceWorldViewProj.resize(mInstanceCount);
+		mInstanceCameraPosition.resize(mInstanceCount);
+		mMaxCommandCount = static_cast<UINT>(mInstanceCount * mMeshlets.size());
+#else
+		mMaxCommandCount = mInstanceCount;
+#endif
+		mInstances.resize(mInstanceCount);
+		for (auto tid = 0u; tid < mInstanceCount; tid++)
+		{
+			mInstances.x[tid] = 0.5f * ((tid & 1) ? 1 : -1);
+			mInstances.y[tid] = 0.2f + 0.5f * ((tid & 2) ? -1 : 1);
+			mInstances.sx[tid] = mInstances.sy[tid] = mInstances.sz[tid] = 0.5f;
+		}
 
 		mIndexCount = static_cast<UINT>(mesh.indices.size());
 		mVBIndexOffset = static_cast<UINT>(sizeof(mesh.vertices[0]) * mesh.vertices.size());
@@ -286,29 +316,18 @@ public:
 
 #define CB_SIZE 128
 #define CB_ALIGNED_SIZE ((CB_SIZE + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) & ~(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1))
-		UINT cbSize = CB_ALIGNED_SIZE;
+#define CB_RING_SIZE (64 * 1024) // Shared by all frames in flight, one batch of mInstanceCount per frame
 		CHK(mDev->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(cbSize * MaxFrameLatency * mInstanceCount),
+			&CD3DX12_RESOURCE_DESC::Buffer(CB_RING_SIZE),
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			nullptr,
 			IID_PPV_ARGS(mCB.ReleaseAndGetAddressOf())));
 		mCB->SetName(L"ConstantBuffer");
-		auto cbvDescHeapIncSize = mDev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-		for (auto i = 0u; i < MaxFrameLatency; ++i)
-		{
-			for (auto j = 0u; j < mInstanceCount; ++j)
-			{
-				D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-				cbvDesc.BufferLocation = mCB->GetGPUVirtualAddress() + (i * mInstanceCount + j) * cbSize;
-				cbvDesc.SizeInBytes = cbSize;
-				auto cbvSrvUavHeapDesc = mDescHeapCbvSrvUav[i]->GetCPUDescriptorHandleForHeapStart();
-				cbvSrvUavHeapDesc.ptr += j * cbvDescHeapIncSize;
-				mDev->CreateConstantBufferView(&cbvDesc, cbvSrvUavHeapDesc);
-			}
-		}
-		CHK(mCB->Map(0, nullptr, reinterpret_cast<void**>(&mCBUploadPtr)));
+		void* cbUploadPtr = nullptr;
+		CHK(mCB->Map(0, nullptr, &cbUploadPtr));
+		mCBAllocator.init(cbUploadPtr, mCB->GetGPUVirtualAddress(), CB_RING_SIZE);
 
 		{
 			D3D12_INDIRECT_ARGUMENT_DESC param[2];
@@ -323,28 +342,49 @@ public:
 
 			mIndirectCmdBufStride = cmdSignatureDesc.ByteStride;
 
-			CHK(mDev->CreateCommittedResource(
-				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-				D3D12_HEAP_FLAG_NONE,
-				&CD3DX12_RESOURCE_DESC::Buffer(cmdSignatureDesc.ByteStride * MaxFrameLatency * mInstanceCount),
-				D3D12_RESOURCE_STATE_GENERIC_READ,
-				nullptr,
-				IID_PPV_ARGS(mIndirectCmdBuf.ReleaseAndGetAddressOf())));
-			CHK(mIndirectCmdBuf->Map(0, nullptr, reinterpret_cast<void**>(&mIndirectCmdBufUploadPtr)));
-
 			CHK(mDev->CreateCommittedResource(
 				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 				D3D12_HEAP_FLAG_NONE,
-				&CD3DX12_RESOURCE_DESC::Buffer(cmdSignatureDesc.ByteStride * MaxFrameLatency * mInstanceCount),
+				&CD3DX12_RESOURCE_DESC::Buffer(cmdSignatureDesc.ByteStride * MaxFrameLatency * mMaxCommandCount),
 				D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT,
 				nullptr,
 				IID_PPV_ARGS(mIndirectCmdBufOnDefaultHeap.ReleaseAndGetAddressOf())));
 		}
+
+#define UPLOAD_RING_SIZE (1024 * 1024) // Larger uploads get their own buffer
+		bool uploadRingCreated = mUploadRing.init(UPLOAD_RING_SIZE,
+			[this](uint64_t size, UploadRing<ID3D12Resource*>::Buffer& buffer)
+			{
+				ID3D12Resource* resource = nullptr;
+				if (FAILED(mDev->CreateCommittedResource(
+					&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+					D3D12_HEAP_FLAG_NONE,
+					&CD3DX12_RESOURCE_DESC::Buffer(size),
+					D3D12_RESOURCE_STATE_GENERIC_READ,
+					nullptr,
+					IID_PPV_ARGS(&resource))))
+					return false;
+				resource->SetName(L"UploadRing");
+				void* data = nullptr;
+				if (FAILED(resource->Map(0, nullptr, &data)))
+				{
+					resource->Release();
+					return false;
+				}
+				buffer = { resource, data, resource->GetGPUVirtualAddress(), size };
+				return true;
+			},
+			[](UploadRing<ID3D12Resource*>::Buffer& buffer)
+			{
+				buffer.resource->Unmap(0, nullptr);
+				buffer.resource->Release();
+			});
+		if (!uploadRingCreated)
+			throw runtime_error("Failed to create upload ring.");
 	}
 	~D3D()
 	{
 		mCB->Unmap(0, nullptr);
-		mIndirectCmdBuf->Unmap(0, nullptr);
 		CloseHandle(mFenceEveneHandle);
 	}
 	ID3D12Device* GetDevice() const
@@ -369,6 +409,8 @@ public:
 
 			CHK(mCmdAlloc[cmdIndex]->Reset());
 		}
+		mCBAllocator.reclaim(mFence->GetCompletedValue());
+		mUploadRing.reclaim(mFence->GetCompletedValue());
 
 		CHK(cmdList->Reset(mCmdAlloc[cmdIndex].Get(), nullptr));
 
@@ -378,25 +420,37 @@ public:
 			rot += 1.0f;
 			if (rot >= 360.0f) rot = 0.0f;
 
+			float sinHalf, cosHalf;
+			XMScalarSinCos(&sinHalf, &cosHalf, XMConvertToRadians(rot) * 0.5f);
 			for (auto tid = 0u; tid < mInstanceCount; tid++)
 			{
-				XMMATRIX worldMat, viewMat, projMat;
-				worldMat = XMMatrixIdentity();
-				worldMat *= XMMatrixScaling(0.5f, 0.5f, 0.5f);
-				worldMat *= XMMatrixRotationY(XMConvertToRadians(rot));
-				worldMat *= XMMatrixTranslation(0.5f * ((tid & 1) ? 1 : -1), 0.2f + 0.5f * ((tid & 2) ? -1 : 1), 0);
-				viewMat = XMMatrixLookAtLH({ 0, 0.5f, -1.5f }, { 0, 0.5f, 0 }, { 0, 1, 0 });
-				projMat = XMMatrixPerspectiveFovLH(45, (float)mBufferWidth / mBufferHeight, 0.01f, 50.0f);
-				auto mvpMat = XMMatrixTranspose(worldMat * viewMat * projMat);
-
-				auto worldTransMat = XMMatrixTranspose(worldMat);
-
-				// mCBUploadPtr is Write-Combine memory
-				// Shift offset to guarantee that the pointer has not referred by executing command list.
-				char* ptr = reinterpret_cast<char*>(mCBUploadPtr) + CB_ALIGNED_SIZE * (cmdIndex * mInstanceCount + tid);
-				memcpy_s(ptr, 64, &mvpMat, 64);
-				memcpy_s(ptr + 64, 64, &worldTransMat, 64);
+				mInstances.qy[tid] = sinHalf;
+				mInstances.qw[tid] = cosHalf;
 			}
+
+			XMVECTOR eye = XMVectorSet(0, 0.5f, -1.5f, 1);
+			XMMATRIX viewMat = XMMatrixLookAtLH(eye, { 0, 0.5f, 0 }, { 0, 1, 0 });
+			XMMATRIX projMat = XMMatrixPerspectiveFovLH(45, (float)mBufferWidth / mBufferHeight, 0.01f, 50.0f);
+			XMFLOAT4X4 viewProj;
+			XMStoreFloat4x4(&viewProj, viewMat * projMat);
+
+			// All instances in one batch, the ring is Write-Combine memory
+			auto cb = mCBAllocator.allocate(CB_ALIGNED_SIZE * mInstanceCount);
+			if (!cb.data)
+				throw runtime_error("Constant buffer ring is full.");
+			mInstanceCB = cb.gpuAddress;
+#if USE_MESHLET_CULLING
+			// Culling runs in object space: frustum planes come from world-view-projection,
+			// the camera is moved by the inverse world matrix
+			InstanceTransform::computeConstants(mInstances, 0, mInstanceCount, &viewProj.m[0][0], cb.data, CB_ALIGNED_SIZE,
+				&mInstanceWorldViewProj[0].m[0][0]);
+			XMFLOAT3 eyePosition;
+			XMStoreFloat3(&eyePosition, eye);
+			for (auto tid = 0u; tid < mInstanceCount; tid++)
+				InstanceTransform::toObjectSpace(mInstances, tid, &eyePosition.x, &mInstanceCameraPosition[tid].x);
+#else
+			InstanceTransform::computeConstants(mInstances, 0, mInstanceCount, &viewProj.m[0][0], cb.data, CB_ALIGNED_SIZE);
+#endif
 		}
 
 		// Upload indirect parameters
@@ -404,29 +458,51 @@ public:
 			// transition
 			setResourceBarrier(cmdList, mIndirectCmdBufOnDefaultHeap.Get(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_COPY_DEST);
 
+			mCommandCount = 0;
+			auto upload = mUploadRing.allocate(mIndirectCmdBufStride * mMaxCommandCount);
+			if (!upload.data)
+				throw runtime_error("Failed to allocate upload memory.");
 			for (auto tid = 0u; tid < mInstanceCount; tid++)
 			{
-				// set parameters on upload heap
-				char* ptr = reinterpret_cast<char*>(mIndirectCmdBufUploadPtr) + mIndirectCmdBufStride * (cmdIndex * mInstanceCount + tid);
-				UINT* ptrU = reinterpret_cast<UINT*>(ptr);
-
-				// Bytes 0:7 - D3D12_INDIRECT_PARAMETER_CONSTANT_BUFFER_VIEW
-				*reinterpret_cast<D3D12_GPU_VIRTUAL_ADDRESS*>(ptrU)
-					= mCB->GetGPUVirtualAddress() + CB_ALIGNED_SIZE * (cmdIndex * mInstanceCount + tid);
-				// Bytes 8:27 - D3D12_INDIRECT_PARAMETER_DRAW_INDEXED
-				ptrU[2] = mIndexCount;
-				ptrU[3] = 1;
-				ptrU[4] = 0;
-				ptrU[5] = 0;
-				ptrU[6] = 0;
+				auto cbAddress = mInstanceCB + tid * CB_ALIGNED_SIZE;
+#if USE_MESHLET_CULLING
+				float planes[6][4];
+				MeshletBuilder::extractFrustumPlanes(&mInstanceWorldViewProj[tid].m[0][0], planes);
+				size_t visibleCount = MeshletBuilder::cull(mMeshlets.data(), mMeshlets.size(), planes, &mInstanceCameraPosition[tid].x, mVisibleMeshlets.data());
+#else
+				size_t visibleCount = 1;
+#endif
+				for (size_t i = 0; i < visibleCount; i++)
+				{
+					// set parameters on upload heap
+					char* ptr = reinterpret_cast<char*>(upload.data) + mIndirectCmdBufStride * mCommandCount++;
+					UINT* ptrU = reinterpret_cast<UINT*>(ptr);
+
+					// Bytes 0:7 - D3D12_INDIRECT_PARAMETER_CONSTANT_BUFFER_VIEW
+					*reinterpret_cast<D3D12_GPU_VIRTUAL_ADDRESS*>(ptrU) = cbAddress;
+					// Bytes 8:27 - D3D12_INDIRECT_PARAMETER_DRAW_INDEXED
+#if USE_MESHLET_CULLING
+					auto args = MeshletBuilder::drawArguments(mMeshlets[mVisibleMeshlets[i]]);
+					memcpy(ptrU + 2, &args, sizeof(args));
+#else
+					ptrU[2] = mIndexCount;
+					ptrU[3] = 1;
+					ptrU[4] = 0;
+					ptrU[5] = 0;
+					ptrU[6] = 0;
+#endif
+				}
 			}
 
 			// copy parameters to default heap
-			cmdList->CopyBufferRegion(mIndirectCmdBufOnDefaultHeap.Get(),
-										mIndirectCmdBufStride * mInstanceCount * cmdIndex,
-										mIndirectCmdBuf.Get(),
-										mIndirectCmdBufStride * mInstanceCount * cmdIndex,
-										mIndirectCmdBufStride * mInstanceCount);
+			if (mCommandCount)
+			{
+				cmdList->CopyBufferRegion(mIndirectCmdBufOnDefaultHeap.Get(),
+											mIndirectCmdBufStride * mMaxCommandCount * cmdIndex,
+											upload.resource,
+											upload.offset,
+											mIndirectCmdBufStride * mCommandCount);
+			}
 
 			// transition
 			setResourceBarrier(cmdList, mIndirectCmdBufOnDefaultHeap.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
@@ -480,8 +556,7 @@ public:
 			{
 				//cmdList->SetGraphicsRootDescriptorTable(0,
 				//	mDescHeapCbvSrvUav[cmdIndex]->GetGPUDescriptorHandleForHeapStart().MakeOffsetted(tid * cbvDescHeapIncSize));
-				cmdList->SetGraphicsRootConstantBufferView(0,
-					mCB->GetGPUVirtualAddress() + CB_ALIGNED_SIZE * (cmdIndex * mInstanceCount + tid));
+				cmdList->SetGraphicsRootConstantBufferView(0, mInstanceCB + tid * CB_ALIGNED_SIZE);
 				cmdList->SetPipelineState(mPso.Get());
 				cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 				cmdList->IASetVertexBuffers(0, 1, &mVBView);
@@ -496,12 +571,12 @@ public:
 		cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		cmdList->IASetVertexBuffers(0, 1, &mVBView);
 		cmdList->IASetIndexBuffer(&mIBView);
-		for (auto i = 0u; i < mInstanceCount; i++)
+		if (mCommandCount)
 		{
 			cmdList->ExecuteIndirect(mCmdSignature.Get(),
-				1,
+				mCommandCount,
 				mIndirectCmdBufOnDefaultHeap.Get(),
-				mIndirectCmdBufStride * (mInstanceCount * cmdIndex + i),
+				mIndirectCmdBufStride * mMaxCommandCount * cmdIndex,
 				nullptr,
 				0);
 		}
@@ -515,6 +590,8 @@ public:
 		ID3D12CommandList* const cmdLists = cmdList;
 		cmdQueue->ExecuteCommandLists(1, &cmdLists);
 		CHK(cmdQueue->Signal(mFence.Get(), mFrameCount));
+		mCBAllocator.endFrame(mFrameCount);
+		mUploadRing.close(mFrameCount);
 
 		// Present
 		CHK(mSwapChain->Present(1, 0));
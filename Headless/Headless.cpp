@@ -0,0 +1,591 @@
+// Runs the Multithread frame loop on the null device, without a GPU or a
+// window, and reports the CPU time per frame. The loop records what Multithread
+// records, through FrameRecording: a prologue list, batches of draws recorded by
+// the job system on lists from a CommandPool and submitted in order, and an
+// epilogue list.
+// Portable; on Linux: g++ -std=c++14 -O2 -mavx2 -c ../_common/InstanceTransformAvx2.cpp
+//   g++ -std=c++14 -O2 -pthread Headless.cpp InstanceTransformAvx2.o -o Headless
+// Usage: Headless [frames] [draws] [indirect] [capture] [threads=N] [pipeline [latency=N] [gpu=US]]
+// The options may come before, between or after frames and draws.
+// indirect draws every teapot with one ExecuteIndirect instead of the batches.
+// pipeline paces the frames with FramePipeline against a SimulatedQueue that takes
+// gpu microseconds per frame (500 by default), and prints the pipeline's summary.
+// capture records each batch into a command stream and replays it onto its list,
+// then prints the redundant state sets of the last frame and its diff with the one before.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "../_common/NullDevice.h"
+#include "../_common/FrameAllocator.h"
+#include "../_common/InstanceTransform.h"
+#include "../_common/CommandCapture.h"
+#include "../_common/CommandPool.h"
+#include "../_common/DrawBatching.h"
+#include "../_common/JobSystem.h"
+#include "../_common/FrameRecording.h"
+#include "../_common/FramePipeline.h"
+#include "../_common/SimulatedQueue.h"
+
+using namespace std;
+using namespace NullDevice;
+
+namespace
+{
+	const int BUFFER_WIDTH = 400;
+	const int BUFFER_HEIGHT = 240;
+	const int BUFFER_COUNT = 2;
+	// Mesh/teapot.obj as WaveFrontReader loads it: 1292 vertices of position, normal
+	// and texcoord, 2464 triangles
+	const uint32_t TEAPOT_INDEX_COUNT = 7392;
+	const uint32_t TEAPOT_VERTEX_COUNT = 1292;
+	const uint32_t TEAPOT_VERTEX_STRIDE = 32;
+};
+
+#define CB_SIZE 128
+#define CB_ALIGNED_SIZE ((CB_SIZE + FrameAllocator::Alignment - 1) & ~(FrameAllocator::Alignment - 1))
+#define CB_RING_SIZE (16 * 1024 * 1024) // Shared by all frames in flight
+#define MAX_DRAW_COUNT 16384
+#define CAPTURE_STREAM_SIZE (MAX_DRAW_COUNT * 16 + 4096) // bytes per batch, at most
+#define CAPTURE_RING_SIZE (CAPTURE_STREAM_SIZE * 4)
+
+// Arguments of one indirect draw: root CBV + DrawIndexedInstanced
+struct IndirectCommand
+{
+	uint64_t cbvAddress;
+	uint32_t indexCountPerInstance;
+	uint32_t instanceCount;
+	uint32_t startIndexLocation;
+	int32_t baseVertexLocation;
+	uint32_t startInstanceLocation;
+	uint32_t padding;
+};
+
+class Headless
+{
+	typedef chrono::steady_clock Clock;
+	static const uint32_t MaxFrameLatency = 2;
+
+	Device mDev;
+	CommandQueue* mCmdQueue;
+	SwapChain* mSwapChain;
+	typedef CommandPool<CommandAllocator*, CommandList*> CmdPool;
+	CmdPool mCmdPool; // allocators recycled by fence value
+	Fence* mFence;
+	uint64_t mFrameCount = 0;
+
+	DescriptorHeap* mDescHeapRtv;
+	DescriptorHeap* mDescHeapDsv;
+	DescriptorHeap* mDescHeapCbvSrvUav[MaxFrameLatency];
+	RootSignature* mRootSignature;
+	PipelineState* mPso;
+	CommandSignature* mCmdSignature;
+	Resource* mVB;
+	Resource* mDB;
+	Resource* mCB;
+	Resource* mIndirectUpload[MaxFrameLatency];
+	Resource* mIndirectArgs;
+	FrameAllocator mCBAllocator;
+	InstanceTransform::Instances mInstances;
+	JobSystem mJobs; // records the batches
+	vector<DrawBatching::Draw> mDraws; // one per teapot, in submission order
+	vector<FrameRecording::Draw> mDrawArgs; // indices of each draw
+	vector<DrawBatching::Batch> mBatches; // one command list each
+	DrawBatching::OrderedSubmitter mSubmitter;
+	vector<CmdPool::Pair> mBatchCmdPairs;
+	vector<CommandList*> mBatchCmdLists;
+	uint32_t mDrawCount;
+	bool mIndirect;
+	bool mCapture;
+	vector<CommandCapture::Writer> mBatchStreams; // one per batch
+	CommandCapture::Ring mCaptureRing; // the last frames' streams
+
+public:
+	// Microseconds per phase, summed over the frames
+	double mConstantsTime = 0, mDescriptorTime = 0, mRecordTime = 0, mPresentTime = 0;
+	uint64_t mCapturedBytes = 0;
+	uint32_t mCaptureOverflows = 0; // batches recorded straight onto their list
+
+	Headless(uint32_t drawCount, bool indirect, bool capture, unsigned threadCount)
+		: mDrawCount(drawCount), mIndirect(indirect), mCapture(capture)
+	{
+		if (drawCount == 0 || drawCount > MAX_DRAW_COUNT)
+			throw runtime_error("Draw count is out of range.");
+
+		mCmdQueue = mDev.GetQueue();
+		mCmdQueue->SetLatency(1); // the GPU one frame behind
+		mSwapChain = mDev.CreateSwapChain(BUFFER_WIDTH, BUFFER_HEIGHT, BUFFER_COUNT);
+
+		// The device owns its objects; the pool serializes creating them
+		CmdPool::Callbacks cmdPoolCallbacks;
+		cmdPoolCallbacks.createAllocator = [this](CommandAllocator*& allocator)
+		{
+			allocator = mDev.CreateCommandAllocator();
+			return true;
+		};
+		cmdPoolCallbacks.createList = [this](CommandAllocator* allocator, CommandList*& list)
+		{
+			list = mDev.CreateCommandList(allocator, nullptr);
+			return true;
+		};
+		cmdPoolCallbacks.resetAllocator = [](CommandAllocator* allocator) { allocator->Reset(); };
+		cmdPoolCallbacks.resetList = [](CommandList* list, CommandAllocator* allocator) { list->Reset(allocator, nullptr); };
+		cmdPoolCallbacks.releaseAllocator = [](CommandAllocator*) {};
+		cmdPoolCallbacks.releaseList = [](CommandList*) {};
+		mCmdPool.init(cmdPoolCallbacks);
+		mFence = mDev.CreateFence(0);
+
+		mJobs.init(threadCount);
+		if (capture)
+		{
+			mBatchStreams.resize(mJobs.threadCount());
+			for (auto& stream : mBatchStreams)
+			{
+				stream.init(CAPTURE_STREAM_SIZE);
+			}
+			mCaptureRing.init(CAPTURE_RING_SIZE, 4 * mJobs.threadCount());
+		}
+
+		mDescHeapRtv = mDev.CreateDescriptorHeap(DescriptorHeapType::Rtv, BUFFER_COUNT, false);
+		for (int i = 0; i < BUFFER_COUNT; i++)
+		{
+			auto handle = mDescHeapRtv->GetCPUDescriptorHandleForHeapStart();
+			handle.ptr += i * mDev.GetDescriptorHandleIncrementSize(DescriptorHeapType::Rtv);
+			mDev.CreateRenderTargetView(mSwapChain->GetBuffer(i), handle);
+		}
+		mDescHeapDsv = mDev.CreateDescriptorHeap(DescriptorHeapType::Dsv, 1, false);
+		mDB = mDev.CreateTexture2D(BUFFER_WIDTH, BUFFER_HEIGHT, 4, StateDepthWrite);
+		mDev.CreateDepthStencilView(mDB, mDescHeapDsv->GetCPUDescriptorHandleForHeapStart());
+		for (auto& h : mDescHeapCbvSrvUav)
+		{
+			h = mDev.CreateDescriptorHeap(DescriptorHeapType::CbvSrvUav, MAX_DRAW_COUNT, true);
+		}
+
+		mRootSignature = mDev.CreateRootSignature();
+		mPso = mDev.CreatePipelineState();
+		mCmdSignature = mDev.CreateCommandSignature(sizeof(IndirectCommand));
+
+		// Vertex (24 bytes) and 16-bit index data of the teapot in one buffer
+		mVB = mDev.CreateBuffer(HeapType::Default, TEAPOT_VERTEX_COUNT * TEAPOT_VERTEX_STRIDE + TEAPOT_INDEX_COUNT * 2, StateGenericRead);
+
+		mCB = mDev.CreateBuffer(HeapType::Upload, CB_RING_SIZE, StateGenericRead);
+		mCBAllocator.init(mCB->Map(), mCB->GetGPUVirtualAddress(), CB_RING_SIZE);
+
+		// Count (4 bytes, 256-byte aligned) then the commands
+		for (auto& u : mIndirectUpload)
+		{
+			u = mDev.CreateBuffer(HeapType::Upload, 256 + MAX_DRAW_COUNT * sizeof(IndirectCommand), StateGenericRead);
+		}
+		mIndirectArgs = mDev.CreateBuffer(HeapType::Default, 256 + MAX_DRAW_COUNT * sizeof(IndirectCommand), StateIndirectArgument);
+
+		// A grid of teapots, every one drawn whole with mPso
+		mDraws.assign(drawCount, { TEAPOT_INDEX_COUNT, 0 });
+		mDrawArgs.assign(drawCount, { TEAPOT_INDEX_COUNT, 0 });
+		mInstances.resize(drawCount);
+		uint32_t side = 1;
+		while (side * side < drawCount)
+			side++;
+		for (uint32_t i = 0; i < drawCount; i++)
+		{
+			mInstances.x[i] = (float)(i % side) - side * 0.5f;
+			mInstances.z[i] = (float)(i / side) + 2.0f;
+			mInstances.sx[i] = mInstances.sy[i] = mInstances.sz[i] = 0.5f;
+		}
+	}
+
+	void Draw()
+	{
+		mFrameCount++;
+
+		int cmdIndex = mFrameCount % MaxFrameLatency;
+
+		// Wait untill the descriptor heap of this frame be freed
+		if (mFrameCount > MaxFrameLatency)
+		{
+			if (!mFence->Wait(mFrameCount - MaxFrameLatency))
+				throw runtime_error("Fence value was never signaled.");
+		}
+		mCBAllocator.reclaim(mFence->GetCompletedValue());
+		mCmdPool.reclaim(mFence->GetCompletedValue());
+
+		// Constants of every teapot
+		auto t0 = Clock::now();
+		auto cb = mCBAllocator.allocate(CB_ALIGNED_SIZE * mDrawCount);
+		if (!cb.data)
+			throw runtime_error("Constant buffer ring is full.");
+		{
+			float angle = mFrameCount * 0.0174533f;
+			for (uint32_t i = 0; i < mDrawCount; i++)
+			{
+				mInstances.qy[i] = sinf(angle * 0.5f);
+				mInstances.qw[i] = cosf(angle * 0.5f);
+			}
+			// Fixed camera: a translation back and a plain perspective scale, row-major
+			const float viewProj[16] = {
+				1.3f, 0, 0, 0,
+				0, 2.2f, 0, 0,
+				0, 0, 1.0f, 1,
+				0, -1.1f, 1.5f, 1.5f,
+			};
+			InstanceTransform::computeConstants(mInstances, 0, mDrawCount, viewProj, cb.data, CB_ALIGNED_SIZE);
+		}
+
+		// Descriptors or indirect arguments, on this thread as the device is not thread-safe
+		auto t1 = Clock::now();
+		auto cbvDescHeapIncSize = mDev.GetDescriptorHandleIncrementSize(DescriptorHeapType::CbvSrvUav);
+		if (mIndirect)
+		{
+			auto* upload = static_cast<uint8_t*>(mIndirectUpload[cmdIndex]->Map());
+			memcpy(upload, &mDrawCount, 4);
+			auto* commands = reinterpret_cast<IndirectCommand*>(upload + 256);
+			for (uint32_t i = 0; i < mDrawCount; i++)
+			{
+				commands[i] = { cb.gpuAddress + i * CB_ALIGNED_SIZE, TEAPOT_INDEX_COUNT, 1, 0, 0, 0, 0 };
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < mDrawCount; i++)
+			{
+				auto handle = mDescHeapCbvSrvUav[cmdIndex]->GetCPUDescriptorHandleForHeapStart();
+				handle.ptr += i * cbvDescHeapIncSize;
+				mDev.CreateConstantBufferView(cb.gpuAddress + i * CB_ALIGNED_SIZE, CB_ALIGNED_SIZE, handle);
+			}
+		}
+
+		// Record and execute
+		auto t2 = Clock::now();
+		uint32_t backBuffer = mSwapChain->GetCurrentBackBufferIndex();
+		Resource* d3dBuffer = mSwapChain->GetBuffer(backBuffer);
+		auto descHandleRtv = mDescHeapRtv->GetCPUDescriptorHandleForHeapStart();
+		descHandleRtv.ptr += backBuffer * mDev.GetDescriptorHandleIncrementSize(DescriptorHeapType::Rtv);
+		auto descHandleDsv = mDescHeapDsv->GetCPUDescriptorHandleForHeapStart();
+
+		// Barrier Present -> RenderTarget, clear
+		auto prol = acquireCmdList();
+		{
+			float clearColor[4] = { 0.1f, 0.2f, 0.3f, 1.0f };
+			FrameRecording::recordPrologue(*prol.list, d3dBuffer, descHandleRtv.ptr, descHandleDsv.ptr, clearColor);
+		}
+		execute(prol);
+
+		FrameRecording::Pass pass = {};
+		pass.rootSignature = mRootSignature;
+		pass.pipelineState = mPso;
+		pass.descriptorHeap = mDescHeapCbvSrvUav[cmdIndex];
+		pass.table = mDescHeapCbvSrvUav[cmdIndex]->GetGPUDescriptorHandleForHeapStart().ptr;
+		pass.tableStep = cbvDescHeapIncSize;
+		pass.rtv = descHandleRtv.ptr;
+		pass.dsv = descHandleDsv.ptr;
+		pass.width = BUFFER_WIDTH;
+		pass.height = BUFFER_HEIGHT;
+		pass.vertexBuffer = mVB->GetGPUVirtualAddress();
+		pass.vertexBufferSize = TEAPOT_VERTEX_COUNT * TEAPOT_VERTEX_STRIDE;
+		pass.vertexStride = TEAPOT_VERTEX_STRIDE;
+		pass.indexBuffer = mVB->GetGPUVirtualAddress() + TEAPOT_VERTEX_COUNT * TEAPOT_VERTEX_STRIDE;
+		pass.indexBufferSize = TEAPOT_INDEX_COUNT * 2;
+		pass.indexFormat = FormatR16Uint;
+
+		if (mIndirect)
+		{
+			// One batch draws every teapot
+			mBatches.assign(1, { 0, mDrawCount, 0 });
+			auto pair = acquireCmdList();
+			recordList(*pair.list, 0, [&](auto& list) { recordIndirect(list, pass, cmdIndex); });
+			execute(pair);
+		}
+		else
+		{
+			// Split the draws into batches of similar recording cost, at most one per worker thread
+			DrawBatching::partition(mDraws.data(), mDraws.size(), mJobs.threadCount(), DrawBatching::CostModel(), mBatches);
+			mBatchCmdPairs.resize(mBatches.size());
+			mBatchCmdLists.resize(mBatches.size());
+			FrameRecording::recordBatches(mJobs, mBatches, mSubmitter, [&](uint32_t batch)
+			{
+				mBatchCmdPairs[batch] = acquireCmdList();
+				auto* cmdList = mBatchCmdPairs[batch].list;
+				mBatchCmdLists[batch] = cmdList;
+				recordList(*cmdList, batch, [&](auto& list)
+				{
+					FrameRecording::recordBatch(list, pass, mDrawArgs.data(), mBatches[batch]);
+				});
+				cmdList->Close();
+			},
+			[&](uint32_t first, uint32_t count)
+			{
+				mCmdQueue->ExecuteCommandLists(count, mBatchCmdLists.data() + first);
+				for (auto i = first; i < first + count; i++)
+				{
+					mCmdPool.submit(mBatchCmdPairs[i], mFrameCount, mBatchCmdLists[i]->size());
+				}
+			});
+		}
+		if (mCapture)
+		{
+			for (auto batch = 0u; batch < mBatches.size(); batch++)
+			{
+				// A stream that overflowed keeps the commands before; its batch was recorded straight onto the list
+				auto& stream = mBatchStreams[batch];
+				if (stream.droppedCount())
+					mCaptureOverflows++;
+				mCaptureRing.append(mFrameCount, stream.data(), stream.size());
+				mCapturedBytes += stream.size();
+			}
+		}
+
+		// Barrier RenderTarget -> Present
+		auto epir = acquireCmdList();
+		FrameRecording::recordEpilogue(*epir.list, d3dBuffer);
+		execute(epir);
+		mCmdQueue->Signal(mFence, mFrameCount);
+		mCBAllocator.endFrame(mFrameCount);
+
+		// Present
+		auto t3 = Clock::now();
+		mSwapChain->Present();
+		auto t4 = Clock::now();
+
+		mConstantsTime += chrono::duration<double, micro>(t1 - t0).count();
+		mDescriptorTime += chrono::duration<double, micro>(t2 - t1).count();
+		mRecordTime += chrono::duration<double, micro>(t3 - t2).count();
+		mPresentTime += chrono::duration<double, micro>(t4 - t3).count();
+	}
+
+	// Prints the redundant state sets of the last captured frame and its diff with the frame before
+	void PrintCapture()
+	{
+		vector<CommandCapture::Span> last, previous;
+		if (!mCaptureRing.frame(mFrameCount, last) || !mCaptureRing.frame(mFrameCount - 1, previous))
+			throw runtime_error("No captured frames.");
+		CommandCapture::Analysis analysis = {};
+		CommandCapture::Diff diff;
+		for (auto& stream : last)
+		{
+			if (!CommandCapture::analyze(stream.data, stream.size, analysis))
+				throw runtime_error("Malformed command stream.");
+		}
+		if (!CommandCapture::diff(previous.data(), (uint32_t)previous.size(), last.data(), (uint32_t)last.size(), diff))
+			throw runtime_error("Malformed command stream.");
+		vector<char> text(16 * 1024);
+		CommandCapture::print(analysis, text.data(), text.size());
+		printf("frame %llu: %s", (unsigned long long)mFrameCount, text.data());
+		CommandCapture::print(diff, text.data(), text.size());
+		printf("diff with frame %llu: %s", (unsigned long long)(mFrameCount - 1), text.data());
+	}
+
+private:
+	CmdPool::Pair acquireCmdList()
+	{
+		auto pair = mCmdPool.acquire();
+		if (!pair.list)
+			throw runtime_error("Failed to create a command list.");
+		return pair;
+	}
+
+	void execute(const CmdPool::Pair& pair)
+	{
+		pair.list->Close();
+		mCmdQueue->ExecuteCommandLists(1, &pair.list);
+		mCmdPool.submit(pair, mFrameCount, pair.list->size());
+	}
+
+	// Records onto list, through the batch's stream when capturing
+	template<class Record>
+	void recordList(CommandList& list, uint32_t batch, Record record)
+	{
+		if (mCapture)
+			CommandCapture::recordAndReplay(mBatchStreams[batch], list, record);
+		else
+			record(list);
+	}
+
+	// The state of a batch without draws, then every teapot through ExecuteIndirect
+	template<class List>
+	void recordIndirect(List& list, const FrameRecording::Pass& pass, int cmdIndex)
+	{
+		FrameRecording::recordBatch(list, pass, mDrawArgs.data(), DrawBatching::Batch{ 0, 0, 0 });
+		uint64_t argsSize = 256 + mDrawCount * sizeof(IndirectCommand);
+		list.ResourceBarrier(mIndirectArgs, StateIndirectArgument, StateCopyDest);
+		list.CopyBufferRegion(mIndirectArgs, 0, mIndirectUpload[cmdIndex], 0, argsSize);
+		list.ResourceBarrier(mIndirectArgs, StateCopyDest, StateIndirectArgument);
+		list.ExecuteIndirect(mCmdSignature, MAX_DRAW_COUNT, mIndirectArgs, 256, mIndirectArgs, 0);
+	}
+
+public:
+	void Finish()
+	{
+		mCmdQueue->Flush();
+	}
+
+	void ResetTimes()
+	{
+		mConstantsTime = mDescriptorTime = mRecordTime = mPresentTime = 0;
+		mCapturedBytes = 0;
+		mCaptureOverflows = 0;
+		mCmdQueue->ResetStats();
+	}
+
+	const CommandQueue::Stats& GetStats() const
+	{
+		return mCmdQueue->GetStats();
+	}
+
+	uint32_t GetThreadCount() const
+	{
+		return mJobs.threadCount();
+	}
+
+	uint64_t GetErrorCount() const
+	{
+		return mCmdQueue->GetStats().errors + mSwapChain->GetErrorCount();
+	}
+};
+
+// Draw() is the record stage; the submit stage puts gpuMicroseconds of work on the queue
+void RunPipeline(Headless& headless, uint32_t frameCount, uint32_t latency, double gpuMicroseconds)
+{
+	SimulatedQueue queue;
+	FramePipeline pipeline;
+	FramePipeline::Stages stages;
+	stages.simulate = [](uint64_t, uint32_t) {};
+	stages.record = [&](uint64_t, uint32_t) { headless.Draw(); };
+	stages.submit = [&](uint64_t frame, uint32_t)
+	{
+		queue.execute(gpuMicroseconds);
+		queue.signal(frame);
+	};
+	stages.waitForFence = [&](uint64_t value) { queue.waitForValue(value); };
+
+	pipeline.start(stages, latency);
+	queue.resetTimes();
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		pipeline.tick();
+	}
+	pipeline.stop();
+
+	auto summary = pipeline.summary(FramePipeline::HistorySize / 2 - 1);
+	double idle = queue.idleMicroseconds(), busy = queue.busyMicroseconds();
+	printf("pipeline, latency %u, %.0f us of GPU work/frame, last %u frames:\n", pipeline.latency(), gpuMicroseconds, summary.frames);
+	printf("%.2f us/frame, latency %.2f, record wait %.2f, record %.2f, GPU idle %.2f (%.1f%%, the queue measured %.1f%%)\n",
+		summary.frameInterval, summary.latency, summary.recordWait, summary.record, summary.gpuIdle,
+		summary.gpuIdleFraction * 100, idle + busy > 0 ? idle * 100 / (idle + busy) : 0.0);
+}
+
+// A decimal count of at least 1 that fits 32 bits, nothing else
+bool ParseCount(const char* text, uint32_t& value)
+{
+	if (*text < '0' || *text > '9')
+		return false;
+	char* end;
+	unsigned long long v = strtoull(text, &end, 10);
+	if (*end != '\0' || v == 0 || v > 0xFFFFFFFFull)
+		return false;
+	value = (uint32_t)v;
+	return true;
+}
+
+// A finite, non-negative number of microseconds
+bool ParseMicroseconds(const char* text, double& value)
+{
+	char* end;
+	double v = strtod(text, &end);
+	if (end == text || *end != '\0' || !std::isfinite(v) || v < 0)
+		return false;
+	value = v;
+	return true;
+}
+
+void PrintUsage()
+{
+	fprintf(stderr, "Usage: Headless [frames] [draws] [indirect] [capture] [threads=N] [pipeline [latency=N] [gpu=US]]\n"
+		"frames, draws and threads are at least 1, latency 1 to %u; the options may come in any order\n", FramePipeline::MaxLatency);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t frameCount = 10000;
+	uint32_t drawCount = 256;
+	bool indirect = false, capture = false, pipeline = false;
+	unsigned threadCount = 0; // one per core
+	uint32_t latency = 2;
+	double gpuMicroseconds = 500;
+	int counts = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		bool ok = true;
+		if (strcmp(arg, "indirect") == 0)
+			indirect = true;
+		else if (strcmp(arg, "capture") == 0)
+			capture = true;
+		else if (strcmp(arg, "pipeline") == 0)
+			pipeline = true;
+		else if (strncmp(arg, "threads=", 8) == 0)
+			ok = ParseCount(arg + 8, threadCount);
+		else if (strncmp(arg, "latency=", 8) == 0)
+			ok = ParseCount(arg + 8, latency) && latency <= FramePipeline::MaxLatency;
+		else if (strncmp(arg, "gpu=", 4) == 0)
+			ok = ParseMicroseconds(arg + 4, gpuMicroseconds);
+		else if (counts < 2)
+			ok = ParseCount(arg, counts++ == 0 ? frameCount : drawCount);
+		else
+			ok = false;
+		if (!ok)
+		{
+			fprintf(stderr, "Bad argument: %s\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	try
+	{
+		Headless headless(drawCount, indirect, capture, threadCount);
+		// Warm up the ring and the stream capacity
+		for (int i = 0; i < 10; i++)
+		{
+			headless.Draw();
+		}
+		headless.ResetTimes();
+
+		auto start = chrono::steady_clock::now();
+		if (pipeline)
+		{
+			RunPipeline(headless, frameCount, latency, gpuMicroseconds);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < frameCount; i++)
+			{
+				headless.Draw();
+			}
+		}
+		double total = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+		headless.Finish();
+
+		auto& stats = headless.GetStats();
+		printf("%u frames, %u draws, %u threads, %s%s\n", frameCount, drawCount, headless.GetThreadCount(),
+			indirect ? "ExecuteIndirect" : "descriptor table per draw", capture ? ", captured" : "");
+		printf("%.2f us/frame: constants %.2f, %s %.2f, record+execute %.2f, present %.2f\n",
+			total / frameCount, headless.mConstantsTime / frameCount, indirect ? "arguments" : "descriptors",
+			headless.mDescriptorTime / frameCount, headless.mRecordTime / frameCount, headless.mPresentTime / frameCount);
+		if (capture)
+		{
+			printf("%.0f captured bytes/frame, %u partial captures\n", (double)headless.mCapturedBytes / frameCount, headless.mCaptureOverflows);
+			headless.PrintCapture();
+		}
+		printf("%.1f lists/frame, %.0f stream bytes/frame, %.0f commands/frame, %.0f draws/frame, %llu errors\n",
+			(double)stats.lists / frameCount, (double)stats.streamBytes / frameCount, (double)stats.commands / frameCount,
+			(double)stats.draws / frameCount, (unsigned long long)headless.GetErrorCount());
+		return headless.GetErrorCount() ? 1 : 0;
+	}
+	catch (std::exception& e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+}
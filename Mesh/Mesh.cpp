@@ -10,6 +10,10 @@
 #include <DirectXMath.h>
 using DirectX::XMFLOAT3; // for WaveFrontReader
 #include "WaveFrontReader.h"
+#include "SdkMeshReader.h"
+#include "MeshOptimizer.h"
+#include "VertexQuantizer.h"
+#include "MeshCook.h"
 
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3d12.lib")
@@ -19,6 +23,9 @@ using namespace std;
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
+#define USE_SDKMESH 0
+#define USE_COMPACT_VERTEX 1 // 16-byte quantized vertices instead of 32-byte float ones
+
 namespace
 {
 	const int WINDOW_WIDTH = 400;
@@ -61,6 +68,7 @@ class D3D
 	D3D12_INDEX_BUFFER_VIEW mIBView = {};
 	UINT mIndexCount = 0;
 	UINT mVBIndexOffset = 0;
+	XMMATRIX mDequantizeMat = XMMatrixIdentity();
 	ComPtr<ID3D12Resource> mDB;
 	ComPtr<ID3D12Resource> mCB;
 
@@ -183,17 +191,27 @@ public:
 #if _DEBUG
 			flag |= D3DCOMPILE_DEBUG;
 #endif /* _DEBUG */
-			CHK(D3DCompileFromFile(L"Mesh.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", flag, 0, &vs, &info));
-			CHK(D3DCompileFromFile(L"Mesh.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", flag, 0, &ps, &info));
+			D3D_SHADER_MACRO macros[] = {
+				{ "COMPACT_VERTEX", USE_COMPACT_VERTEX ? "1" : "0" },
+				{ nullptr, nullptr },
+			};
+			CHK(D3DCompileFromFile(L"Mesh.hlsl", macros, nullptr, "VSMain", "vs_5_0", flag, 0, &vs, &info));
+			CHK(D3DCompileFromFile(L"Mesh.hlsl", macros, nullptr, "PSMain", "ps_5_0", flag, 0, &ps, &info));
 		}
+#if USE_COMPACT_VERTEX
+		UINT inputLayoutCount;
+		auto inputLayout = VertexQuantizer::compactInputLayout(inputLayoutCount);
+#else
 		D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
 			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		};
+		UINT inputLayoutCount = ARRAYSIZE(inputLayout);
+#endif
 		D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
 		psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		psoDesc.InputLayout.NumElements = 3;
+		psoDesc.InputLayout.NumElements = inputLayoutCount;
 		psoDesc.InputLayout.pInputElementDescs = inputLayout;
 		psoDesc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
 		psoDesc.pRootSignature = mRootSignature.Get();
@@ -216,15 +234,60 @@ public:
 		vs->Release();
 		ps->Release();
 
-		WaveFrontReader<uint16_t> mesh;
-		CHK(mesh.Load(L"teapot.obj"));
+#if USE_SDKMESH
+		SdkMeshReader<uint16_t> mesh;
+		CHK(mesh.Load(L"teapot.sdkmesh"));
+
+		const float* boundsCenter = &mesh.bounds.Center.x;
+		const float* boundsExtents = &mesh.bounds.Extents.x;
 
 		mIndexCount = static_cast<UINT>(mesh.indices.size());
-		mVBIndexOffset = static_cast<UINT>(sizeof(mesh.vertices[0]) * mesh.vertices.size());
 		UINT IBSize = static_cast<UINT>(sizeof(mesh.indices[0]) * mIndexCount);
-
-		void* vbData = mesh.vertices.data();
-		void* ibData = mesh.indices.data();
+		DXGI_FORMAT ibFormat = DXGI_FORMAT_R16_UINT;
+		const void* ibData = mesh.indices.data();
+#if USE_COMPACT_VERTEX
+		vector<VertexQuantizer::CompactVertex> compactVertices(mesh.vertices.size());
+		VertexQuantizer::quantize(mesh.vertices.data(), mesh.vertices.size(), boundsCenter, boundsExtents, compactVertices.data());
+		UINT vbStride = sizeof(compactVertices[0]);
+		const void* vbData = compactVertices.data();
+#else
+		UINT vbStride = sizeof(mesh.vertices[0]);
+		const void* vbData = mesh.vertices.data();
+#endif
+		mVBIndexOffset = static_cast<UINT>(vbStride * mesh.vertices.size());
+#else
+		// Cook the OBJ into the binary cache on first run, then map the cache.
+		// MeshCook recooks whenever the source, the settings or a stage of the
+		// cook change; without the source, a cache of the right format is used as is.
+		MeshCook::Settings cookSettings;
+		cookSettings.compactVertices = USE_COMPACT_VERTEX != 0;
+		MeshCook::Result cooked = MeshCook::cook(L"teapot.obj", L"teapot.vbo2", cookSettings);
+		if (cooked == MeshCook::Result::BadSource || cooked == MeshCook::Result::WriteFailed)
+			throw runtime_error("Failed to cook teapot.obj.");
+		MeshCache::View meshCache;
+		if (!meshCache.open(L"teapot.vbo2") ||
+			meshCache.header().vertexFormat != (USE_COMPACT_VERTEX ? MeshCache::VertexFormatCompact : MeshCache::VertexFormatP3N3T2))
+			throw runtime_error("Failed to open mesh cache.");
+		const float* boundsCenter = meshCache.header().boundsCenter;
+		const float* boundsExtents = meshCache.header().boundsExtents;
+
+		mIndexCount = meshCache.header().indexCount;
+		mVBIndexOffset = static_cast<UINT>(meshCache.vertexDataSize());
+		UINT IBSize = static_cast<UINT>(meshCache.indexDataSize());
+
+		UINT vbStride = meshCache.header().vertexStride;
+		DXGI_FORMAT ibFormat = meshCache.header().indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+		const void* vbData = meshCache.vertexData();
+		const void* ibData = meshCache.indexData();
+#endif
+#if USE_COMPACT_VERTEX
+		// Positions are UNORM in the bounds, fold the decode into the world-view-projection matrix
+		float dequantizeScale[3], dequantizeOffset[3];
+		VertexQuantizer::dequantizeTransform(boundsCenter, boundsExtents, dequantizeScale, dequantizeOffset);
+		mDequantizeMat = XMMatrixScaling(dequantizeScale[0], dequantizeScale[1], dequantizeScale[2]) *
+			XMMatrixTranslation(dequantizeOffset[0], dequantizeOffset[1], dequantizeOffset[2]);
+#endif
 		CHK(mDev->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 			D3D12_HEAP_FLAG_NONE,
@@ -240,10 +303,10 @@ public:
 		mVB->Unmap(0, nullptr);
 
 		mVBView.BufferLocation = mVB->GetGPUVirtualAddress();
-		mVBView.StrideInBytes = sizeof(mesh.vertices[0]);
+		mVBView.StrideInBytes = vbStride;
 		mVBView.SizeInBytes = mVBIndexOffset;
 		mIBView.BufferLocation = mVB->GetGPUVirtualAddress() + mVBIndexOffset;
-		mIBView.Format = DXGI_FORMAT_R16_UINT;
+		mIBView.Format = ibFormat;
 		mIBView.SizeInBytes = IBSize;
 
 		auto resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(
@@ -308,7 +371,7 @@ public:
 			worldMat = XMMatrixRotationY(XMConvertToRadians(rot));
 			viewMat = XMMatrixLookAtLH({ 0, 1, -1.5f }, { 0, 0.5f, 0 }, { 0, 1, 0 });
 			projMat = XMMatrixPerspectiveFovLH(45, (float)mBufferWidth / mBufferHeight, 0.01f, 50.0f);
-			auto mvpMat = XMMatrixTranspose(worldMat * viewMat * projMat);
+			auto mvpMat = XMMatrixTranspose(mDequantizeMat * worldMat * viewMat * projMat);
 
 			auto worldTransMat = XMMatrixTranspose(worldMat);
 
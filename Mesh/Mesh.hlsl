@@ -1,7 +1,16 @@
+#ifndef COMPACT_VERTEX
+#define COMPACT_VERTEX 0
+#endif
+
 struct VSIn
 {
+#if COMPACT_VERTEX
+	float4 pos : POSITION;      // UNORM in the mesh bounds, decoded by worldViewProjMatrix
+	float2 normal : NORMAL;     // octahedral
+#else
 	float3 pos : POSITION;
 	float3 normal : NORMAL;
+#endif
 };
 
 struct VSOut
@@ -16,11 +25,24 @@ cbuffer Scene
 	float4x4 worldMatrix;
 };
 
+// Same as VertexQuantizer::decodeOctahedral()
+float3 decodeOctahedral(float2 e)
+{
+	float3 n = float3(e.xy, 1 - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += (n.xy >= 0) ? -t : t;
+	return normalize(n);
+}
+
 VSOut VSMain(VSIn vsIn)
 {
 	VSOut output;
 	output.pos = mul(float4(vsIn.pos.xyz, 1), worldViewProjMatrix);
+#if COMPACT_VERTEX
+	output.normal = mul(decodeOctahedral(vsIn.normal), (float3x3)(worldMatrix));
+#else
 	output.normal = mul(vsIn.normal.xyz, (float3x3)(worldMatrix));
+#endif
 	return output;
 }
 
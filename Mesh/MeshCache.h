@@ -0,0 +1,261 @@
+#pragma once
+
+// Binary mesh cache (.vbo v2).
+// Layout: 256-byte header, then vertex, index, subset and material sections,
+// each starting on a 256-byte boundary. The file is meant to be memory-mapped
+// and copied straight into an upload heap, so sections are stored exactly as
+// the GPU reads them.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "../_common/MappedFile.h"
+
+namespace MeshCache
+{
+	static const uint32_t Magic = 0x324F4256; // "VBO2"
+	static const uint32_t Version = 2;
+	static const uint32_t SectionAlignment = 256;
+
+	enum VertexFormat : uint32_t
+	{
+		VertexFormatP3N3T2 = 0, // float3 position, float3 normal, float2 texcoord (WaveFrontReader::Vertex)
+		VertexFormatCompact = 1, // VertexQuantizer::CompactVertex, positions relative to the header bounds
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t headerSize;
+		uint32_t checksum;      // CRC-32 of the whole file, computed with this field zero
+		uint32_t vertexFormat;
+		uint32_t vertexStride;
+		uint32_t vertexCount;
+		uint32_t indexSize;     // 2 or 4
+		uint32_t indexCount;
+		uint32_t subsetCount;
+		uint32_t materialCount;
+		uint32_t settingsHash;  // of the cook settings, tool versions and source, recook when it differs
+		float boundsCenter[3];
+		float boundsExtents[3];
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t subsetOffset;
+		uint64_t materialOffset;
+		uint64_t fileSize;
+		uint8_t reserved[256 - 112];
+	};
+	static_assert(sizeof(Header) == 256, "MeshCache::Header must be 256 bytes");
+
+	// A run of triangles that share one material.
+	struct Subset
+	{
+		uint32_t materialIndex;
+		uint32_t indexStart;
+		uint32_t indexCount;
+		uint32_t reserved;
+	};
+
+	struct Material
+	{
+		float ambient[3];
+		float diffuse[3];
+		float specular[3];
+		uint32_t shininess;
+		float alpha;
+		uint32_t specularEnabled;
+		char name[128];         // UTF-8, NUL terminated
+		char texture[128];
+	};
+	static_assert(sizeof(Material) == 304, "MeshCache::Material layout changed");
+
+	inline uint64_t alignUp(uint64_t v)
+	{
+		return (v + SectionAlignment - 1) & ~static_cast<uint64_t>(SectionAlignment - 1);
+	}
+
+	inline uint32_t crc32(const void* data, size_t size, uint32_t crc = 0)
+	{
+		struct Table
+		{
+			uint32_t t[256];
+			Table()
+			{
+				for (uint32_t i = 0; i < 256; ++i)
+				{
+					uint32_t c = i;
+					for (int k = 0; k < 8; ++k)
+						c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					t[i] = c;
+				}
+			}
+		};
+		static const Table table;
+
+		auto* p = static_cast<const uint8_t*>(data);
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	// Builds subsets from per-triangle material ids, keeping triangle order.
+	inline std::vector<Subset> buildSubsets(const uint32_t* attributes, size_t triangleCount)
+	{
+		std::vector<Subset> subsets;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			if (subsets.empty() || subsets.back().materialIndex != attributes[t])
+			{
+				Subset s = { attributes[t], static_cast<uint32_t>(t * 3), 0, 0 };
+				subsets.push_back(s);
+			}
+			subsets.back().indexCount += 3;
+		}
+		return subsets;
+	}
+
+	struct MeshDesc
+	{
+		uint32_t vertexFormat = VertexFormatP3N3T2;
+		uint32_t vertexStride = 0;
+		uint32_t vertexCount = 0;
+		const void* vertices = nullptr;
+		uint32_t indexSize = 0;
+		uint32_t indexCount = 0;
+		const void* indices = nullptr;
+		const Subset* subsets = nullptr;
+		uint32_t subsetCount = 0;
+		const Material* materials = nullptr;
+		uint32_t materialCount = 0;
+		float boundsCenter[3] = {};
+		float boundsExtents[3] = {};
+		uint32_t settingsHash = 0;
+	};
+
+	// Serializes a mesh. Returns false on stream failure or bad parameters.
+	inline bool write(std::ostream& os, const MeshDesc& desc)
+	{
+		if ((desc.indexSize != 2 && desc.indexSize != 4) || desc.vertexStride == 0)
+			return false;
+
+		Header h = {};
+		h.magic = Magic;
+		h.version = Version;
+		h.headerSize = sizeof(Header);
+		h.vertexFormat = desc.vertexFormat;
+		h.vertexStride = desc.vertexStride;
+		h.vertexCount = desc.vertexCount;
+		h.indexSize = desc.indexSize;
+		h.indexCount = desc.indexCount;
+		h.subsetCount = desc.subsetCount;
+		h.materialCount = desc.materialCount;
+		h.settingsHash = desc.settingsHash;
+		memcpy(h.boundsCenter, desc.boundsCenter, sizeof(h.boundsCenter));
+		memcpy(h.boundsExtents, desc.boundsExtents, sizeof(h.boundsExtents));
+
+		uint64_t vertexBytes = static_cast<uint64_t>(desc.vertexStride) * desc.vertexCount;
+		uint64_t indexBytes = static_cast<uint64_t>(desc.indexSize) * desc.indexCount;
+		uint64_t subsetBytes = sizeof(Subset) * static_cast<uint64_t>(desc.subsetCount);
+		uint64_t materialBytes = sizeof(Material) * static_cast<uint64_t>(desc.materialCount);
+		h.vertexOffset = alignUp(sizeof(Header));
+		h.indexOffset = alignUp(h.vertexOffset + vertexBytes);
+		h.subsetOffset = alignUp(h.indexOffset + indexBytes);
+		h.materialOffset = alignUp(h.subsetOffset + subsetBytes);
+		h.fileSize = h.materialOffset + materialBytes;
+
+		// Assemble the payload once so the checksum and the write see the same bytes
+		std::vector<char> payload(static_cast<size_t>(h.fileSize - sizeof(Header)), 0);
+		auto put = [&](uint64_t offset, const void* src, uint64_t size)
+		{
+			if (size)
+				memcpy(payload.data() + (offset - sizeof(Header)), src, static_cast<size_t>(size));
+		};
+		put(h.vertexOffset, desc.vertices, vertexBytes);
+		put(h.indexOffset, desc.indices, indexBytes);
+		put(h.subsetOffset, desc.subsets, subsetBytes);
+		put(h.materialOffset, desc.materials, materialBytes);
+		h.checksum = crc32(payload.data(), payload.size(), crc32(&h, sizeof(h)));
+
+		os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+		os.write(payload.data(), payload.size());
+		return !!os;
+	}
+
+	// Whether size bytes at offset end by limit. Counts are 32-bit and strides
+	// small, so size cannot overflow, but the offsets come from the file.
+	inline bool fits(uint64_t offset, uint64_t size, uint64_t limit)
+	{
+		return offset <= limit && size <= limit - offset;
+	}
+
+	// Read-only view of a mapped cache file. All pointers point into the mapping.
+	class View
+	{
+		MappedFile mFile;
+		const Header* mHeader = nullptr;
+
+		bool validate(bool verifyChecksum) const
+		{
+			if (mFile.size() < sizeof(Header))
+				return false;
+
+			auto* h = reinterpret_cast<const Header*>(mFile.data());
+			if (h->magic != Magic || h->version != Version || h->headerSize != sizeof(Header))
+				return false;
+			if (h->fileSize != mFile.size() || (h->indexSize != 2 && h->indexSize != 4))
+				return false;
+			// Sections in order after the header, each ending before the next begins
+			if (h->vertexOffset < sizeof(Header) ||
+				!fits(h->vertexOffset, static_cast<uint64_t>(h->vertexStride) * h->vertexCount, h->indexOffset) ||
+				!fits(h->indexOffset, static_cast<uint64_t>(h->indexSize) * h->indexCount, h->subsetOffset) ||
+				!fits(h->subsetOffset, sizeof(Subset) * static_cast<uint64_t>(h->subsetCount), h->materialOffset) ||
+				!fits(h->materialOffset, sizeof(Material) * static_cast<uint64_t>(h->materialCount), h->fileSize))
+				return false;
+			if (verifyChecksum)
+			{
+				Header zeroed = *h;
+				zeroed.checksum = 0;
+				uint32_t crc = crc32(&zeroed, sizeof(zeroed));
+				if (crc32(mFile.data() + sizeof(Header), mFile.size() - sizeof(Header), crc) != h->checksum)
+					return false;
+			}
+			return true;
+		}
+
+	public:
+		// A rejected file is unmapped again, so it can be rewritten right away
+		template<class Char>
+		bool open(const Char* fileName, bool verifyChecksum = true)
+		{
+			mHeader = nullptr;
+			if (!mFile.open(fileName))
+				return false;
+			if (!validate(verifyChecksum))
+			{
+				mFile.close();
+				return false;
+			}
+
+			mHeader = reinterpret_cast<const Header*>(mFile.data());
+			return true;
+		}
+
+		void close()
+		{
+			mHeader = nullptr;
+			mFile.close();
+		}
+
+		const Header& header() const { return *mHeader; }
+		const void* vertexData() const { return mFile.data() + mHeader->vertexOffset; }
+		size_t vertexDataSize() const { return static_cast<size_t>(mHeader->vertexStride) * mHeader->vertexCount; }
+		const void* indexData() const { return mFile.data() + mHeader->indexOffset; }
+		size_t indexDataSize() const { return static_cast<size_t>(mHeader->indexSize) * mHeader->indexCount; }
+		const Subset* subsets() const { return reinterpret_cast<const Subset*>(mFile.data() + mHeader->subsetOffset); }
+		const Material* materials() const { return reinterpret_cast<const Material*>(mFile.data() + mHeader->materialOffset); }
+	};
+};
@@ -0,0 +1,391 @@
+#pragma once
+
+// Offline-style mesh cooking: WaveFront OBJ and its MTL in, MeshCache (.vbo v2)
+// out. The portable counterpart of WaveFrontReader::LoadMapped() followed by
+// SaveVBO2(): ObjParser scans the file, VertexDedupTable merges the corners,
+// MeshOptimizer reorders the triangles and VertexQuantizer optionally packs the
+// vertices. The header's settingsHash covers the cook settings, the stage
+// versions and the source bytes, so an up-to-date output is not cooked again.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../_common/MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "VertexDedupTable.h"
+#include "VertexQuantizer.h"
+
+namespace MeshCook
+{
+	enum class Result
+	{
+		Cooked,
+		UpToDate,
+		SourceNotFound,
+		BadSource,
+		WriteFailed,
+	};
+
+	static const uint32_t CookVersion = 1;
+
+	struct Settings
+	{
+		bool compactVertices = false;   // VertexQuantizer::CompactVertex instead of float3/float3/float2
+		bool optimizeOverdraw = true;
+		bool ccw = true;                // as WaveFrontReader::LoadMapped()
+	};
+
+	struct Float2
+	{
+		float x, y;
+	};
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	// Laid out as WaveFrontReader::Vertex (MeshCache::VertexFormatP3N3T2)
+	struct Vertex
+	{
+		Float3 position;
+		Float3 normal;
+		Float2 textureCoordinate;
+	};
+
+	// An OBJ as WaveFrontReader loads it, before the cook stages run
+	struct Mesh
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> attributes;       // material of each triangle
+		std::vector<MeshCache::Material> materials;
+		float boundsCenter[3] = {};
+		float boundsExtents[3] = {};
+	};
+
+	namespace detail
+	{
+		inline void copyName(char (&dst)[128], const char* src, size_t length)
+		{
+			length = (std::min)(length, sizeof(dst) - 1);
+			memcpy(dst, src, length);
+			memset(dst + length, 0, sizeof(dst) - length);
+		}
+
+		// Material defaults of WaveFrontReader::Material
+		inline MeshCache::Material material(const char* name, size_t length)
+		{
+			MeshCache::Material m;
+			memset(&m, 0, sizeof(m));
+			for (int k = 0; k < 3; ++k)
+			{
+				m.ambient[k] = 0.2f;
+				m.diffuse[k] = 0.8f;
+				m.specular[k] = 1.0f;
+			}
+			m.alpha = 1.0f;
+			copyName(m.name, name, length);
+			return m;
+		}
+
+		inline uint32_t findOrAddMaterial(std::vector<MeshCache::Material>& materials, const char* name, size_t length)
+		{
+			MeshCache::Material m = material(name, length);
+			for (size_t i = 0; i < materials.size(); ++i)
+			{
+				if (strcmp(materials[i].name, m.name) == 0)
+					return static_cast<uint32_t>(i);
+			}
+			materials.push_back(m);
+			return static_cast<uint32_t>(materials.size() - 1);
+		}
+
+		struct Sink
+		{
+			Mesh& mesh;
+			bool ccw;
+			std::vector<Float3> positions;
+			std::vector<Float3> normals;
+			std::vector<Float2> texCoords;
+			VertexDedupTable<Vertex> vertexCache;
+			uint32_t curSubset = 0;
+			std::string libraryName;
+
+			Sink(Mesh& m, bool c, size_t fileSize) : mesh(m), ccw(c)
+			{
+				// Face lines are about 10 bytes per corner, so this rarely grows
+				vertexCache.reserve(fileSize / 32);
+			}
+
+			bool position(float x, float y, float z)
+			{
+				positions.push_back({ x, y, z });
+				return true;
+			}
+			bool texcoord(float u, float v)
+			{
+				texCoords.push_back({ u, v });
+				return true;
+			}
+			bool normal(float x, float y, float z)
+			{
+				normals.push_back({ x, y, z });
+				return true;
+			}
+			bool face(const ObjParser::FaceVertex* verts, size_t count)
+			{
+				if (count < 3)
+					return false;
+				uint32_t faceIndex[ObjParser::MaxPolygonVertex];
+				for (size_t i = 0; i < count; ++i)
+				{
+					const ObjParser::FaceVertex& fv = verts[i];
+					Vertex vertex;
+					memset(&vertex, 0, sizeof(vertex));
+					if (fv.position == 0 || fv.position > positions.size() ||
+						fv.texcoord > texCoords.size() || fv.normal > normals.size())
+						return false;
+					vertex.position = positions[fv.position - 1];
+					if (fv.texcoord)
+						vertex.textureCoordinate = texCoords[fv.texcoord - 1];
+					if (fv.normal)
+						vertex.normal = normals[fv.normal - 1];
+					faceIndex[i] = vertexCache.findOrAdd(fv.position, fv.texcoord, fv.normal, vertex, mesh.vertices);
+					if (faceIndex[i] == VertexDedupTable<Vertex>::NotFound)
+						return false;
+				}
+
+				// Triangle fan, wound as WaveFrontReader::AddPolygon()
+				for (size_t j = 2; j < count; ++j)
+				{
+					if (ccw)
+						mesh.indices.insert(mesh.indices.end(), { faceIndex[0], faceIndex[j - 1], faceIndex[j] });
+					else
+						mesh.indices.insert(mesh.indices.end(), { faceIndex[0], faceIndex[j], faceIndex[j - 1] });
+					mesh.attributes.push_back(curSubset);
+				}
+				return true;
+			}
+			bool useMaterial(const char* name, size_t length)
+			{
+				curSubset = findOrAddMaterial(mesh.materials, name, length);
+				return true;
+			}
+			bool materialLibrary(const char* name, size_t length)
+			{
+				libraryName.assign(name, length);
+				return true;
+			}
+		};
+
+		inline bool parseFloats(const char*& p, const char* end, float* out, int count)
+		{
+			for (int k = 0; k < count; ++k)
+			{
+				if (!ObjParser::parseFloat(p, end, out[k]))
+					return false;
+			}
+			return true;
+		}
+
+		// Fills in the materials the OBJ uses, as WaveFrontReader::LoadMTL() does
+		inline void parseMaterials(const char* p, const char* end, std::vector<MeshCache::Material>& materials)
+		{
+			MeshCache::Material* current = nullptr;
+			for (; p < end; p = ObjParser::skipLine(p, end))
+			{
+				const char* cmd = ObjParser::skipBlank(p, end);
+				p = ObjParser::tokenEnd(cmd, end);
+				std::string command(cmd, p);
+				if (command == "newmtl")
+				{
+					const char* name = ObjParser::skipBlank(p, end);
+					p = ObjParser::tokenEnd(name, end);
+					MeshCache::Material m = material(name, static_cast<size_t>(p - name));
+					current = nullptr;
+					for (auto& existing : materials)
+					{
+						if (strcmp(existing.name, m.name) == 0)
+							current = &existing;
+					}
+					continue;
+				}
+
+				// The rest of the commands rely on an active material
+				if (!current)
+					continue;
+
+				float v[3];
+				uint32_t illumination;
+				if (command == "Ka" && parseFloats(p, end, v, 3))
+					memcpy(current->ambient, v, sizeof(v));
+				else if (command == "Kd" && parseFloats(p, end, v, 3))
+					memcpy(current->diffuse, v, sizeof(v));
+				else if (command == "Ks" && parseFloats(p, end, v, 3))
+					memcpy(current->specular, v, sizeof(v));
+				else if ((command == "d" || command == "Tr") && parseFloats(p, end, v, 1))
+					current->alpha = v[0];
+				else if (command == "Ns" && parseFloats(p, end, v, 1))
+					current->shininess = static_cast<uint32_t>(static_cast<int>(v[0]));
+				else if (command == "illum" && ObjParser::parseUInt(p, end, illumination))
+					current->specularEnabled = illumination == 2 ? 1 : 0;
+				else if (command == "map_Kd")
+				{
+					const char* name = ObjParser::skipBlank(p, end);
+					p = ObjParser::tokenEnd(name, end);
+					copyName(current->texture, name, static_cast<size_t>(p - name));
+				}
+			}
+		}
+
+		// The library's file name in the directory of the OBJ; the library's own
+		// directory is dropped, as WaveFrontReader::LoadMaterialLibrary() does
+		template<class Char>
+		std::basic_string<Char> siblingPath(const Char* objFileName, const std::string& name)
+		{
+			std::basic_string<Char> path(objFileName);
+			size_t slash = path.find_last_of(std::basic_string<Char>(1, Char('/')) + Char('\\'));
+			path.resize(slash == std::basic_string<Char>::npos ? 0 : slash + 1);
+			size_t nameSlash = name.find_last_of("/\\");
+			for (size_t i = nameSlash == std::string::npos ? 0 : nameSlash + 1; i < name.size(); ++i)
+				path += static_cast<Char>(static_cast<unsigned char>(name[i]));
+			return path;
+		}
+
+		inline uint32_t settingsHash(const Settings& settings)
+		{
+			const uint32_t words[] = {
+				settings.compactVertices ? MeshCache::VertexFormatCompact : MeshCache::VertexFormatP3N3T2,
+				settings.optimizeOverdraw ? 1u : 0u,
+				settings.ccw ? 1u : 0u,
+				MeshOptimizer::CookVersion,
+				VertexQuantizer::CookVersion,
+				CookVersion,
+			};
+			return MeshCache::crc32(words, sizeof(words));
+		}
+
+		template<class Char>
+		bool isUpToDate(const Char* fileName, uint32_t settingsHash)
+		{
+			MeshCache::View view;
+			return view.open(fileName) && view.header().settingsHash == settingsHash;
+		}
+	};
+
+	// Loads objFileName and the material library it names, as WaveFrontReader::LoadMapped()
+	// does, and chains sourceHash over the bytes of both. On failure error tells why.
+	template<class Char>
+	bool load(const Char* objFileName, Mesh& mesh, uint32_t& sourceHash, Result& error, bool ccw = true)
+	{
+		mesh = Mesh();
+		mesh.materials.push_back(detail::material("default", 7));
+
+		MappedFile obj;
+		error = Result::SourceNotFound;
+		if (!obj.open(objFileName))
+			return false;
+		detail::Sink sink(mesh, ccw, obj.size());
+		error = Result::BadSource;
+		if (ObjParser::parse(obj.data(), obj.end(), sink) != ObjParser::Result::Ok)
+			return false;
+		sourceHash = MeshCache::crc32(obj.data(), obj.size(), sourceHash);
+
+		if (!sink.positions.empty())
+		{
+			Float3 lo = sink.positions[0], hi = lo;
+			for (auto& p : sink.positions)
+			{
+				lo = { (std::min)(lo.x, p.x), (std::min)(lo.y, p.y), (std::min)(lo.z, p.z) };
+				hi = { (std::max)(hi.x, p.x), (std::max)(hi.y, p.y), (std::max)(hi.z, p.z) };
+			}
+			const float* l = &lo.x;
+			const float* h = &hi.x;
+			for (int k = 0; k < 3; ++k)
+			{
+				mesh.boundsCenter[k] = (l[k] + h[k]) * 0.5f;
+				mesh.boundsExtents[k] = (h[k] - l[k]) * 0.5f;
+			}
+		}
+
+		if (!sink.libraryName.empty())
+		{
+			MappedFile mtl;
+			error = Result::SourceNotFound;
+			if (!mtl.open(detail::siblingPath(objFileName, sink.libraryName).c_str()))
+				return false;
+			detail::parseMaterials(mtl.data(), mtl.end(), mesh.materials);
+			sourceHash = MeshCache::crc32(mtl.data(), mtl.size(), sourceHash);
+		}
+		return true;
+	}
+
+	// Cooks objFileName into vbo2FileName, unless vbo2FileName was already cooked
+	// from the same source with the same settings. Indices are 16-bit when every
+	// vertex fits below the 0xFFFF strip cut, 32-bit otherwise. quantizationError,
+	// if given, receives the error of compact vertices; it is zero otherwise.
+	template<class Char>
+	Result cook(const Char* objFileName, const Char* vbo2FileName, const Settings& settings = Settings(),
+		VertexQuantizer::QuantizationError* quantizationError = nullptr)
+	{
+		if (quantizationError)
+			*quantizationError = VertexQuantizer::QuantizationError();
+
+		Mesh mesh;
+		Result error;
+		uint32_t settingsHash = detail::settingsHash(settings);
+		if (!load(objFileName, mesh, settingsHash, error, settings.ccw))
+			return error;
+		if (detail::isUpToDate(vbo2FileName, settingsHash))
+			return Result::UpToDate;
+
+		MeshOptimizer::optimizeMesh(mesh, settings.optimizeOverdraw);
+		auto subsets = MeshCache::buildSubsets(mesh.attributes.data(), mesh.attributes.size());
+
+		MeshCache::MeshDesc desc;
+		desc.vertexFormat = MeshCache::VertexFormatP3N3T2;
+		desc.vertexStride = sizeof(Vertex);
+		desc.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		desc.vertices = mesh.vertices.data();
+		std::vector<VertexQuantizer::CompactVertex> compact;
+		if (settings.compactVertices)
+		{
+			compact.resize(mesh.vertices.size());
+			auto err = VertexQuantizer::quantize(mesh.vertices.data(), mesh.vertices.size(), mesh.boundsCenter, mesh.boundsExtents, compact.data());
+			if (quantizationError)
+				*quantizationError = err;
+			desc.vertexFormat = MeshCache::VertexFormatCompact;
+			desc.vertexStride = sizeof(VertexQuantizer::CompactVertex);
+			desc.vertices = compact.data();
+		}
+
+		std::vector<uint16_t> shortIndices;
+		desc.indexSize = sizeof(uint32_t);
+		desc.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		desc.indices = mesh.indices.data();
+		if (mesh.vertices.size() <= 0xFFFF)
+		{
+			shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+			desc.indexSize = sizeof(uint16_t);
+			desc.indices = shortIndices.data();
+		}
+		desc.subsets = subsets.data();
+		desc.subsetCount = static_cast<uint32_t>(subsets.size());
+		desc.materials = mesh.materials.data();
+		desc.materialCount = static_cast<uint32_t>(mesh.materials.size());
+		memcpy(desc.boundsCenter, mesh.boundsCenter, sizeof(desc.boundsCenter));
+		memcpy(desc.boundsExtents, mesh.boundsExtents, sizeof(desc.boundsExtents));
+		desc.settingsHash = settingsHash;
+
+		std::ofstream file(vbo2FileName, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return Result::WriteFailed;
+		return MeshCache::write(file, desc) ? Result::Cooked : Result::WriteFailed;
+	}
+};
@@ -0,0 +1,415 @@
+#pragma once
+
+// Index/vertex reordering for loaded meshes.
+//   optimizeVertexCache  - Forsyth's linear-speed triangle order for post-transform cache reuse
+//   optimizeOverdraw     - splits the cache-optimized order into clusters and draws outward-facing clusters first
+//   optimizeVertexFetch  - renumbers vertices by first use so the vertex buffer is read linearly
+//   analyzeVertexCache   - FIFO cache simulator reporting ACMR / ATVR
+// Everything is plain C++ so the same code runs in Linux asset tools.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace MeshOptimizer
+{
+	// Bump when the output changes, so cooked meshes are rebuilt
+	static const uint32_t CookVersion = 1;
+
+	struct VertexCacheStatistics
+	{
+		size_t misses = 0;
+		float acmr = 0; // misses per triangle (0.5 .. 3)
+		float atvr = 0; // misses per referenced vertex (1 is optimal)
+	};
+
+	// Simulates a FIFO post-transform cache of cacheSize entries.
+	template<class index_t>
+	VertexCacheStatistics analyzeVertexCache(const index_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16)
+	{
+		VertexCacheStatistics stats;
+		std::vector<uint32_t> timestamp(vertexCount, 0);
+		std::vector<bool> used(vertexCount, false);
+		uint32_t time = cacheSize + 1;
+		size_t uniqueCount = 0;
+
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			index_t v = indices[i];
+			if (!used[v])
+			{
+				used[v] = true;
+				++uniqueCount;
+			}
+			// A vertex is resident when it entered the FIFO less than cacheSize misses ago
+			if (time - timestamp[v] > cacheSize)
+			{
+				timestamp[v] = time++;
+				++stats.misses;
+			}
+		}
+
+		if (indexCount)
+			stats.acmr = static_cast<float>(stats.misses) / (indexCount / 3);
+		if (uniqueCount)
+			stats.atvr = static_cast<float>(stats.misses) / uniqueCount;
+		return stats;
+	}
+
+	namespace detail
+	{
+		static const int MaxCacheSize = 32;
+
+		// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+		inline float vertexScore(int cachePosition, unsigned int remainingTriangles)
+		{
+			static const float CacheDecayPower = 1.5f;
+			static const float LastTriScore = 0.75f;
+			static const float ValenceBoostScale = 2.0f;
+			static const float ValenceBoostPower = 0.5f;
+
+			if (remainingTriangles == 0)
+				return -1.0f;
+
+			float score = 0.0f;
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3)
+				{
+					// The vertices of the last triangle get a fixed score so that
+					// the algorithm does not prefer strips over fans.
+					score = LastTriScore;
+				}
+				else
+				{
+					const float scaler = 1.0f / (MaxCacheSize - 3);
+					score = powf(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+				}
+			}
+			score += ValenceBoostScale * powf(static_cast<float>(remainingTriangles), -ValenceBoostPower);
+			return score;
+		}
+	};
+
+	// Reorders triangles in place.
+	template<class index_t>
+	void optimizeVertexCache(index_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		using namespace detail;
+
+		size_t triCount = indexCount / 3;
+		if (triCount == 0)
+			return;
+
+		// Vertex -> triangle adjacency (CSR)
+		std::vector<uint32_t> remaining(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+			remaining[indices[i]]++;
+		std::vector<uint32_t> adjOffset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjOffset[v + 1] = adjOffset[v] + remaining[v];
+		std::vector<uint32_t> adjacency(indexCount);
+		{
+			std::vector<uint32_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+			for (size_t i = 0; i < indexCount; ++i)
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<float> vScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			vScore[v] = vertexScore(-1, remaining[v]);
+
+		std::vector<bool> emitted(triCount, false);
+
+		std::vector<index_t> output;
+		output.reserve(indexCount);
+
+		uint32_t cache[MaxCacheSize + 3];
+		int cacheCount = 0;
+		size_t scan = 0;       // fallback search position for disconnected pieces
+		int64_t best = -1;
+
+		for (size_t emittedCount = 0; emittedCount < triCount; ++emittedCount)
+		{
+			if (best < 0)
+			{
+				// Nothing useful in the cache: take the next unused triangle
+				while (emitted[scan])
+					++scan;
+				best = static_cast<int64_t>(scan);
+			}
+
+			size_t t = static_cast<size_t>(best);
+			emitted[t] = true;
+			const index_t* tri = &indices[t * 3];
+			output.insert(output.end(), tri, tri + 3);
+
+			// Push the triangle's vertices to the front of the LRU cache
+			uint32_t newCache[MaxCacheSize + 3];
+			int newCount = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				newCache[newCount++] = tri[k];
+				remaining[tri[k]]--;
+
+				// Remove t from the vertex's live adjacency
+				uint32_t* adj = &adjacency[adjOffset[tri[k]]];
+				uint32_t n = remaining[tri[k]] + 1;
+				for (uint32_t a = 0; a < n; ++a)
+				{
+					if (adj[a] == t)
+					{
+						adj[a] = adj[n - 1];
+						break;
+					}
+				}
+			}
+			for (int c = 0; c < cacheCount; ++c)
+			{
+				uint32_t v = cache[c];
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					newCache[newCount++] = v;
+			}
+
+			// Vertices pushed out of the cache lose their cache score
+			for (int c = MaxCacheSize; c < newCount; ++c)
+			{
+				vScore[newCache[c]] = vertexScore(-1, remaining[newCache[c]]);
+			}
+			cacheCount = (std::min)(newCount, MaxCacheSize);
+			memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+			// Rescore the cached vertices and their triangles, remembering the best candidate
+			for (int c = 0; c < cacheCount; ++c)
+				vScore[cache[c]] = vertexScore(c, remaining[cache[c]]);
+			best = -1;
+			float bestScore = -1.0f;
+			for (int c = 0; c < cacheCount; ++c)
+			{
+				uint32_t v = cache[c];
+				const uint32_t* adj = &adjacency[adjOffset[v]];
+				for (uint32_t a = 0; a < remaining[v]; ++a)
+				{
+					uint32_t at = adj[a];
+					float s = vScore[indices[at * 3]] + vScore[indices[at * 3 + 1]] + vScore[indices[at * 3 + 2]];
+					if (s > bestScore)
+					{
+						bestScore = s;
+						best = at;
+					}
+				}
+			}
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	// Splits a cache-optimized triangle order into clusters and sorts them so
+	// that outward-facing clusters draw first (Sander et al., "Fast Triangle
+	// Reordering for Vertex Locality and Reduced Overdraw").
+	// Clusters start where the FIFO cache restarts cold (every vertex misses),
+	// plus soft splits wherever the cold-start ACMR stays within threshold
+	// times the hard cluster's ACMR, so cache efficiency is kept.
+	// positions: float3 at the start of every vertex, vertexStride bytes apart.
+	template<class index_t>
+	void optimizeOverdraw(index_t* indices, size_t indexCount, const void* positions, size_t vertexStride, size_t vertexCount, float threshold = 1.05f, unsigned int cacheSize = 16)
+	{
+		size_t triCount = indexCount / 3;
+		if (triCount < 2)
+			return;
+
+		auto pos = [&](index_t v) { return reinterpret_cast<const float*>(static_cast<const char*>(positions) + v * vertexStride); };
+
+		// One timestamp array serves every simulation below: advancing time by
+		// cacheSize + 1 evicts everything, so each run starts from a cold cache
+		std::vector<uint32_t> timestamp(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		auto miss = [&](index_t v)
+		{
+			if (time - timestamp[v] <= cacheSize)
+				return 0;
+			timestamp[v] = time++;
+			return 1;
+		};
+
+		// Hard boundaries
+		std::vector<size_t> hard;
+		for (size_t t = 0; t < triCount; ++t)
+		{
+			int misses = miss(indices[t * 3]) + miss(indices[t * 3 + 1]) + miss(indices[t * 3 + 2]);
+			if (t == 0 || misses == 3)
+				hard.push_back(t);
+		}
+		hard.push_back(triCount);
+
+		// Soft boundaries inside each hard cluster
+		std::vector<size_t> clusters;
+		for (size_t h = 0; h + 1 < hard.size(); ++h)
+		{
+			size_t begin = hard[h], end = hard[h + 1];
+			if (time > 0x80000000u)
+			{
+				// Restart the epochs before time wraps
+				std::fill(timestamp.begin(), timestamp.end(), 0);
+				time = 0;
+			}
+			time += cacheSize + 1;
+			size_t hardMisses = 0;
+			for (size_t i = begin * 3; i < end * 3; ++i)
+				hardMisses += miss(indices[i]);
+			float hardAcmr = static_cast<float>(hardMisses) / (end - begin);
+
+			time += cacheSize + 1;
+			size_t start = begin, misses = 0;
+			clusters.push_back(begin);
+			for (size_t t = begin; t < end; ++t)
+			{
+				misses += miss(indices[t * 3]) + miss(indices[t * 3 + 1]) + miss(indices[t * 3 + 2]);
+				size_t tris = t + 1 - start;
+				if (t + 1 < end && tris >= 8 && static_cast<float>(misses) / tris <= threshold * hardAcmr)
+				{
+					clusters.push_back(t + 1);
+					start = t + 1;
+					misses = 0;
+					time += cacheSize + 1; // cold cache for the next cluster
+				}
+			}
+		}
+		clusters.push_back(triCount);
+
+		// Mesh centroid
+		float meshCenter[3] = {};
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			const float* p = pos(static_cast<index_t>(v));
+			meshCenter[0] += p[0];
+			meshCenter[1] += p[1];
+			meshCenter[2] += p[2];
+		}
+		for (int k = 0; k < 3; ++k)
+			meshCenter[k] /= vertexCount;
+
+		// Sort key: area-weighted cluster normal against the direction from the mesh center
+		size_t clusterCount = clusters.size() - 1;
+		std::vector<float> sortKey(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			float center[3] = {}, normal[3] = {}, area = 0;
+			for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+			{
+				const float* p0 = pos(indices[t * 3]);
+				const float* p1 = pos(indices[t * 3 + 1]);
+				const float* p2 = pos(indices[t * 3 + 2]);
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (int k = 0; k < 3; ++k)
+				{
+					center[k] += (p0[k] + p1[k] + p2[k]) * (a / 3);
+					normal[k] += n[k];
+				}
+				area += a;
+			}
+			float key = 0;
+			if (area > 0)
+			{
+				for (int k = 0; k < 3; ++k)
+					key += (center[k] / area - meshCenter[k]) * normal[k];
+				key /= area;
+			}
+			sortKey[c] = key;
+		}
+
+		std::vector<size_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+			order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+		std::vector<index_t> output;
+		output.reserve(triCount * 3);
+		for (size_t c : order)
+			output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	// Renumbers vertices in order of first use and compacts the vertex array in place.
+	// Returns the new vertex count (unreferenced vertices are dropped).
+	template<class index_t>
+	size_t optimizeVertexFetch(void* vertices, size_t vertexStride, size_t vertexCount, index_t* indices, size_t indexCount)
+	{
+		static const uint32_t Unused = 0xFFFFFFFFu;
+		std::vector<uint32_t> remap(vertexCount, Unused);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			index_t& v = indices[i];
+			if (remap[v] == Unused)
+				remap[v] = next++;
+			v = static_cast<index_t>(remap[v]);
+		}
+
+		std::vector<char> copy(static_cast<const char*>(vertices), static_cast<const char*>(vertices) + vertexStride * vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			if (remap[v] != Unused)
+				memcpy(static_cast<char*>(vertices) + remap[v] * vertexStride, copy.data() + v * vertexStride, vertexStride);
+		}
+		return next;
+	}
+
+	// Runs the whole stage on a WaveFrontReader/SdkMeshReader-style mesh
+	// (vertices with a leading float3 position, indices, per-triangle attributes).
+	// Triangles are grouped by attribute first and every group is optimized on
+	// its own, so material subsets stay contiguous.
+	template<class Mesh>
+	void optimizeMesh(Mesh& mesh, bool overdraw = false, float overdrawThreshold = 1.05f)
+	{
+		typedef typename std::remove_reference<decltype(mesh.indices[0])>::type index_t;
+
+		size_t triCount = mesh.indices.size() / 3;
+		if (triCount == 0)
+			return;
+
+		if (mesh.attributes.size() == triCount)
+		{
+			std::vector<uint32_t> order(triCount);
+			for (size_t t = 0; t < triCount; ++t)
+				order[t] = static_cast<uint32_t>(t);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return mesh.attributes[a] < mesh.attributes[b]; });
+
+			std::vector<index_t> sortedIndices(triCount * 3);
+			std::vector<uint32_t> sortedAttributes(triCount);
+			for (size_t t = 0; t < triCount; ++t)
+			{
+				memcpy(&sortedIndices[t * 3], &mesh.indices[order[t] * 3], 3 * sizeof(index_t));
+				sortedAttributes[t] = mesh.attributes[order[t]];
+			}
+			std::copy(sortedIndices.begin(), sortedIndices.end(), mesh.indices.begin());
+			std::copy(sortedAttributes.begin(), sortedAttributes.end(), mesh.attributes.begin());
+		}
+
+		size_t begin = 0;
+		while (begin < triCount)
+		{
+			size_t end = begin + 1;
+			while (end < triCount && mesh.attributes.size() == triCount && mesh.attributes[end] == mesh.attributes[begin])
+				++end;
+			if (mesh.attributes.size() != triCount)
+				end = triCount;
+
+			index_t* ib = &mesh.indices[begin * 3];
+			size_t count = (end - begin) * 3;
+			optimizeVertexCache(ib, count, mesh.vertices.size());
+			if (overdraw)
+				optimizeOverdraw(ib, count, mesh.vertices.data(), sizeof(mesh.vertices[0]), mesh.vertices.size(), overdrawThreshold);
+			begin = end;
+		}
+
+		size_t vertexCount = optimizeVertexFetch(mesh.vertices.data(), sizeof(mesh.vertices[0]), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+		mesh.vertices.resize(vertexCount);
+	}
+};
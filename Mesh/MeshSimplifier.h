@@ -0,0 +1,650 @@
+#pragma once
+
+// Quadric error metric simplification (Garland & Heckbert) by edge collapse.
+// Vertices are only ever collapsed onto existing vertices, so every level of
+// detail indexes the original vertex buffer and the levels can share it.
+// Collapses move a whole position: where a UV/normal seam splits it into two
+// vertices, both move along the seam, each onto the vertex on its own side.
+// Positions split more ways, as by per-face normals, only collapse onto other
+// such positions. Open borders only collapse along themselves, and vertices on
+// material boundaries, non-manifold edges and the ends of seams are locked, so
+// seams and subsets keep their outline.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace MeshSimplifier
+{
+	struct Lod
+	{
+		uint32_t indexStart;
+		uint32_t indexCount;
+		float error;            // approximate object-space distance to level 0
+	};
+
+	namespace detail
+	{
+		struct Quadric
+		{
+			double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+			double weight;
+		};
+
+		inline void addPlane(Quadric& q, double a, double b, double c, double d, double w)
+		{
+			q.a2 += a * a * w;
+			q.b2 += b * b * w;
+			q.c2 += c * c * w;
+			q.ab += a * b * w;
+			q.ac += a * c * w;
+			q.bc += b * c * w;
+			q.ad += a * d * w;
+			q.bd += b * d * w;
+			q.cd += c * d * w;
+			q.d2 += d * d * w;
+			q.weight += w;
+		}
+
+		inline void add(Quadric& q, const Quadric& r)
+		{
+			q.a2 += r.a2; q.b2 += r.b2; q.c2 += r.c2;
+			q.ab += r.ab; q.ac += r.ac; q.bc += r.bc;
+			q.ad += r.ad; q.bd += r.bd; q.cd += r.cd;
+			q.d2 += r.d2;
+			q.weight += r.weight;
+		}
+
+		// Weighted mean of the squared plane distances
+		inline double evaluate(const Quadric& q, const float* p)
+		{
+			double x = p[0], y = p[1], z = p[2];
+			double e = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z
+				+ 2 * (q.ab * x * y + q.ac * x * z + q.bc * y * z)
+				+ 2 * (q.ad * x + q.bd * y + q.cd * z) + q.d2;
+			return q.weight > 0 ? fabs(e) / q.weight : 0;
+		}
+
+		enum VertexKind : uint8_t
+		{
+			Manifold,   // collapses onto any neighbour
+			Border,     // collapses only along its open border
+			Seam,       // collapses only along its seam, with the vertex on the other side
+			Complex,    // collapses only onto Complex or Locked positions, with every vertex there
+			Locked,
+		};
+
+		struct Candidate
+		{
+			uint32_t from, to;
+			double error;
+		};
+
+		inline const float* position(const void* positions, size_t stride, uint32_t v)
+		{
+			return reinterpret_cast<const float*>(static_cast<const char*>(positions) + stride * v);
+		}
+
+		// Normal of (p0, p1, p2); the winding does not matter as only sign changes are checked.
+		inline void triangleNormal(const float* p0, const float* p1, const float* p2, double n[3])
+		{
+			double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		}
+	};
+
+	// Simplifies indices in place until at most targetIndexCount remain or no
+	// collapse below maxError (object-space distance) is left. attributes (one per
+	// triangle, may be null) is compacted along with the triangles. Returns the new
+	// index count; resultError receives the largest collapse error.
+	template<class index_t>
+	size_t simplify(index_t* indices, size_t indexCount, uint32_t* attributes,
+		const void* positions, size_t vertexStride, size_t vertexCount,
+		size_t targetIndexCount, float maxError = FLT_MAX, float* resultError = nullptr)
+	{
+		using namespace detail;
+
+		size_t triangleCount = indexCount / 3;
+		double maxErrorSq = static_cast<double>(maxError) * maxError;
+		double worstError = 0;
+
+		// Position ids: vertices that only differ in normal or texcoord share one,
+		// and the vertices of one position are linked in a cycle
+		std::vector<uint32_t> positionId(vertexCount);
+		std::vector<uint32_t> nextAtPosition(vertexCount);
+		{
+			std::vector<uint32_t> order(vertexCount);
+			for (size_t v = 0; v < vertexCount; ++v)
+				order[v] = static_cast<uint32_t>(v);
+			std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+			{
+				int c = memcmp(position(positions, vertexStride, a), position(positions, vertexStride, b), sizeof(float) * 3);
+				return c < 0 || (c == 0 && a < b);
+			});
+			for (size_t i = 0; i < vertexCount; ++i)
+			{
+				bool same = i > 0 && memcmp(position(positions, vertexStride, order[i]), position(positions, vertexStride, order[i - 1]), sizeof(float) * 3) == 0;
+				positionId[order[i]] = same ? positionId[order[i - 1]] : order[i];
+				nextAtPosition[order[i]] = same ? nextAtPosition[order[i - 1]] : order[i];
+				if (same)
+					nextAtPosition[order[i - 1]] = order[i];
+			}
+		}
+
+		// Position -> triangle adjacency of the input, to find twin half-edges
+		std::vector<uint32_t> positionAdjacencyOffset(vertexCount + 1, 0);
+		std::vector<uint32_t> positionAdjacency(triangleCount * 3);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			++positionAdjacencyOffset[positionId[indices[i]] + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			positionAdjacencyOffset[v + 1] += positionAdjacencyOffset[v];
+		{
+			std::vector<uint32_t> fill(positionAdjacencyOffset.begin(), positionAdjacencyOffset.end() - 1);
+			for (size_t t = 0; t < triangleCount; ++t)
+				for (int k = 0; k < 3; ++k)
+					positionAdjacency[fill[positionId[indices[t * 3 + k]]]++] = static_cast<uint32_t>(t);
+		}
+		auto hasHalfEdge = [&](uint32_t pa, uint32_t pb)
+		{
+			for (uint32_t j = positionAdjacencyOffset[pa]; j < positionAdjacencyOffset[pa + 1]; ++j)
+			{
+				const index_t* tri = indices + positionAdjacency[j] * 3;
+				for (int k = 0; k < 3; ++k)
+					if (positionId[tri[k]] == pa && positionId[tri[(k + 1) % 3]] == pb)
+						return true;
+			}
+			return false;
+		};
+
+		// Vertex -> triangle adjacency of the current indices
+		std::vector<uint32_t> adjacencyOffset(vertexCount + 1);
+		std::vector<uint32_t> adjacency;
+		auto buildAdjacency = [&]()
+		{
+			std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+			for (size_t i = 0; i < triangleCount * 3; ++i)
+				++adjacencyOffset[indices[i] + 1];
+			for (size_t v = 0; v < vertexCount; ++v)
+				adjacencyOffset[v + 1] += adjacencyOffset[v];
+			adjacency.resize(triangleCount * 3);
+			std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t t = 0; t < triangleCount; ++t)
+				for (int k = 0; k < 3; ++k)
+					adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+		};
+		auto corner = [&](const index_t* tri, uint32_t v)
+		{
+			return tri[0] == v ? 0 : tri[1] == v ? 1 : 2;
+		};
+		// Whether the half-edge a->b has a twin b->a with the same vertices, or at
+		// least at the same positions; a twin of positions only is across a seam
+		auto hasVertexTwin = [&](uint32_t a, uint32_t b)
+		{
+			for (uint32_t j = adjacencyOffset[a]; j < adjacencyOffset[a + 1]; ++j)
+			{
+				const index_t* tri = indices + adjacency[j] * 3;
+				if (tri[(corner(tri, a) + 2) % 3] == b)
+					return true;
+			}
+			return false;
+		};
+		auto hasTwin = [&](uint32_t a, uint32_t b)
+		{
+			uint32_t u = a;
+			do
+			{
+				for (uint32_t j = adjacencyOffset[u]; j < adjacencyOffset[u + 1]; ++j)
+				{
+					const index_t* tri = indices + adjacency[j] * 3;
+					if (positionId[tri[(corner(tri, u) + 2) % 3]] == positionId[b])
+						return true;
+				}
+				u = nextAtPosition[u];
+			} while (u != a);
+			return false;
+		};
+		buildAdjacency();
+
+		// Classify positions. One vertex: Manifold, or Border on an open border.
+		// Two vertices whose triangles meet along one seam line through the
+		// position: Seam. More vertices, as with per-face normals: Complex.
+		// Material boundaries, non-manifold edges, seams that end or meet a
+		// border there are Locked.
+		std::vector<uint8_t> kind(vertexCount, Manifold);
+		{
+			std::vector<uint8_t> borderOut(vertexCount, 0);
+			std::vector<uint32_t> attributeAt(vertexCount, 0xFFFFFFFFu); // first attribute seen per position
+			std::vector<uint8_t> lockPosition(vertexCount, 0);
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					uint32_t p = positionId[indices[t * 3 + k]];
+					uint32_t next = positionId[indices[t * 3 + (k + 1) % 3]];
+					if (borderOut[p] < 2 && !hasHalfEdge(next, p))
+						++borderOut[p];
+					uint32_t a = attributes ? attributes[t] : 0;
+					if (attributeAt[p] == 0xFFFFFFFFu)
+						attributeAt[p] = a;
+					else if (attributeAt[p] != a)
+						lockPosition[p] = 1; // Material boundary
+				}
+			}
+
+			// The half-edges of v without a twin of the same vertices: the number
+			// leaving and entering it and the position at the other end of each
+			struct Open
+			{
+				int outCount, inCount;
+				uint32_t outTo, inFrom;
+			};
+			auto open = [&](uint32_t v)
+			{
+				Open o = { 0, 0, 0, 0 };
+				for (uint32_t j = adjacencyOffset[v]; j < adjacencyOffset[v + 1]; ++j)
+				{
+					const index_t* tri = indices + adjacency[j] * 3;
+					int k = corner(tri, v);
+					uint32_t next = tri[(k + 1) % 3], prev = tri[(k + 2) % 3];
+					if (!hasVertexTwin(v, next))
+						++o.outCount, o.outTo = positionId[next];
+					if (!hasVertexTwin(prev, v))
+						++o.inCount, o.inFrom = positionId[prev];
+				}
+				return o;
+			};
+
+			// Only the vertices with triangles count, the levels of generateLods() leave others unused
+			std::vector<uint32_t> used;
+			for (size_t v = 0; v < vertexCount; ++v)
+			{
+				uint32_t p = positionId[v];
+				if (p != v)
+					continue;
+				used.clear();
+				uint32_t u = p;
+				do
+				{
+					if (adjacencyOffset[u] != adjacencyOffset[u + 1])
+						used.push_back(u);
+					u = nextAtPosition[u];
+				} while (u != p);
+
+				uint8_t k = Locked;
+				if (lockPosition[p] || borderOut[p] > 1 || used.empty())
+					k = Locked;
+				else if (used.size() == 1)
+				{
+					Open o = open(used[0]);
+					if (borderOut[p] == 0)
+						k = o.outCount == 0 && o.inCount == 0 ? Manifold : Locked;
+					else
+						k = o.outCount == 1 && o.inCount == 1 ? Border : Locked;
+				}
+				else if (borderOut[p] == 0 && used.size() == 2)
+				{
+					// The seam runs in through one side and out through the other
+					Open o0 = open(used[0]), o1 = open(used[1]);
+					bool seam = o0.outCount == 1 && o0.inCount == 1 && o1.outCount == 1 && o1.inCount == 1 &&
+						o0.outTo == o1.inFrom && o0.inFrom == o1.outTo && o0.outTo != o0.inFrom;
+					k = seam ? Seam : Complex;
+				}
+				else if (borderOut[p] == 0)
+					k = Complex;
+				do
+				{
+					kind[u] = k;
+					u = nextAtPosition[u];
+				} while (u != p);
+			}
+		}
+
+		// Quadrics per position: triangle planes weighted by area, plus planes
+		// through border edges and the edges of Seam positions
+		std::vector<Quadric> quadrics(vertexCount, Quadric());
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const float* p[3];
+			for (int k = 0; k < 3; ++k)
+				p[k] = position(positions, vertexStride, indices[t * 3 + k]);
+			double n[3];
+			triangleNormal(p[0], p[1], p[2], n);
+			double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (len == 0)
+				continue;
+			for (int k = 0; k < 3; ++k)
+				n[k] /= len;
+			double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+			for (int k = 0; k < 3; ++k)
+				addPlane(quadrics[positionId[indices[t * 3 + k]]], n[0], n[1], n[2], d, len * 0.5);
+
+			for (int k = 0; k < 3; ++k)
+			{
+				uint32_t a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+				bool border = !hasHalfEdge(positionId[b], positionId[a]);
+				bool seam = !border && (kind[a] == Seam || kind[b] == Seam) && !hasVertexTwin(a, b);
+				if (!border && !seam)
+					continue;
+				// Plane through the edge, perpendicular to the triangle
+				const float* pa = p[k];
+				const float* pb = p[(k + 1) % 3];
+				double e[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+				double el = sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+				if (el == 0)
+					continue;
+				double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+				for (int j = 0; j < 3; ++j)
+					m[j] /= el;
+				double md = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+				addPlane(quadrics[positionId[a]], m[0], m[1], m[2], md, el * el * 10);
+				addPlane(quadrics[positionId[b]], m[0], m[1], m[2], md, el * el * 10);
+			}
+		}
+
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint8_t> collapseLocked(vertexCount);
+		std::vector<Candidate> candidates;
+		std::vector<uint32_t> ringFrom, ringTo;
+		std::vector<std::pair<uint32_t, uint32_t>> moves;
+
+		for (bool first = true; triangleCount * 3 > targetIndexCount; first = false)
+		{
+			if (!first)
+				buildAdjacency();
+
+			// Best direction for every edge; edges with twins of the same vertices are seen
+			// from both triangles, keep one. Manifold vertices collapse onto any neighbour,
+			// Border and Seam ones only along their border or seam, Complex ones onto
+			// Complex or Locked positions, so that the splits there are kept.
+			candidates.clear();
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					uint32_t a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+					if (kind[a] == Locked && kind[b] == Locked)
+						continue;
+					bool open = kind[a] != Manifold && kind[b] != Manifold && !hasVertexTwin(a, b);
+					bool border = open && !hasTwin(a, b);
+					if (!open && a > b)
+						continue;
+					Candidate best = { 0, 0, DBL_MAX };
+					uint32_t ends[2][2] = { { a, b }, { b, a } };
+					for (auto& e : ends)
+					{
+						uint8_t k0 = kind[e[0]], k1 = kind[e[1]];
+						bool allowed = k0 == Manifold || (k0 == Border && border) || (k0 == Seam && open && !border) ||
+							(k0 == Complex && (k1 == Complex || k1 == Locked));
+						if (!allowed)
+							continue;
+						Quadric q = quadrics[positionId[e[0]]];
+						add(q, quadrics[positionId[e[1]]]);
+						double error = evaluate(q, position(positions, vertexStride, e[1]));
+						if (error < best.error)
+						{
+							best.from = e[0];
+							best.to = e[1];
+							best.error = error;
+						}
+					}
+					if (best.error <= maxErrorSq)
+						candidates.push_back(best);
+				}
+			}
+			if (candidates.empty())
+				break;
+			std::sort(candidates.begin(), candidates.end(), [](const Candidate& l, const Candidate& r) { return l.error < r.error; });
+
+			for (size_t v = 0; v < vertexCount; ++v)
+				remap[v] = static_cast<uint32_t>(v);
+			std::fill(collapseLocked.begin(), collapseLocked.end(), 0);
+
+			// Every pass takes the best quarter of the triangles' worth of candidates, so
+			// that a collapse the locks below defer waits for the next pass instead of
+			// giving way to a worse one. The rest are only tried when none of those could
+			// collapse. The passes do not depend on the target, which only stops them, so
+			// a lower target never ends with more triangles than a higher one.
+			size_t removeGoal = triangleCount - targetIndexCount / 3;
+			size_t passGoal = (std::max)(triangleCount / 4, static_cast<size_t>(1));
+			size_t removed = 0;
+			size_t collapses = 0;
+			double errorLimit = candidates[(std::min)(candidates.size(), passGoal) - 1].error;
+			for (auto& c : candidates)
+			{
+				if (removed >= removeGoal)
+					break;
+				if (c.error > errorLimit)
+				{
+					if (collapses > 0)
+						break;
+					errorLimit = DBL_MAX;
+				}
+				if (collapseLocked[c.from] || collapseLocked[c.to])
+					continue;
+
+				// Every vertex at the position moves: onto the vertex its triangles along the
+				// edge hold at the other end, which removes them, or onto c.to if it has none.
+				// A vertex whose triangles along the edge hold different vertices there would
+				// weld the sides of a seam into zero-area triangles.
+				uint32_t fromPosition = positionId[c.from], toPosition = positionId[c.to];
+				size_t shared = 0;
+				bool torn = false;
+				ringFrom.clear();
+				moves.clear();
+				uint32_t u = c.from;
+				do
+				{
+					uint32_t target = 0xFFFFFFFFu;
+					for (uint32_t a = adjacencyOffset[u]; a < adjacencyOffset[u + 1]; ++a)
+					{
+						const index_t* tri = indices + adjacency[a] * 3;
+						for (int k = 0; k < 3; ++k)
+						{
+							uint32_t p = positionId[tri[k]];
+							if (p == toPosition)
+							{
+								torn |= target != 0xFFFFFFFFu && target != tri[k];
+								target = tri[k];
+								++shared;
+							}
+							else if (p != fromPosition)
+								ringFrom.push_back(p);
+						}
+					}
+					if (adjacencyOffset[u] != adjacencyOffset[u + 1])
+						moves.push_back(std::make_pair(u, target != 0xFFFFFFFFu ? target : c.to));
+					u = nextAtPosition[u];
+				} while (u != c.from);
+				if (torn)
+					continue;
+
+				// The ends may share no neighbour besides those of the triangles removed
+				// with the edge, or the collapse would fold the surface onto itself
+				std::sort(ringFrom.begin(), ringFrom.end());
+				ringFrom.erase(std::unique(ringFrom.begin(), ringFrom.end()), ringFrom.end());
+				ringTo.clear();
+				u = c.to;
+				do
+				{
+					for (uint32_t a = adjacencyOffset[u]; a < adjacencyOffset[u + 1]; ++a)
+					{
+						const index_t* tri = indices + adjacency[a] * 3;
+						for (int k = 0; k < 3; ++k)
+						{
+							uint32_t p = positionId[tri[k]];
+							if (p != fromPosition && p != toPosition)
+								ringTo.push_back(p);
+						}
+					}
+					u = nextAtPosition[u];
+				} while (u != c.to);
+				std::sort(ringTo.begin(), ringTo.end());
+				ringTo.erase(std::unique(ringTo.begin(), ringTo.end()), ringTo.end());
+				size_t common = 0;
+				for (size_t i = 0, j = 0; i < ringFrom.size() && j < ringTo.size();)
+				{
+					if (ringFrom[i] < ringTo[j])
+						++i;
+					else if (ringTo[j] < ringFrom[i])
+						++j;
+					else
+						++common, ++i, ++j;
+				}
+				if (common > shared)
+					continue;
+
+				// Reject collapses that flip a remaining triangle around the moved position
+				const float* target = position(positions, vertexStride, c.to);
+				bool flips = false;
+				for (auto& m : moves)
+				{
+					for (uint32_t a = adjacencyOffset[m.first]; a < adjacencyOffset[m.first + 1] && !flips; ++a)
+					{
+						const index_t* tri = indices + adjacency[a] * 3;
+						if (positionId[tri[0]] == toPosition || positionId[tri[1]] == toPosition || positionId[tri[2]] == toPosition)
+							continue;
+						const float* p[3];
+						const float* q[3];
+						for (int k = 0; k < 3; ++k)
+						{
+							p[k] = position(positions, vertexStride, tri[k]);
+							q[k] = tri[k] == m.first ? target : p[k];
+						}
+						double n0[3], n1[3];
+						triangleNormal(p[0], p[1], p[2], n0);
+						triangleNormal(q[0], q[1], q[2], n1);
+						double l0 = sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+						double l1 = sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+						flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] < 0.25 * l0 * l1;
+					}
+				}
+				if (flips)
+					continue;
+
+				for (auto& m : moves)
+					remap[m.first] = m.second;
+				add(quadrics[toPosition], quadrics[fromPosition]);
+				// The ring around the moved position changes too: another collapse into it
+				// this pass would pass the tests above against triangles that no longer exist
+				for (auto& m : moves)
+				{
+					for (uint32_t a = adjacencyOffset[m.first]; a < adjacencyOffset[m.first + 1]; ++a)
+					{
+						for (int k = 0; k < 3; ++k)
+						{
+							uint32_t v = indices[adjacency[a] * 3 + k];
+							uint32_t w = v;
+							do
+							{
+								collapseLocked[w] = 1;
+								w = nextAtPosition[w];
+							} while (w != v);
+						}
+					}
+				}
+				removed += shared;
+				worstError = (std::max)(worstError, c.error);
+				++collapses;
+			}
+			if (collapses == 0)
+				break;
+
+			// Apply the collapses and drop the degenerate triangles
+			size_t write = 0;
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				index_t v0 = static_cast<index_t>(remap[indices[t * 3 + 0]]);
+				index_t v1 = static_cast<index_t>(remap[indices[t * 3 + 1]]);
+				index_t v2 = static_cast<index_t>(remap[indices[t * 3 + 2]]);
+				if (v0 == v1 || v1 == v2 || v0 == v2)
+					continue;
+				indices[write * 3 + 0] = v0;
+				indices[write * 3 + 1] = v1;
+				indices[write * 3 + 2] = v2;
+				if (attributes)
+					attributes[write] = attributes[t];
+				++write;
+			}
+			triangleCount = write;
+		}
+
+		if (resultError)
+			*resultError = static_cast<float>(sqrt(worstError));
+		return triangleCount * 3;
+	}
+
+	// Builds up to levelCount levels, each about ratio times the triangles of the
+	// one before, into one index buffer (level 0 is the input). Every level has
+	// fewer triangles than the one before; the chain stops when none can be
+	// removed. lodAttributes, if not null, receives the attribute of every
+	// triangle of every level.
+	template<class index_t>
+	std::vector<Lod> generateLods(const index_t* indices, size_t indexCount, const uint32_t* attributes,
+		const void* positions, size_t vertexStride, size_t vertexCount,
+		size_t levelCount, float ratio, std::vector<index_t>& lodIndices, std::vector<uint32_t>* lodAttributes = nullptr,
+		float maxError = FLT_MAX)
+	{
+		std::vector<Lod> lods;
+		lodIndices.assign(indices, indices + indexCount);
+		if (lodAttributes)
+		{
+			if (attributes)
+				lodAttributes->assign(attributes, attributes + indexCount / 3);
+			else
+				lodAttributes->assign(indexCount / 3, 0);
+		}
+		Lod lod0 = { 0, static_cast<uint32_t>(indexCount), 0.0f };
+		lods.push_back(lod0);
+
+		std::vector<index_t> level(indices, indices + indexCount);
+		std::vector<uint32_t> levelAttributes;
+		if (attributes)
+			levelAttributes.assign(attributes, attributes + indexCount / 3);
+
+		for (size_t i = 1; i < levelCount; ++i)
+		{
+			size_t target = static_cast<size_t>(level.size() / 3 * ratio) * 3;
+			float error = 0;
+			size_t count = simplify(level.data(), level.size(), attributes ? levelAttributes.data() : nullptr,
+				positions, vertexStride, vertexCount, target, maxError, &error);
+			if (count >= level.size())
+				break; // Nothing left to collapse within maxError
+			level.resize(count);
+			if (attributes)
+				levelAttributes.resize(count / 3);
+
+			Lod lod = { static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(count), lods.back().error + error };
+			lods.push_back(lod);
+			lodIndices.insert(lodIndices.end(), level.begin(), level.end());
+			if (lodAttributes)
+			{
+				if (attributes)
+					lodAttributes->insert(lodAttributes->end(), levelAttributes.begin(), levelAttributes.end());
+				else
+					lodAttributes->resize(lodAttributes->size() + count / 3, 0);
+			}
+		}
+		return lods;
+	}
+
+	// Picks the coarsest level whose error projects to at most pixelError pixels.
+	// projectedScale is pixels per object-space unit at the object's distance,
+	// e.g. worldScale * viewportHeight / (2 * tan(fovY / 2) * distance).
+	inline size_t selectLod(const Lod* lods, size_t lodCount, float projectedScale, float pixelError = 1.0f)
+	{
+		size_t lod = 0;
+		for (size_t i = 1; i < lodCount; ++i)
+		{
+			if (lods[i].error * projectedScale > pixelError)
+				break;
+			lod = i;
+		}
+		return lod;
+	}
+};
@@ -0,0 +1,327 @@
+#pragma once
+
+// Splits an index buffer into meshlets (small clusters of triangles) for
+// CPU-side culling. The index buffer is reordered in place so each meshlet is
+// one contiguous index range, i.e. one DrawIndexed / indirect draw argument.
+// Each meshlet carries a bounding sphere for frustum culling and a normal
+// cone for backface culling of the whole cluster.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace MeshletBuilder
+{
+	static const size_t DefaultMaxVertices = 64;
+	static const size_t DefaultMaxTriangles = 124;
+
+	struct Meshlet
+	{
+		uint32_t indexStart;    // StartIndexLocation
+		uint32_t indexCount;    // IndexCountPerInstance
+		uint32_t vertexCount;   // unique vertices referenced
+		uint32_t attribute;     // material of every triangle in the meshlet
+		float center[3];
+		float radius;
+		float coneAxis[3];
+		float coneCutoff;       // sin of the cone half-angle; 1 disables cone culling
+	};
+
+	// Same layout as D3D12_DRAW_INDEXED_ARGUMENTS.
+	struct DrawIndexedArguments
+	{
+		uint32_t indexCountPerInstance;
+		uint32_t instanceCount;
+		uint32_t startIndexLocation;
+		int32_t baseVertexLocation;
+		uint32_t startInstanceLocation;
+	};
+
+	inline DrawIndexedArguments drawArguments(const Meshlet& m)
+	{
+		DrawIndexedArguments args = { m.indexCount, 1, m.indexStart, 0, 0 };
+		return args;
+	}
+
+	namespace detail
+	{
+		inline const float* position(const void* positions, size_t stride, uint32_t v)
+		{
+			return reinterpret_cast<const float*>(static_cast<const char*>(positions) + stride * v);
+		}
+
+		// Ritter's bounding sphere: start from the two far-apart points along the widest axis, then grow.
+		inline void boundingSphere(const std::vector<const float*>& points, float center[3], float& radius)
+		{
+			size_t pmin[3] = {}, pmax[3] = {};
+			for (size_t i = 0; i < points.size(); ++i)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					if (points[i][k] < points[pmin[k]][k]) pmin[k] = i;
+					if (points[i][k] > points[pmax[k]][k]) pmax[k] = i;
+				}
+			}
+			int axis = 0;
+			float best = -1;
+			for (int k = 0; k < 3; ++k)
+			{
+				const float* a = points[pmin[k]];
+				const float* b = points[pmax[k]];
+				float d = (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+				if (d > best)
+				{
+					best = d;
+					axis = k;
+				}
+			}
+			const float* a = points[pmin[axis]];
+			const float* b = points[pmax[axis]];
+			for (int k = 0; k < 3; ++k)
+				center[k] = (a[k] + b[k]) * 0.5f;
+			radius = sqrtf(best) * 0.5f;
+
+			for (auto p : points)
+			{
+				float d[3] = { p[0] - center[0], p[1] - center[1], p[2] - center[2] };
+				float dist = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+				if (dist > radius)
+				{
+					float grow = (dist - radius) * 0.5f;
+					radius += grow;
+					for (int k = 0; k < 3; ++k)
+						center[k] += d[k] / dist * grow;
+				}
+			}
+		}
+
+		template<class index_t>
+		void computeBounds(Meshlet& m, const index_t* indices, const void* positions, size_t stride)
+		{
+			std::vector<const float*> points;
+			points.reserve(m.indexCount);
+			float axis[3] = {};
+			std::vector<float> normals;
+			normals.reserve(m.indexCount);
+
+			for (uint32_t i = m.indexStart; i < m.indexStart + m.indexCount; i += 3)
+			{
+				const float* p0 = position(positions, stride, indices[i + 0]);
+				const float* p1 = position(positions, stride, indices[i + 1]);
+				const float* p2 = position(positions, stride, indices[i + 2]);
+				points.push_back(p0);
+				points.push_back(p1);
+				points.push_back(p2);
+
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				// Outward normal of a clockwise front face in a left-handed space
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (len == 0)
+					continue; // Degenerate triangles can not be seen from any side
+				for (int k = 0; k < 3; ++k)
+				{
+					normals.push_back(n[k] / len);
+					axis[k] += n[k] / len;
+				}
+			}
+
+			boundingSphere(points, m.center, m.radius);
+
+			float axisLen = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+			m.coneCutoff = 1.0f;
+			memset(m.coneAxis, 0, sizeof(m.coneAxis));
+			if (axisLen == 0)
+				return;
+			float minDot = 1.0f;
+			for (size_t i = 0; i < normals.size(); i += 3)
+			{
+				float d = (normals[i] * axis[0] + normals[i + 1] * axis[1] + normals[i + 2] * axis[2]) / axisLen;
+				minDot = (std::min)(minDot, d);
+			}
+			for (int k = 0; k < 3; ++k)
+				m.coneAxis[k] = axis[k] / axisLen;
+			// A cone wider than a hemisphere is visible from everywhere
+			if (minDot > 0)
+				m.coneCutoff = sqrtf(1.0f - minDot * minDot);
+		}
+	};
+
+	// Reorders indices so that meshlets are contiguous and returns them.
+	// Triangles are grown greedily from the current meshlet's vertices, preferring the
+	// triangle that adds the fewest new vertices. attributes (one per triangle, may be
+	// null) is respected: a meshlet never spans two materials, and since a meshlet only
+	// takes triangles from one run of equal attributes the array stays valid.
+	template<class index_t>
+	std::vector<Meshlet> build(index_t* indices, size_t indexCount, const uint32_t* attributes,
+		const void* positions, size_t vertexStride, size_t vertexCount,
+		size_t maxVertices = DefaultMaxVertices, size_t maxTriangles = DefaultMaxTriangles)
+	{
+		std::vector<Meshlet> meshlets;
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0)
+			return meshlets;
+
+		// Vertex -> triangle adjacency
+		std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			++adjacencyOffset[indices[i] + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacencyOffset[v + 1] += adjacencyOffset[v];
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		{
+			std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t t = 0; t < triangleCount; ++t)
+				for (int k = 0; k < 3; ++k)
+					adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+		}
+
+		std::vector<index_t> source(indices, indices + triangleCount * 3);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> meshletTag(vertexCount, 0xFFFFFFFFu); // meshlet id that last used the vertex
+		std::vector<uint32_t> meshletVertices;
+		meshletVertices.reserve(maxVertices);
+
+		size_t out = 0;
+		size_t runStart = 0;
+		while (runStart < triangleCount)
+		{
+			uint32_t attribute = attributes ? attributes[runStart] : 0;
+			size_t runEnd = attributes ? runStart + 1 : triangleCount;
+			while (runEnd < triangleCount && attributes[runEnd] == attribute)
+				++runEnd;
+
+			size_t seed = runStart;
+			for (;;)
+			{
+				while (seed < runEnd && emitted[seed])
+					++seed;
+				if (seed == runEnd)
+					break;
+
+				Meshlet m = {};
+				m.indexStart = static_cast<uint32_t>(out);
+				m.attribute = attribute;
+				uint32_t id = static_cast<uint32_t>(meshlets.size());
+				meshletVertices.clear();
+
+				size_t next = seed;
+				while (next != SIZE_MAX)
+				{
+					// Emit the triangle
+					emitted[next] = true;
+					for (int k = 0; k < 3; ++k)
+					{
+						index_t v = source[next * 3 + k];
+						indices[out++] = v;
+						if (meshletTag[v] != id)
+						{
+							meshletTag[v] = id;
+							meshletVertices.push_back(v);
+						}
+					}
+					m.indexCount += 3;
+					if (m.indexCount / 3 >= maxTriangles)
+						break;
+
+					// Pick the neighbouring triangle that adds the fewest new vertices
+					next = SIZE_MAX;
+					int bestNew = 4;
+					for (auto v : meshletVertices)
+					{
+						for (uint32_t a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a)
+						{
+							uint32_t t = adjacency[a];
+							if (emitted[t] || t < runStart || t >= runEnd)
+								continue;
+							int newCount = 0;
+							for (int k = 0; k < 3; ++k)
+								newCount += meshletTag[source[t * 3 + k]] != id;
+							if (newCount < bestNew || (newCount == bestNew && t < next))
+							{
+								bestNew = newCount;
+								next = t;
+							}
+						}
+						if (bestNew == 0)
+							break;
+					}
+					// No connected triangle left: continue with the next one in order
+					if (next == SIZE_MAX)
+					{
+						while (seed < runEnd && emitted[seed])
+							++seed;
+						if (seed < runEnd)
+						{
+							next = seed;
+							bestNew = 0;
+							for (int k = 0; k < 3; ++k)
+								bestNew += meshletTag[source[next * 3 + k]] != id;
+						}
+					}
+					if (next != SIZE_MAX && meshletVertices.size() + bestNew > maxVertices)
+						break;
+				}
+
+				m.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+				detail::computeBounds(m, indices, positions, vertexStride);
+				meshlets.push_back(m);
+			}
+			runStart = runEnd;
+		}
+		return meshlets;
+	}
+
+	// Extracts the six frustum planes (ax + by + cz + d >= 0 inside) from a
+	// row-major, row-vector matrix such as DirectXMath's world * view * proj.
+	// With a world-view-projection matrix the planes are in object space.
+	inline void extractFrustumPlanes(const float m[16], float planes[6][4])
+	{
+		for (int k = 0; k < 4; ++k)
+		{
+			float c0 = m[k * 4 + 0], c1 = m[k * 4 + 1], c2 = m[k * 4 + 2], c3 = m[k * 4 + 3];
+			planes[0][k] = c3 + c0; // left
+			planes[1][k] = c3 - c0; // right
+			planes[2][k] = c3 + c1; // bottom
+			planes[3][k] = c3 - c1; // top
+			planes[4][k] = c2;      // near (D3D depth range 0..1)
+			planes[5][k] = c3 - c2; // far
+		}
+		for (int p = 0; p < 6; ++p)
+		{
+			float len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+			if (len > 0)
+				for (int k = 0; k < 4; ++k)
+					planes[p][k] /= len;
+		}
+	}
+
+	inline bool isVisible(const Meshlet& m, const float planes[6][4], const float cameraPosition[3])
+	{
+		for (int p = 0; p < 6; ++p)
+		{
+			if (planes[p][0] * m.center[0] + planes[p][1] * m.center[1] + planes[p][2] * m.center[2] + planes[p][3] < -m.radius)
+				return false;
+		}
+		// Backfacing when the view direction is inside the cone for the whole sphere
+		float d[3] = { m.center[0] - cameraPosition[0], m.center[1] - cameraPosition[1], m.center[2] - cameraPosition[2] };
+		float dist = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		return d[0] * m.coneAxis[0] + d[1] * m.coneAxis[1] + d[2] * m.coneAxis[2] < m.coneCutoff * dist + m.radius;
+	}
+
+	// Writes the indices of visible meshlets and returns how many there are.
+	// planes and cameraPosition must be in the meshlets' (object) space.
+	inline size_t cull(const Meshlet* meshlets, size_t meshletCount, const float planes[6][4], const float cameraPosition[3], uint32_t* visible)
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < meshletCount; ++i)
+		{
+			if (isVisible(meshlets[i], planes, cameraPosition))
+				visible[count++] = static_cast<uint32_t>(i);
+		}
+		return count;
+	}
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+// Vertex deduplication of the chunks of ObjParser::parseChunked() on a JobSystem.
+// Every chunk first deduplicates its own face vertices with a VertexDedupTable
+// keyed on the positions it references, as one job per chunk. The unique
+// vertices of the chunks are then merged in file order through one table for
+// the whole file, which is the only serial step and costs one lookup per unique
+// vertex of a chunk rather than one per face vertex. Last, every chunk rewrites
+// its face vertices to the merged indices and triangulates its faces, again as
+// one job per chunk.
+// The result is the one a single VertexDedupTable gives over all face vertices
+// in file order: a vertex is identified by its position index and its bytes,
+// and the chunks are merged in order, so vertices keep their first-use order.
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "../_common/JobSystem.h"
+#include "ObjChunkParser.h"
+#include "VertexDedupTable.h"
+
+namespace ObjParser
+{
+	enum class MergeResult
+	{
+		Ok,
+		BadIndex,           // an element index out of range
+		BadFace,            // a face with fewer than 3 vertices
+		TooManyVertices,    // more unique vertices than the limit
+	};
+
+	namespace detail
+	{
+		template<class Vertex>
+		struct ChunkVertices
+		{
+			std::vector<Vertex> vertices;       // unique within the chunk, in first-use order
+			std::vector<FaceVertex> keys;       // the index triple each was first seen with
+			std::vector<uint32_t> corners;      // chunk vertex of every face vertex
+			std::vector<uint32_t> merged;       // chunk vertex -> merged vertex
+			size_t firstTriangle = 0;
+			MergeResult result = MergeResult::Ok;
+		};
+
+		template<class Vertex, class MakeVertex>
+		void dedupChunk(const ChunkRecords& chunk, size_t chunkIndex, MakeVertex& makeVertex, ChunkVertices<Vertex>& out)
+		{
+			// Keys are relative to the lowest position the chunk references, so the
+			// table heads cover the chunk's range rather than the whole file
+			uint32_t lowest = UINT32_MAX;
+			for (auto& fv : chunk.faceVertices)
+				lowest = (std::min)(lowest, fv.position);
+			if (lowest == 0)
+			{
+				out.result = MergeResult::BadIndex;
+				return;
+			}
+
+			VertexDedupTable<Vertex> table;
+			table.reserve(chunk.faceVertices.size());
+			out.corners.resize(chunk.faceVertices.size());
+			for (auto& face : chunk.faces)
+			{
+				if (face.vertexCount < 3)
+				{
+					out.result = MergeResult::BadFace;
+					return;
+				}
+				for (uint32_t k = face.firstVertex; k < face.firstVertex + face.vertexCount; ++k)
+				{
+					const FaceVertex& fv = chunk.faceVertices[k];
+					Vertex vertex;
+					if (!makeVertex(chunkIndex, face, fv, vertex))
+					{
+						out.result = MergeResult::BadIndex;
+						return;
+					}
+					uint32_t index = table.findOrAdd(fv.position - lowest, fv.texcoord, fv.normal, vertex, out.vertices);
+					if (index == VertexDedupTable<Vertex>::NotFound)
+					{
+						out.result = MergeResult::TooManyVertices;
+						return;
+					}
+					if (index == out.keys.size())
+						out.keys.push_back(fv);
+					out.corners[k] = index;
+				}
+			}
+		}
+
+		template<class Vertex, class Index>
+		void triangulateChunk(const ChunkRecords& chunk, const ChunkVertices<Vertex>& cv, bool ccw, Index* indices)
+		{
+			Index* out = indices + cv.firstTriangle * 3;
+			for (auto& face : chunk.faces)
+			{
+				const uint32_t* corners = &cv.corners[face.firstVertex];
+				Index i0 = static_cast<Index>(cv.merged[corners[0]]);
+				Index i1 = static_cast<Index>(cv.merged[corners[1]]);
+				for (uint32_t j = 2; j < face.vertexCount; ++j)
+				{
+					Index index = static_cast<Index>(cv.merged[corners[j]]);
+					*out++ = i0;
+					*out++ = ccw ? i1 : index;
+					*out++ = ccw ? index : i1;
+					i1 = index;
+				}
+			}
+		}
+	};
+
+	// Deduplicates the face vertices of chunks into vertices and triangulates the
+	// faces into indices, three per triangle, as fans wound like
+	// WaveFrontReader::AddPolygon(). makeVertex(chunkIndex, face, faceVertex, vertex)
+	// fills vertex and returns false when an index is out of range; it is called
+	// from the jobs. More than vertexLimit unique vertices fail.
+	template<class Vertex, class Index, class MakeVertex>
+	MergeResult mergeChunks(const std::vector<ChunkRecords>& chunks, JobSystem& jobs, bool ccw, size_t vertexLimit,
+		MakeVertex makeVertex, std::vector<Vertex>& vertices, std::vector<Index>& indices)
+	{
+		vertices.clear();
+		indices.clear();
+		std::vector<detail::ChunkVertices<Vertex>> chunkVertices(chunks.size());
+		jobs.parallelFor(0, static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t c)
+		{
+			detail::dedupChunk(chunks[c], c, makeVertex, chunkVertices[c]);
+		});
+
+		size_t uniqueCount = 0, triangleCount = 0;
+		for (size_t c = 0; c < chunks.size(); ++c)
+		{
+			auto& cv = chunkVertices[c];
+			if (cv.result != MergeResult::Ok)
+				return cv.result;
+			uniqueCount += cv.vertices.size();
+			cv.firstTriangle = triangleCount;
+			for (auto& face : chunks[c].faces)
+				triangleCount += face.vertexCount - 2;
+		}
+
+		// Serial: one lookup per unique vertex of every chunk, in file order
+		VertexDedupTable<Vertex> table;
+		table.reserve(uniqueCount);
+		vertices.reserve(uniqueCount);
+		for (auto& cv : chunkVertices)
+		{
+			cv.merged.resize(cv.vertices.size());
+			for (size_t i = 0; i < cv.vertices.size(); ++i)
+			{
+				const FaceVertex& key = cv.keys[i];
+				uint32_t index = table.findOrAdd(key.position, key.texcoord, key.normal, cv.vertices[i], vertices);
+				if (index == VertexDedupTable<Vertex>::NotFound || vertices.size() > vertexLimit)
+					return MergeResult::TooManyVertices;
+				cv.merged[i] = index;
+			}
+			cv.vertices.clear();
+			cv.vertices.shrink_to_fit();
+		}
+
+		indices.resize(triangleCount * 3);
+		jobs.parallelFor(0, static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t c)
+		{
+			detail::triangulateChunk(chunks[c], chunkVertices[c], ccw, indices.data());
+		});
+		return MergeResult::Ok;
+	}
+};
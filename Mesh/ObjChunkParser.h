@@ -0,0 +1,175 @@
+#pragma once
+
+// Multi-threaded front end of ObjParser.
+// The buffer is split at line boundaries, each chunk is scanned on its own
+// thread, or as a job of a JobSystem, into flat record arrays, and the caller
+// merges the chunks in order (ObjChunkMerge.h deduplicates their vertices).
+// Face records keep the element counts seen so far in the chunk, so the merged
+// result validates indices exactly like a serial scan.
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "../_common/JobSystem.h"
+#include "ObjParser.h"
+
+namespace ObjParser
+{
+	struct FaceRecord
+	{
+		uint32_t firstVertex;    // into ChunkRecords::faceVertices
+		uint32_t vertexCount;
+		uint32_t positionLimit;  // elements declared in this chunk before the face
+		uint32_t texcoordLimit;
+		uint32_t normalLimit;
+	};
+
+	struct MaterialRecord
+	{
+		uint32_t faceIndex;      // first face of the chunk that uses this material
+		const char* name;        // points into the source buffer
+		size_t length;
+	};
+
+	struct ChunkRecords
+	{
+		std::vector<float> positions; // xyz
+		std::vector<float> texcoords; // uv
+		std::vector<float> normals;   // xyz
+		std::vector<FaceVertex> faceVertices;
+		std::vector<FaceRecord> faces;
+		std::vector<MaterialRecord> materials;
+		const char* mtllibName = nullptr;
+		size_t mtllibLength = 0;
+		Result result = Result::Ok;
+
+		size_t positionCount() const { return positions.size() / 3; }
+		size_t texcoordCount() const { return texcoords.size() / 2; }
+		size_t normalCount() const { return normals.size() / 3; }
+
+		bool position(float x, float y, float z)
+		{
+			positions.push_back(x);
+			positions.push_back(y);
+			positions.push_back(z);
+			return true;
+		}
+		bool texcoord(float u, float v)
+		{
+			texcoords.push_back(u);
+			texcoords.push_back(v);
+			return true;
+		}
+		bool normal(float x, float y, float z)
+		{
+			normals.push_back(x);
+			normals.push_back(y);
+			normals.push_back(z);
+			return true;
+		}
+		bool face(const FaceVertex* verts, size_t count)
+		{
+			FaceRecord f;
+			f.firstVertex = static_cast<uint32_t>(faceVertices.size());
+			f.vertexCount = static_cast<uint32_t>(count);
+			f.positionLimit = static_cast<uint32_t>(positionCount());
+			f.texcoordLimit = static_cast<uint32_t>(texcoordCount());
+			f.normalLimit = static_cast<uint32_t>(normalCount());
+			faces.push_back(f);
+			faceVertices.insert(faceVertices.end(), verts, verts + count);
+			return true;
+		}
+		bool useMaterial(const char* name, size_t length)
+		{
+			MaterialRecord m = { static_cast<uint32_t>(faces.size()), name, length };
+			materials.push_back(m);
+			return true;
+		}
+		bool materialLibrary(const char* name, size_t length)
+		{
+			mtllibName = name;
+			mtllibLength = length;
+			return true;
+		}
+	};
+
+	// Splits [begin, end) into at most chunkCount ranges that end on '\n'.
+	inline std::vector<const char*> splitLines(const char* begin, const char* end, size_t chunkCount)
+	{
+		std::vector<const char*> bounds;
+		bounds.push_back(begin);
+		size_t size = static_cast<size_t>(end - begin);
+		for (size_t i = 1; i < chunkCount; ++i)
+		{
+			const char* p = begin + size * i / chunkCount;
+			if (p <= bounds.back())
+				continue;
+			p = skipLine(p - 1, end);
+			if (p > bounds.back() && p < end)
+				bounds.push_back(p);
+		}
+		bounds.push_back(end);
+		return bounds;
+	}
+
+	namespace detail
+	{
+		// Splits [begin, end) into at most chunkCount chunks and presizes their records
+		inline std::vector<const char*> prepareChunks(const char* begin, const char* end, std::vector<ChunkRecords>& chunks, size_t chunkCount)
+		{
+			// Small files are not worth the thread start-up
+			static const size_t MinChunkSize = 256 * 1024;
+
+			size_t maxChunks = std::max<size_t>(1, static_cast<size_t>(end - begin) / MinChunkSize);
+			auto bounds = splitLines(begin, end, std::min<size_t>(chunkCount, maxChunks));
+			chunks.clear();
+			chunks.resize(bounds.size() - 1);
+			return bounds;
+		}
+
+		inline void parseChunk(const std::vector<const char*>& bounds, std::vector<ChunkRecords>& chunks, size_t i)
+		{
+			// Rough reservation from the chunk size, assuming ~30 bytes per line
+			auto& c = chunks[i];
+			size_t lines = static_cast<size_t>(bounds[i + 1] - bounds[i]) / 30;
+			c.positions.reserve(lines * 3);
+			c.faceVertices.reserve(lines * 3);
+			c.faces.reserve(lines);
+			c.result = parse(bounds[i], bounds[i + 1], c);
+		}
+
+		inline Result firstError(const std::vector<ChunkRecords>& chunks)
+		{
+			for (auto& c : chunks)
+			{
+				if (c.result != Result::Ok)
+					return c.result;
+			}
+			return Result::Ok;
+		}
+	};
+
+	// Scans [begin, end) with threadCount threads (0 = hardware concurrency).
+	inline Result parseChunked(const char* begin, const char* end, std::vector<ChunkRecords>& chunks, unsigned int threadCount = 0)
+	{
+		if (threadCount == 0)
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+		auto bounds = detail::prepareChunks(begin, end, chunks, threadCount);
+
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < chunks.size(); ++i)
+			threads.emplace_back([&, i] { detail::parseChunk(bounds, chunks, i); });
+		detail::parseChunk(bounds, chunks, 0);
+		for (auto& t : threads)
+			t.join();
+		return detail::firstError(chunks);
+	}
+
+	// Scans [begin, end) in one chunk per thread of jobs, as jobs of that system
+	inline Result parseChunked(const char* begin, const char* end, std::vector<ChunkRecords>& chunks, JobSystem& jobs)
+	{
+		auto bounds = detail::prepareChunks(begin, end, chunks, (std::max)(1u, jobs.threadCount()));
+		jobs.parallelFor(0, static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t i) { detail::parseChunk(bounds, chunks, i); });
+		return detail::firstError(chunks);
+	}
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+// Allocation-free WaveFront OBJ tokenizer over a narrow byte buffer.
+// Records are handed to a Sink one at a time, so the same scanner serves
+// WaveFrontReader on Windows and plain C++ tools on Linux.
+//
+// Sink interface (return false to abort):
+//   bool position(float x, float y, float z);
+//   bool texcoord(float u, float v);
+//   bool normal(float x, float y, float z);
+//   bool face(const ObjParser::FaceVertex* verts, size_t count);
+//   bool useMaterial(const char* name, size_t length);
+//   bool materialLibrary(const char* name, size_t length);
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace ObjParser
+{
+	static const size_t MaxPolygonVertex = 64;
+
+	// OBJ indices are 1-based. 0 means the element is absent.
+	struct FaceVertex
+	{
+		uint32_t position;
+		uint32_t texcoord;
+		uint32_t normal;
+	};
+
+	enum class Result
+	{
+		Ok,
+		BadNumber,
+		BadFace,
+		TooManyPolygonVertex,
+		Aborted,
+	};
+
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+	}
+
+	inline bool isDigit(char c)
+	{
+		return static_cast<unsigned char>(c - '0') < 10;
+	}
+
+	inline const char* skipBlank(const char* p, const char* end)
+	{
+		while (p < end && isBlank(*p))
+			++p;
+		return p;
+	}
+
+	// Returns the position just after the next '\n' (or end).
+	inline const char* skipLine(const char* p, const char* end)
+	{
+		auto* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+		return nl ? nl + 1 : end;
+	}
+
+	inline const char* tokenEnd(const char* p, const char* end)
+	{
+		while (p < end && *p != '\n' && !isBlank(*p))
+			++p;
+		return p;
+	}
+
+	inline bool parseUInt(const char*& p, const char* end, uint32_t& out)
+	{
+		p = skipBlank(p, end);
+		if (p >= end || !isDigit(*p))
+			return false;
+		uint64_t v = 0;
+		while (p < end && isDigit(*p))
+		{
+			v = v * 10 + (*p++ - '0');
+			if (v > 0xFFFFFFFFu)
+				return false;
+		}
+		out = static_cast<uint32_t>(v);
+		return true;
+	}
+
+	// Parses a decimal float.
+	// Short mantissas with small exponents are computed with a single correctly
+	// rounded float operation (both operands are exact), which gives the same
+	// bits as strtof(). Anything else falls back to strtof() on a local copy.
+	inline bool parseFloat(const char*& p, const char* end, float& out)
+	{
+		static const float pow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+		p = skipBlank(p, end);
+		const char* start = p;
+		bool neg = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			neg = (*p++ == '-');
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any = false;
+		while (p < end && isDigit(*p))
+		{
+			if (mantissa || *p != '0')
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				++digits;
+			}
+			++p;
+			any = true;
+			if (digits > 18)
+				break;
+		}
+		if (p < end && *p == '.')
+		{
+			++p;
+			while (p < end && isDigit(*p))
+			{
+				if (mantissa || *p != '0')
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					++digits;
+				}
+				--exponent;
+				++p;
+				any = true;
+				if (digits > 18)
+					break;
+			}
+		}
+		if (any && p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* q = p + 1;
+			bool expNeg = false;
+			if (q < end && (*q == '-' || *q == '+'))
+				expNeg = (*q++ == '-');
+			if (q < end && isDigit(*q))
+			{
+				int e = 0;
+				while (q < end && isDigit(*q))
+				{
+					if (e < 10000)
+						e = e * 10 + (*q - '0');
+					++q;
+				}
+				exponent += expNeg ? -e : e;
+				p = q;
+			}
+		}
+
+		bool fast = any && digits <= 18 && (p >= end || !(isDigit(*p) || *p == '.'));
+		if (fast && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10)
+		{
+			float f = static_cast<float>(mantissa);
+			f = exponent < 0 ? f / pow10[-exponent] : f * pow10[exponent];
+			out = neg ? -f : f;
+			return true;
+		}
+
+		// Slow path: long mantissa, large exponent, inf/nan
+		char buf[128];
+		const char* tokEnd = tokenEnd(start, end);
+		size_t len = static_cast<size_t>(tokEnd - start);
+		if (len == 0 || len >= sizeof(buf))
+			return false;
+		memcpy(buf, start, len);
+		buf[len] = '\0';
+		char* stop = nullptr;
+		out = strtof(buf, &stop);
+		if (stop == buf)
+			return false;
+		p = start + (stop - buf);
+		return true;
+	}
+
+	template<class Sink>
+	Result parseFace(const char*& p, const char* end, Sink& sink)
+	{
+		FaceVertex verts[MaxPolygonVertex];
+		size_t count = 0;
+		for (;;)
+		{
+			if (count >= MaxPolygonVertex)
+				return Result::TooManyPolygonVertex;
+
+			FaceVertex& fv = verts[count];
+			fv.position = fv.texcoord = fv.normal = 0;
+			if (!parseUInt(p, end, fv.position))
+				return Result::BadFace;
+			if (p < end && *p == '/')
+			{
+				++p;
+				if (p < end && *p != '/')
+				{
+					// Optional texture coordinate
+					if (!parseUInt(p, end, fv.texcoord))
+						return Result::BadFace;
+				}
+				if (p < end && *p == '/')
+				{
+					++p;
+					// Optional vertex normal
+					if (!parseUInt(p, end, fv.normal))
+						return Result::BadFace;
+				}
+			}
+			++count;
+
+			// Check for more face data or end of the face statement
+			while (p < end && *p != '\n' && !isDigit(*p))
+				++p;
+			if (p >= end || *p == '\n')
+				break;
+		}
+		return sink.face(verts, count) ? Result::Ok : Result::Aborted;
+	}
+
+	// Parses [begin, end). The range may be any run of whole lines.
+	template<class Sink>
+	Result parse(const char* begin, const char* end, Sink& sink)
+	{
+		const char* p = begin;
+		while (p < end)
+		{
+			// Skip blank lines and leading white space
+			while (p < end && (isBlank(*p) || *p == '\n'))
+				++p;
+			if (p >= end)
+				break;
+
+			const char* cmd = p;
+			p = tokenEnd(p, end);
+			size_t cmdLen = static_cast<size_t>(p - cmd);
+			bool ok = true;
+
+			if (cmdLen == 1 && cmd[0] == 'v')
+			{
+				// Vertex Position
+				float x, y, z;
+				if (!parseFloat(p, end, x) || !parseFloat(p, end, y) || !parseFloat(p, end, z))
+					return Result::BadNumber;
+				ok = sink.position(x, y, z);
+			}
+			else if (cmdLen == 2 && cmd[0] == 'v' && cmd[1] == 't')
+			{
+				// Vertex TexCoord
+				float u, v;
+				if (!parseFloat(p, end, u) || !parseFloat(p, end, v))
+					return Result::BadNumber;
+				ok = sink.texcoord(u, v);
+			}
+			else if (cmdLen == 2 && cmd[0] == 'v' && cmd[1] == 'n')
+			{
+				// Vertex Normal
+				float x, y, z;
+				if (!parseFloat(p, end, x) || !parseFloat(p, end, y) || !parseFloat(p, end, z))
+					return Result::BadNumber;
+				ok = sink.normal(x, y, z);
+			}
+			else if (cmdLen == 1 && cmd[0] == 'f')
+			{
+				// Face
+				Result r = parseFace(p, end, sink);
+				if (r != Result::Ok)
+					return r;
+			}
+			else if (cmdLen == 6 && memcmp(cmd, "mtllib", 6) == 0)
+			{
+				// Material library
+				const char* name = skipBlank(p, end);
+				p = tokenEnd(name, end);
+				ok = sink.materialLibrary(name, static_cast<size_t>(p - name));
+			}
+			else if (cmdLen == 6 && memcmp(cmd, "usemtl", 6) == 0)
+			{
+				// Material
+				const char* name = skipBlank(p, end);
+				p = tokenEnd(name, end);
+				ok = sink.useMaterial(name, static_cast<size_t>(p - name));
+			}
+			else
+			{
+				// Comment, unimplemented or unrecognized command
+			}
+
+			if (!ok)
+				return Result::Aborted;
+			p = skipLine(p, end);
+		}
+		return Result::Ok;
+	}
+};
@@ -0,0 +1,403 @@
+#pragma once
+
+// SDKMESH (version 101/200) file format.
+// SdkMesh::File validates every table (vertex/index buffer headers, meshes,
+// subsets, frames, materials) of a file held in memory and reads them in
+// place; load() converts one mesh to float3/float3/float2 vertices. There are
+// no platform headers, so SdkMeshReader on Windows and plain C++ tools on
+// Linux share the same checks.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace SdkMesh
+{
+	static const uint32_t FileVersion = 101;
+	static const uint32_t FileVersionV2 = 200;
+	static const size_t MaxVertexElements = 32;
+	static const size_t MaxVertexStreams = 16;
+
+	enum IndexType : uint32_t
+	{
+		IndexType16Bit = 0,
+		IndexType32Bit = 1,
+	};
+
+	enum PrimitiveType : uint32_t
+	{
+		PrimitiveTriangleList = 0,
+	};
+
+	// D3DDECLTYPE / D3DDECLUSAGE values used by the vertex declaration
+	enum : uint8_t
+	{
+		DeclTypeFloat2 = 1,
+		DeclTypeFloat3 = 2,
+		DeclTypeUnused = 17,
+		DeclUsagePosition = 0,
+		DeclUsageNormal = 3,
+		DeclUsageTexcoord = 5,
+	};
+
+	// Vectors and matrices are stored as DirectXMath's XMFLOAT3/XMFLOAT4/XMFLOAT4X4
+#pragma pack(push, 8)
+	struct Header
+	{
+		uint32_t Version;
+		uint8_t IsBigEndian;
+		uint64_t HeaderSize;
+		uint64_t NonBufferDataSize;
+		uint64_t BufferDataSize;
+
+		uint32_t NumVertexBuffers;
+		uint32_t NumIndexBuffers;
+		uint32_t NumMeshes;
+		uint32_t NumTotalSubsets;
+		uint32_t NumFrames;
+		uint32_t NumMaterials;
+
+		uint64_t VertexStreamHeadersOffset;
+		uint64_t IndexStreamHeadersOffset;
+		uint64_t MeshDataOffset;
+		uint64_t SubsetDataOffset;
+		uint64_t FrameDataOffset;
+		uint64_t MaterialDataOffset;
+	};
+
+	struct VertexElement
+	{
+		uint16_t Stream;
+		uint16_t Offset;
+		uint8_t Type;
+		uint8_t Method;
+		uint8_t Usage;
+		uint8_t UsageIndex;
+	};
+
+	struct VertexBufferHeader
+	{
+		uint64_t NumVertices;
+		uint64_t SizeBytes;
+		uint64_t StrideBytes;
+		VertexElement Decl[MaxVertexElements];
+		uint64_t DataOffset;
+	};
+
+	struct IndexBufferHeader
+	{
+		uint64_t NumIndices;
+		uint64_t SizeBytes;
+		uint32_t IndexType;
+		uint64_t DataOffset;
+	};
+
+	struct Mesh
+	{
+		char Name[100];
+		uint8_t NumVertexBuffers;
+		uint32_t VertexBuffers[MaxVertexStreams];
+		uint32_t IndexBuffer;
+		uint32_t NumSubsets;
+		uint32_t NumFrameInfluences;
+		float BoundingBoxCenter[3];
+		float BoundingBoxExtents[3];
+		uint64_t SubsetOffset;          // uint32_t[NumSubsets] of subset indices
+		uint64_t FrameInfluenceOffset;
+	};
+
+	struct Subset
+	{
+		char Name[100];
+		uint32_t MaterialID;
+		uint32_t PrimitiveType;
+		uint64_t IndexStart;
+		uint64_t IndexCount;
+		uint64_t VertexStart;
+		uint64_t VertexCount;
+	};
+
+	struct Frame
+	{
+		char Name[100];
+		uint32_t Mesh;
+		uint32_t ParentFrame;
+		uint32_t ChildFrame;
+		uint32_t SiblingFrame;
+		float Matrix[4][4];
+		uint32_t AnimationDataIndex;
+	};
+
+	struct Material
+	{
+		char Name[100];
+		char MaterialInstancePath[260];
+		char DiffuseTexture[260];
+		char NormalTexture[260];
+		char SpecularTexture[260];
+		float Diffuse[4];
+		float Ambient[4];
+		float Specular[4];
+		float Emissive[4];
+		float Power;
+		uint64_t Force64[6];
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(Header) == 104, "SDKMESH header size mismatch");
+	static_assert(sizeof(VertexBufferHeader) == 288, "SDKMESH vertex buffer header size mismatch");
+	static_assert(sizeof(IndexBufferHeader) == 32, "SDKMESH index buffer header size mismatch");
+	static_assert(sizeof(Mesh) == 224, "SDKMESH mesh size mismatch");
+	static_assert(sizeof(Subset) == 144, "SDKMESH subset size mismatch");
+	static_assert(sizeof(Frame) == 184, "SDKMESH frame size mismatch");
+	static_assert(sizeof(Material) == 1256, "SDKMESH material size mismatch");
+
+	class File
+	{
+	public:
+		// Validates every table of size bytes at data, which must stay valid
+		// while the file is used. Nothing is copied.
+		bool open(const char* data, size_t size)
+		{
+			close();
+			mData = data;
+			mSize = size;
+
+			if (mSize < sizeof(SdkMesh::Header))
+				return fail();
+			auto* h = reinterpret_cast<const SdkMesh::Header*>(mData);
+			if ((h->Version != FileVersion && h->Version != FileVersionV2) || h->IsBigEndian)
+				return fail();
+			if (h->HeaderSize > mSize || h->NonBufferDataSize > mSize - h->HeaderSize ||
+				h->BufferDataSize > mSize - h->HeaderSize - h->NonBufferDataSize)
+				return fail();
+			if (!inFile(h->VertexStreamHeadersOffset, sizeof(SdkMesh::VertexBufferHeader), h->NumVertexBuffers) ||
+				!inFile(h->IndexStreamHeadersOffset, sizeof(SdkMesh::IndexBufferHeader), h->NumIndexBuffers) ||
+				!inFile(h->MeshDataOffset, sizeof(SdkMesh::Mesh), h->NumMeshes) ||
+				!inFile(h->SubsetDataOffset, sizeof(SdkMesh::Subset), h->NumTotalSubsets) ||
+				!inFile(h->FrameDataOffset, sizeof(SdkMesh::Frame), h->NumFrames) ||
+				!inFile(h->MaterialDataOffset, sizeof(SdkMesh::Material), h->NumMaterials))
+				return fail();
+			mHeader = h;
+
+			// Element counts are checked by division, their products can overflow 64 bits
+			for (uint32_t i = 0; i < h->NumVertexBuffers; ++i)
+			{
+				auto& vb = VertexBufferHeader(i);
+				if (vb.StrideBytes == 0 ? vb.NumVertices != 0 : vb.NumVertices > vb.SizeBytes / vb.StrideBytes)
+					return fail();
+				if (!inFile(vb.DataOffset, vb.SizeBytes, 1))
+					return fail();
+			}
+			for (uint32_t i = 0; i < h->NumIndexBuffers; ++i)
+			{
+				auto& ib = IndexBufferHeader(i);
+				if (ib.IndexType != IndexType16Bit && ib.IndexType != IndexType32Bit)
+					return fail();
+				uint64_t size = (ib.IndexType == IndexType32Bit) ? 4 : 2;
+				if (ib.NumIndices > ib.SizeBytes / size || !inFile(ib.DataOffset, ib.SizeBytes, 1))
+					return fail();
+			}
+			for (uint32_t i = 0; i < h->NumMeshes; ++i)
+			{
+				auto& m = Mesh(i);
+				if (m.NumVertexBuffers > MaxVertexStreams || m.IndexBuffer >= h->NumIndexBuffers ||
+					!inFile(m.SubsetOffset, sizeof(uint32_t), m.NumSubsets))
+					return fail();
+				for (uint32_t j = 0; j < m.NumVertexBuffers; ++j)
+				{
+					if (m.VertexBuffers[j] >= h->NumVertexBuffers)
+						return fail();
+				}
+				for (uint32_t j = 0; j < m.NumSubsets; ++j)
+				{
+					if (SubsetIndices(i)[j] >= h->NumTotalSubsets)
+						return fail();
+				}
+			}
+
+			return true;
+		}
+
+		void close()
+		{
+			mData = nullptr;
+			mSize = 0;
+			mHeader = nullptr;
+		}
+
+		// Fills vertices/indices/attributes from stream 0 of an opened mesh.
+		// Vertex is float3 position, float3 normal, float2 texcoord; absent
+		// elements are zero. When the vertex declaration and index size already
+		// match, both buffers are copied with one memcpy each. Every index is
+		// checked against the vertex count once subset VertexStarts are added.
+		template<class Vertex, class index_t>
+		bool load(uint32_t meshIndex, std::vector<Vertex>& vertices, std::vector<index_t>& indices, std::vector<uint32_t>& attributes,
+			bool& hasNormals, bool& hasTexcoords) const
+		{
+			static_assert(sizeof(Vertex) == 32, "Vertex must be float3 position, float3 normal, float2 texcoord");
+
+			if (!mHeader || meshIndex >= mHeader->NumMeshes)
+				return false;
+			auto& mesh = Mesh(meshIndex);
+			if (mesh.NumVertexBuffers == 0)
+				return false;
+			auto& vbh = VertexBufferHeader(mesh.VertexBuffers[0]);
+			auto& ibh = IndexBufferHeader(mesh.IndexBuffer);
+
+			// Locate position/normal/texcoord in the declaration
+			int posOffset = -1, normalOffset = -1, texOffset = -1;
+			for (size_t i = 0; i < MaxVertexElements; ++i)
+			{
+				auto& e = vbh.Decl[i];
+				if (e.Stream == 0xFF || e.Type == DeclTypeUnused)
+					break;
+				if (e.UsageIndex != 0)
+					continue;
+				if (e.Usage == DeclUsagePosition && e.Type == DeclTypeFloat3)
+					posOffset = e.Offset;
+				else if (e.Usage == DeclUsageNormal && e.Type == DeclTypeFloat3)
+					normalOffset = e.Offset;
+				else if (e.Usage == DeclUsageTexcoord && e.Type == DeclTypeFloat2)
+					texOffset = e.Offset;
+			}
+			if (posOffset < 0)
+				return false;
+
+			// Every element must lie inside one vertex
+			size_t stride = static_cast<size_t>(vbh.StrideBytes);
+			if (static_cast<size_t>(posOffset) + 12 > stride ||
+				(normalOffset >= 0 && static_cast<size_t>(normalOffset) + 12 > stride) ||
+				(texOffset >= 0 && static_cast<size_t>(texOffset) + 8 > stride))
+				return false;
+			hasNormals = normalOffset >= 0;
+			hasTexcoords = texOffset >= 0;
+
+			auto* src = VertexData(mesh.VertexBuffers[0]);
+			vertices.resize(static_cast<size_t>(vbh.NumVertices));
+			if (stride == sizeof(Vertex) && posOffset == 0 && normalOffset == 12 && texOffset == 24)
+			{
+				memcpy(vertices.data(), src, vertices.size() * sizeof(Vertex));
+			}
+			else
+			{
+				memset(vertices.data(), 0, vertices.size() * sizeof(Vertex));
+				for (size_t i = 0; i < vertices.size(); ++i, src += stride)
+				{
+					auto* dst = reinterpret_cast<char*>(&vertices[i]);
+					memcpy(dst, src + posOffset, 12);
+					if (hasNormals)
+						memcpy(dst + 12, src + normalOffset, 12);
+					if (hasTexcoords)
+						memcpy(dst + 24, src + texOffset, 8);
+				}
+			}
+
+			indices.resize(static_cast<size_t>(ibh.NumIndices));
+			if (ibh.IndexType == IndexType16Bit)
+			{
+				auto* ib = reinterpret_cast<const uint16_t*>(IndexData(mesh.IndexBuffer));
+				if (sizeof(index_t) == 2)
+					memcpy(indices.data(), ib, indices.size() * sizeof(uint16_t));
+				else
+					std::copy(ib, ib + indices.size(), indices.begin());
+			}
+			else
+			{
+				auto* ib = reinterpret_cast<const uint32_t*>(IndexData(mesh.IndexBuffer));
+				if (sizeof(index_t) == 4)
+				{
+					memcpy(indices.data(), ib, indices.size() * sizeof(uint32_t));
+				}
+				else
+				{
+					for (size_t i = 0; i < indices.size(); ++i)
+					{
+						// Too many indices for 16-bit IB!
+						if (ib[i] >= 0xFFFF)
+							return false;
+						indices[i] = static_cast<index_t>(ib[i]);
+					}
+				}
+			}
+
+			// One attribute per triangle, taken from the subset that covers it.
+			// Subset indices are relative to the subset's VertexStart.
+			attributes.assign(indices.size() / 3, 0);
+			auto* subsetIndices = SubsetIndices(meshIndex);
+			for (uint32_t i = 0; i < mesh.NumSubsets; ++i)
+			{
+				auto& s = Subset(subsetIndices[i]);
+				if (s.PrimitiveType != PrimitiveTriangleList)
+					return false;
+				if (s.IndexStart % 3 != 0 || s.IndexCount % 3 != 0 ||
+					s.IndexStart > indices.size() || s.IndexCount > indices.size() - s.IndexStart)
+					return false;
+				if (s.MaterialID >= mHeader->NumMaterials)
+					return false;
+				if (s.VertexStart)
+				{
+					if (s.VertexStart >= vertices.size())
+						return false;
+					for (size_t j = static_cast<size_t>(s.IndexStart); j < static_cast<size_t>(s.IndexStart + s.IndexCount); ++j)
+					{
+						uint64_t index = indices[j] + s.VertexStart;
+						// Too many vertices for 16-bit IB!
+						if (sizeof(index_t) == 2 && index >= 0xFFFF)
+							return false;
+						indices[j] = static_cast<index_t>(index);
+					}
+				}
+				std::fill(attributes.begin() + static_cast<size_t>(s.IndexStart / 3),
+					attributes.begin() + static_cast<size_t>((s.IndexStart + s.IndexCount) / 3),
+					s.MaterialID);
+			}
+
+			// Including those no subset covers
+			for (index_t index : indices)
+			{
+				if (index >= vertices.size())
+					return false;
+			}
+
+			return true;
+		}
+
+		// In-place views into the file. Valid until close() or the next open().
+		const SdkMesh::Header& Header() const { return *mHeader; }
+		const SdkMesh::VertexBufferHeader& VertexBufferHeader(uint32_t i) const { return table<SdkMesh::VertexBufferHeader>(mHeader->VertexStreamHeadersOffset)[i]; }
+		const SdkMesh::IndexBufferHeader& IndexBufferHeader(uint32_t i) const { return table<SdkMesh::IndexBufferHeader>(mHeader->IndexStreamHeadersOffset)[i]; }
+		const SdkMesh::Mesh& Mesh(uint32_t i) const { return table<SdkMesh::Mesh>(mHeader->MeshDataOffset)[i]; }
+		const uint32_t* SubsetIndices(uint32_t mesh) const { return table<uint32_t>(Mesh(mesh).SubsetOffset); }
+		const SdkMesh::Subset& Subset(uint32_t i) const { return table<SdkMesh::Subset>(mHeader->SubsetDataOffset)[i]; }
+		const SdkMesh::Frame& Frame(uint32_t i) const { return table<SdkMesh::Frame>(mHeader->FrameDataOffset)[i]; }
+		const SdkMesh::Material& Material(uint32_t i) const { return table<SdkMesh::Material>(mHeader->MaterialDataOffset)[i]; }
+		const char* VertexData(uint32_t i) const { return mData + VertexBufferHeader(i).DataOffset; }
+		const char* IndexData(uint32_t i) const { return mData + IndexBufferHeader(i).DataOffset; }
+
+	private:
+		const char* mData = nullptr;
+		size_t mSize = 0;
+		const SdkMesh::Header* mHeader = nullptr;
+
+		bool fail()
+		{
+			close();
+			return false;
+		}
+
+		template<class T>
+		const T* table(uint64_t offset) const
+		{
+			return reinterpret_cast<const T*>(mData + offset);
+		}
+
+		// Element sizes are at most a table entry or a single buffer, so the product fits
+		bool inFile(uint64_t offset, uint64_t elementSize, uint64_t count) const
+		{
+			return offset <= mSize && elementSize * count <= mSize - offset;
+		}
+	};
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+// SDKMESH (version 101/200) reader.
+// The file is memory-mapped and every table (vertex/index buffer headers,
+// meshes, subsets, frames, materials) is validated and used in place by
+// SdkMesh::File. Load() additionally fills the same vertices/indices/attributes
+// surface as WaveFrontReader, so samples can switch between OBJ and SDKMESH
+// assets.
+
+#include <windows.h>
+
+#include <string>
+#include <vector>
+
+#include <directxmath.h>
+#include <directxcollision.h>
+
+#include "../_common/MappedFile.h"
+#include "SdkMeshFormat.h"
+
+template<class index_t>
+class SdkMeshReader
+{
+public:
+	struct Vertex
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMFLOAT3 normal;
+		DirectX::XMFLOAT2 textureCoordinate;
+	};
+
+	// Maps the file and validates every table. Nothing is copied.
+	HRESULT Open(_In_z_ const wchar_t* szFileName)
+	{
+		Clear();
+
+		if (!mFile.open(szFileName))
+			return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+		if (!mSdkMesh.open(mFile.data(), mFile.size()))
+			return E_FAIL;
+
+		return S_OK;
+	}
+
+	// Open() and fill vertices/indices/attributes from stream 0 of one mesh.
+	// When the vertex declaration and index size already match, both buffers
+	// are copied with one memcpy each.
+	HRESULT Load(_In_z_ const wchar_t* szFileName, uint32_t meshIndex = 0)
+	{
+		HRESULT hr = Open(szFileName);
+		if (FAILED(hr))
+			return hr;
+		if (meshIndex >= Header().NumMeshes)
+			return E_INVALIDARG;
+
+		WCHAR fname[_MAX_FNAME];
+		_wsplitpath_s(szFileName, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, nullptr, 0);
+		name = fname;
+
+		if (!mSdkMesh.load(meshIndex, vertices, indices, attributes, hasNormals, hasTexcoords))
+			return E_FAIL;
+
+		auto& mesh = Mesh(meshIndex);
+		bounds.Center = DirectX::XMFLOAT3(mesh.BoundingBoxCenter);
+		bounds.Extents = DirectX::XMFLOAT3(mesh.BoundingBoxExtents);
+
+		return S_OK;
+	}
+
+	void Clear()
+	{
+		mSdkMesh.close();
+		mFile.close();
+		vertices.clear();
+		indices.clear();
+		attributes.clear();
+		name.clear();
+		hasNormals = false;
+		hasTexcoords = false;
+
+		bounds.Center.x = bounds.Center.y = bounds.Center.z = 0.f;
+		bounds.Extents.x = bounds.Extents.y = bounds.Extents.z = 0.f;
+	}
+
+	// In-place views into the mapped file. Valid until Clear() or the next Open().
+	const SdkMesh::Header& Header() const { return mSdkMesh.Header(); }
+	const SdkMesh::VertexBufferHeader& VertexBufferHeader(uint32_t i) const { return mSdkMesh.VertexBufferHeader(i); }
+	const SdkMesh::IndexBufferHeader& IndexBufferHeader(uint32_t i) const { return mSdkMesh.IndexBufferHeader(i); }
+	const SdkMesh::Mesh& Mesh(uint32_t i) const { return mSdkMesh.Mesh(i); }
+	const uint32_t* SubsetIndices(uint32_t mesh) const { return mSdkMesh.SubsetIndices(mesh); }
+	const SdkMesh::Subset& Subset(uint32_t i) const { return mSdkMesh.Subset(i); }
+	const SdkMesh::Frame& Frame(uint32_t i) const { return mSdkMesh.Frame(i); }
+	const SdkMesh::Material& Material(uint32_t i) const { return mSdkMesh.Material(i); }
+	const char* VertexData(uint32_t i) const { return mSdkMesh.VertexData(i); }
+	const char* IndexData(uint32_t i) const { return mSdkMesh.IndexData(i); }
+
+	std::vector<Vertex>     vertices;
+	std::vector<index_t>    indices;
+	std::vector<uint32_t>   attributes;
+
+	std::wstring            name;
+	bool                    hasNormals = false;
+	bool                    hasTexcoords = false;
+
+	DirectX::BoundingBox    bounds;
+
+private:
+	MappedFile mFile;
+	SdkMesh::File mSdkMesh;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+// Flat table for OBJ vertex deduplication.
+// Entries are keyed on the (position, texcoord, normal) index triple, so repeated
+// corners of adjacent faces resolve without a vertex compare. OBJ position
+// indices are dense, so each position indexes the head of its own chain of
+// triples directly: faces mostly reference nearby positions, and the heads and
+// the entries, stored in insertion order, stay in a few cache lines where a
+// hash would scatter them. A triple seen for the first time is compared by
+// vertex bytes with the other triples of its position, which keeps merging
+// vertices whose attributes are equal but were written with different indices.
+// Both arrays grow by doubling, so there is no heap allocation per insert.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+template<class Vertex>
+class VertexDedupTable
+{
+	static const uint32_t Empty = 0xFFFFFFFFu;
+
+	struct Entry
+	{
+		uint32_t texcoord, normal;
+		uint32_t index;
+		uint32_t next;                  // next entry of the same position
+	};
+
+	std::vector<uint32_t> mHeads;       // first entry per position index
+	std::vector<Entry> mEntries;
+
+public:
+	static const uint32_t NotFound = Empty;
+
+	VertexDedupTable()
+	{
+		reserve(1024);
+	}
+
+	// Presizes for about vertexCount face corners (e.g. 3 * face count).
+	// Only the capacity is reserved, so a generous count costs address space only.
+	void reserve(size_t vertexCount)
+	{
+		mHeads.reserve(vertexCount + 1);
+		mEntries.reserve(vertexCount);
+	}
+
+	void clear()
+	{
+		mHeads.clear();
+		mEntries.clear();
+	}
+
+	// Returns the index of an equal vertex, appending it to vertices if none exists.
+	// Index 0 means the texcoord or normal is absent, as in OBJ.
+	uint32_t findOrAdd(uint32_t position, uint32_t texcoord, uint32_t normal, const Vertex& v, std::vector<Vertex>& vertices)
+	{
+		if (position >= mHeads.size())
+		{
+			// Double within the reserved capacity; parenthesized for the min/max macros of Windows.h
+			size_t size = (std::min)(mHeads.capacity(), mHeads.size() * 2);
+			mHeads.resize((std::max)(static_cast<size_t>(position) + 1, size), uint32_t(Empty));
+		}
+
+		uint32_t index = Empty;
+		for (uint32_t i = mHeads[position]; i != Empty; i = mEntries[i].next)
+		{
+			auto& e = mEntries[i];
+			if (e.texcoord == texcoord && e.normal == normal)
+				return e.index;
+			// New triple: look for a vertex with equal contents under the same position
+			if (index == Empty && memcmp(&vertices[e.index], &v, sizeof(Vertex)) == 0)
+				index = e.index;
+		}
+
+		if (index == Empty)
+		{
+			if (vertices.size() >= Empty || mEntries.size() >= Empty)
+				return NotFound;
+			index = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(v);
+		}
+		mEntries.push_back({ texcoord, normal, index, mHeads[position] });
+		mHeads[position] = static_cast<uint32_t>(mEntries.size() - 1);
+		return index;
+	}
+};
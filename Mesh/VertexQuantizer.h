@@ -0,0 +1,187 @@
+#pragma once
+
+// Compact 16-byte vertex format.
+//   position : R16G16B16A16_UNORM, quantized against the mesh bounds (w = 1)
+//   normal   : R16G16_SNORM, octahedral encoding
+//   texcoord : R16G16_FLOAT
+// The position is dequantized by an affine transform (dequantizeTransform)
+// that can be folded into the world matrix, so only the normal needs decoding
+// in the shader.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "../_common/Half.h"
+
+#ifdef _WIN32
+#include <d3d12.h>
+#endif
+
+namespace VertexQuantizer
+{
+	// Bump when the encoding changes, so cooked meshes are rebuilt
+	static const uint32_t CookVersion = 1;
+
+	struct CompactVertex
+	{
+		uint16_t position[4];
+		int16_t normal[2];
+		uint16_t texcoord[2];
+	};
+	static_assert(sizeof(CompactVertex) == 16, "CompactVertex must be 16 bytes");
+
+	using Half::floatToHalf;
+	using Half::halfToFloat;
+
+	inline int16_t toSnorm16(float v)
+	{
+		v = (std::max)(-1.0f, (std::min)(1.0f, v));
+		return static_cast<int16_t>(v * 32767.0f + (v >= 0 ? 0.5f : -0.5f));
+	}
+
+	inline float fromSnorm16(int16_t v)
+	{
+		return (std::max)(-1.0f, v / 32767.0f);
+	}
+
+	// Octahedral normal encoding (Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors")
+	inline void encodeOctahedral(const float n[3], int16_t out[2])
+	{
+		float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+		if (l1 <= 0)
+		{
+			out[0] = out[1] = 0;
+			return;
+		}
+		float x = n[0] / l1, y = n[1] / l1;
+		if (n[2] < 0)
+		{
+			float ox = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+			float oy = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+			x = ox;
+			y = oy;
+		}
+		out[0] = toSnorm16(x);
+		out[1] = toSnorm16(y);
+	}
+
+	// Same math as decodeOctahedral() in the shaders.
+	inline void decodeOctahedral(const int16_t in[2], float n[3])
+	{
+		float x = fromSnorm16(in[0]), y = fromSnorm16(in[1]);
+		float z = 1.0f - fabsf(x) - fabsf(y);
+		float t = (std::max)(-z, 0.0f);
+		x += (x >= 0) ? -t : t;
+		y += (y >= 0) ? -t : t;
+		float len = sqrtf(x * x + y * y + z * z);
+		n[0] = x / len;
+		n[1] = y / len;
+		n[2] = z / len;
+	}
+
+	// Position dequantization: p = q * scale + offset, per axis.
+	inline void dequantizeTransform(const float center[3], const float extents[3], float scale[3], float offset[3])
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			scale[k] = extents[k] * 2.0f;
+			offset[k] = center[k] - extents[k];
+		}
+	}
+
+	// Largest round-trip error over a set of vertices
+	struct QuantizationError
+	{
+		float maxPosition = 0;        // object-space distance
+		float maxNormalDegrees = 0;   // angle between source and decoded normal
+		float maxTexcoord = 0;
+	};
+
+	namespace detail
+	{
+		// Folds the error of one vertex into err
+		inline void addError(const float p[3], const float n[3], const float t[2], const CompactVertex& v,
+			const float scale[3], const float offset[3], QuantizationError& err)
+		{
+			float d2 = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				float d = v.position[k] / 65535.0f * scale[k] + offset[k] - p[k];
+				d2 += d * d;
+			}
+			err.maxPosition = (std::max)(err.maxPosition, sqrtf(d2));
+
+			float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (len > 0)
+			{
+				float dn[3];
+				decodeOctahedral(v.normal, dn);
+				float c = (n[0] * dn[0] + n[1] * dn[1] + n[2] * dn[2]) / len;
+				c = (std::max)(-1.0f, (std::min)(1.0f, c));
+				err.maxNormalDegrees = (std::max)(err.maxNormalDegrees, acosf(c) * 57.2957795f);
+			}
+
+			err.maxTexcoord = (std::max)(err.maxTexcoord, fabsf(halfToFloat(v.texcoord[0]) - t[0]));
+			err.maxTexcoord = (std::max)(err.maxTexcoord, fabsf(halfToFloat(v.texcoord[1]) - t[1]));
+		}
+	};
+
+	// Vertex needs position, normal and textureCoordinate members laid out as
+	// float3/float3/float2 (WaveFrontReader::Vertex, SdkMeshReader::Vertex).
+	// Returns the largest error of the vertices written, as measureError() would.
+	template<class Vertex>
+	QuantizationError quantize(const Vertex* src, size_t count, const float center[3], const float extents[3], CompactVertex* dst)
+	{
+		float scale[3], offset[3], invScale[3];
+		dequantizeTransform(center, extents, scale, offset);
+		for (int k = 0; k < 3; ++k)
+			invScale[k] = scale[k] > 0 ? 1.0f / scale[k] : 0.0f;
+
+		QuantizationError err;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float* p = &src[i].position.x;
+			const float* n = &src[i].normal.x;
+			const float* t = &src[i].textureCoordinate.x;
+			CompactVertex& v = dst[i];
+			for (int k = 0; k < 3; ++k)
+			{
+				float q = (p[k] - offset[k]) * invScale[k];
+				q = (std::max)(0.0f, (std::min)(1.0f, q));
+				v.position[k] = static_cast<uint16_t>(q * 65535.0f + 0.5f);
+			}
+			v.position[3] = 65535;
+			encodeOctahedral(n, v.normal);
+			v.texcoord[0] = floatToHalf(t[0]);
+			v.texcoord[1] = floatToHalf(t[1]);
+			detail::addError(p, n, t, v, scale, offset, err);
+		}
+		return err;
+	}
+
+	// The error of vertices quantized earlier, against their source
+	template<class Vertex>
+	QuantizationError measureError(const Vertex* src, const CompactVertex* dst, size_t count, const float center[3], const float extents[3])
+	{
+		QuantizationError err;
+		float scale[3], offset[3];
+		dequantizeTransform(center, extents, scale, offset);
+		for (size_t i = 0; i < count; ++i)
+			detail::addError(&src[i].position.x, &src[i].normal.x, &src[i].textureCoordinate.x, dst[i], scale, offset, err);
+		return err;
+	}
+
+#ifdef _WIN32
+	inline const D3D12_INPUT_ELEMENT_DESC* compactInputLayout(UINT& count)
+	{
+		static const D3D12_INPUT_ELEMENT_DESC layout[] = {
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		};
+		count = ARRAYSIZE(layout);
+		return layout;
+	}
+#endif
+};
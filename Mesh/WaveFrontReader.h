@@ -21,7 +21,6 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <unordered_map>
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -31,6 +30,14 @@
 #include <directxmath.h>
 #include <directxcollision.h>
 
+#include "../_common/MappedFile.h"
+#include "ObjParser.h"
+#include "ObjChunkParser.h"
+#include "ObjChunkMerge.h"
+#include "VertexDedupTable.h"
+#include "MeshCache.h"
+#include "VertexQuantizer.h"
+
 template<class index_t>
 class WaveFrontReader
 {
@@ -130,6 +137,7 @@ public:
                     }
 
                     memset( &vertex, 0, sizeof( vertex ) );
+                    iTexCoord = iNormal = 0;
 
                     // OBJ format uses 1-based arrays
                     InFile >> iPosition;
@@ -169,7 +177,7 @@ public:
                     // list. Store the index in the Indices array. The Vertices and Indices
                     // lists will eventually become the Vertex Buffer and Index Buffer for
                     // the mesh.
-                    DWORD index = AddVertex( iPosition, &vertex, vertexCache );
+                    DWORD index = AddVertex( iPosition, iTexCoord, iNormal, &vertex, vertexCache );
                     if ( index == (DWORD)-1 )
                        return E_OUTOFMEMORY;
 
@@ -209,37 +217,9 @@ public:
                         break;
                 }
 
-                if ( iFace < 3 )
-                {
-                    // Need at least 3 points to form a triangle
-                    return E_FAIL;
-                }
-
-                // Convert polygons to triangles
-                DWORD i0 = faceIndex[0];
-                DWORD i1 = faceIndex[1];
-
-                for( size_t j = 2; j < iFace; ++ j )
-                {
-                    DWORD index = faceIndex[ j ];
-                    indices.push_back( static_cast<index_t>( i0 ) );
-                    if ( ccw )
-                    {
-                        indices.push_back( static_cast<index_t>( i1 ) );
-                        indices.push_back( static_cast<index_t>( index ) );
-                    }
-                    else
-                    {
-                        indices.push_back( static_cast<index_t>( index ) );
-                        indices.push_back( static_cast<index_t>( i1 ) );
-                    }                        
-                     
-                    attributes.push_back( curSubset );
-
-                    i1 = index;
-                }
-
-                assert( attributes.size()*3 == indices.size() );
+                HRESULT hr = AddPolygon( faceIndex, iFace, ccw, curSubset );
+                if ( FAILED(hr) )
+                    return hr;
             }
             else if( 0 == wcscmp( strCommand, L"mtllib" ) )
             {
@@ -252,25 +232,7 @@ public:
                 WCHAR strName[MAX_PATH] = {0};
                 InFile >> strName;
 
-                bool bFound = false;
-                uint32_t count = 0;
-                for( auto it = materials.cbegin(); it != materials.cend(); ++it, ++count )
-                {
-                    if( 0 == wcscmp( it->strName, strName ) )
-                    {
-                        bFound = true;
-                        curSubset = count;
-                        break;
-                    }
-                }
-
-                if( !bFound )
-                {
-                    Material mat;
-                    curSubset = static_cast<uint32_t>( materials.size() );
-                    wcscpy_s( mat.strName, MAX_PATH - 1, strName );
-                    materials.push_back( mat );
-                }
+                curSubset = FindOrAddMaterial( strName );
             }
             else
             {
@@ -287,24 +249,236 @@ public:
         BoundingBox::CreateFromPoints( bounds, positions.size(), &positions.front(), sizeof(XMFLOAT3) );
 
         // If an associated material file was found, read that in as well.
-        if( *strMaterialFilename )
+        return LoadMaterialLibrary( szFileName, strMaterialFilename );
+    }
+
+    // Same output as Load(), but the file is memory-mapped and scanned as narrow
+    // text by ObjParser instead of going through std::wifstream.
+    HRESULT LoadMapped( _In_z_ const wchar_t* szFileName, bool ccw = true )
+    {
+        Clear();
+
+        using namespace DirectX;
+
+        MappedFile file;
+        if( !file.open( szFileName ) )
+            return HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND );
+
+        WCHAR fname[_MAX_FNAME];
+        _wsplitpath_s( szFileName, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, nullptr, 0 );
+
+        name = fname;
+
+        Material defmat;
+
+        wcscpy_s( defmat.strName, L"default" );
+        materials.push_back( defmat );
+
+        struct Sink
         {
-            WCHAR ext[_MAX_EXT];
-            _wsplitpath_s( strMaterialFilename, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
+            WaveFrontReader&        reader;
+            bool                    ccw;
+            std::vector<XMFLOAT3>   positions;
+            std::vector<XMFLOAT3>   normals;
+            std::vector<XMFLOAT2>   texCoords;
+            VertexCache             vertexCache;
+            uint32_t                curSubset;
+            HRESULT                 hr;
+            WCHAR                   strMaterialFilename[MAX_PATH];
+
+            Sink( WaveFrontReader& r, bool c, size_t fileSize ) : reader( r ), ccw( c ), curSubset( 0 ), hr( S_OK )
+            {
+                memset( strMaterialFilename, 0, sizeof(strMaterialFilename) );
 
-            WCHAR drive[_MAX_DRIVE];
-            WCHAR dir[_MAX_DIR];
-            _wsplitpath_s( szFileName, drive, _MAX_DRIVE, dir, _MAX_DIR, nullptr, 0, nullptr, 0 );
+                // Face lines are about 10 bytes per corner, so this rarely grows
+                vertexCache.reserve( fileSize / 32 );
+            }
 
-            WCHAR szPath[ MAX_PATH ];
-            _wmakepath_s( szPath, MAX_PATH, drive, dir, fname, ext );
+            bool position( float x, float y, float z )
+            {
+                positions.push_back( XMFLOAT3( x, y, z ) );
+                return true;
+            }
+            bool texcoord( float u, float v )
+            {
+                texCoords.push_back( XMFLOAT2( u, v ) );
+                reader.hasTexcoords = true;
+                return true;
+            }
+            bool normal( float x, float y, float z )
+            {
+                normals.push_back( XMFLOAT3( x, y, z ) );
+                reader.hasNormals = true;
+                return true;
+            }
+            bool face( const ObjParser::FaceVertex* verts, size_t count )
+            {
+                hr = reader.AddFace( verts, count,
+                                     positions, positions.size(), texCoords, texCoords.size(), normals, normals.size(),
+                                     vertexCache, ccw, curSubset );
+                return SUCCEEDED( hr );
+            }
+            bool useMaterial( const char* str, size_t length )
+            {
+                WCHAR strName[MAX_PATH] = {0};
+                WidenName( strName, str, length );
+                curSubset = reader.FindOrAddMaterial( strName );
+                return true;
+            }
+            bool materialLibrary( const char* str, size_t length )
+            {
+                WidenName( strMaterialFilename, str, length );
+                return true;
+            }
+        };
 
-            HRESULT hr = LoadMTL( szPath );
-            if ( FAILED(hr) )
-                return hr;
+        Sink sink( *this, ccw, file.size() );
+        switch( ObjParser::parse( file.data(), file.end(), sink ) )
+        {
+        case ObjParser::Result::Ok:
+            break;
+        case ObjParser::Result::Aborted:
+            return sink.hr;
+        default:
+            return E_FAIL;
         }
 
-        return S_OK;
+        file.close();
+
+        if ( !sink.positions.empty() )
+            BoundingBox::CreateFromPoints( bounds, sink.positions.size(), &sink.positions.front(), sizeof(XMFLOAT3) );
+
+        return LoadMaterialLibrary( szFileName, sink.strMaterialFilename );
+    }
+
+    // Same output as Load(), but the mapped file is scanned in line-aligned
+    // chunks, one per thread of jobs, and the vertices are deduplicated per chunk
+    // as jobs too (ObjChunkMerge.h). Only the merge of the chunks' unique vertices
+    // and the material assignment run on the calling thread. Vertex and index
+    // order match the serial loader.
+    HRESULT LoadParallel( _In_z_ const wchar_t* szFileName, JobSystem& jobs, bool ccw = true )
+    {
+        Clear();
+
+        using namespace DirectX;
+
+        MappedFile file;
+        if( !file.open( szFileName ) )
+            return HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND );
+
+        WCHAR fname[_MAX_FNAME];
+        _wsplitpath_s( szFileName, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, nullptr, 0 );
+
+        name = fname;
+
+        Material defmat;
+
+        wcscpy_s( defmat.strName, L"default" );
+        materials.push_back( defmat );
+
+        std::vector<ObjParser::ChunkRecords> chunks;
+        if ( ObjParser::parseChunked( file.data(), file.end(), chunks, jobs ) != ObjParser::Result::Ok )
+            return E_FAIL;
+
+        // Prefix sums of the per-chunk element counts
+        std::vector<size_t> positionBase( chunks.size() + 1, 0 );
+        std::vector<size_t> texcoordBase( chunks.size() + 1, 0 );
+        std::vector<size_t> normalBase( chunks.size() + 1, 0 );
+        for( size_t c = 0; c < chunks.size(); ++c )
+        {
+            positionBase[ c + 1 ] = positionBase[ c ] + chunks[ c ].positionCount();
+            texcoordBase[ c + 1 ] = texcoordBase[ c ] + chunks[ c ].texcoordCount();
+            normalBase[ c + 1 ] = normalBase[ c ] + chunks[ c ].normalCount();
+        }
+
+        std::vector<XMFLOAT3>   positions( positionBase.back() );
+        std::vector<XMFLOAT3>   normals( normalBase.back() );
+        std::vector<XMFLOAT2>   texCoords( texcoordBase.back() );
+        jobs.parallelFor( 0, static_cast<uint32_t>( chunks.size() ), 1, [&]( uint32_t c )
+        {
+            auto& chunk = chunks[ c ];
+            if ( !chunk.positions.empty() )
+                memcpy( &positions[ positionBase[ c ] ], chunk.positions.data(), chunk.positions.size() * sizeof(float) );
+            if ( !chunk.normals.empty() )
+                memcpy( &normals[ normalBase[ c ] ], chunk.normals.data(), chunk.normals.size() * sizeof(float) );
+            if ( !chunk.texcoords.empty() )
+                memcpy( &texCoords[ texcoordBase[ c ] ], chunk.texcoords.data(), chunk.texcoords.size() * sizeof(float) );
+        } );
+        hasNormals = !normals.empty();
+        hasTexcoords = !texCoords.empty();
+
+        // Index limits as AddFace() checks them
+        auto makeVertex = [&]( size_t c, const ObjParser::FaceRecord& face, const ObjParser::FaceVertex& fv, Vertex& vertex )
+        {
+            memset( &vertex, 0, sizeof( vertex ) );
+            if ( fv.position == 0 || fv.position > positionBase[ c ] + face.positionLimit )
+                return false;
+            vertex.position = positions[ fv.position - 1 ];
+            if ( fv.texcoord )
+            {
+                if ( fv.texcoord > texcoordBase[ c ] + face.texcoordLimit )
+                    return false;
+                vertex.textureCoordinate = texCoords[ fv.texcoord - 1 ];
+            }
+            if ( fv.normal )
+            {
+                if ( fv.normal > normalBase[ c ] + face.normalLimit )
+                    return false;
+                vertex.normal = normals[ fv.normal - 1 ];
+            }
+            return true;
+        };
+
+        // 0xFFFF is the strip cut value of a 16-bit IB
+        size_t vertexLimit = ( sizeof(index_t) == 2 ) ? 0xFFFF : 0xFFFFFFFE;
+        switch( ObjParser::mergeChunks( chunks, jobs, ccw, vertexLimit, makeVertex, vertices, indices ) )
+        {
+        case ObjParser::MergeResult::Ok:
+            break;
+        case ObjParser::MergeResult::TooManyVertices:
+#pragma warning( suppress : 4127 )
+            if ( sizeof(index_t) != 2 )
+                return E_OUTOFMEMORY;
+            return E_FAIL;
+        default:
+            return E_FAIL;
+        }
+
+        // Materials switch between faces, so the subsets are assigned per face in file order
+        attributes.reserve( indices.size() / 3 );
+        uint32_t curSubset = 0;
+        WCHAR strMaterialFilename[MAX_PATH] = {0};
+        for( size_t c = 0; c < chunks.size(); ++c )
+        {
+            auto& chunk = chunks[ c ];
+            auto mat = chunk.materials.cbegin();
+            for( size_t f = 0; f < chunk.faces.size(); ++f )
+            {
+                for( ; mat != chunk.materials.cend() && mat->faceIndex == f; ++mat )
+                {
+                    WCHAR strName[MAX_PATH] = {0};
+                    WidenName( strName, mat->name, mat->length );
+                    curSubset = FindOrAddMaterial( strName );
+                }
+                attributes.insert( attributes.end(), chunk.faces[ f ].vertexCount - 2, curSubset );
+            }
+            for( ; mat != chunk.materials.cend(); ++mat )
+            {
+                WCHAR strName[MAX_PATH] = {0};
+                WidenName( strName, mat->name, mat->length );
+                curSubset = FindOrAddMaterial( strName );
+            }
+
+            if ( chunk.mtllibName )
+                WidenName( strMaterialFilename, chunk.mtllibName, chunk.mtllibLength );
+        }
+
+        file.close();
+
+        if ( !positions.empty() )
+            BoundingBox::CreateFromPoints( bounds, positions.size(), &positions.front(), sizeof(XMFLOAT3) );
+
+        return LoadMaterialLibrary( szFileName, strMaterialFilename );
     }
 
     HRESULT LoadMTL( _In_z_ const wchar_t* szFileName )
@@ -466,11 +640,8 @@ public:
             tmp.resize( numIndices );
             vboFile.read( reinterpret_cast<char*>( &tmp.front() ), sizeof(uint16_t) * numIndices );
 
-            indices.reserve( numIndices );
-            for( auto it = tmp.cbegin(); it != tmp.cend(); ++it )
-            {
-                indices.push_back( *it );
-            }
+            indices.resize( numIndices );
+            std::copy( tmp.cbegin(), tmp.cend(), indices.begin() );
         }
 
         BoundingBox::CreateFromPoints( bounds, vertices.size(), reinterpret_cast<const XMFLOAT3*>( &vertices.front() ), sizeof(Vertex) );
@@ -480,6 +651,67 @@ public:
         return S_OK;
     }
 
+    // Writes the mesh as a MeshCache (.vbo v2) file, which MeshCache::View
+    // maps back without parsing.
+    // With compactVertices the vertices are written as VertexQuantizer::CompactVertex
+    // (16 bytes) quantized against bounds; the header bounds are needed to decode them.
+    // settingsHash identifies the cook settings, the loader recooks when it differs.
+    HRESULT SaveVBO2( _In_z_ const wchar_t* szFileName, bool compactVertices = false, uint32_t settingsHash = 0 ) const
+    {
+        std::vector<MeshCache::Material> mats( materials.size() );
+        for( size_t i = 0; i < materials.size(); ++i )
+        {
+            auto& src = materials[ i ];
+            auto& dst = mats[ i ];
+            memset( &dst, 0, sizeof(dst) );
+            memcpy( dst.ambient, &src.vAmbient, sizeof(dst.ambient) );
+            memcpy( dst.diffuse, &src.vDiffuse, sizeof(dst.diffuse) );
+            memcpy( dst.specular, &src.vSpecular, sizeof(dst.specular) );
+            dst.shininess = src.nShininess;
+            dst.alpha = src.fAlpha;
+            dst.specularEnabled = src.bSpecular ? 1 : 0;
+            WideCharToMultiByte( CP_UTF8, 0, src.strName, -1, dst.name, sizeof(dst.name) - 1, nullptr, nullptr );
+            WideCharToMultiByte( CP_UTF8, 0, src.strTexture, -1, dst.texture, sizeof(dst.texture) - 1, nullptr, nullptr );
+        }
+
+        auto subsets = MeshCache::buildSubsets( attributes.data(), attributes.size() );
+
+        MeshCache::MeshDesc desc;
+        desc.vertexFormat = MeshCache::VertexFormatP3N3T2;
+        desc.vertexStride = sizeof(Vertex);
+        desc.vertexCount = static_cast<uint32_t>( vertices.size() );
+        desc.vertices = vertices.data();
+
+        std::vector<VertexQuantizer::CompactVertex> compact;
+        if ( compactVertices )
+        {
+            compact.resize( vertices.size() );
+            VertexQuantizer::quantize( vertices.data(), vertices.size(), &bounds.Center.x, &bounds.Extents.x, compact.data() );
+            desc.vertexFormat = MeshCache::VertexFormatCompact;
+            desc.vertexStride = sizeof(VertexQuantizer::CompactVertex);
+            desc.vertices = compact.data();
+        }
+        desc.indexSize = sizeof(index_t);
+        desc.indexCount = static_cast<uint32_t>( indices.size() );
+        desc.indices = indices.data();
+        desc.subsets = subsets.data();
+        desc.subsetCount = static_cast<uint32_t>( subsets.size() );
+        desc.materials = mats.data();
+        desc.materialCount = static_cast<uint32_t>( mats.size() );
+        memcpy( desc.boundsCenter, &bounds.Center, sizeof(desc.boundsCenter) );
+        memcpy( desc.boundsExtents, &bounds.Extents, sizeof(desc.boundsExtents) );
+        desc.settingsHash = settingsHash;
+
+        std::ofstream vboFile( szFileName, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc );
+        if ( !vboFile.is_open() )
+            return HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND );
+
+        if ( !MeshCache::write( vboFile, desc ) )
+            return E_FAIL;
+
+        return S_OK;
+    }
+
     struct Material
     {
         DirectX::XMFLOAT3 vAmbient;
@@ -515,27 +747,139 @@ public:
     DirectX::BoundingBox    bounds;
 
 private:
-    typedef std::unordered_multimap<UINT, UINT> VertexCache;
+    typedef VertexDedupTable<Vertex> VertexCache;
 
-    DWORD AddVertex( UINT hash, Vertex* pVertex, VertexCache& cache )
+    uint32_t FindOrAddMaterial( _In_z_ const WCHAR* strName )
     {
-        auto f = cache.equal_range( hash );
+        uint32_t count = 0;
+        for( auto it = materials.cbegin(); it != materials.cend(); ++it, ++count )
+        {
+            if( 0 == wcscmp( it->strName, strName ) )
+                return count;
+        }
 
-        for( auto it = f.first; it != f.second; ++it )
+        Material mat;
+        wcscpy_s( mat.strName, MAX_PATH - 1, strName );
+        materials.push_back( mat );
+        return static_cast<uint32_t>( materials.size() - 1 );
+    }
+
+    static void WidenName( WCHAR* dst, const char* src, size_t length )
+    {
+        // Byte-wise, as the classic locale of std::wifstream does
+        length = std::min<size_t>( length, MAX_PATH - 1 );
+        for( size_t i = 0; i < length; ++i )
+            dst[ i ] = static_cast<unsigned char>( src[ i ] );
+        dst[ length ] = 0;
+    }
+
+    // Resolves one polygon of ObjParser records. Only the first *Limit elements
+    // of each array may be referenced, as when the face was declared.
+    HRESULT AddFace( const ObjParser::FaceVertex* verts, size_t count,
+                     const std::vector<DirectX::XMFLOAT3>& positions, size_t positionLimit,
+                     const std::vector<DirectX::XMFLOAT2>& texCoords, size_t texcoordLimit,
+                     const std::vector<DirectX::XMFLOAT3>& normals, size_t normalLimit,
+                     VertexCache& vertexCache, bool ccw, uint32_t curSubset )
+    {
+        DWORD faceIndex[ ObjParser::MaxPolygonVertex ];
+        for( size_t i = 0; i < count; ++i )
         {
-            auto& tv = vertices[ it->second ];
+            const ObjParser::FaceVertex& fv = verts[ i ];
+            Vertex vertex;
+            memset( &vertex, 0, sizeof( vertex ) );
+
+            if ( fv.position == 0 || fv.position > positionLimit )
+                return E_FAIL;
+            vertex.position = positions[ fv.position - 1 ];
 
-            if ( 0 == memcmp( pVertex, &tv, sizeof(Vertex) ) )
+            if ( fv.texcoord )
             {
-                return it->second;
+                if ( fv.texcoord > texcoordLimit )
+                    return E_FAIL;
+                vertex.textureCoordinate = texCoords[ fv.texcoord - 1 ];
+            }
+
+            if ( fv.normal )
+            {
+                if ( fv.normal > normalLimit )
+                    return E_FAIL;
+                vertex.normal = normals[ fv.normal - 1 ];
             }
+
+            DWORD index = AddVertex( fv.position, fv.texcoord, fv.normal, &vertex, vertexCache );
+            if ( index == (DWORD)-1 )
+                return E_OUTOFMEMORY;
+
+#pragma warning( suppress : 4127 )
+            if ( sizeof(index_t) == 2 && ( index >= 0xFFFF ) )
+            {
+                // Too many indices for 16-bit IB!
+                return E_FAIL;
+            }
+
+            faceIndex[ i ] = index;
+        }
+        return AddPolygon( faceIndex, count, ccw, curSubset );
+    }
+
+    HRESULT AddPolygon( const DWORD* faceIndex, size_t iFace, bool ccw, uint32_t curSubset )
+    {
+        if ( iFace < 3 )
+        {
+            // Need at least 3 points to form a triangle
+            return E_FAIL;
         }
 
-        DWORD index = static_cast<UINT>( vertices.size() );
-        vertices.push_back( *pVertex );
+        // Convert polygons to triangles
+        DWORD i0 = faceIndex[0];
+        DWORD i1 = faceIndex[1];
 
-        VertexCache::value_type entry( hash, index );
-        cache.insert( entry );
-        return index;
+        for( size_t j = 2; j < iFace; ++ j )
+        {
+            DWORD index = faceIndex[ j ];
+            indices.push_back( static_cast<index_t>( i0 ) );
+            if ( ccw )
+            {
+                indices.push_back( static_cast<index_t>( i1 ) );
+                indices.push_back( static_cast<index_t>( index ) );
+            }
+            else
+            {
+                indices.push_back( static_cast<index_t>( index ) );
+                indices.push_back( static_cast<index_t>( i1 ) );
+            }
+
+            attributes.push_back( curSubset );
+
+            i1 = index;
+        }
+
+        assert( attributes.size()*3 == indices.size() );
+        return S_OK;
+    }
+
+    HRESULT LoadMaterialLibrary( _In_z_ const wchar_t* szFileName, _In_z_ const WCHAR* strMaterialFilename )
+    {
+        if( !*strMaterialFilename )
+            return S_OK;
+
+        WCHAR fname[_MAX_FNAME];
+        WCHAR ext[_MAX_EXT];
+        _wsplitpath_s( strMaterialFilename, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
+
+        WCHAR drive[_MAX_DRIVE];
+        WCHAR dir[_MAX_DIR];
+        _wsplitpath_s( szFileName, drive, _MAX_DRIVE, dir, _MAX_DIR, nullptr, 0, nullptr, 0 );
+
+        WCHAR szPath[ MAX_PATH ];
+        _wmakepath_s( szPath, MAX_PATH, drive, dir, fname, ext );
+
+        return LoadMTL( szPath );
+    }
+
+    DWORD AddVertex( UINT iPosition, UINT iTexCoord, UINT iNormal, Vertex* pVertex, VertexCache& cache )
+    {
+        uint32_t index = cache.findOrAdd( iPosition, iTexCoord, iNormal, *pVertex, vertices );
+        return ( index == VertexCache::NotFound ) ? (DWORD)-1 : index;
     }
 };
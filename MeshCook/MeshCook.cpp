@@ -0,0 +1,63 @@
+// Cooks a WaveFront OBJ and its MTL into the binary mesh cache (.vbo v2) with
+// MeshCook::cook(), as Mesh does on first run. An output already cooked from
+// the same source with the same settings is kept. With compact vertices the
+// largest quantization error is printed.
+// Portable; on Linux: g++ -std=c++14 -O2 MeshCook.cpp -o MeshCook
+// Usage: MeshCook input.obj output.vbo2 [compact] [no_overdraw] [cw]
+#include <cstdio>
+#include <cstring>
+#include "../Mesh/MeshCook.h"
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: MeshCook input.obj output.vbo2 [compact] [no_overdraw] [cw]\n");
+		return 1;
+	}
+
+	MeshCook::Settings settings;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "compact") == 0)
+		{
+			settings.compactVertices = true;
+		}
+		else if (strcmp(argv[i], "no_overdraw") == 0)
+		{
+			settings.optimizeOverdraw = false;
+		}
+		else if (strcmp(argv[i], "cw") == 0)
+		{
+			settings.ccw = false;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	VertexQuantizer::QuantizationError err;
+	switch (MeshCook::cook(argv[1], argv[2], settings, &err))
+	{
+	case MeshCook::Result::Cooked:
+		printf("Cooked %s\n", argv[2]);
+		if (settings.compactVertices)
+			printf("Quantization error: position %g, normal %g deg, texcoord %g\n", err.maxPosition, err.maxNormalDegrees, err.maxTexcoord);
+		return 0;
+	case MeshCook::Result::UpToDate:
+		printf("%s is up to date\n", argv[2]);
+		return 0;
+	case MeshCook::Result::SourceNotFound:
+		fprintf(stderr, "Cannot read %s or its material library\n", argv[1]);
+		return 1;
+	case MeshCook::Result::BadSource:
+		fprintf(stderr, "%s is not a valid OBJ\n", argv[1]);
+		return 1;
+	case MeshCook::Result::WriteFailed:
+	default:
+		fprintf(stderr, "Cannot write %s\n", argv[2]);
+		return 1;
+	}
+}
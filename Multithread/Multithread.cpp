@@ -2,31 +2,45 @@
 #include <tchar.h>
 #include <wrl/client.h>
 #include <stdexcept>
-#include <ppl.h>
 #include <dxgi1_3.h>
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include "../_common/dxcommon.h"
+#include "../_common/FrameAllocator.h"
+#include "../_common/CommandPool.h"
+#include "../_common/InstanceTransform.h"
+#include "../_common/DrawBatching.h"
+#include "../_common/JobSystem.h"
+#include "../_common/CommandCaptureD3D12.h"
+#include "../_common/FrameRecording.h"
 
 #include <DirectXMath.h>
 using DirectX::XMFLOAT3; // for WaveFrontReader
 #include "../Mesh/WaveFrontReader.h"
+#include "../Mesh/MeshSimplifier.h"
 
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3d12.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
 using namespace std;
-using namespace concurrency;
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
+#define USE_LOD 1 // draw each teapot with the coarsest level that stays under a pixel of error
+#define CMD_LIST_BYTES 1024 // recorded bytes estimated for a list's state setup
+#define CMD_DRAW_BYTES 256 // and for each draw
+#define USE_COMMAND_CAPTURE 1 // D records the next two frames' batches into command streams, replays them and prints the last one's
+#define CAPTURE_STREAM_SIZE (64 * 1024) // bytes per batch, at most
+#define CAPTURE_RING_SIZE (1024 * 1024) // the last frames' streams
+
 namespace
 {
 	const int WINDOW_WIDTH = 400;
 	const int WINDOW_HEIGHT = 240;
 	const int BUFFER_COUNT = 2;
 	HWND g_mainWindowHandle = 0;
+	bool g_printCapture = false; // D key
 };
 
 void CHK(HRESULT hr)
@@ -46,19 +60,16 @@ class D3D
 	static const UINT MaxThreadCount = 4;
 
 	ID3D12Device* mDev;
-	ComPtr<ID3D12CommandAllocator> mCmdAlloc[MaxFrameLatency][MaxThreadCount];
+	typedef CommandPool<ID3D12CommandAllocator*, ID3D12GraphicsCommandList*> CmdPool;
+	CmdPool mCmdPool; // allocators recycled by fence value
 	ComPtr<ID3D12CommandQueue> mCmdQueue;
-
-	ComPtr<ID3D12GraphicsCommandList> mCmdList[MaxThreadCount];
-	ComPtr<ID3D12GraphicsCommandList> mCmdListProl;
-	ComPtr<ID3D12GraphicsCommandList> mCmdListEpir;
 	ComPtr<ID3D12Fence> mFence;
 	HANDLE mFenceEveneHandle = 0;
 
 	ComPtr<ID3D12DescriptorHeap> mDescHeapRtv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapDsv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapCbvSrvUav[MaxFrameLatency];
-	void* mCBUploadPtr = nullptr;
+	FrameAllocator mCBAllocator; // Constants of every frame in flight
 
 	ComPtr<ID3D12RootSignature> mRootSignature;
 	ComPtr<ID3D12PipelineState> mPso;
@@ -66,6 +77,21 @@ class D3D
 	D3D12_VERTEX_BUFFER_VIEW mVBView = {};
 	D3D12_INDEX_BUFFER_VIEW mIBView = {};
 	UINT mIndexCount = 0;
+	vector<MeshSimplifier::Lod> mLods;
+	size_t mInstanceLod[MaxThreadCount] = {};
+	InstanceTransform::Instances mInstances; // one per thread
+	JobSystem mJobs; // records the command lists
+	vector<DrawBatching::Draw> mDraws; // one per instance, in submission order
+	vector<FrameRecording::Draw> mDrawArgs; // indices of each draw
+	vector<DrawBatching::Batch> mBatches; // one command list each
+	DrawBatching::OrderedSubmitter mSubmitter;
+	vector<CmdPool::Pair> mBatchCmdPairs;
+	vector<ID3D12CommandList*> mBatchCmdLists;
+#if USE_COMMAND_CAPTURE
+	vector<CommandCapture::Writer> mBatchStreams; // one per batch
+	CommandCapture::Ring mCaptureRing;
+	UINT mCaptureFrames = 0; // frames left to capture
+#endif
 	UINT mVBIndexOffset = 0;
 	ComPtr<ID3D12Resource> mDB;
 	ComPtr<ID3D12Resource> mCB;
@@ -99,13 +125,20 @@ public:
 			IID_PPV_ARGS(&dev)));
 		mDev = dev;
 
-		for (auto& a : mCmdAlloc)
+		CmdPool::Callbacks cmdPoolCallbacks;
+		cmdPoolCallbacks.createAllocator = [this](ID3D12CommandAllocator*& allocator)
 		{
-			for (auto& t : a)
-			{
-				CHK(mDev->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(t.ReleaseAndGetAddressOf())));
-			}
-		}
+			return SUCCEEDED(mDev->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)));
+		};
+		cmdPoolCallbacks.createList = [this](ID3D12CommandAllocator* allocator, ID3D12GraphicsCommandList*& list)
+		{
+			return SUCCEEDED(mDev->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator, nullptr, IID_PPV_ARGS(&list)));
+		};
+		cmdPoolCallbacks.resetAllocator = [](ID3D12CommandAllocator* allocator) { CHK(allocator->Reset()); };
+		cmdPoolCallbacks.resetList = [](ID3D12GraphicsCommandList* list, ID3D12CommandAllocator* allocator) { CHK(list->Reset(allocator, nullptr)); };
+		cmdPoolCallbacks.releaseAllocator = [](ID3D12CommandAllocator* allocator) { allocator->Release(); };
+		cmdPoolCallbacks.releaseList = [](ID3D12GraphicsCommandList* list) { list->Release(); };
+		mCmdPool.init(cmdPoolCallbacks);
 
 		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
 		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
@@ -121,30 +154,6 @@ public:
 		scDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
 		CHK(mDxgiFactory->CreateSwapChainForHwnd(mCmdQueue.Get(), hWnd, &scDesc, nullptr, nullptr, mSwapChain.ReleaseAndGetAddressOf()));
 
-		for (int i = 0; i < MaxThreadCount; i++)
-		{
-			CHK(mDev->CreateCommandList(
-				0,
-				D3D12_COMMAND_LIST_TYPE_DIRECT,
-				mCmdAlloc[0][0].Get(),
-				nullptr,
-				IID_PPV_ARGS(mCmdList[i].ReleaseAndGetAddressOf())));
-			mCmdList[i]->Close();
-		}
-		CHK(mDev->CreateCommandList(
-			0,
-			D3D12_COMMAND_LIST_TYPE_DIRECT,
-			mCmdAlloc[0][0].Get(),
-			nullptr,
-			IID_PPV_ARGS(mCmdListProl.ReleaseAndGetAddressOf())));
-		mCmdListProl->Close();
-		CHK(mDev->CreateCommandList(
-			0,
-			D3D12_COMMAND_LIST_TYPE_DIRECT,
-			mCmdAlloc[0][0].Get(),
-			nullptr,
-			IID_PPV_ARGS(mCmdListEpir.ReleaseAndGetAddressOf())));
-		mCmdListEpir->Close();
 
 		CHK(mDev->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFence.ReleaseAndGetAddressOf())));
 
@@ -254,10 +263,19 @@ public:
 
 		mIndexCount = static_cast<UINT>(mesh.indices.size());
 		mVBIndexOffset = static_cast<UINT>(sizeof(mesh.vertices[0]) * mesh.vertices.size());
+#if USE_LOD
+		// All levels index the same vertex buffer and follow each other in the index buffer
+		vector<uint16_t> lodIndices;
+		mLods = MeshSimplifier::generateLods(mesh.indices.data(), mesh.indices.size(), mesh.attributes.data(),
+			mesh.vertices.data(), sizeof(mesh.vertices[0]), mesh.vertices.size(), 5, 0.5f, lodIndices);
+		UINT IBSize = static_cast<UINT>(sizeof(lodIndices[0]) * lodIndices.size());
+		void* ibData = lodIndices.data();
+#else
 		UINT IBSize = static_cast<UINT>(sizeof(mesh.indices[0]) * mIndexCount);
+		void* ibData = mesh.indices.data();
+#endif
 
 		void* vbData = mesh.vertices.data();
-		void* ibData = mesh.indices.data();
 		CHK(mDev->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 			D3D12_HEAP_FLAG_NONE,
@@ -304,29 +322,36 @@ public:
 
 #define CB_SIZE 128
 #define CB_ALIGNED_SIZE ((CB_SIZE + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) & ~(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1))
-		UINT cbSize = CB_ALIGNED_SIZE;
+#define CB_RING_SIZE (64 * 1024) // Shared by all frames in flight
 		CHK(mDev->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(cbSize * MaxFrameLatency * MaxThreadCount),
+			&CD3DX12_RESOURCE_DESC::Buffer(CB_RING_SIZE),
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			nullptr,
 			IID_PPV_ARGS(mCB.ReleaseAndGetAddressOf())));
 		mCB->SetName(L"ConstantBuffer");
-		auto cbvDescHeapIncSize = mDev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-		for (auto i = 0u; i < MaxFrameLatency; ++i)
+		void* cbUploadPtr = nullptr;
+		CHK(mCB->Map(0, nullptr, &cbUploadPtr));
+		mCBAllocator.init(cbUploadPtr, mCB->GetGPUVirtualAddress(), CB_RING_SIZE);
+
+		mInstances.resize(MaxThreadCount);
+		for (auto tid = 0u; tid < MaxThreadCount; tid++)
 		{
-			for (auto j = 0u; j < MaxThreadCount; ++j)
-			{
-				D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-				cbvDesc.BufferLocation = mCB->GetGPUVirtualAddress() + (i * MaxThreadCount + j) * cbSize;
-				cbvDesc.SizeInBytes = cbSize;
-				auto cbvSrvUavDescHeap = mDescHeapCbvSrvUav[i]->GetCPUDescriptorHandleForHeapStart();
-				cbvSrvUavDescHeap.ptr += j * cbvDescHeapIncSize;
-				mDev->CreateConstantBufferView(&cbvDesc, cbvSrvUavDescHeap);
-			}
+			mInstances.x[tid] = 0.5f * ((tid & 1) ? 1 : -1);
+			mInstances.y[tid] = 0.2f + 0.5f * ((tid & 2) ? -1 : 1);
+			mInstances.sx[tid] = mInstances.sy[tid] = mInstances.sz[tid] = 0.5f;
 		}
-		CHK(mCB->Map(0, nullptr, reinterpret_cast<void**>(&mCBUploadPtr)));
+
+		mJobs.init();
+#if USE_COMMAND_CAPTURE
+		mBatchStreams.resize(mJobs.threadCount());
+		for (auto& stream : mBatchStreams)
+		{
+			stream.init(CAPTURE_STREAM_SIZE);
+		}
+		mCaptureRing.init(CAPTURE_RING_SIZE, 256);
+#endif
 	}
 	~D3D()
 	{
@@ -343,48 +368,24 @@ public:
 
 		int cmdIndex = mFrameCount % MaxFrameLatency;
 		auto* cmdQueue = mCmdQueue.Get();
-		auto* cmdListProl = mCmdListProl.Get();
-		auto* cmdListEpir = mCmdListEpir.Get();
 
-		// Wait untill next queue be freed
+		// Wait untill the descriptor heap of this frame be freed
 		if (mFrameCount > MaxFrameLatency)
 		{
 			mFence->SetEventOnCompletion(mFrameCount - MaxFrameLatency, mFenceEveneHandle);
 			DWORD wait = WaitForSingleObject(mFenceEveneHandle, 10000);
 			if (wait != WAIT_OBJECT_0)
 				throw runtime_error("Failed WaitForSingleObject().");
-
-			CHK(mCmdAlloc[cmdIndex][0]->Reset());
 		}
+		mCBAllocator.reclaim(mFence->GetCompletedValue());
+		mCmdPool.reclaim(mFence->GetCompletedValue());
 
-		CHK(cmdListProl->Reset(mCmdAlloc[cmdIndex][0].Get(), nullptr));
-
-		// Upload constant buffer
-		{
-			static float rot = 0.0f;
-			rot += 1.0f;
-			if (rot >= 360.0f) rot = 0.0f;
+		auto prol = acquireCmdList();
+		auto* cmdListProl = prol.list;
 
-			for (auto tid = 0u; tid < MaxThreadCount; tid++)
-			{
-				XMMATRIX worldMat, viewMat, projMat;
-				worldMat = XMMatrixIdentity();
-				worldMat *= XMMatrixScaling(0.5f, 0.5f, 0.5f);
-				worldMat *= XMMatrixRotationY(XMConvertToRadians(rot));
-				worldMat *= XMMatrixTranslation(0.5f * ((tid & 1) ? 1 : -1), 0.2f + 0.5f * ((tid & 2) ? -1 : 1), 0);
-				viewMat = XMMatrixLookAtLH({ 0, 0.5f, -1.5f }, { 0, 0.5f, 0 }, { 0, 1, 0 });
-				projMat = XMMatrixPerspectiveFovLH(45, (float)mBufferWidth / mBufferHeight, 0.01f, 50.0f);
-				auto mvpMat = XMMatrixTranspose(worldMat * viewMat * projMat);
-
-				auto worldTransMat = XMMatrixTranspose(worldMat);
-
-				// mCBUploadPtr is Write-Combine memory
-				// Shift offset to guarantee that the pointer has not referred by executing command list.
-				char* ptr = reinterpret_cast<char*>(mCBUploadPtr) + CB_ALIGNED_SIZE * (cmdIndex * MaxThreadCount + tid);
-				memcpy_s(ptr, 64, &mvpMat, 64);
-				memcpy_s(ptr + 64, 64, &worldTransMat, 64);
-			}
-		}
+		static float rot = 0.0f;
+		rot += 1.0f;
+		if (rot >= 360.0f) rot = 0.0f;
 
 		// Get current RTV descriptor
 		auto descHandleRtvStep = mDev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -395,104 +396,215 @@ public:
 		// Get DSV
 		auto descHandleDsv = mDescHeapDsv->GetCPUDescriptorHandleForHeapStart();
 
-		// Barrier Present -> RenderTarget
-		setResourceBarrier(cmdListProl, d3dBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-
-		// Clear DepthTexture
-		cmdListProl->ClearDepthStencilView(descHandleDsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-
-		// Clear
+		// Barrier Present -> RenderTarget, clear
 		{
+			CommandCapture::D3D12Target target(cmdListProl);
 			float clearColor[4] = { 0.1f, 0.2f, 0.3f, 1.0f };
-			cmdListProl->ClearRenderTargetView(descHandleRtv, clearColor, 0, nullptr);
+			FrameRecording::recordPrologue(target, d3dBuffer, descHandleRtv.ptr, descHandleDsv.ptr, clearColor);
 		}
 
 		// Fix prorouge command
 		CHK(cmdListProl->Close());
+		ID3D12CommandList* const cmdListsProl = cmdListProl;
+		cmdQueue->ExecuteCommandLists(1, &cmdListsProl);
+		mCmdPool.submit(prol, mFrameCount, CMD_LIST_BYTES);
 
-		auto cbvDescHeapIncSize = mDev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		// Upload constant buffer of all threads in one batch, which is Write-Combine memory
+		auto cb = mCBAllocator.allocate(CB_ALIGNED_SIZE * MaxThreadCount);
+		if (!cb.data)
+			throw runtime_error("Constant buffer ring is full.");
+		{
+			XMVECTOR eye = XMVectorSet(0, 0.5f, -1.5f, 1);
+			XMMATRIX viewMat = XMMatrixLookAtLH(eye, { 0, 0.5f, 0 }, { 0, 1, 0 });
+			XMMATRIX projMat = XMMatrixPerspectiveFovLH(45, (float)mBufferWidth / mBufferHeight, 0.01f, 50.0f);
+			XMFLOAT4X4 viewProj;
+			XMStoreFloat4x4(&viewProj, viewMat * projMat);
+			float sinHalf, cosHalf;
+			XMScalarSinCos(&sinHalf, &cosHalf, XMConvertToRadians(rot) * 0.5f);
+			for (auto tid = 0u; tid < MaxThreadCount; tid++)
+			{
+				mInstances.qy[tid] = sinHalf;
+				mInstances.qw[tid] = cosHalf;
+			}
+			InstanceTransform::computeConstants(mInstances, 0, MaxThreadCount, &viewProj.m[0][0], cb.data, CB_ALIGNED_SIZE);
+#if USE_LOD
+			// Pixels per object-space unit at the instance's distance
+			XMFLOAT4X4 proj;
+			XMStoreFloat4x4(&proj, projMat);
+			for (auto tid = 0u; tid < MaxThreadCount; tid++)
+			{
+				XMVECTOR position = XMVectorSet(mInstances.x[tid], mInstances.y[tid], mInstances.z[tid], 1);
+				float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(position, eye)));
+				float projectedScale = mInstances.sy[tid] * proj._22 * mBufferHeight * 0.5f / distance;
+				mInstanceLod[tid] = MeshSimplifier::selectLod(mLods.data(), mLods.size(), projectedScale);
+			}
+#endif
+		}
 
-		//for (auto tid = 0u; tid < MaxThreadCount; tid++)
-		parallel_for(0u, MaxThreadCount, [&](auto tid)
+		// Split the draws into batches of similar recording cost, at most one per command list
+		mDraws.resize(MaxThreadCount);
+		mDrawArgs.resize(MaxThreadCount);
+		for (auto tid = 0u; tid < MaxThreadCount; tid++)
+		{
+#if USE_LOD
+			auto& lod = mLods[mInstanceLod[tid]];
+			mDrawArgs[tid] = { lod.indexCount, lod.indexStart };
+#else
+			mDrawArgs[tid] = { mIndexCount, 0 };
+#endif
+			mDraws[tid].indexCount = mDrawArgs[tid].indexCount;
+			mDraws[tid].stateKey = 0; // every teapot uses mPso
+		}
+		// Four teapots cost far less than the default minBatchCost, which would keep
+		// them in one list; let every worker thread take a batch
+		DrawBatching::CostModel costModel;
+		costModel.minBatchCost = 0;
+		DrawBatching::partition(mDraws.data(), mDraws.size(), mJobs.threadCount(), costModel, mBatches);
+
+		FrameRecording::Pass pass = {};
+		pass.rootSignature = mRootSignature.Get();
+		pass.pipelineState = mPso.Get();
+		pass.descriptorHeap = mDescHeapCbvSrvUav[cmdIndex].Get();
+		pass.table = mDescHeapCbvSrvUav[cmdIndex]->GetGPUDescriptorHandleForHeapStart().ptr;
+		pass.tableStep = mDev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		pass.rtv = descHandleRtv.ptr;
+		pass.dsv = descHandleDsv.ptr;
+		pass.width = mBufferWidth;
+		pass.height = mBufferHeight;
+		pass.vertexBuffer = mVBView.BufferLocation;
+		pass.vertexBufferSize = mVBView.SizeInBytes;
+		pass.vertexStride = mVBView.StrideInBytes;
+		pass.indexBuffer = mIBView.BufferLocation;
+		pass.indexBufferSize = mIBView.SizeInBytes;
+		pass.indexFormat = mIBView.Format;
+
+		// Each batch is submitted once it and the batches before it are recorded
+		mBatchCmdLists.resize(mBatches.size());
+		mBatchCmdPairs.resize(mBatches.size());
+#if USE_COMMAND_CAPTURE
+		if (g_printCapture)
+		{
+			g_printCapture = false;
+			mCaptureFrames = 2; // the diff needs the frame before
+		}
+		bool capture = mCaptureFrames > 0;
+#endif
+		FrameRecording::recordBatches(mJobs, mBatches, mSubmitter, [&](uint32_t batch)
 		{
 			// Start draw command
-			auto* cmdList = mCmdList[tid].Get();
-			CHK(cmdList->Reset(mCmdAlloc[cmdIndex][tid].Get(), nullptr));
-
-			cmdList->OMSetRenderTargets(1, &descHandleRtv, true, &descHandleDsv);
-
-			// Viewport & Scissor
-			D3D12_VIEWPORT viewport = {};
-			viewport.Width = (float)mBufferWidth;
-			viewport.Height = (float)mBufferHeight;
-			viewport.MinDepth = 0.0f;
-			viewport.MaxDepth = 1.0f;
-			cmdList->RSSetViewports(1, &viewport);
-			D3D12_RECT scissor = {};
-			scissor.right = (LONG)mBufferWidth;
-			scissor.bottom = (LONG)mBufferHeight;
-			cmdList->RSSetScissorRects(1, &scissor);
-
-			// Draw
-			cmdList->SetGraphicsRootSignature(mRootSignature.Get());
-			ID3D12DescriptorHeap* descHeaps[] = { mDescHeapCbvSrvUav[cmdIndex].Get() };
-			cmdList->SetDescriptorHeaps(ARRAYSIZE(descHeaps), descHeaps);
+			mBatchCmdPairs[batch] = acquireCmdList();
+			auto* cmdList = mBatchCmdPairs[batch].list;
+			mBatchCmdLists[batch] = cmdList;
+
+			// Constant buffer views of the batch's instance slices
+			auto& range = mBatches[batch];
+			for (auto tid = range.first; tid < range.first + range.count; tid++)
 			{
-				auto cbvSrvUavDescHeap = mDescHeapCbvSrvUav[cmdIndex]->GetGPUDescriptorHandleForHeapStart();
-				cbvSrvUavDescHeap.ptr += tid * cbvDescHeapIncSize;
-				cmdList->SetGraphicsRootDescriptorTable(0, cbvSrvUavDescHeap);
-				cmdList->SetPipelineState(mPso.Get());
-				cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				cmdList->IASetVertexBuffers(0, 1, &mVBView);
-				cmdList->IASetIndexBuffer(&mIBView);
-				cmdList->DrawIndexedInstanced(mIndexCount, 1, 0, 0, 0);
+				D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+				cbvDesc.BufferLocation = cb.gpuAddress + tid * CB_ALIGNED_SIZE;
+				cbvDesc.SizeInBytes = CB_ALIGNED_SIZE;
+				auto cbvSrvUavDescHeapCpu = mDescHeapCbvSrvUav[cmdIndex]->GetCPUDescriptorHandleForHeapStart();
+				cbvSrvUavDescHeapCpu.ptr += tid * pass.tableStep;
+				mDev->CreateConstantBufferView(&cbvDesc, cbvSrvUavDescHeapCpu);
 			}
 
+			CommandCapture::D3D12Target target(cmdList);
+			auto record = [&](auto& list)
+			{
+				FrameRecording::recordBatch(list, pass, mDrawArgs.data(), range);
+			};
+#if USE_COMMAND_CAPTURE
+			// Record into the batch's stream, then replay it onto the list
+			if (capture)
+				CommandCapture::recordAndReplay(mBatchStreams[batch], target, record);
+			else
+				record(target);
+#else
+			record(target);
+#endif
+
 			// Fix draw command
 			CHK(cmdList->Close());
+		},
+		[&](uint32_t first, uint32_t count)
+		{
+			cmdQueue->ExecuteCommandLists(count, mBatchCmdLists.data() + first);
+			for (auto i = first; i < first + count; i++)
+			{
+				mCmdPool.submit(mBatchCmdPairs[i], mFrameCount, CMD_LIST_BYTES + mBatches[i].count * CMD_DRAW_BYTES);
+			}
 		});
 
+#if USE_COMMAND_CAPTURE
+		if (capture)
+		{
+			for (auto batch = 0u; batch < mBatches.size(); batch++)
+			{
+				// A stream that overflowed keeps the commands before; its batch was recorded straight onto the list
+				auto& stream = mBatchStreams[batch];
+				if (stream.droppedCount())
+					OutputDebugStringA("Command stream overflowed, the capture is partial.\n");
+				mCaptureRing.append(mFrameCount, stream.data(), stream.size());
+			}
+			if (--mCaptureFrames == 0)
+				printCapture();
+		}
+#endif
+
 		// Start epirouge command
-		CHK(cmdListEpir->Reset(mCmdAlloc[cmdIndex][0].Get(), nullptr));
+		auto epir = acquireCmdList();
+		auto* cmdListEpir = epir.list;
 
 		// Barrier RenderTarget -> Present
-		setResourceBarrier(cmdListEpir, d3dBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+		{
+			CommandCapture::D3D12Target target(cmdListEpir);
+			FrameRecording::recordEpilogue(target, d3dBuffer);
+		}
 
 		// Fix epirouge command
 		CHK(cmdListEpir->Close());
 
 		// Exec
-		ID3D12CommandList* const cmdListsProl = cmdListProl;
-		ID3D12CommandList* const cmdLists[MaxThreadCount] = {};
-		for (int i = 0; i < MaxThreadCount; i++)
-		{
-			const_cast<ID3D12CommandList*>(cmdLists[i]) = mCmdList[i].Get();
-		}
 		ID3D12CommandList* const cmdListsEpir = cmdListEpir;
-		cmdQueue->ExecuteCommandLists(1, &cmdListsProl);
-		cmdQueue->ExecuteCommandLists(MaxThreadCount, cmdLists);
 		cmdQueue->ExecuteCommandLists(1, &cmdListsEpir);
+		mCmdPool.submit(epir, mFrameCount, CMD_LIST_BYTES);
 		CHK(cmdQueue->Signal(mFence.Get(), mFrameCount));
+		mCBAllocator.endFrame(mFrameCount);
 
 		// Present
 		CHK(mSwapChain->Present(1, 0));
 	}
 
 private:
-	void setResourceBarrier(ID3D12GraphicsCommandList* commandList,
-		ID3D12Resource* res,
-		D3D12_RESOURCE_STATES before,
-		D3D12_RESOURCE_STATES after)
+	CmdPool::Pair acquireCmdList()
+	{
+		auto pair = mCmdPool.acquire();
+		if (!pair.list)
+			throw runtime_error("Failed to create a command list.");
+		return pair;
+	}
+
+#if USE_COMMAND_CAPTURE
+	// Sends the redundant state sets of this frame's batches and the diff with the last frame to the debugger
+	void printCapture()
 	{
-		D3D12_RESOURCE_BARRIER desc = {};
-		desc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		desc.Transition.pResource = res;
-		desc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-		desc.Transition.StateBefore = before;
-		desc.Transition.StateAfter = after;
-		desc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-		commandList->ResourceBarrier(1, &desc);
+		vector<CommandCapture::Span> last, previous;
+		if (!mCaptureRing.frame(mFrameCount, last) || !mCaptureRing.frame(mFrameCount - 1, previous))
+			return;
+		CommandCapture::Analysis analysis = {};
+		for (auto& stream : last)
+		{
+			CommandCapture::analyze(stream.data, stream.size, analysis);
+		}
+		CommandCapture::Diff diff;
+		CommandCapture::diff(previous.data(), (UINT)previous.size(), last.data(), (UINT)last.size(), diff);
+		vector<char> text(16 * 1024);
+		CommandCapture::print(analysis, text.data(), text.size());
+		OutputDebugStringA(text.data());
+		CommandCapture::print(diff, text.data(), text.size());
+		OutputDebugStringA(text.data());
 	}
+#endif
 };
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -506,6 +618,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 			PostMessage(hWnd, WM_DESTROY, 0, 0);
 			return 0;
 		}
+		if (wParam == 'D') {
+			g_printCapture = true;
+			return 0;
+		}
 		break;
 
 	case WM_PAINT:
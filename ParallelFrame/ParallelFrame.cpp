@@ -6,6 +6,8 @@
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include "../_common/dxcommon.h"
+#include "../_common/FrameAllocator.h"
+#include "../_common/FramePipeline.h"
 
 #include <DirectXMath.h>
 using DirectX::XMFLOAT3; // for WaveFrontReader
@@ -25,6 +27,7 @@ namespace
 	const int WINDOW_HEIGHT = 240;
 	const int BUFFER_COUNT = 2;
 	HWND g_mainWindowHandle = 0;
+	UINT g_frameLatency = 2; // keys 1-4 change it
 };
 
 void CHK(HRESULT hr)
@@ -39,21 +42,20 @@ class D3D
 	ComPtr<IDXGISwapChain1> mSwapChain;
 	ComPtr<ID3D12Resource> mD3DBuffer[BUFFER_COUNT];
 	int mBufferWidth, mBufferHeight;
-	UINT64 mFrameCount = 0;
-	static const UINT MaxFrameLatency = 2;
+	static const UINT MaxFrameLatency = FramePipeline::MaxLatency;
 
 	ID3D12Device* mDev;
 	ComPtr<ID3D12CommandAllocator> mCmdAlloc[MaxFrameLatency];
 	ComPtr<ID3D12CommandQueue> mCmdQueue;
 
-	ComPtr<ID3D12GraphicsCommandList> mCmdList;
+	ComPtr<ID3D12GraphicsCommandList> mCmdList[MaxFrameLatency]; // the next frame records while this one waits for submission
 	ComPtr<ID3D12Fence> mFence;
 	HANDLE mFenceEveneHandle = 0;
 
 	ComPtr<ID3D12DescriptorHeap> mDescHeapRtv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapDsv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapCbvSrvUav[MaxFrameLatency];
-	void* mCBUploadPtr = nullptr;
+	FrameAllocator mCBAllocator; // Constants of every frame in flight
 
 	ComPtr<ID3D12RootSignature> mRootSignature;
 	ComPtr<ID3D12PipelineState> mPso;
@@ -65,6 +67,12 @@ class D3D
 	ComPtr<ID3D12Resource> mDB;
 	ComPtr<ID3D12Resource> mCB;
 
+	FramePipeline mPipeline;
+	uint64_t mShownFrame = 0;
+	float mRot = 0.0f;
+	XMFLOAT4X4 mMvp[MaxFrameLatency]; // simulated per frame, transposed for the shader
+	XMFLOAT4X4 mWorld[MaxFrameLatency];
+
 public:
 	D3D(int width, int height, HWND hWnd)
 		: mBufferWidth(width), mBufferHeight(height), mDev(nullptr)
@@ -113,13 +121,16 @@ public:
 		scDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
 		CHK(mDxgiFactory->CreateSwapChainForHwnd(mCmdQueue.Get(), hWnd, &scDesc, nullptr, nullptr, mSwapChain.ReleaseAndGetAddressOf()));
 
-		CHK(mDev->CreateCommandList(
-			0,
-			D3D12_COMMAND_LIST_TYPE_DIRECT,
-			mCmdAlloc[0].Get(),
-			nullptr,
-			IID_PPV_ARGS(mCmdList.ReleaseAndGetAddressOf())));
-		mCmdList->Close();
+		for (auto& c : mCmdList)
+		{
+			CHK(mDev->CreateCommandList(
+				0,
+				D3D12_COMMAND_LIST_TYPE_DIRECT,
+				mCmdAlloc[0].Get(),
+				nullptr,
+				IID_PPV_ARGS(c.ReleaseAndGetAddressOf())));
+			c->Close();
+		}
 
 		CHK(mDev->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFence.ReleaseAndGetAddressOf())));
 
@@ -278,29 +289,36 @@ public:
 		mDev->CreateDepthStencilView(mDB.Get(), &dsvDesc, mDescHeapDsv->GetCPUDescriptorHandleForHeapStart());
 
 #define CB_SIZE 256
-		UINT cbSize = CB_SIZE;
-		assert((cbSize % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) == 0);
+#define CB_RING_SIZE (64 * 1024) // Shared by all frames in flight
+		assert((CB_SIZE % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) == 0);
 		CHK(mDev->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(cbSize * MaxFrameLatency),
+			&CD3DX12_RESOURCE_DESC::Buffer(CB_RING_SIZE),
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			nullptr,
 			IID_PPV_ARGS(mCB.ReleaseAndGetAddressOf())));
 		mCB->SetName(L"ConstantBuffer");
-		for (auto i = 0u; i < MaxFrameLatency; ++i)
+		void* cbUploadPtr = nullptr;
+		CHK(mCB->Map(0, nullptr, &cbUploadPtr));
+		mCBAllocator.init(cbUploadPtr, mCB->GetGPUVirtualAddress(), CB_RING_SIZE);
+
+		FramePipeline::Stages stages;
+		stages.simulate = [this](uint64_t frame, uint32_t slot) { simulate(frame, slot); };
+		stages.record = [this](uint64_t frame, uint32_t slot) { record(frame, slot); };
+		stages.submit = [this](uint64_t frame, uint32_t slot) { submit(frame, slot); };
+		stages.waitForFence = [this](uint64_t fenceValue)
 		{
-			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-			cbvDesc.BufferLocation = mCB->GetGPUVirtualAddress() + i * cbSize;
-			cbvDesc.SizeInBytes = cbSize;
-			mDev->CreateConstantBufferView(
-				&cbvDesc,
-				mDescHeapCbvSrvUav[i]->GetCPUDescriptorHandleForHeapStart());
-		}
-		CHK(mCB->Map(0, nullptr, reinterpret_cast<void**>(&mCBUploadPtr)));
+			CHK(mFence->SetEventOnCompletion(fenceValue, mFenceEveneHandle));
+			DWORD wait = WaitForSingleObject(mFenceEveneHandle, 10000);
+			if (wait != WAIT_OBJECT_0)
+				throw runtime_error("Failed WaitForSingleObject().");
+		};
+		mPipeline.start(stages, g_frameLatency);
 	}
 	~D3D()
 	{
+		mPipeline.stop();
 		mCB->Unmap(0, nullptr);
 		CloseHandle(mFenceEveneHandle);
 	}
@@ -310,57 +328,77 @@ public:
 	}
 	void Draw()
 	{
-		mFrameCount++;
-
-		int cmdIndex = mFrameCount % MaxFrameLatency;
-		auto* cmdQueue = mCmdQueue.Get();
-		auto* cmdList = mCmdList.Get();
+		mPipeline.setLatency(g_frameLatency);
+		mPipeline.tick();
 
-		// Wait untill next queue be freed
-		if (mFrameCount > MaxFrameLatency)
+		// Show the pacing once a second
+		uint64_t frame = mPipeline.completedFrame();
+		if (frame % 60 == 0 && frame != mShownFrame)
 		{
-			mFence->SetEventOnCompletion(mFrameCount - MaxFrameLatency, mFenceEveneHandle);
-			DWORD wait = WaitForSingleObject(mFenceEveneHandle, 10000);
-			if (wait != WAIT_OBJECT_0)
-				throw runtime_error("Failed WaitForSingleObject().");
-
-			CHK(mCmdAlloc[cmdIndex]->Reset());
+			mShownFrame = frame;
+			auto summary = mPipeline.summary(60);
+			char title[256];
+			sprintf_s(title, "Latency %u: %.1f ms/frame, %.1f ms to GPU, CPU wait %.1f ms, record %.2f ms, GPU idle %.0f%%",
+				mPipeline.latency(), summary.frameInterval / 1000, summary.latency / 1000,
+				summary.recordWait / 1000, summary.record / 1000, summary.gpuIdleFraction * 100);
+			SetWindowTextA(g_mainWindowHandle, title);
 		}
+	}
 
-		CHK(cmdList->Reset(mCmdAlloc[cmdIndex].Get(), nullptr));
+private:
+	// Pipeline thread; CPU-side state only
+	void simulate(uint64_t frame, uint32_t slot)
+	{
+		mRot += 1.0f;
+		if (mRot >= 360.0f) mRot = 0.0f;
+
+		XMMATRIX worldMat, viewMat, projMat;
+		worldMat = XMMatrixRotationY(XMConvertToRadians(mRot));
+		viewMat = XMMatrixLookAtLH({ 0, 1, -1.5f }, { 0, 0.5f, 0 }, { 0, 1, 0 });
+		projMat = XMMatrixPerspectiveFovLH(45, (float)mBufferWidth / mBufferHeight, 0.01f, 50.0f);
+		XMStoreFloat4x4(&mMvp[slot], XMMatrixTranspose(worldMat * viewMat * projMat));
+		XMStoreFloat4x4(&mWorld[slot], XMMatrixTranspose(worldMat));
+	}
+
+	// Pipeline thread; the frame latency guarantees the GPU is done with the slot
+	void record(uint64_t frame, uint32_t slot)
+	{
+		auto* cmdList = mCmdList[slot].Get();
+
+		CHK(mCmdAlloc[slot]->Reset());
+		mCBAllocator.reclaim(mFence->GetCompletedValue());
+
+		CHK(cmdList->Reset(mCmdAlloc[slot].Get(), nullptr));
 
 		// Upload constant buffer
 		{
-			static float rot = 0.0f;
-			rot += 1.0f;
-			if (rot >= 360.0f) rot = 0.0f;
-
-			XMMATRIX worldMat, viewMat, projMat;
-			worldMat = XMMatrixRotationY(XMConvertToRadians(rot));
-			viewMat = XMMatrixLookAtLH({ 0, 1, -1.5f }, { 0, 0.5f, 0 }, { 0, 1, 0 });
-			projMat = XMMatrixPerspectiveFovLH(45, (float)mBufferWidth / mBufferHeight, 0.01f, 50.0f);
-			auto mvpMat = XMMatrixTranspose(worldMat * viewMat * projMat);
-
-			auto worldTransMat = XMMatrixTranspose(worldMat);
-
-			// mCBUploadPtr is Write-Combine memory
-			// Shift offset to guarantee that the pointer has not referred by executing command list.
-			char* ptr = reinterpret_cast<char*>(mCBUploadPtr) + CB_SIZE * cmdIndex;
-			memcpy_s(ptr, 64, &mvpMat, 64);
-			memcpy_s(ptr + 64, 64, &worldTransMat, 64);
+			// The ring is Write-Combine memory
+			auto cb = mCBAllocator.allocate(CB_SIZE);
+			if (!cb.data)
+				throw runtime_error("Constant buffer ring is full.");
+			char* ptr = reinterpret_cast<char*>(cb.data);
+			memcpy_s(ptr, 64, &mMvp[slot], 64);
+			memcpy_s(ptr + 64, 64, &mWorld[slot], 64);
+
+			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+			cbvDesc.BufferLocation = cb.gpuAddress;
+			cbvDesc.SizeInBytes = CB_SIZE;
+			mDev->CreateConstantBufferView(
+				&cbvDesc,
+				mDescHeapCbvSrvUav[slot]->GetCPUDescriptorHandleForHeapStart());
 		}
 
 		// Get current RTV descriptor
 		auto descHandleRtvStep = mDev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 		D3D12_CPU_DESCRIPTOR_HANDLE descHandleRtv = mDescHeapRtv->GetCPUDescriptorHandleForHeapStart();
-		descHandleRtv.ptr += ((mFrameCount - 1) % BUFFER_COUNT) * descHandleRtvStep;
+		descHandleRtv.ptr += ((frame - 1) % BUFFER_COUNT) * descHandleRtvStep;
 		// Get current swap chain
-		ID3D12Resource* d3dBuffer = mD3DBuffer[(mFrameCount - 1) % BUFFER_COUNT].Get();
+		ID3D12Resource* d3dBuffer = mD3DBuffer[(frame - 1) % BUFFER_COUNT].Get();
 		// Get DSV
 		auto descHandleDsv = mDescHeapDsv->GetCPUDescriptorHandleForHeapStart();
 
 		// Barrier Present -> RenderTarget
-		setResourceBarrier(mCmdList.Get(), d3dBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		setResourceBarrier(cmdList, d3dBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
 
 		// Viewport & Scissor
 		D3D12_VIEWPORT viewport = {};
@@ -375,22 +413,22 @@ public:
 		cmdList->RSSetScissorRects(1, &scissor);
 
 		// Clear DepthTexture
-		mCmdList->ClearDepthStencilView(descHandleDsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+		cmdList->ClearDepthStencilView(descHandleDsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
 		// Clear
 		{
 			float clearColor[4] = { 0.1f, 0.2f, 0.3f, 1.0f };
-			mCmdList->ClearRenderTargetView(descHandleRtv, clearColor, 0, nullptr);
+			cmdList->ClearRenderTargetView(descHandleRtv, clearColor, 0, nullptr);
 		}
 
-		mCmdList->OMSetRenderTargets(1, &descHandleRtv, true, &descHandleDsv);
+		cmdList->OMSetRenderTargets(1, &descHandleRtv, true, &descHandleDsv);
 
 		// Draw
 		cmdList->SetGraphicsRootSignature(mRootSignature.Get());
-		ID3D12DescriptorHeap* descHeaps[] = { mDescHeapCbvSrvUav[cmdIndex].Get() };
+		ID3D12DescriptorHeap* descHeaps[] = { mDescHeapCbvSrvUav[slot].Get() };
 		cmdList->SetDescriptorHeaps(ARRAYSIZE(descHeaps), descHeaps);
 		{
-			cmdList->SetGraphicsRootDescriptorTable(0, mDescHeapCbvSrvUav[cmdIndex]->GetGPUDescriptorHandleForHeapStart());
+			cmdList->SetGraphicsRootDescriptorTable(0, mDescHeapCbvSrvUav[slot]->GetGPUDescriptorHandleForHeapStart());
 			cmdList->SetPipelineState(mPso.Get());
 			cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 			cmdList->IASetVertexBuffers(0, 1, &mVBView);
@@ -399,19 +437,23 @@ public:
 		}
 
 		// Barrier RenderTarget -> Present
-		setResourceBarrier(mCmdList.Get(), d3dBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+		setResourceBarrier(cmdList, d3dBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
 
-		// Exec
 		CHK(cmdList->Close());
-		ID3D12CommandList* const cmdLists = cmdList;
-		cmdQueue->ExecuteCommandLists(1, &cmdLists);
-		CHK(cmdQueue->Signal(mFence.Get(), mFrameCount));
+		mCBAllocator.endFrame(frame);
+	}
+
+	// Thread calling Draw()
+	void submit(uint64_t frame, uint32_t slot)
+	{
+		ID3D12CommandList* const cmdLists = mCmdList[slot].Get();
+		mCmdQueue->ExecuteCommandLists(1, &cmdLists);
+		CHK(mCmdQueue->Signal(mFence.Get(), frame));
 
 		// Present
 		CHK(mSwapChain->Present(1, 0));
 	}
 
-private:
 	void setResourceBarrier(ID3D12GraphicsCommandList* commandList,
 		ID3D12Resource* res,
 		D3D12_RESOURCE_STATES before,
@@ -439,6 +481,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 			PostMessage(hWnd, WM_DESTROY, 0, 0);
 			return 0;
 		}
+		if (wParam >= '1' && wParam <= '4') {
+			g_frameLatency = (UINT)(wParam - '0');
+			return 0;
+		}
 		break;
 
 	case WM_PAINT:
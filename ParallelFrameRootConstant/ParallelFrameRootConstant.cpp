@@ -6,6 +6,8 @@
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include "../_common/dxcommon.h"
+#include "../_common/RootBinding.h"
+#include "../_common/CommandCaptureD3D12.h"
 
 #include <DirectXMath.h>
 using DirectX::XMFLOAT3; // for WaveFrontReader
@@ -25,6 +27,13 @@ namespace
 	const int WINDOW_HEIGHT = 240;
 	const int BUFFER_COUNT = 2;
 	HWND g_mainWindowHandle = 0;
+
+	// Constant buffers of ParallelFrameRootConstant.hlsl
+	const RootBinding::Parameter BindingParams[] = {
+		{ 0, 0, 512, false },   // SceneParam
+		{ 1, 0, 4, true },      // SceneIndex
+	};
+	const uint32_t SceneIndexParam = 1;
 };
 
 void CHK(HRESULT hr)
@@ -56,6 +65,8 @@ class D3D
 	void* mCBUploadPtr = nullptr;
 
 	ComPtr<ID3D12RootSignature> mRootSignature;
+	RootBinding::Layout mBindingLayout;
+	RootBinding::Binder mBinder;
 	ComPtr<ID3D12PipelineState> mPso;
 	ComPtr<ID3D12Resource> mVB;
 	D3D12_VERTEX_BUFFER_VIEW mVBView = {};
@@ -159,18 +170,45 @@ public:
 		}
 
 		{
-			CD3DX12_DESCRIPTOR_RANGE descRange1[1];
-			descRange1[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
-
-			CD3DX12_ROOT_PARAMETER rootParam[2];
-			rootParam[0].InitAsDescriptorTable(ARRAYSIZE(descRange1), descRange1);
-			rootParam[1].InitAsConstants(1, 1, 0);
+			// Root constants, root CBVs or table entries, as the binding layer chooses
+			if (!RootBinding::choose(BindingParams, ARRAYSIZE(BindingParams), mBindingLayout))
+				throw runtime_error("Constant buffers do not fit in the root signature.");
+			vector<CD3DX12_DESCRIPTOR_RANGE> descRange;
+			descRange.reserve(ARRAYSIZE(BindingParams)); // never reallocated, tables point into it
+			vector<CD3DX12_ROOT_PARAMETER> rootParam(mBindingLayout.rootParameters.size());
+			for (size_t i = 0; i < rootParam.size(); i++)
+			{
+				auto& root = mBindingLayout.rootParameters[i];
+				auto& param = BindingParams[root.parameters[0]];
+				switch (root.kind)
+				{
+				case RootBinding::Kind::Constants:
+					rootParam[i].InitAsConstants(RootBinding::dwordCount(root.kind, param.size), param.shaderRegister, param.space);
+					break;
+				case RootBinding::Kind::RootCbv:
+					rootParam[i].InitAsConstantBufferView(param.shaderRegister, param.space);
+					break;
+				case RootBinding::Kind::Table:
+				{
+					auto* ranges = descRange.data() + descRange.size();
+					for (auto p : root.parameters)
+					{
+						descRange.emplace_back();
+						descRange.back().Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, BindingParams[p].shaderRegister, BindingParams[p].space,
+							mBindingLayout.slots[p].tableOffset);
+					}
+					rootParam[i].InitAsDescriptorTable(static_cast<UINT>(root.parameters.size()), ranges);
+					break;
+				}
+				}
+			}
+			mBinder.init(mBindingLayout, BindingParams, nullptr);
 
 			ID3D10Blob *sig, *info;
 			auto rootSigDesc = D3D12_ROOT_SIGNATURE_DESC();
-			rootSigDesc.NumParameters = ARRAYSIZE(rootParam);
+			rootSigDesc.NumParameters = static_cast<UINT>(rootParam.size());
 			rootSigDesc.NumStaticSamplers = 0;
-			rootSigDesc.pParameters = rootParam;
+			rootSigDesc.pParameters = rootParam.data();
 			rootSigDesc.pStaticSamplers = nullptr;
 			rootSigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
 			CHK(D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, &sig, &info));
@@ -383,14 +421,20 @@ public:
 		cmdList->SetGraphicsRootSignature(mRootSignature.Get());
 		ID3D12DescriptorHeap* descHeaps[] = { mDescHeapCbvSrvUav.Get() };
 		cmdList->SetDescriptorHeaps(ARRAYSIZE(descHeaps), descHeaps);
-		cmdList->SetGraphicsRoot32BitConstant(1, cmdIndex, 0);
 		{
-			cmdList->SetGraphicsRootDescriptorTable(0, mDescHeapCbvSrvUav->GetGPUDescriptorHandleForHeapStart());
+			// Record the bindings, then replay them; values already bound are not set again
+			mBinder.reset();
+			UINT sceneParamIndex = cmdIndex;
+			mBinder.set(SceneIndexParam, &sceneParamIndex);
+			mBinder.setTable(mDescHeapCbvSrvUav->GetGPUDescriptorHandleForHeapStart().ptr);
+			mBinder.drawIndexed(mIndexCount, 1, 0, 0, 0);
+
 			cmdList->SetPipelineState(mPso.Get());
 			cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 			cmdList->IASetVertexBuffers(0, 1, &mVBView);
 			cmdList->IASetIndexBuffer(&mIBView);
-			cmdList->DrawIndexedInstanced(mIndexCount, 1, 0, 0, 0);
+			CommandCapture::D3D12Target target(cmdList);
+			CommandCapture::replay(mBinder.stream().data(), mBinder.stream().size(), target);
 		}
 
 		// Barrier RenderTarget -> Present
@@ -0,0 +1,507 @@
+// Checks BCDecoder.h against known-answer blocks worked out by hand from the
+// D3D11 functional spec: BC1 in four-color and three-color punch-through mode,
+// BC2 and BC3 alpha, BC4 and BC5 UNORM and SNORM in both palette modes, BC6H
+// unsigned and signed in a direct and a transformed (delta) mode, BC7 modes 6
+// and 7, and the reserved modes. Then compresses a test image, decodes it and
+// checks the PSNR of every format against a floor: BC1/3/4/5/7 compressed by
+// BCCompressor, BC6H by a one-region mode 11 encoder written here, as
+// BCCompressor has none.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread BCDecoderTest.cpp -o BCDecoderTest
+// Usage: BCDecoderTest
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../_common/BCCompressor.h"
+#include "../_common/BCDecoder.h"
+#include "../_common/Half.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// Builds a block LSB first, as the BC6H and BC7 bit streams are read
+	struct BitWriter
+	{
+		uint8_t block[16] = {};
+		int position = 0;
+
+		void write(uint32_t value, int count)
+		{
+			for (int i = 0; i < count; i++, position++)
+			{
+				if ((value >> i) & 1)
+					block[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+			}
+		}
+	};
+
+	struct Texel8
+	{
+		uint8_t v[4];
+	};
+
+	struct Texel16
+	{
+		uint16_t v[4];
+	};
+
+	bool equal(const uint8_t a[4], uint8_t r, uint8_t g, uint8_t b, uint8_t alpha)
+	{
+		return a[0] == r && a[1] == g && a[2] == b && a[3] == alpha;
+	}
+
+	bool equal(const uint16_t a[4], uint16_t r, uint16_t g, uint16_t b)
+	{
+		return a[0] == r && a[1] == g && a[2] == b && a[3] == 0x3C00;
+	}
+
+	void decode8(uint32_t format, const uint8_t* block, uint8_t out[16][4])
+	{
+		check(BC::decodeBlock(format, block, out), "decodeBlock accepts the format", format);
+	}
+
+	// 565 endpoints and 2-bit indices, pixel i taking index i % 4
+	void bc1Block(uint16_t c0, uint16_t c1, uint8_t* block)
+	{
+		memcpy(block, &c0, 2);
+		memcpy(block + 2, &c1, 2);
+		memset(block + 4, 0xE4, 4);
+	}
+
+	void knownBC1()
+	{
+		uint8_t block[8], out[16][4];
+
+		// c0 > c1: four colors, thirds rounded to nearest
+		bc1Block(0xF800, 0x001F, block);
+		decode8(DDS::FormatBC1Unorm, block, out);
+		check(equal(out[0], 255, 0, 0, 255) && equal(out[1], 0, 0, 255, 255) &&
+			equal(out[2], 170, 0, 85, 255) && equal(out[3], 85, 0, 170, 255), "BC1 four colors", 0);
+
+		// c0 <= c1: three colors and transparent black (punch-through alpha)
+		bc1Block(0x001F, 0xF800, block);
+		decode8(DDS::FormatBC1Unorm, block, out);
+		check(equal(out[0], 0, 0, 255, 255) && equal(out[1], 255, 0, 0, 255) &&
+			equal(out[2], 128, 0, 128, 255) && equal(out[3], 0, 0, 0, 0) && equal(out[15], 0, 0, 0, 0), "BC1 three colors and punch-through", 0);
+
+		// Equal endpoints are three-color mode too; 5 and 6 bits expand by replicating the top bits
+		bc1Block(0x8410, 0x8410, block);
+		decode8(DDS::FormatBC1Unorm, block, out);
+		check(equal(out[0], 132, 130, 132, 255) && equal(out[2], 132, 130, 132, 255) && equal(out[3], 0, 0, 0, 0), "BC1 equal endpoints", 0);
+	}
+
+	void knownBC2BC3()
+	{
+		uint8_t block[16], out[16][4];
+
+		// BC2: explicit 4-bit alpha, pixel i = i * 17; the color block is always four colors
+		for (int k = 0; k < 8; k++)
+			block[k] = static_cast<uint8_t>((2 * k) | ((2 * k + 1) << 4));
+		bc1Block(0x001F, 0xF800, block + 8);
+		decode8(DDS::FormatBC2Unorm, block, out);
+		bool alpha = true;
+		for (int i = 0; i < 16; i++)
+			alpha &= out[i][3] == i * 17;
+		check(alpha, "BC2 alpha", 0);
+		check(equal(out[2], 85, 0, 170, 34) && equal(out[3], 170, 0, 85, 51), "BC2 color in four-color mode", 0);
+
+		// BC3: a0 > a1 interpolates six values, pixel i taking index i % 8
+		const uint8_t eight[8] = { 255, 0, 219, 182, 146, 109, 73, 36 };
+		auto alphaBlock = [](uint8_t a0, uint8_t a1, uint8_t* out)
+		{
+			out[0] = a0;
+			out[1] = a1;
+			uint64_t indices = 0;
+			for (int i = 0; i < 16; i++)
+				indices |= static_cast<uint64_t>(i & 7) << (3 * i);
+			for (int k = 0; k < 6; k++)
+				out[2 + k] = static_cast<uint8_t>(indices >> (8 * k));
+		};
+		alphaBlock(255, 0, block);
+		bc1Block(0xF800, 0x001F, block + 8);
+		decode8(DDS::FormatBC3Unorm, block, out);
+		alpha = true;
+		for (int i = 0; i < 16; i++)
+			alpha &= out[i][3] == eight[i & 7];
+		check(alpha && equal(out[0], 255, 0, 0, 255), "BC3 eight alpha values", 0);
+
+		// a0 <= a1 interpolates four, then 0 and 255
+		const uint8_t six[8] = { 0, 255, 51, 102, 153, 204, 0, 255 };
+		alphaBlock(0, 255, block);
+		decode8(DDS::FormatBC3Unorm, block, out);
+		alpha = true;
+		for (int i = 0; i < 16; i++)
+			alpha &= out[i][3] == six[i & 7];
+		check(alpha, "BC3 six alpha values", 0);
+
+		// BC4 and BC5 decode the same blocks into red (and green)
+		alphaBlock(255, 0, block);
+		alphaBlock(0, 255, block + 8);
+		decode8(DDS::FormatBC4Unorm, block, out);
+		bool red = true;
+		for (int i = 0; i < 16; i++)
+			red &= equal(out[i], eight[i & 7], 0, 0, 255);
+		check(red, "BC4 UNORM", 0);
+		decode8(DDS::FormatBC5Unorm, block, out);
+		bool redGreen = true;
+		for (int i = 0; i < 16; i++)
+			redGreen &= equal(out[i], eight[i & 7], six[i & 7], 0, 255);
+		check(redGreen, "BC5 UNORM", 0);
+
+		// SNORM: -128 clamps to -127; results are int8 bit patterns
+		const int8_t signedEight[8] = { 127, -127, 91, 54, 18, -18, -54, -91 };
+		const int8_t signedSix[8] = { -100, 100, -60, -20, 20, 60, -127, 127 };
+		alphaBlock(127, 0x80, block);
+		alphaBlock(0x9C, 100, block + 8);
+		decode8(DDS::FormatBC5Snorm, block, out);
+		bool snorm = true;
+		for (int i = 0; i < 16; i++)
+		{
+			snorm &= static_cast<int8_t>(out[i][0]) == signedEight[i & 7] && static_cast<int8_t>(out[i][1]) == signedSix[i & 7] &&
+				out[i][2] == 0 && out[i][3] == 127;
+		}
+		check(snorm, "BC5 SNORM", 0);
+		decode8(DDS::FormatBC4Snorm, block, out);
+		check(static_cast<int8_t>(out[1][0]) == -127 && static_cast<int8_t>(out[4][0]) == 18 && out[4][3] == 127, "BC4 SNORM", 0);
+	}
+
+	// BC6H mode 11 (5-bit mode 0x03): two 10-bit endpoints, 4-bit indices
+	void bc6hMode11(const int e0[3], const int e1[3], const uint8_t indices[16], uint8_t* block)
+	{
+		BitWriter w;
+		w.write(0x03, 5);
+		for (int c = 0; c < 3; c++)
+			w.write(static_cast<uint32_t>(e0[c]) & 0x3FF, 10);
+		for (int c = 0; c < 3; c++)
+			w.write(static_cast<uint32_t>(e1[c]) & 0x3FF, 10);
+		for (int i = 0; i < 16; i++)
+			w.write(indices[i], i == 0 ? 3 : 4);
+		memcpy(block, w.block, 16);
+	}
+
+	// BC6H mode 12 (0x07): an 11-bit endpoint and a 9-bit delta per channel
+	void bc6hMode12(const int e0[3], const int delta[3], const uint8_t indices[16], uint8_t* block)
+	{
+		BitWriter w;
+		w.write(0x07, 5);
+		for (int c = 0; c < 3; c++)
+			w.write(static_cast<uint32_t>(e0[c]) & 0x3FF, 10);
+		for (int c = 0; c < 3; c++)
+		{
+			w.write(static_cast<uint32_t>(delta[c]) & 0x1FF, 9);
+			w.write((static_cast<uint32_t>(e0[c]) >> 10) & 1, 1);
+		}
+		for (int i = 0; i < 16; i++)
+			w.write(indices[i], i == 0 ? 3 : 4);
+		memcpy(block, w.block, 16);
+	}
+
+	void knownBC6H()
+	{
+		uint8_t indices[16], block[16];
+		uint16_t out[16][4];
+		for (int i = 0; i < 16; i++)
+			indices[i] = static_cast<uint8_t>(i);
+
+		// Unsigned: 1023 unquantizes to 0xFFFF, the largest finite half 0x7BFF
+		const int u0[3] = { 0, 512, 1023 }, u1[3] = { 1023, 0, 512 };
+		bc6hMode11(u0, u1, indices, block);
+		check(BC::decodeBlock(DDS::FormatBC6HUF16, block, out), "decodeBlock BC6H", 0);
+		check(equal(out[0], 0x0000, 0x3E0F, 0x7BFF) && equal(out[5], 0x28B0, 0x29B2, 0x67AC) &&
+			equal(out[15], 0x7BFF, 0x0000, 0x3E0F), "BC6H unsigned mode 11", 0);
+
+		// Signed: two's complement endpoints, -511 saturates to -0x7FFF
+		const int s0[3] = { 100, -511, 1 }, s1[3] = { -100, 0, 1 };
+		bc6hMode11(s0, s1, indices, block);
+		BC::decodeBlock(DDS::FormatBC6HSF16, block, out);
+		check(equal(out[0], 0x1857, 0xFBFF, 0x005D) && equal(out[1], 0x154C, 0xF43F, 0x005D) &&
+			equal(out[8], 0x8185, 0xBA20, 0x005D) && equal(out[15], 0x9857, 0x0000, 0x005D), "BC6H signed mode 11", 0);
+
+		// Transformed: e1 = e0 + delta, wrapped to 11 bits
+		const int t0[3] = { 1024, 100, 2047 }, d[3] = { -1, 255, -256 };
+		bc6hMode12(t0, d, indices, block);
+		BC::decodeBlock(DDS::FormatBC6HUF16, block, out);
+		check(equal(out[0], 0x3E07, 0x0615, 0x7BFF) && equal(out[8], 0x3DFF, 0x0E49, 0x73BF) &&
+			equal(out[15], 0x3DF8, 0x1586, 0x6C78), "BC6H unsigned mode 12", 0);
+
+		const int ts0[3] = { -1, -1000, 1000 }, ds[3] = { 2, -24, 23 };
+		bc6hMode12(ts0, ds, indices, block);
+		BC::decodeBlock(DDS::FormatBC6HSF16, block, out);
+		check(equal(out[0], 0x802E, 0xF927, 0x7927) && equal(out[8], 0x0002, 0xFAAA, 0x7AAA) &&
+			equal(out[15], 0x002E, 0xFBFF, 0x7BFF), "BC6H signed mode 12", 0);
+
+		// Reserved mode bits 0x13 decode to opaque black
+		BitWriter w;
+		w.write(0x13, 5);
+		w.write(0xFFFFFFFF, 32);
+		BC::decodeBlock(DDS::FormatBC6HUF16, w.block, out);
+		check(equal(out[0], 0, 0, 0) && equal(out[15], 0, 0, 0), "BC6H reserved mode", 0);
+	}
+
+	void knownBC7()
+	{
+		uint8_t out[16][4];
+
+		// Mode 6: one subset, 7-bit RGBA endpoints with a p-bit each, 4-bit indices
+		BitWriter m6;
+		m6.write(1 << 6, 7);
+		const int e0[4] = { 127, 0, 64, 127 }, e1[4] = { 0, 127, 64, 0 };
+		for (int c = 0; c < 4; c++)
+		{
+			m6.write(e0[c], 7);
+			m6.write(e1[c], 7);
+		}
+		m6.write(1, 1);
+		m6.write(0, 1);
+		for (int i = 0; i < 16; i++)
+			m6.write(i, i == 0 ? 3 : 4);
+		decode8(DDS::FormatBC7Unorm, m6.block, out);
+		check(equal(out[0], 255, 1, 129, 255) && equal(out[1], 239, 17, 129, 239) && equal(out[7], 135, 120, 129, 135) &&
+			equal(out[8], 120, 135, 128, 120) && equal(out[15], 0, 254, 128, 0), "BC7 mode 6", 0);
+
+		// Mode 7: two subsets (partition 0: columns 2 and 3 are subset 1), 5-bit RGBA
+		// endpoints with a p-bit each, 2-bit indices; pixels 0 and 15 are the anchors
+		BitWriter m7;
+		m7.write(1 << 7, 8);
+		m7.write(0, 6);
+		const int e[4][4] = { { 31, 0, 0, 31 }, { 0, 31, 0, 16 }, { 0, 0, 31, 31 }, { 16, 16, 16, 0 } };
+		for (int c = 0; c < 4; c++)
+		{
+			for (int k = 0; k < 4; k++)
+				m7.write(e[k][c], 5);
+		}
+		const int pbits[4] = { 1, 0, 1, 0 };
+		for (int k = 0; k < 4; k++)
+			m7.write(pbits[k], 1);
+		for (int i = 0; i < 16; i++)
+			m7.write(i == 15 ? 1 : i & 3, i == 0 || i == 15 ? 1 : 2);
+		decode8(DDS::FormatBC7Unorm, m7.block, out);
+		bool mode7 = true;
+		for (int row = 0; row < 4; row++)
+		{
+			mode7 &= equal(out[row * 4], 255, 4, 4, 255) && equal(out[row * 4 + 1], 171, 85, 3, 214);
+			mode7 &= equal(out[row * 4 + 2], 89, 89, 171, 84);
+			mode7 &= row == 3 || equal(out[row * 4 + 3], 130, 130, 130, 0);
+		}
+		check(mode7 && equal(out[15], 45, 45, 214, 171), "BC7 mode 7", 0);
+
+		// No mode bit set: reserved, transparent black
+		uint8_t reserved[16] = {};
+		memset(out, 0xAB, sizeof(out));
+		decode8(DDS::FormatBC7Unorm, reserved, out);
+		check(equal(out[0], 0, 0, 0, 0) && equal(out[15], 0, 0, 0, 0), "BC7 reserved mode", 0);
+	}
+
+	// A 64x64 RGBA8 image: smooth gradients, hard edges, noise and an alpha ramp
+	vector<uint8_t> testImage(uint32_t size, unsigned seed)
+	{
+		mt19937 rng(seed);
+		uniform_int_distribution<int> noise(-12, 12);
+		vector<uint8_t> image(size * size * 4);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint8_t* p = &image[(y * size + x) * 4];
+				int r = x * 255 / (size - 1);
+				int g = y * 255 / (size - 1);
+				int b = ((x / 8 + y / 8) & 1) ? 200 : 40;
+				int a = (x + y) * 255 / (2 * (size - 1));
+				if (x > size / 2 && y > size / 2)
+				{
+					r = (min)(255, (max)(0, 128 + noise(rng)));
+					g = (min)(255, (max)(0, 64 + noise(rng)));
+				}
+				p[0] = static_cast<uint8_t>(r);
+				p[1] = static_cast<uint8_t>(g);
+				p[2] = static_cast<uint8_t>(b);
+				p[3] = static_cast<uint8_t>(a);
+			}
+		}
+		return image;
+	}
+
+	double psnr(double squaredError, size_t count, double peak)
+	{
+		if (squaredError == 0)
+			return 99;
+		return 10 * log10(peak * peak * count / squaredError);
+	}
+
+	// Compresses with BCCompressor, decodes, and compares the channels the format keeps.
+	// BC1 gets the image opaque, as texels with alpha below 128 become transparent black.
+	double roundTrip(uint32_t format, int channels, vector<uint8_t> image, uint32_t size)
+	{
+		if (format == DDS::FormatBC1Unorm)
+		{
+			for (size_t i = 3; i < image.size(); i += 4)
+				image[i] = 255;
+		}
+		uint32_t blocks = size / 4;
+		uint32_t blockBytes = DDS::blockBytes(format);
+		vector<uint8_t> compressed(blocks * blocks * blockBytes);
+		check(BC::compress(format, image.data(), size * 4, size, size, false, compressed.data(), blocks * blockBytes),
+			"compress", format);
+		vector<uint8_t> decoded(image.size());
+		BC::DecodeJob job = { compressed.data(), blocks * blockBytes, size, size, decoded.data(), size * 4 };
+		check(BC::decode(format, &job, 1, 1), "decode", format);
+
+		double error = 0;
+		for (size_t i = 0; i < image.size(); i += 4)
+		{
+			for (int c = 0; c < channels; c++)
+			{
+				double d = static_cast<double>(image[i + c]) - decoded[i + c];
+				error += d * d;
+			}
+		}
+		return psnr(error, image.size() / 4 * channels, 255);
+	}
+
+	// One-region BC6H mode 11 block from 16 non-negative half texels: box endpoints
+	// in the unquantized domain, nearest of the 16 weights along the axis
+	void encodeMode11(const uint16_t texels[16][3], uint8_t* block)
+	{
+		double value[16][3];
+		double lo[3] = { 1e30, 1e30, 1e30 }, hi[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				// Inverse of bc6ToHalf(): half = unquantized * 31 / 64
+				value[i][c] = texels[i][c] * 64.0 / 31.0;
+				lo[c] = (min)(lo[c], value[i][c]);
+				hi[c] = (max)(hi[c], value[i][c]);
+			}
+		}
+		int e0[3], e1[3];
+		double u0[3], u1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			// Inverse of bc6Unquantize() for 10 bits
+			e0[c] = (min)(1023, (max)(0, static_cast<int>(lo[c] * 1024 / 65536)));
+			e1[c] = (min)(1023, (max)(0, static_cast<int>(ceil(hi[c] * 1024 / 65536))));
+			u0[c] = e0[c] == 1023 ? 65535 : ((e0[c] << 16) + 0x8000) >> 10;
+			u1[c] = e1[c] == 1023 ? 65535 : ((e1[c] << 16) + 0x8000) >> 10;
+			if (e0[c] == 0)
+				u0[c] = 0;
+		}
+		double axis[3] = { u1[0] - u0[0], u1[1] - u0[1], u1[2] - u0[2] };
+		double length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		uint8_t indices[16];
+		for (int i = 0; i < 16; i++)
+		{
+			double t = 0;
+			for (int c = 0; c < 3; c++)
+				t += (value[i][c] - u0[c]) * axis[c];
+			t = length2 > 0 ? t / length2 * 64 : 0;
+			int best = 0;
+			for (int k = 1; k < 16; k++)
+			{
+				if (fabs(BC::detail::Weights4[k] - t) < fabs(BC::detail::Weights4[best] - t))
+					best = k;
+			}
+			indices[i] = static_cast<uint8_t>(best);
+		}
+		// The anchor index has no top bit: swap the endpoints if it needs one
+		if (indices[0] >= 8)
+		{
+			swap(e0, e1);
+			for (auto& index : indices)
+				index = static_cast<uint8_t>(15 - index);
+		}
+		bc6hMode11(e0, e1, indices, block);
+	}
+
+	// The test image as halves in [0, 4), through encodeMode11() and the decoder
+	double roundTripBC6H(const vector<uint8_t>& image, uint32_t size)
+	{
+		uint32_t blocks = size / 4;
+		vector<uint8_t> compressed(blocks * blocks * 16);
+		for (uint32_t by = 0; by < blocks; by++)
+		{
+			for (uint32_t bx = 0; bx < blocks; bx++)
+			{
+				uint16_t texels[16][3];
+				for (int i = 0; i < 16; i++)
+				{
+					const uint8_t* p = &image[((by * 4 + i / 4) * size + bx * 4 + i % 4) * 4];
+					for (int c = 0; c < 3; c++)
+						texels[i][c] = Half::floatToHalf(p[c] / 64.0f);
+				}
+				encodeMode11(texels, &compressed[(by * blocks + bx) * 16]);
+			}
+		}
+		vector<uint16_t> decoded(size * size * 4);
+		BC::DecodeJob job = { compressed.data(), blocks * 16, size, size, reinterpret_cast<uint8_t*>(decoded.data()), size * 8 };
+		check(BC::decode(DDS::FormatBC6HUF16, &job, 1, 1), "decode", DDS::FormatBC6HUF16);
+
+		double error = 0;
+		for (size_t i = 0; i < size * size; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				double d = image[i * 4 + c] / 64.0 - Half::halfToFloat(decoded[i * 4 + c]);
+				error += d * d;
+			}
+		}
+		return psnr(error, size * size * 3, 255 / 64.0);
+	}
+
+	struct Floor
+	{
+		const char* name;
+		uint32_t format;
+		int channels;
+		double minimum;
+	};
+};
+
+int main()
+{
+	knownBC1();
+	knownBC2BC3();
+	knownBC6H();
+	knownBC7();
+
+	// Floors sit about 1.5 dB under what the compressors reach today
+	const uint32_t size = 64;
+	vector<uint8_t> image = testImage(size, 1);
+	const Floor floors[] = {
+		{ "BC1", DDS::FormatBC1Unorm, 3, 36 },
+		{ "BC3", DDS::FormatBC3Unorm, 4, 37 },
+		{ "BC4", DDS::FormatBC4Unorm, 1, 47 },
+		{ "BC5", DDS::FormatBC5Unorm, 2, 45 },
+		{ "BC7", DDS::FormatBC7Unorm, 4, 38 },
+	};
+	printf("  %-8s %10s %10s\n", "format", "PSNR dB", "floor");
+	for (auto& f : floors)
+	{
+		double db = roundTrip(f.format, f.channels, image, size);
+		printf("  %-8s %10.2f %10.2f\n", f.name, db, f.minimum);
+		check(db >= f.minimum, f.name, f.format);
+	}
+	const double bc6hFloor = 33;
+	double db = roundTripBC6H(image, size);
+	printf("  %-8s %10.2f %10.2f\n", "BC6H", db, bc6hFloor);
+	check(db >= bc6hFloor, "BC6H", DDS::FormatBC6HUF16);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,268 @@
+// Checks CommandPool against fake allocators and lists. Frames are recorded by
+// several threads while the fake GPU completes them two frames behind; the
+// callbacks check no allocator is reset or released before its fence value has
+// completed and no list is reset while open. A steady load keeps the pool small,
+// a burst of large frames grows it, and the same steady load after the burst
+// shrinks it back to its size and pinned memory before the burst. Random loads,
+// failed creations and leaks once the pool is cleared are checked too.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread CommandPoolTest.cpp -o CommandPoolTest
+// Usage: CommandPoolTest [random frames]
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../_common/CommandPool.h"
+
+using namespace std;
+
+namespace
+{
+	const uint64_t Latency = 2;                 // frames the fake GPU is behind
+
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// Stand in for ID3D12CommandAllocator and ID3D12GraphicsCommandList
+	struct Allocator
+	{
+		uint64_t busyUntil;                     // fence value of its last submission
+		bool recording;                         // a list is open on it
+	};
+
+	struct List
+	{
+		Allocator* allocator;
+		bool open;
+	};
+
+	typedef CommandPool<Allocator*, List*> Pool;
+
+	struct Device
+	{
+		uint64_t completed = 0;                 // only changed while no frame is recorded
+		atomic<int> liveAllocators{ 0 };
+		atomic<int> liveLists{ 0 };
+		atomic<int> failAllocators{ 0 };        // creations to fail
+		atomic<int> failLists{ 0 };
+		atomic<int> violations{ 0 };
+
+		Pool::Callbacks callbacks()
+		{
+			Pool::Callbacks c;
+			c.createAllocator = [this](Allocator*& allocator)
+			{
+				if (failAllocators > 0)
+				{
+					failAllocators--;
+					return false;
+				}
+				allocator = new Allocator{ 0, false };
+				liveAllocators++;
+				return true;
+			};
+			c.createList = [this](Allocator* allocator, List*& list)
+			{
+				if (failLists > 0)
+				{
+					failLists--;
+					return false;
+				}
+				list = new List{ allocator, true };
+				allocator->recording = true;
+				liveLists++;
+				return true;
+			};
+			c.resetAllocator = [this](Allocator* allocator)
+			{
+				violations += allocator->busyUntil > completed || allocator->recording ? 1 : 0;
+			};
+			c.resetList = [this](List* list, Allocator* allocator)
+			{
+				violations += list->open ? 1 : 0;
+				list->open = true;
+				list->allocator = allocator;
+				allocator->recording = true;
+			};
+			c.releaseAllocator = [this](Allocator* allocator)
+			{
+				violations += allocator->busyUntil > completed ? 1 : 0;
+				delete allocator;
+				liveAllocators--;
+			};
+			c.releaseList = [this](List* list)
+			{
+				violations += list->open ? 1 : 0;
+				delete list;
+				liveLists--;
+			};
+			return c;
+		}
+	};
+
+	struct Frames
+	{
+		Device& device;
+		Pool& pool;
+		uint64_t frame = 0;
+
+		// Reclaims, then records lists with threads, each with the given recorded bytes
+		void run(uint32_t listCount, uint64_t bytes, uint32_t threadCount)
+		{
+			frame++;
+			device.completed = frame > Latency ? frame - Latency : 0;
+			pool.reclaim(device.completed);
+			vector<thread> threads;
+			for (uint32_t t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([this, t, listCount, bytes, threadCount]
+				{
+					for (uint32_t i = t; i < listCount; i += threadCount)
+					{
+						auto pair = pool.acquire();
+						if (!pair.list || !pair.list->open || pair.list->allocator != pair.allocator || !pair.allocator->recording)
+						{
+							device.violations++;
+							continue;
+						}
+						pair.list->open = false;
+						pair.allocator->recording = false;
+						pair.allocator->busyUntil = frame;
+						pool.submit(pair, frame, bytes);
+					}
+				});
+			}
+			for (auto& t : threads)
+				t.join();
+		}
+
+		// Lets the GPU finish everything submitted
+		void drain()
+		{
+			device.completed = frame;
+			pool.reclaim(device.completed);
+		}
+	};
+
+	void testLoads(unsigned seed, uint32_t randomFrames)
+	{
+		Device device;
+		{
+			Pool pool;
+			pool.init(device.callbacks());
+			Frames frames{ device, pool };
+
+			// 4 lists a frame need 4 allocators for each frame in flight, and the lists are free at once
+			for (int i = 0; i < 300; i++)
+				frames.run(4, 10000, 2);
+			auto steady = pool.stats();
+			check(steady.allocators <= 4 * (Latency + 1) && steady.lists <= 4, "steady load keeps the pool small", seed);
+			check(steady.created == steady.allocators && steady.released == 0, "no churn under a steady load", seed);
+			check(steady.pinnedBytes == steady.allocators * 10000ull, "pinned bytes are the peaks", seed);
+
+			for (int i = 0; i < 10; i++)
+				frames.run(64, 200000, 4);
+			auto burst = pool.stats();
+			check(burst.allocators >= 64 && burst.lists <= 4 && burst.pinnedBytes >= 64 * 200000ull, "a burst grows the pool", seed);
+
+			// Allocators that recorded the burst record far less now, and the rest go idle
+			for (uint64_t i = 0; i < Pool::IdleLimit + 60; i++)
+				frames.run(4, 10000, 2);
+			auto after = pool.stats();
+			check(after.allocators == steady.allocators && after.pinnedBytes == steady.pinnedBytes, "the pool shrinks back after the burst", seed);
+			check(after.lists <= steady.lists + 1 && after.released == after.created - after.allocators, "lists shrink back, released counted", seed);
+			uint32_t reported = 0;
+			bool peaks = true;
+			pool.forEachAllocator([&](uint32_t, uint64_t peakBytes, uint64_t uses)
+			{
+				reported++;
+				peaks &= peakBytes == 10000 && uses > 0;
+			});
+			check(reported == after.allocators && peaks, "forEachAllocator reports the live allocators and their peaks", seed);
+
+			mt19937 rng(seed);
+			for (uint32_t i = 0; i < randomFrames; i++)
+				frames.run(rng() % 20, rng() % 3 ? 1000 : rng() % 500000, 1 + rng() % 4);
+			frames.drain();
+			auto random = pool.stats();
+			check(random.allocators == random.created - random.released, "allocator count", seed);
+			check(device.liveAllocators == (int)random.allocators && device.liveLists == (int)random.lists, "stats match the live objects", seed);
+			check(device.violations == 0, "nothing reset or released early, no open list reset", seed);
+
+			// init() releases everything
+			pool.init(device.callbacks());
+			check(device.liveAllocators == 0 && device.liveLists == 0 && pool.stats().allocators == 0, "init() releases everything", seed);
+			frames.frame = 0;
+			device.completed = 0;
+			for (int i = 0; i < 10; i++)
+				frames.run(8, 1000, 3);
+			frames.drain();
+		}
+		check(device.liveAllocators == 0 && device.liveLists == 0, "destructor releases everything", seed);
+	}
+
+	void testCreateFailure()
+	{
+		Device device;
+		Pool pool;
+		pool.init(device.callbacks());
+
+		device.failAllocators = 1;
+		auto pair = pool.acquire();
+		check(!pair.allocator && !pair.list, "failed allocator creation gives an empty pair", 0);
+
+		// The allocator created for a failed list is kept for the next acquire()
+		device.failLists = 1;
+		pair = pool.acquire();
+		check(!pair.list && device.liveAllocators == 1, "failed list creation gives an empty pair", 0);
+		pair = pool.acquire();
+		check(pair.list && pair.allocator && device.liveAllocators == 1 && device.liveLists == 1, "allocator reused after a failed list", 0);
+		pair.list->open = false;
+		pair.allocator->recording = false;
+		pair.allocator->busyUntil = 1;
+		pool.submit(pair, 1, 100);
+
+		// Not free before its fence value completes
+		pool.reclaim(0);
+		auto second = pool.acquire();
+		check(second.allocator && second.allocator != pair.allocator && device.liveAllocators == 2, "allocator busy until its fence completes", 0);
+		second.list->open = false;
+		second.allocator->recording = false;
+		second.allocator->busyUntil = 1;
+		pool.submit(second, 1, 100);
+		device.completed = 1;
+		pool.reclaim(1);
+		auto third = pool.acquire();
+		check(third.allocator == second.allocator && device.liveAllocators == 2, "most recently used allocator first", 0);
+		third.list->open = false;
+		third.allocator->recording = false;
+		third.allocator->busyUntil = 2;
+		pool.submit(third, 2, 100);
+		device.completed = 2;
+		pool.reclaim(2);
+		check(device.violations == 0, "no early resets", 0);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	uint32_t randomFrames = argc > 1 ? atoi(argv[1]) : 5000;
+
+	testCreateFailure();
+	for (unsigned seed = 1; seed <= 3; seed++)
+		testLoads(seed, randomFrames);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok: %u random frames x 3 seeds\n", randomFrames);
+	return 0;
+}
@@ -0,0 +1,430 @@
+// Checks DDSTexture.h against known layouts: legacy and DX10 headers, the
+// legacy pixel format mapping, subresource offsets of mip chains, cube arrays
+// and volumes, and footprints against the values GetCopyableFootprints returns
+// (rows aligned to 256 bytes, subresources to 512). Malformed files, huge
+// array sizes and sizes that overflow included, are rejected without
+// allocating, makeHeaders() round-trips through parse(), and copySubresource()
+// pitches the rows. DDS files given on the command line are parsed too.
+// Portable; on Linux: g++ -std=c++14 -O2 DDSTextureTest.cpp -o DDSTextureTest
+// Usage: DDSTextureTest [file.dds ...]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../_common/DDSTexture.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// GetCopyableFootprints results of one subresource
+	struct Expected
+	{
+		uint64_t offset;
+		uint32_t rowPitch;
+		uint32_t rowCount;
+		uint64_t rowSize;
+	};
+
+	DDS::Header legacyHeader(uint32_t width, uint32_t height, uint32_t mipLevels, const DDS::PixelFormat& pf)
+	{
+		DDS::Header header = {};
+		header.size = sizeof(DDS::Header);
+		header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;
+		header.width = width;
+		header.height = height;
+		header.mipMapCount = mipLevels;
+		header.pixelFormat = pf;
+		header.pixelFormat.size = sizeof(DDS::PixelFormat);
+		return header;
+	}
+
+	DDS::PixelFormat rgba8()
+	{
+		return { 0, DDS::PixelFlagRGB, 0, 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000 };
+	}
+
+	DDS::PixelFormat fourCC(char a, char b, char c, char d)
+	{
+		return { 0, DDS::PixelFlagFourCC, DDS::fourCC(a, b, c, d), 0, 0, 0, 0, 0 };
+	}
+
+	// Magic, headers and a payload filled with its offset
+	vector<uint8_t> makeFile(const DDS::Header& header, const DDS::HeaderDXT10* dx10, size_t payloadSize)
+	{
+		size_t headerSize = 4 + sizeof(DDS::Header) + (dx10 ? sizeof(DDS::HeaderDXT10) : 0);
+		vector<uint8_t> file(headerSize + payloadSize);
+		memcpy(&file[0], &DDS::Magic, 4);
+		memcpy(&file[4], &header, sizeof(header));
+		if (dx10)
+			memcpy(&file[4 + sizeof(header)], dx10, sizeof(*dx10));
+		for (size_t i = headerSize; i < file.size(); i++)
+			file[i] = (uint8_t)(i * 7);
+		return file;
+	}
+
+	void checkFootprints(const DDS::TextureDesc& desc, const Expected* expected, size_t count, uint64_t total, const char* what)
+	{
+		vector<DDS::Footprint> footprints;
+		check(DDS::computeFootprints(desc, footprints) == total, what, 0);
+		check(footprints.size() == count, what, 0);
+		for (size_t i = 0; i < count && i < footprints.size(); i++)
+		{
+			auto& f = footprints[i];
+			check(f.offset == expected[i].offset && f.rowPitch == expected[i].rowPitch && f.rowCount == expected[i].rowCount &&
+				f.rowSize == expected[i].rowSize && f.format == desc.format, what, (unsigned)i);
+		}
+	}
+
+	void testLegacyRgba8()
+	{
+		// The 256x256 RGBA8 textures of the samples, which used to be read with seekg(128)
+		auto file = makeFile(legacyHeader(256, 256, 1, rgba8()), nullptr, 256 * 256 * 4);
+		DDS::TextureDesc desc;
+		vector<DDS::Subresource> subresources;
+		check(DDS::parse(file.data(), file.size(), desc, subresources), "legacy RGBA8 parses", 0);
+		check(desc.format == DDS::FormatR8G8B8A8Unorm && desc.width == 256 && desc.height == 256 && desc.mipLevels == 1 &&
+			desc.arraySize == 1 && desc.dimension == DDS::DimensionTexture2D && !desc.cubemap, "legacy RGBA8 desc", 0);
+		check(subresources.size() == 1 && subresources[0].data == file.data() + 128 && subresources[0].rowSize == 1024 &&
+			subresources[0].rowCount == 256 && subresources[0].slicePitch == 256 * 1024, "legacy RGBA8 payload at 128", 0);
+
+		Expected expected[] = { { 0, 1024, 256, 1024 } };
+		checkFootprints(desc, expected, 1, 256 * 1024, "legacy RGBA8 footprint");
+	}
+
+	void testMipChains()
+	{
+		// RGBA8 100x100, 3 mips: rows padded to 256, mips placed at 512
+		DDS::TextureDesc desc;
+		desc.format = DDS::FormatR8G8B8A8Unorm;
+		desc.width = desc.height = 100;
+		desc.mipLevels = 3;
+		Expected rgba[] = {
+			{ 0, 512, 100, 400 },
+			{ 51200, 256, 50, 200 },
+			{ 64000, 256, 25, 100 },
+		};
+		checkFootprints(desc, rgba, 3, 70244, "RGBA8 100x100 footprints");
+
+		// BC1 256x256 full chain, like TextureOptimize's d3d12_bc1.dds; small mips take one block
+		desc.format = DDS::FormatBC1Unorm;
+		desc.width = desc.height = 256;
+		desc.mipLevels = 9;
+		Expected bc1[] = {
+			{ 0, 512, 64, 512 },
+			{ 32768, 256, 32, 256 },
+			{ 40960, 256, 16, 128 },
+			{ 45056, 256, 8, 64 },
+			{ 47104, 256, 4, 32 },
+			{ 48128, 256, 2, 16 },
+			{ 48640, 256, 1, 8 },
+			{ 49152, 256, 1, 8 },
+			{ 49664, 256, 1, 8 },
+		};
+		checkFootprints(desc, bc1, 9, 49672, "BC1 256x256 footprints");
+		vector<DDS::Footprint> footprints;
+		DDS::computeFootprints(desc, footprints);
+		check(footprints[8].width == 4 && footprints[8].height == 4, "BC footprints are whole blocks", 0);
+
+		// Legacy DXT1 file of the same texture: 43704 bytes of payload
+		auto file = makeFile(legacyHeader(256, 256, 9, fourCC('D', 'X', 'T', '1')), nullptr, 43704);
+		vector<DDS::Subresource> subresources;
+		check(DDS::parse(file.data(), file.size(), desc, subresources), "DXT1 parses", 0);
+		size_t offsets[] = { 128, 32896, 41088, 43136, 43648, 43776, 43808, 43816, 43824 };
+		bool packed = subresources.size() == 9;
+		for (size_t i = 0; packed && i < 9; i++)
+			packed = subresources[i].data == file.data() + offsets[i];
+		check(packed, "DXT1 mips packed in the file", 0);
+		check(!DDS::parse(file.data(), file.size() - 1, desc, subresources) && subresources.empty(), "truncated DXT1 rejected", 0);
+	}
+
+	void testCubeArray()
+	{
+		// DX10 BC7 cube array of 2 cubes, 8x8 with 4 mips: 112 bytes per face
+		DDS::HeaderDXT10 dx10 = { DDS::FormatBC7Unorm, DDS::DimensionTexture2D, DDS::MiscTextureCube, 2, 0 };
+		auto file = makeFile(legacyHeader(8, 8, 4, fourCC('D', 'X', '1', '0')), &dx10, 12 * 112);
+		DDS::TextureDesc desc;
+		vector<DDS::Subresource> subresources;
+		check(DDS::parse(file.data(), file.size(), desc, subresources), "cube array parses", 0);
+		check(desc.cubemap && desc.arraySize == 12 && desc.subresourceCount() == 48 && subresources.size() == 48, "cube array counts faces", 0);
+		bool ordered = subresources.size() == 48;
+		size_t mipOffsets[] = { 0, 64, 80, 96 };
+		for (uint32_t face = 0; ordered && face < 12; face++)
+		{
+			for (uint32_t mip = 0; ordered && mip < 4; mip++)
+				ordered = subresources[mip + face * 4].data == file.data() + 148 + face * 112 + mipOffsets[mip];
+		}
+		check(ordered, "subresources in D3D12 order", 0);
+
+		vector<DDS::Footprint> footprints;
+		uint64_t total = DDS::computeFootprints(desc, footprints);
+		check(footprints.size() == 48 && footprints[4].offset == 2048 && footprints[47].offset == 47 * 512 && total == 47 * 512 + 16,
+			"cube array footprints", 0);
+	}
+
+	void testVolume()
+	{
+		// Legacy RGBA8 volume 16x8x4 with 3 mips
+		auto header = legacyHeader(16, 8, 3, rgba8());
+		header.flags |= DDS::FlagDepth;
+		header.depth = 4;
+		header.caps2 = DDS::Caps2Volume;
+		auto file = makeFile(header, nullptr, 2048 + 256 + 32);
+		DDS::TextureDesc desc;
+		vector<DDS::Subresource> subresources;
+		check(DDS::parse(file.data(), file.size(), desc, subresources), "volume parses", 0);
+		check(desc.dimension == DDS::DimensionTexture3D && desc.depth == 4 && subresources.size() == 3, "volume desc", 0);
+		check(subresources.size() == 3 && subresources[1].depth == 2 && subresources[1].data == file.data() + 128 + 2048 &&
+			subresources[2].depth == 1 && subresources[2].data == file.data() + 128 + 2304, "volume mips hold every depth slice", 0);
+
+		Expected expected[] = {
+			{ 0, 256, 8, 64 },
+			{ 8192, 256, 4, 32 },
+			{ 10240, 256, 2, 16 },
+		};
+		checkFootprints(desc, expected, 3, 10512, "volume footprints");
+	}
+
+	void testLegacyFormats()
+	{
+		struct Case
+		{
+			DDS::PixelFormat pf;
+			uint32_t format;
+		};
+		Case cases[] = {
+			{ fourCC('D', 'X', 'T', '1'), DDS::FormatBC1Unorm },
+			{ fourCC('D', 'X', 'T', '3'), DDS::FormatBC2Unorm },
+			{ fourCC('D', 'X', 'T', '5'), DDS::FormatBC3Unorm },
+			{ fourCC('A', 'T', 'I', '1'), DDS::FormatBC4Unorm },
+			{ fourCC('A', 'T', 'I', '2'), DDS::FormatBC5Unorm },
+			{ fourCC('B', 'C', '5', 'S'), DDS::FormatBC5Snorm },
+			{ { 0, DDS::PixelFlagFourCC, 113, 0, 0, 0, 0, 0 }, DDS::FormatR16G16B16A16Float },
+			{ rgba8(), DDS::FormatR8G8B8A8Unorm },
+			{ { 0, DDS::PixelFlagRGB, 0, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 }, DDS::FormatB8G8R8A8Unorm },
+			{ { 0, DDS::PixelFlagRGB, 0, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0 }, DDS::FormatB8G8R8X8Unorm },
+			{ { 0, DDS::PixelFlagRGB, 0, 16, 0xF800, 0x07E0, 0x001F, 0 }, DDS::FormatB5G6R5Unorm },
+			{ { 0, DDS::PixelFlagLuminance, 0, 8, 0xFF, 0, 0, 0 }, DDS::FormatR8Unorm },
+			{ { 0, DDS::PixelFlagAlpha, 0, 8, 0, 0, 0, 0xFF }, DDS::FormatA8Unorm },
+			{ { 0, DDS::PixelFlagRGB, 0, 24, 0xFF0000, 0xFF00, 0xFF, 0 }, DDS::FormatUnknown },
+			{ fourCC('Y', 'U', 'Y', '2'), DDS::FormatUnknown },
+		};
+		for (auto& c : cases)
+		{
+			auto pf = c.pf;
+			pf.size = sizeof(DDS::PixelFormat);
+			check(DDS::detail::legacyFormat(pf) == c.format, "legacy pixel format", c.format);
+		}
+	}
+
+	void testRejected()
+	{
+		DDS::TextureDesc desc;
+		vector<DDS::Subresource> subresources;
+		auto good = makeFile(legacyHeader(4, 4, 3, rgba8()), nullptr, 64 + 16 + 4);
+		check(DDS::parse(good.data(), good.size(), desc, subresources), "4x4 with 3 mips parses", 0);
+
+		auto file = good;
+		file[0] = 'X';
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "bad magic rejected", 0);
+		check(!DDS::parse(good.data(), 100, desc, subresources), "short header rejected", 0);
+
+		file = makeFile(legacyHeader(4, 4, 4, rgba8()), nullptr, 64 + 16 + 4 + 4);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "mips past 1x1 rejected", 0);
+
+		auto header = legacyHeader(4, 4, 1, rgba8());
+		header.caps2 = DDS::Caps2Cubemap | 0x400;
+		file = makeFile(header, nullptr, 6 * 64);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "partial cubemap rejected", 0);
+
+		header = legacyHeader(4, 4, 1, fourCC('D', 'X', '1', '0'));
+		DDS::HeaderDXT10 dx10 = { DDS::FormatR8G8B8A8Unorm, DDS::DimensionTexture2D, 0, 0, 0 };
+		file = makeFile(header, &dx10, 64);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "array size 0 rejected", 0);
+		dx10.arraySize = 2;
+		dx10.resourceDimension = DDS::DimensionTexture3D;
+		header.flags |= DDS::FlagDepth;
+		header.depth = 1;
+		file = makeFile(header, &dx10, 128);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "3D array rejected", 0);
+		dx10 = { 130, DDS::DimensionTexture2D, 0, 1, 0 };  // DXGI_FORMAT_P208
+		file = makeFile(legacyHeader(4, 4, 1, fourCC('D', 'X', '1', '0')), &dx10, 64);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "unsupported format rejected", 0);
+
+		// A 212-byte file claiming 2^31 - 1 slices, which used to throw bad_alloc, and cubes past the limit
+		dx10 = { DDS::FormatR8G8B8A8Unorm, DDS::DimensionTexture2D, 0, 0x7FFFFFFF, 0 };
+		file = makeFile(legacyHeader(4, 4, 1, fourCC('D', 'X', '1', '0')), &dx10, 64);
+		check(file.size() == 212 && !DDS::parse(file.data(), file.size(), desc, subresources) && subresources.empty(),
+			"huge array size rejected", 0);
+		dx10 = { DDS::FormatR8G8B8A8Unorm, DDS::DimensionTexture2D, DDS::MiscTextureCube, 0x2AAAAAAB, 0 };
+		file = makeFile(legacyHeader(4, 4, 1, fourCC('D', 'X', '1', '0')), &dx10, 64);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "cube count overflowing 32 bits rejected", 0);
+		dx10 = { DDS::FormatR8G8B8A8Unorm, DDS::DimensionTexture2D, DDS::MiscTextureCube, 342, 0 };
+		file = makeFile(legacyHeader(1, 1, 1, fourCC('D', 'X', '1', '0')), &dx10, 342 * 6 * 4);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "more than 2048 cube faces rejected", 0);
+		dx10.arraySize = 341;
+		file = makeFile(legacyHeader(1, 1, 1, fourCC('D', 'X', '1', '0')), &dx10, 341 * 6 * 4);
+		check(DDS::parse(file.data(), file.size(), desc, subresources) && desc.arraySize == 2046, "2046 cube faces parse", 0);
+
+		// Sizes whose row bytes or payload overflow 32 and 64 bits, in files far too short for them
+		dx10 = { DDS::FormatR8G8B8A8Unorm, DDS::DimensionTexture2D, 0, 2048, 0 };
+		file = makeFile(legacyHeader(0x40000000, 0x40000000, 1, fourCC('D', 'X', '1', '0')), &dx10, 64);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources) && subresources.empty(), "4 GB rows rejected", 0);
+		dx10 = { DDS::FormatR32G32B32A32Float, DDS::DimensionTexture2D, 0, 1, 0 };
+		file = makeFile(legacyHeader(0x10000000, 1, 1, fourCC('D', 'X', '1', '0')), &dx10, 64);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "row bytes overflowing 32 bits rejected", 0);
+		dx10 = { DDS::FormatBC1Unorm, DDS::DimensionTexture3D, 0, 1, 0 };
+		header = legacyHeader(0xFFFFFFFF, 0xFFFFFFFF, 1, fourCC('D', 'X', '1', '0'));
+		header.flags |= DDS::FlagDepth;
+		header.depth = 0xFFFFFFFF;
+		file = makeFile(header, &dx10, 64);
+		check(!DDS::parse(file.data(), file.size(), desc, subresources), "volume bytes overflowing 64 bits rejected", 0);
+		dx10 = { DDS::FormatBC1Unorm, DDS::DimensionTexture2D, 0, 2048, 0 };
+		file = makeFile(legacyHeader(4096, 4096, 13, fourCC('D', 'X', '1', '0')), &dx10, 64);
+		vector<DDS::Subresource> unallocated;
+		check(!DDS::parse(file.data(), file.size(), desc, unallocated) && unallocated.capacity() == 0,
+			"short payload rejected before allocating", 0);
+	}
+
+	void testMakeHeaders()
+	{
+		DDS::TextureDesc descs[4];
+		descs[0].format = DDS::FormatBC7UnormSrgb;
+		descs[0].width = 300;
+		descs[0].height = 200;
+		descs[0].mipLevels = 9;
+		descs[1].format = DDS::FormatR16G16B16A16Float;
+		descs[1].width = descs[1].height = 32;
+		descs[1].arraySize = 12;
+		descs[1].cubemap = true;
+		descs[1].mipLevels = 6;
+		descs[2].format = DDS::FormatR8Unorm;
+		descs[2].dimension = DDS::DimensionTexture3D;
+		descs[2].width = 7;
+		descs[2].height = 5;
+		descs[2].depth = 3;
+		descs[2].mipLevels = 3;
+		descs[3].format = DDS::FormatBC4Unorm;
+		descs[3].dimension = DDS::DimensionTexture1D;
+		descs[3].width = 64;
+		descs[3].height = 1;
+		descs[3].arraySize = 3;
+
+		for (unsigned i = 0; i < 4; i++)
+		{
+			auto& desc = descs[i];
+			DDS::Header header;
+			DDS::HeaderDXT10 dx10;
+			DDS::makeHeaders(desc, header, dx10);
+			size_t payload = 0;
+			uint32_t sliceCount = desc.dimension == DDS::DimensionTexture3D ? 1 : desc.arraySize;
+			for (uint32_t mip = 0; mip < desc.mipLevels; mip++)
+			{
+				uint32_t rowSize = 0, rowCount = 0;
+				DDS::surfaceInfo(desc.format, DDS::mipSize(desc.width, mip), DDS::mipSize(desc.height, mip), rowSize, rowCount);
+				uint32_t depth = desc.dimension == DDS::DimensionTexture3D ? DDS::mipSize(desc.depth, mip) : 1;
+				payload += (size_t)rowSize * rowCount * depth * sliceCount;
+			}
+			auto file = makeFile(header, &dx10, payload);
+
+			DDS::TextureDesc parsed;
+			vector<DDS::Subresource> subresources;
+			check(DDS::parse(file.data(), file.size(), parsed, subresources), "makeHeaders output parses", i);
+			check(parsed.format == desc.format && parsed.width == desc.width && parsed.height == desc.height &&
+				parsed.depth == desc.depth && parsed.arraySize == desc.arraySize && parsed.mipLevels == desc.mipLevels &&
+				parsed.dimension == desc.dimension && parsed.cubemap == desc.cubemap, "makeHeaders round trip", i);
+			bool filled = !subresources.empty() && subresources.size() == desc.subresourceCount();
+			if (filled)
+			{
+				auto& last = subresources.back();
+				filled = last.data + last.slicePitch * last.depth == file.data() + file.size();
+			}
+			check(filled, "payload ends with the last subresource", i);
+		}
+	}
+
+	void testCopySubresource()
+	{
+		auto file = makeFile(legacyHeader(100, 20, 2, rgba8()), nullptr, 100 * 20 * 4 + 50 * 10 * 4);
+		DDS::TextureDesc desc;
+		vector<DDS::Subresource> subresources;
+		check(DDS::parse(file.data(), file.size(), desc, subresources), "100x20 parses", 0);
+		vector<DDS::Footprint> footprints;
+		vector<uint8_t> upload((size_t)DDS::computeFootprints(desc, footprints), 0xCD);
+		for (size_t i = 0; i < footprints.size(); i++)
+			DDS::copySubresource(upload.data(), footprints[i], subresources[i]);
+
+		bool copied = true;
+		for (size_t i = 0; i < footprints.size(); i++)
+		{
+			auto& f = footprints[i];
+			auto& s = subresources[i];
+			for (uint32_t row = 0; row < f.rowCount; row++)
+			{
+				const uint8_t* dst = &upload[(size_t)(f.offset + (uint64_t)row * f.rowPitch)];
+				copied &= memcmp(dst, s.data + (size_t)row * s.rowSize, s.rowSize) == 0;
+				// Rows may be written up to the next 16 bytes, never up to the pitch
+				if (row + 1 < f.rowCount)
+					copied &= dst[f.rowPitch - 1] == 0xCD;
+			}
+		}
+		check(copied, "rows copied to their pitch, padding untouched", 0);
+	}
+
+	void testFile(const char* fileName)
+	{
+		DDS::File file;
+		if (!file.open(fileName))
+		{
+			printf("FAILED: %s does not parse\n", fileName);
+			g_failures++;
+			return;
+		}
+		auto& desc = file.desc();
+		vector<DDS::Footprint> footprints;
+		uint64_t total = DDS::computeFootprints(desc, footprints);
+		bool placed = footprints.size() == file.subresources().size();
+		uint64_t end = 0;
+		for (size_t i = 0; placed && i < footprints.size(); i++)
+		{
+			auto& f = footprints[i];
+			auto& s = file.subresource(i);
+			placed = f.offset % DDS::PlacementAlignment == 0 && f.rowPitch % DDS::PitchAlignment == 0 && f.offset >= end &&
+				f.rowSize == s.rowSize && f.rowCount == s.rowCount && f.depth == s.depth;
+			end = f.offset + (uint64_t)f.rowPitch * (f.rowCount * f.depth - 1) + f.rowSize;
+		}
+		check(placed && end == total, fileName, 0);
+		printf("%s: format %u, %ux%ux%u, %u mips, %u slices, %llu upload bytes\n", fileName, desc.format, desc.width, desc.height,
+			desc.depth, desc.mipLevels, desc.arraySize, (unsigned long long)total);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	testLegacyRgba8();
+	testMipChains();
+	testCubeArray();
+	testVolume();
+	testLegacyFormats();
+	testRejected();
+	testMakeHeaders();
+	testCopySubresource();
+	for (int i = 1; i < argc; i++)
+		testFile(argv[i]);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok: %d files\n", argc - 1);
+	return 0;
+}
@@ -0,0 +1,165 @@
+// Checks DrawBatching: partition() covers the draws in order with at most
+// maxBatches batches and the smallest possible largest batch, and
+// OrderedSubmitter submits batches in order whatever order they complete in.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread DrawBatchingTest.cpp -o DrawBatchingTest
+// Usage: DrawBatchingTest [seeds]
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../_common/DrawBatching.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// Smallest largest batch over every split of the draws into at most batchCount batches
+	uint64_t bestLimit(const vector<DrawBatching::Draw>& draws, size_t batchCount, const DrawBatching::CostModel& model)
+	{
+		size_t count = draws.size();
+		const uint64_t none = ~0ull;
+		// best[k][i]: draws [0, i) in k batches
+		vector<vector<uint64_t>> best(batchCount + 1, vector<uint64_t>(count + 1, none));
+		best[0][0] = 0;
+		for (size_t k = 1; k <= batchCount; k++)
+		{
+			for (size_t end = 1; end <= count; end++)
+			{
+				for (size_t first = 0; first < end; first++)
+				{
+					if (best[k - 1][first] == none)
+						continue;
+					uint64_t cost = DrawBatching::batchCost(draws.data(), first, end - first, model);
+					best[k][end] = min(best[k][end], max(best[k - 1][first], cost));
+				}
+			}
+		}
+		uint64_t limit = none;
+		for (size_t k = 1; k <= batchCount; k++)
+			limit = min(limit, best[k][count]);
+		return limit;
+	}
+
+	void testPartition(unsigned seed)
+	{
+		mt19937 rng(seed);
+		DrawBatching::CostModel model;
+		model.minBatchCost = rng() % 2 ? 0 : rng() % 5000;
+
+		vector<DrawBatching::Draw> draws(1 + rng() % 12);
+		for (auto& draw : draws)
+		{
+			draw.indexCount = rng() % 4 ? rng() % 20000 : rng() % 400000;
+			draw.stateKey = rng() % 3;
+		}
+		size_t maxBatches = 1 + rng() % 6;
+
+		vector<DrawBatching::Batch> batches;
+		DrawBatching::partition(draws.data(), draws.size(), maxBatches, model, batches);
+
+		check(!batches.empty() && batches.size() <= maxBatches, "batch count", seed);
+		uint32_t next = 0;
+		uint64_t largest = 0;
+		for (auto& batch : batches)
+		{
+			check(batch.first == next && batch.count > 0, "batches cover the draws in order", seed);
+			check(batch.cost == DrawBatching::batchCost(draws.data(), batch.first, batch.count, model), "batch cost", seed);
+			next = batch.first + batch.count;
+			largest = max(largest, batch.cost);
+		}
+		check(next == draws.size(), "every draw is in a batch", seed);
+
+		// partition() picks the batch count from minBatchCost, then minimizes the largest batch
+		uint64_t total = DrawBatching::batchCost(draws.data(), 0, draws.size(), model);
+		uint64_t minCost = model.minBatchCost ? model.minBatchCost : 1;
+		size_t batchCount = static_cast<size_t>(min<uint64_t>(maxBatches, max<uint64_t>(1, total / minCost)));
+		check(largest == bestLimit(draws, batchCount, model), "largest batch is minimal", seed);
+	}
+
+	void testSmallList()
+	{
+		// Four teapots stay in one list with the default model and spread with minBatchCost 0
+		vector<DrawBatching::Draw> draws(4, { 7392, 0 });
+		vector<DrawBatching::Batch> batches;
+		DrawBatching::CostModel model;
+		DrawBatching::partition(draws.data(), draws.size(), 4, model, batches);
+		check(batches.size() == 1, "default model keeps a small list together", 0);
+		model.minBatchCost = 0;
+		DrawBatching::partition(draws.data(), draws.size(), 4, model, batches);
+		check(batches.size() == 4, "minBatchCost 0 gives a batch per thread", 0);
+		DrawBatching::partition(draws.data(), 0, 4, model, batches);
+		check(batches.empty(), "no draws, no batches", 0);
+	}
+
+	void testSubmitter(unsigned seed)
+	{
+		mt19937 rng(seed);
+		uint32_t batchCount = 1 + rng() % 64;
+		vector<uint32_t> order(batchCount);
+		for (uint32_t i = 0; i < batchCount; i++)
+			order[i] = i;
+		shuffle(order.begin(), order.end(), rng);
+
+		DrawBatching::OrderedSubmitter submitter;
+		submitter.reset(batchCount);
+		vector<uint32_t> submitted;
+		atomic<uint32_t> nextOrder(0);
+		atomic<int> inSubmit(0);
+		bool overlapped = false;
+		auto worker = [&]
+		{
+			for (uint32_t i; (i = nextOrder++) < batchCount;)
+			{
+				submitter.complete(order[i], [&](uint32_t first, uint32_t count)
+				{
+					overlapped |= inSubmit++ != 0;
+					for (uint32_t b = first; b < first + count; b++)
+						submitted.push_back(b);
+					inSubmit--;
+				});
+			}
+		};
+		thread a(worker), b(worker);
+		worker();
+		a.join();
+		b.join();
+
+		check(!overlapped, "submit never runs twice at once", seed);
+		check(submitter.finished(), "every batch submitted", seed);
+		bool inOrder = submitted.size() == batchCount;
+		for (uint32_t i = 0; inOrder && i < batchCount; i++)
+			inOrder = submitted[i] == i;
+		check(inOrder, "batches submitted in order, once each", seed);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	unsigned seeds = argc > 1 ? atoi(argv[1]) : 2000;
+
+	testSmallList();
+	for (unsigned seed = 1; seed <= seeds; seed++)
+	{
+		testPartition(seed);
+		testSubmitter(seed);
+	}
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok: %u seeds\n", seeds);
+	return 0;
+}
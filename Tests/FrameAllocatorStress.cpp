@@ -0,0 +1,173 @@
+// Stress test for FrameAllocator with a simulated GPU. Threads allocate and
+// fill constants every frame while a GPU thread completes the frames in order
+// after a random delay and checks each frame's constants are still intact, so
+// space handed out before its frame's fence completed shows up as overwritten
+// data. Also checks alignment, addresses, the full ring and reclaim().
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread FrameAllocatorStress.cpp -o FrameAllocatorStress
+// Usage: FrameAllocatorStress [frames] [threads] [latency]
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../_common/FrameAllocator.h"
+
+using namespace std;
+
+namespace
+{
+	const uint64_t Capacity = 256 * 1024;
+	const uint64_t GpuAddress = 0x10000000;
+
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	struct Constants
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint8_t value;
+	};
+
+	void testFullRing()
+	{
+		vector<uint8_t> buffer(4096);
+		FrameAllocator allocator;
+		allocator.init(buffer.data(), 0, buffer.size());
+		int count = 0;
+		while (allocator.allocate(1).data)
+			count++;
+		check(count == 16, "a 4 KB ring holds 16 allocations", 0);
+		check(allocator.used() == allocator.capacity(), "full ring is used up", 0);
+
+		allocator.endFrame(1);
+		check(!allocator.allocate(1).data, "no space before the fence completes", 0);
+		allocator.reclaim(0);
+		check(!allocator.allocate(1).data, "no space for an older fence value", 0);
+		allocator.reclaim(1);
+		check(allocator.allocate(1).data != nullptr, "space comes back after reclaim", 0);
+		check(!allocator.allocate(0).data && !allocator.allocate(8192).data, "empty and oversized allocations fail", 0);
+	}
+
+	// The main thread records frames; the GPU thread completes them latency frames behind
+	void testFrames(unsigned seed, uint32_t frameCount, uint32_t threadCount, uint32_t latency)
+	{
+		vector<uint8_t> buffer(Capacity);
+		FrameAllocator allocator;
+		allocator.init(buffer.data(), GpuAddress, Capacity);
+
+		vector<vector<Constants>> frames(frameCount + 1);
+		atomic<uint64_t> submitted(0), completed(0);
+		atomic<int> overwritten(0);
+		thread gpu([&]
+		{
+			mt19937 rng(seed);
+			for (uint64_t frame = 1; frame <= frameCount; frame++)
+			{
+				while (submitted.load() < frame)
+					this_thread::yield();
+				for (uint32_t i = rng() % 64; i > 0; i--)
+					this_thread::yield();
+				for (auto& c : frames[frame])
+				{
+					for (uint64_t i = 0; i < c.size; i++)
+					{
+						if (buffer[c.offset + i] != c.value)
+						{
+							overwritten++;
+							break;
+						}
+					}
+				}
+				completed.store(frame);
+			}
+		});
+
+		atomic<int> misplaced(0), full(0);
+		for (uint64_t frame = 1; frame <= frameCount; frame++)
+		{
+			while (frame > latency && completed.load() < frame - latency)
+				this_thread::yield();
+			allocator.reclaim(completed.load());
+
+			// Frames ask for between half and twice their share of the ring, so the ring
+			// runs full and allocate() has to turn down space still in flight
+			uint64_t budget = Capacity / latency / threadCount / 2 * (1 + frame % 4);
+			vector<vector<Constants>> recorded(threadCount);
+			vector<thread> threads;
+			for (uint32_t t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([&, t]
+				{
+					mt19937 rng(seed * 7919 + (unsigned)frame * 31 + t);
+					for (uint64_t used = 0;;)
+					{
+						uint64_t size = 1 + rng() % 400;
+						used += (size + FrameAllocator::Alignment - 1) & ~(FrameAllocator::Alignment - 1);
+						if (used > budget)
+							break;
+						auto a = allocator.allocate(size);
+						if (!a.data)
+						{
+							full++;
+							continue;
+						}
+						if (a.offset % FrameAllocator::Alignment || a.gpuAddress != GpuAddress + a.offset || a.offset + size > Capacity)
+						{
+							misplaced++;
+							continue;
+						}
+						uint8_t value = (uint8_t)(rng() | 1);
+						memset(a.data, value, (size_t)size);
+						recorded[t].push_back({ a.offset, size, value });
+					}
+				});
+			}
+			for (auto& t : threads)
+				t.join();
+			for (auto& r : recorded)
+				frames[frame].insert(frames[frame].end(), r.begin(), r.end());
+
+			allocator.endFrame(frame);
+			submitted.store(frame);
+		}
+		gpu.join();
+
+		check(misplaced == 0, "allocations aligned and inside the buffer", seed);
+		check(full > 0, "ring runs full", seed);
+		check(overwritten == 0, "constants intact until their frame completes", seed);
+		allocator.reclaim(frameCount);
+		check(allocator.used() == 0, "every frame reclaimed", seed);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	uint32_t frameCount = argc > 1 ? atoi(argv[1]) : 2000;
+	uint32_t threadCount = argc > 2 ? atoi(argv[2]) : 4;
+	uint32_t latency = argc > 3 ? atoi(argv[3]) : 2;
+	if (threadCount < 1 || threadCount > 8 || latency < 1 || latency > 3)
+	{
+		printf("Usage: FrameAllocatorStress [frames] [threads 1-8] [latency 1-3]\n");
+		return 1;
+	}
+
+	testFullRing();
+	for (unsigned seed = 1; seed <= 4; seed++)
+		testFrames(seed, frameCount, threadCount, latency);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok: %u frames x 4 seeds, %u threads, latency %u\n", frameCount, threadCount, latency);
+	return 0;
+}
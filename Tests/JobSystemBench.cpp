@@ -0,0 +1,201 @@
+// Benchmarks JobSystem scaling from 1 to 64 threads. Each thread count runs
+// fine (~2 us) and coarse (~50 us) parallelFor jobs and a recursive fork/join,
+// and prints the time, speedup over 1 thread, steals, and per-job queue latency
+// (run() to start) and run time percentiles with the queue latency histogram.
+// Thread counts above the hardware threads oversubscribe the cores and show
+// the cost of it. Checks fork/join, continuations, exceptions, parallelFor and
+// jobs from outside threads first.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread JobSystemBench.cpp -o JobSystemBench
+// Usage: JobSystemBench [max threads] [jobs]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include "../_common/JobSystem.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// Roughly iterations * 5 ns of arithmetic the compiler cannot drop
+	void spin(uint32_t seed, uint32_t iterations)
+	{
+		volatile double v = seed;
+		for (uint32_t i = 0; i < iterations; i++)
+			v = v * 1.0000001 + 1.0;
+	}
+
+	long fib(JobSystem& jobs, int n)
+	{
+		if (n < 12)
+		{
+			long a = 0, b = 1;
+			for (int i = 0; i < n; i++)
+			{
+				long t = a + b;
+				a = b;
+				b = t;
+			}
+			return a;
+		}
+		long x = 0, y = 0;
+		JobSystem::Counter counter;
+		jobs.run([&] { x = fib(jobs, n - 1); }, &counter);
+		jobs.run([&] { y = fib(jobs, n - 2); }, &counter);
+		jobs.wait(counter);
+		return x + y;
+	}
+
+	void testJobs(unsigned threadCount)
+	{
+		JobSystem jobs;
+		jobs.init(threadCount, true);
+		for (unsigned round = 0; round < 10; round++)
+		{
+			check(fib(jobs, 25) == 75025, "fork/join", threadCount);
+
+			// Continuations start once their dependency is done, and at once after that
+			atomic<int> stage(0);
+			atomic<bool> early(false);
+			JobSystem::Counter first, second, third;
+			for (int i = 0; i < 100; i++)
+				jobs.run([&] { early = early || stage.load() != 0; }, &first);
+			jobs.runAfter(first, [&] { stage = 1; }, &second);
+			for (int i = 0; i < 50; i++)
+				jobs.runAfter(second, [&] { early = early || stage.load() != 1; }, &third);
+			jobs.wait(third);
+			check(!early && first.done() && second.done(), "continuations wait for their dependency", threadCount);
+			JobSystem::Counter late;
+			jobs.runAfter(first, [&] { stage = 2; }, &late);
+			jobs.wait(late);
+			check(stage == 2, "continuation of a finished counter runs", threadCount);
+
+			JobSystem::Counter failing;
+			for (int i = 0; i < 10; i++)
+				jobs.run([i] { if (i == 7) throw runtime_error("job failed"); }, &failing);
+			bool caught = false;
+			try
+			{
+				jobs.wait(failing);
+			}
+			catch (runtime_error&)
+			{
+				caught = true;
+			}
+			check(caught, "wait() rethrows a job's exception", threadCount);
+
+			atomic<uint64_t> sum(0);
+			jobs.parallelFor(0, 100000, 97, [&](uint32_t i) { sum += i; });
+			check(sum == 4999950000ull, "parallelFor covers the range once", threadCount);
+
+			// A thread that is not a worker hands jobs in and waits for them
+			JobSystem::Counter outside;
+			atomic<int> ran(0);
+			thread submitter([&]
+			{
+				for (int i = 0; i < 1000; i++)
+					jobs.run([&] { ran++; }, &outside);
+				jobs.wait(outside);
+			});
+			submitter.join();
+			check(ran == 1000, "jobs from outside threads", threadCount);
+		}
+	}
+
+	struct Run
+	{
+		double ms;
+		JobSystem::Stats stats;
+	};
+
+	template<class F>
+	Run measure(JobSystem& jobs, F f)
+	{
+		jobs.resetStats();
+		auto start = chrono::steady_clock::now();
+		f();
+		auto end = chrono::steady_clock::now();
+		return { chrono::duration<double, milli>(end - start).count(), jobs.stats() };
+	}
+
+	void print(const char* name, unsigned threadCount, const Run& run, double baseMs)
+	{
+		auto& s = run.stats;
+		printf("  %-8s %3u %9.2f %7.2f %9llu %8llu %8llu %8llu\n", name, threadCount, run.ms, baseMs / run.ms,
+			(unsigned long long)s.steals, (unsigned long long)s.queueLatency.percentile(0.5),
+			(unsigned long long)s.queueLatency.percentile(0.99), (unsigned long long)s.runTime.percentile(0.5));
+	}
+
+	// Non-empty buckets as "<upper bound ns>:count"
+	void printHistogram(const JobSystem::Histogram& histogram)
+	{
+		printf("           queue latency:");
+		for (int i = 0; i < JobSystem::Histogram::BucketCount; i++)
+		{
+			if (histogram.buckets[i])
+				printf(" <%llu:%llu", 2ull << i, (unsigned long long)histogram.buckets[i]);
+		}
+		printf("\n");
+	}
+};
+
+int main(int argc, char** argv)
+{
+	unsigned maxThreads = argc > 1 ? atoi(argv[1]) : 64;
+	uint32_t jobCount = argc > 2 ? atoi(argv[2]) : 100000;
+	if (maxThreads < 1 || jobCount < 1)
+	{
+		printf("Usage: JobSystemBench [max threads] [jobs]\n");
+		return 1;
+	}
+
+	for (unsigned threadCount : { 1u, 2u, 4u })
+		testJobs(threadCount);
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+
+	printf("%u hardware threads, %u jobs; times in ms, latencies as upper bounds in ns\n", thread::hardware_concurrency(), jobCount);
+	printf("  %-8s %3s %9s %7s %9s %8s %8s %8s\n", "work", "thr", "ms", "speedup", "steals", "wait p50", "wait p99", "run p50");
+	double base[3] = {};
+	for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+	{
+		JobSystem jobs;
+		jobs.init(threadCount, true);
+
+		Run fine = measure(jobs, [&] { jobs.parallelFor(0, jobCount, 1, [](uint32_t i) { spin(i, 400); }); });
+		Run coarse = measure(jobs, [&] { jobs.parallelFor(0, jobCount / 25, 1, [](uint32_t i) { spin(i, 10000); }); });
+		long result = 0;
+		Run forkJoin = measure(jobs, [&] { result = fib(jobs, 27); });
+		check(result == 196418, "fork/join result", threadCount);
+		if (threadCount == 1)
+		{
+			base[0] = fine.ms;
+			base[1] = coarse.ms;
+			base[2] = forkJoin.ms;
+		}
+		print("fine", threadCount, fine, base[0]);
+		print("coarse", threadCount, coarse, base[1]);
+		print("fib(27)", threadCount, forkJoin, base[2]);
+		printHistogram(fine.stats.queueLatency);
+	}
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,244 @@
+// Checks MeshCook and MeshCache: the bundled teapot cooks into a cache that
+// MeshCache::View maps back with every index in range and every subset inside
+// the index buffer, a second cook finds it up to date, and a change of the
+// settings or of the material library cooks it again. A small OBJ checks the
+// triangulation, the subsets and the materials read from its MTL. Damaged
+// caches are rejected: a changed header or payload byte by the checksum, and
+// section offsets that overlap the header or wrap around 2^64 by validate()
+// even with the checksum off.
+// Portable; on Linux: g++ -std=c++14 -O2 MeshCacheTest.cpp -o MeshCacheTest
+// Usage: MeshCacheTest
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../Mesh/MeshCook.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	const char* CacheFile = "MeshCacheTest.tmp.vbo2";
+	const char* DamagedFile = "MeshCacheTest.damaged.vbo2";
+	const char* ObjFile = "MeshCacheTest.tmp.obj";
+	const char* MtlFile = "MeshCacheTest.tmp.mtl";
+
+	bool writeFile(const char* fileName, const void* data, size_t size)
+	{
+		ofstream file(fileName, ios::binary | ios::trunc);
+		file.write(static_cast<const char*>(data), size);
+		return !!file;
+	}
+
+	bool writeText(const char* fileName, const char* text)
+	{
+		return writeFile(fileName, text, strlen(text));
+	}
+
+	vector<char> readFile(const char* fileName)
+	{
+		ifstream file(fileName, ios::binary);
+		return vector<char>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+	}
+
+	// Indices in range, subsets inside the index buffer and naming real materials
+	bool consistent(const MeshCache::View& view)
+	{
+		auto& h = view.header();
+		for (uint32_t i = 0; i < h.indexCount; i++)
+		{
+			uint32_t index = h.indexSize == 2 ? static_cast<const uint16_t*>(view.indexData())[i] : static_cast<const uint32_t*>(view.indexData())[i];
+			if (index >= h.vertexCount)
+				return false;
+		}
+		uint32_t covered = 0;
+		for (uint32_t s = 0; s < h.subsetCount; s++)
+		{
+			auto& subset = view.subsets()[s];
+			if (subset.indexStart != covered || subset.materialIndex >= h.materialCount)
+				return false;
+			covered += subset.indexCount;
+		}
+		return covered == h.indexCount;
+	}
+
+	void cookTeapot()
+	{
+		const char* teapot = "../Mesh/teapot.obj";
+		MeshCook::Settings settings;
+		check(MeshCook::cook(teapot, CacheFile, settings) == MeshCook::Result::Cooked, "cook teapot.obj", 0);
+		check(MeshCook::cook(teapot, CacheFile, settings) == MeshCook::Result::UpToDate, "a second cook is up to date", 0);
+
+		MeshCache::View view;
+		if (!view.open(CacheFile))
+		{
+			check(false, "open the cooked teapot", 0);
+			return;
+		}
+		auto& h = view.header();
+		printf("  teapot.obj: %u vertices, %u indices of %u bytes, %u subsets, %u materials, %llu bytes\n",
+			h.vertexCount, h.indexCount, h.indexSize, h.subsetCount, h.materialCount, static_cast<unsigned long long>(h.fileSize));
+		check(h.vertexFormat == MeshCache::VertexFormatP3N3T2 && h.vertexStride == sizeof(MeshCook::Vertex), "float vertices", 0);
+		check(h.vertexCount > 0 && h.vertexCount <= 0xFFFF && h.indexSize == 2, "16-bit indices", 0);
+		check(h.indexCount % 3 == 0 && consistent(view), "indices and subsets in range", 0);
+		bool inBounds = true;
+		auto* vertices = static_cast<const MeshCook::Vertex*>(view.vertexData());
+		for (uint32_t v = 0; v < h.vertexCount; v++)
+		{
+			const float* p = &vertices[v].position.x;
+			for (int k = 0; k < 3; k++)
+				inBounds &= fabsf(p[k] - h.boundsCenter[k]) <= h.boundsExtents[k] * 1.0001f;
+		}
+		check(inBounds, "vertices inside the header bounds", 0);
+		view.close();
+
+		settings.compactVertices = true;
+		check(MeshCook::cook(teapot, CacheFile, settings) == MeshCook::Result::Cooked, "new settings cook again", 0);
+		check(view.open(CacheFile) && view.header().vertexFormat == MeshCache::VertexFormatCompact &&
+			view.header().vertexStride == sizeof(VertexQuantizer::CompactVertex) && consistent(view), "compact vertices", 0);
+	}
+
+	void cookSmall()
+	{
+		// A quad and a triangle in two materials, and a material the OBJ does not use
+		check(writeText(ObjFile,
+			"mtllib some/dir/MeshCacheTest.tmp.mtl\n"
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 2\n"
+			"vn 0 0 1\n"
+			"usemtl red\n"
+			"f 1//1 2//1 3//1 4//1\n"
+			"usemtl blue\n"
+			"f 1//1 2//1 5//1\n"), "write the OBJ", 0);
+		const char* mtl =
+			"newmtl unused\nKd 0 1 0\n"
+			"newmtl red\nKd 1 0 0\nKs 0.5 0.5 0.5\nNs 20\nillum 2\nmap_Kd red.dds\n"
+			"# comment\n"
+			"newmtl blue\nKa 0 0 0.1\nd 0.5\n";
+		check(writeText(MtlFile, mtl), "write the MTL", 0);
+
+		check(MeshCook::cook(ObjFile, CacheFile) == MeshCook::Result::Cooked, "cook the small OBJ", 0);
+		MeshCache::View view;
+		if (!view.open(CacheFile))
+		{
+			check(false, "open the small cache", 0);
+			return;
+		}
+		auto& h = view.header();
+		check(h.vertexCount == 5 && h.indexCount == 9 && consistent(view), "a quad and a triangle", 0);
+		check(h.boundsCenter[2] == 1.0f && h.boundsExtents[0] == 0.5f && h.boundsExtents[2] == 1.0f, "bounds", 0);
+		check(h.materialCount == 3 && h.subsetCount == 2, "default, red and blue", 0);
+		if (h.materialCount == 3 && h.subsetCount == 2)
+		{
+			auto* m = view.materials();
+			check(strcmp(m[0].name, "default") == 0 && m[0].diffuse[0] == 0.8f && m[0].alpha == 1.0f, "default material", 0);
+			check(strcmp(m[1].name, "red") == 0 && m[1].diffuse[0] == 1.0f && m[1].diffuse[1] == 0.0f && m[1].specular[0] == 0.5f &&
+				m[1].shininess == 20 && m[1].specularEnabled == 1 && strcmp(m[1].texture, "red.dds") == 0, "red material", 0);
+			check(strcmp(m[2].name, "blue") == 0 && m[2].ambient[2] == 0.1f && m[2].alpha == 0.5f && m[2].diffuse[0] == 0.8f &&
+				m[2].specularEnabled == 0 && m[2].texture[0] == 0, "blue material", 0);
+			check(view.subsets()[0].materialIndex == 1 && view.subsets()[0].indexCount == 6 &&
+				view.subsets()[1].materialIndex == 2 && view.subsets()[1].indexCount == 3, "subsets by material", 0);
+		}
+		view.close();
+
+		// The material library is part of the source
+		check(MeshCook::cook(ObjFile, CacheFile) == MeshCook::Result::UpToDate, "small OBJ up to date", 0);
+		string changed = mtl;
+		changed.replace(changed.find("d 0.5"), 5, "d 0.25");
+		check(writeText(MtlFile, changed.c_str()), "rewrite the MTL", 0);
+		check(MeshCook::cook(ObjFile, CacheFile) == MeshCook::Result::Cooked, "a changed MTL cooks again", 0);
+		check(view.open(CacheFile) && view.header().materialCount == 3 && view.materials()[2].alpha == 0.25f, "changed alpha", 0);
+		view.close();
+
+		remove(MtlFile);
+		check(MeshCook::cook(ObjFile, CacheFile) == MeshCook::Result::SourceNotFound, "missing MTL", 0);
+		check(writeText(ObjFile, "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n"), "write a bad OBJ", 0);
+		check(MeshCook::cook(ObjFile, CacheFile) == MeshCook::Result::BadSource, "face index out of range", 0);
+		check(writeText(ObjFile, "v 0 0 0\nv 1 0 0\nf 1 2\n"), "write a bad OBJ", 0);
+		check(MeshCook::cook(ObjFile, CacheFile) == MeshCook::Result::BadSource, "face of two corners", 0);
+		remove(ObjFile);
+		check(MeshCook::cook(ObjFile, CacheFile) == MeshCook::Result::SourceNotFound, "missing OBJ", 0);
+	}
+
+	// Opens a damaged copy of the cache with and without the checksum
+	void damaged(const vector<char>& good, void (*damage)(vector<char>&, MeshCache::Header&), bool rejectUnchecked, const char* what)
+	{
+		vector<char> bytes = good;
+		MeshCache::Header h;
+		memcpy(&h, bytes.data(), sizeof(h));
+		damage(bytes, h);
+		if (bytes.size() >= sizeof(h))
+			memcpy(bytes.data(), &h, sizeof(h));
+		check(writeFile(DamagedFile, bytes.data(), bytes.size()), "write the damaged cache", 0);
+
+		MeshCache::View view;
+		char message[128];
+		snprintf(message, sizeof(message), "%s rejected", what);
+		check(!view.open(DamagedFile), message, 0);
+		snprintf(message, sizeof(message), "%s rejected without the checksum", what);
+		check(view.open(DamagedFile, false) != rejectUnchecked, message, 0);
+	}
+
+	void damages()
+	{
+		check(MeshCook::cook("../Mesh/teapot.obj", CacheFile) != MeshCook::Result::SourceNotFound, "cook teapot.obj", 0);
+		vector<char> good = readFile(CacheFile);
+		MeshCache::View view;
+		check(good.size() > sizeof(MeshCache::Header) && view.open(CacheFile), "the undamaged cache opens", 0);
+		if (good.size() <= sizeof(MeshCache::Header))
+			return;
+
+		// The checksum covers the header and the payload
+		damaged(good, [](vector<char>&, MeshCache::Header& h) { h.boundsCenter[1] += 1.0f; }, false, "changed bounds");
+		damaged(good, [](vector<char>&, MeshCache::Header& h) { h.settingsHash ^= 1; }, false, "changed settings hash");
+		damaged(good, [](vector<char>& b, MeshCache::Header&) { b[sizeof(MeshCache::Header) + 5] ^= 0x10; }, false, "changed vertex");
+		damaged(good, [](vector<char>& b, MeshCache::Header&) { b.back() ^= 1; }, false, "changed material");
+		// The payload-only checksum of earlier caches
+		damaged(good, [](vector<char>& b, MeshCache::Header& h)
+		{
+			h.checksum = MeshCache::crc32(b.data() + sizeof(h), b.size() - sizeof(h));
+		}, false, "payload-only checksum");
+
+		// Section offsets, checked with the checksum off too
+		damaged(good, [](vector<char>&, MeshCache::Header& h) { h.vertexOffset = 0; }, true, "vertices over the header");
+		damaged(good, [](vector<char>&, MeshCache::Header& h) { h.vertexOffset = h.indexOffset + 1; }, true, "vertices past the indices");
+		damaged(good, [](vector<char>&, MeshCache::Header& h)
+		{
+			// indexOffset + index bytes wraps to 0; the vertices still end before indexOffset
+			h.indexOffset = 0 - static_cast<uint64_t>(h.indexSize) * h.indexCount;
+		}, true, "index offset wrapping around");
+		damaged(good, [](vector<char>&, MeshCache::Header& h)
+		{
+			h.materialOffset = 0 - sizeof(MeshCache::Material) * static_cast<uint64_t>(h.materialCount);
+		}, true, "material offset wrapping around");
+		damaged(good, [](vector<char>&, MeshCache::Header& h) { h.vertexCount += 0x10000; }, true, "vertex count past the section");
+		damaged(good, [](vector<char>& b, MeshCache::Header& h) { b.pop_back(); h.fileSize--; }, true, "truncated materials");
+		damaged(good, [](vector<char>& b, MeshCache::Header&) { b.resize(sizeof(MeshCache::Header) - 1); }, true, "truncated header");
+		remove(DamagedFile);
+	}
+};
+
+int main()
+{
+	cookTeapot();
+	cookSmall();
+	damages();
+	remove(CacheFile);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
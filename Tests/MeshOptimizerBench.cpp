@@ -0,0 +1,265 @@
+// Benchmarks MeshOptimizer: runs optimizeVertexCache, optimizeOverdraw and
+// optimizeVertexFetch on the bundled teapots, the teapot with unshared vertices
+// as flat shading writes it, and a grid of millions of triangles in random
+// order. Prints the ACMR and ATVR of a 16 and a 32 entry FIFO cache before and
+// after every stage, with its time, then the time of optimizeOverdraw on
+// unshared meshes of growing size, where every triangle is a cluster.
+// Checks every stage keeps the triangles, optimizeMesh keeps the material of
+// each, the vertex cache order lowers the ACMR of a shuffled mesh, the vertex
+// fetch order numbers vertices by first use, and optimizeOverdraw stays linear.
+// Portable; on Linux: g++ -std=c++14 -O2 MeshOptimizerBench.cpp -o MeshOptimizerBench
+// Usage: MeshOptimizerBench [grid triangles]
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../_common/MappedFile.h"
+#include "../Mesh/MeshOptimizer.h"
+#include "../Mesh/ObjParser.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// A leading float3 position as optimizeMesh() expects, and the vertex it was loaded as
+	struct Vertex
+	{
+		float position[3];
+		uint32_t id;
+	};
+
+	struct Mesh
+	{
+		vector<Vertex> vertices;
+		vector<uint32_t> indices;
+		vector<uint32_t> attributes;
+	};
+
+	// Positions and triangulated faces of an OBJ, one vertex per position
+	struct Sink
+	{
+		Mesh& mesh;
+		uint32_t attribute;
+
+		bool position(float x, float y, float z)
+		{
+			mesh.vertices.push_back({ { x, y, z }, (uint32_t)mesh.vertices.size() });
+			return true;
+		}
+		bool texcoord(float, float)
+		{
+			return true;
+		}
+		bool normal(float, float, float)
+		{
+			return true;
+		}
+		bool face(const ObjParser::FaceVertex* verts, size_t count)
+		{
+			for (size_t j = 2; j < count; j++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { verts[0].position - 1, verts[j - 1].position - 1, verts[j].position - 1 });
+				mesh.attributes.push_back(attribute);
+			}
+			return true;
+		}
+		bool useMaterial(const char*, size_t)
+		{
+			attribute++;
+			return true;
+		}
+		bool materialLibrary(const char*, size_t)
+		{
+			return true;
+		}
+	};
+
+	bool load(const char* fileName, Mesh& mesh)
+	{
+		MappedFile file;
+		Sink sink{ mesh, 0 };
+		return file.open(fileName) && ObjParser::parse(file.data(), file.end(), sink) == ObjParser::Result::Ok;
+	}
+
+	// Every corner its own vertex, as meshes with per-face normals are
+	Mesh unshared(const Mesh& mesh)
+	{
+		Mesh result;
+		result.attributes = mesh.attributes;
+		for (uint32_t index : mesh.indices)
+		{
+			Vertex v = mesh.vertices[index];
+			v.id = (uint32_t)result.vertices.size();
+			result.indices.push_back(v.id);
+			result.vertices.push_back(v);
+		}
+		return result;
+	}
+
+	// A width x height grid of quads in random triangle order, in three materials by row
+	Mesh grid(size_t triangleCount, unsigned seed)
+	{
+		const uint32_t width = 1024;
+		uint32_t height = (uint32_t)(triangleCount / (2 * width)) + 1;
+		Mesh mesh;
+		for (uint32_t y = 0; y <= height; y++)
+		{
+			for (uint32_t x = 0; x <= width; x++)
+				mesh.vertices.push_back({ { x * 0.01f, y * 0.01f, ((x * 7 + y * 13) % 17) * 0.001f }, (uint32_t)mesh.vertices.size() });
+		}
+		vector<array<uint32_t, 4>> triangles;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint32_t a = y * (width + 1) + x, b = a + 1, c = a + width + 1, d = c + 1;
+				uint32_t attribute = y * 3 / height;
+				triangles.push_back({ { a, c, b, attribute } });
+				triangles.push_back({ { b, c, d, attribute } });
+			}
+		}
+		shuffle(triangles.begin(), triangles.end(), mt19937(seed));
+		for (auto& t : triangles)
+		{
+			mesh.indices.insert(mesh.indices.end(), { t[0], t[1], t[2] });
+			mesh.attributes.push_back(t[3]);
+		}
+		return mesh;
+	}
+
+	// The loaded ids and material of every triangle, each rotated to start at its smallest id
+	vector<array<uint32_t, 4>> triangles(const Mesh& mesh)
+	{
+		vector<array<uint32_t, 4>> result;
+		for (size_t i = 0; i < mesh.indices.size(); i += 3)
+		{
+			uint32_t id[3] = { mesh.vertices[mesh.indices[i]].id, mesh.vertices[mesh.indices[i + 1]].id, mesh.vertices[mesh.indices[i + 2]].id };
+			int k = id[1] < id[0] ? (id[2] < id[1] ? 2 : 1) : (id[2] < id[0] ? 2 : 0);
+			result.push_back({ { id[k], id[(k + 1) % 3], id[(k + 2) % 3], mesh.attributes[i / 3] } });
+		}
+		sort(result.begin(), result.end());
+		return result;
+	}
+
+	void print(const char* stage, const Mesh& mesh, double ms)
+	{
+		auto cache16 = MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), 16);
+		auto cache32 = MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), 32);
+		printf("    %-14s %7.3f %7.3f %7.3f %7.3f %10.2f\n", stage, cache16.acmr, cache16.atvr, cache32.acmr, cache32.atvr, ms);
+	}
+
+	template<class F>
+	double time(F f)
+	{
+		auto start = chrono::steady_clock::now();
+		f();
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+
+	// The stages one at a time on the whole index buffer, materials ignored
+	void bench(const char* name, const Mesh& input)
+	{
+		printf("  %s: %zu triangles, %zu vertices\n", name, input.indices.size() / 3, input.vertices.size());
+		Mesh mesh = input;
+		mesh.attributes.assign(mesh.indices.size() / 3, 0);
+		auto expected = triangles(mesh);
+		print("input", mesh, 0);
+
+		float inputAcmr = MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()).acmr;
+		double ms = time([&] { MeshOptimizer::optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()); });
+		check(triangles(mesh) == expected, "optimizeVertexCache keeps the triangles", 0);
+		float acmr = MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()).acmr;
+		check(acmr <= inputAcmr, "optimizeVertexCache does not raise the ACMR", 0);
+		print("vertex cache", mesh, ms);
+
+		ms = time([&] { MeshOptimizer::optimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), sizeof(Vertex), mesh.vertices.size()); });
+		check(triangles(mesh) == expected, "optimizeOverdraw keeps the triangles", 0);
+		print("overdraw", mesh, ms);
+
+		size_t vertexCount = 0;
+		ms = time([&] { vertexCount = MeshOptimizer::optimizeVertexFetch(mesh.vertices.data(), sizeof(Vertex), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size()); });
+		bool firstUse = true;
+		uint32_t next = 0;
+		for (uint32_t index : mesh.indices)
+		{
+			firstUse &= index <= next;
+			next = (max)(next, index + 1);
+		}
+		check(firstUse && next == vertexCount, "optimizeVertexFetch numbers vertices by first use", 0);
+		mesh.vertices.resize(vertexCount);
+		check(triangles(mesh) == expected, "optimizeVertexFetch keeps the triangles", 0);
+		print("vertex fetch", mesh, ms);
+
+		// The whole stage, material by material
+		mesh = input;
+		expected = triangles(mesh);
+		ms = time([&] { MeshOptimizer::optimizeMesh(mesh, true); });
+		check(triangles(mesh) == expected, "optimizeMesh keeps the triangles and their materials", 0);
+		print("optimizeMesh", mesh, ms);
+	}
+
+	// optimizeOverdraw alone on unshared grids, best of three runs
+	double overdrawNsPerTriangle(size_t triangleCount)
+	{
+		Mesh mesh = unshared(grid(triangleCount, 1));
+		MeshOptimizer::optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+		double best = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			Mesh copy = mesh;
+			best = (min)(best, time([&] { MeshOptimizer::optimizeOverdraw(copy.indices.data(), copy.indices.size(), copy.vertices.data(), sizeof(Vertex), copy.vertices.size()); }));
+		}
+		size_t triangles = mesh.indices.size() / 3;
+		printf("    %10zu %10.2f %10.1f\n", triangles, best, best * 1e6 / triangles);
+		return best * 1e6 / triangles;
+	}
+};
+
+int main(int argc, char** argv)
+{
+	size_t gridTriangles = argc > 1 ? atoi(argv[1]) : 2000000;
+	if (gridTriangles < 2048)
+	{
+		printf("Usage: MeshOptimizerBench [grid triangles]\n");
+		return 1;
+	}
+
+	printf("    %-14s %7s %7s %7s %7s %10s\n", "stage", "ACMR16", "ATVR16", "ACMR32", "ATVR32", "ms");
+	const char* files[] = { "../Mesh/teapot.obj", "../MeshTex/teapot_tex2.obj" };
+	for (auto fileName : files)
+	{
+		Mesh mesh;
+		check(load(fileName, mesh), fileName, 0);
+		bench(fileName, mesh);
+	}
+	Mesh teapot;
+	load(files[0], teapot);
+	bench("teapot.obj, unshared vertices", unshared(teapot));
+	bench("shuffled grid", grid(gridTriangles, 0));
+
+	printf("  optimizeOverdraw, unshared vertices\n");
+	printf("    %10s %10s %10s\n", "triangles", "ms", "ns/tri");
+	double small = overdrawNsPerTriangle(10000);
+	overdrawNsPerTriangle(40000);
+	double large = overdrawNsPerTriangle(160000);
+	check(large < small * 4, "optimizeOverdraw time linear in the triangles", 0);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
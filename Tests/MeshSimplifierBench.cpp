@@ -0,0 +1,516 @@
+// Benchmarks MeshSimplifier: simplifies the bundled teapots and a sphere with
+// millions of triangles to a range of targets, printing the triangles/s and the
+// triangle reduction against the reported error and the measured distance of
+// the result to the original surface, then times generateLods().
+// Checks the levels share the vertex buffer with contiguous index ranges and
+// decreasing triangle counts, lower targets never keep more triangles, material
+// boundaries keep every edge, UV seams and hard edges only collapse along
+// themselves with each triangle keeping the vertices of its side, the
+// attributes follow their triangles, and closed meshes stay closed.
+// Portable; on Linux: g++ -std=c++14 -O2 MeshSimplifierBench.cpp -o MeshSimplifierBench
+// Usage: MeshSimplifierBench [sphere triangles] [file.obj ...]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "../_common/MappedFile.h"
+#include "../Mesh/MeshSimplifier.h"
+#include "../Mesh/ObjParser.h"
+#include "../Mesh/VertexDedupTable.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// WaveFrontReader::Vertex without DirectXMath
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float textureCoordinate[2];
+	};
+
+	// WaveFrontReader output: deduplicated vertices, indices and one attribute per triangle
+	struct Mesh
+	{
+		vector<Vertex> vertices;
+		vector<uint32_t> indices;
+		vector<uint32_t> attributes;
+		function<double(const double*)> distance;   // to the original surface
+		float maxUSpan = 0;                         // of any triangle when checked
+	};
+
+	struct Sink
+	{
+		Mesh& mesh;
+		vector<float> positions, texcoords, normals;
+		VertexDedupTable<Vertex> table;
+		uint32_t attribute;
+
+		bool position(float x, float y, float z)
+		{
+			positions.insert(positions.end(), { x, y, z });
+			return true;
+		}
+		bool texcoord(float u, float v)
+		{
+			texcoords.insert(texcoords.end(), { u, v });
+			return true;
+		}
+		bool normal(float x, float y, float z)
+		{
+			normals.insert(normals.end(), { x, y, z });
+			return true;
+		}
+		uint32_t add(const ObjParser::FaceVertex& c)
+		{
+			Vertex v;
+			memset(&v, 0, sizeof(v));
+			memcpy(v.position, &positions[(c.position - 1) * 3], sizeof(v.position));
+			if (c.texcoord)
+				memcpy(v.textureCoordinate, &texcoords[(c.texcoord - 1) * 2], sizeof(v.textureCoordinate));
+			if (c.normal)
+				memcpy(v.normal, &normals[(c.normal - 1) * 3], sizeof(v.normal));
+			return table.findOrAdd(c.position, c.texcoord, c.normal, v, mesh.vertices);
+		}
+		bool face(const ObjParser::FaceVertex* verts, size_t count)
+		{
+			for (size_t j = 2; j < count; j++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { add(verts[0]), add(verts[j - 1]), add(verts[j]) });
+				mesh.attributes.push_back(attribute);
+			}
+			return true;
+		}
+		bool useMaterial(const char*, size_t)
+		{
+			attribute++;
+			return true;
+		}
+		bool materialLibrary(const char*, size_t)
+		{
+			return true;
+		}
+	};
+
+	double dot(const double* a, const double* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Distance from p to the triangle (a, b, c), by the closest point regions
+	double pointTriangleDistance(const double* p, const float* fa, const float* fb, const float* fc)
+	{
+		double a[3] = { fa[0], fa[1], fa[2] }, b[3] = { fb[0], fb[1], fb[2] }, c[3] = { fc[0], fc[1], fc[2] };
+		double ab[3], ac[3], ap[3], bp[3], cp[3];
+		for (int k = 0; k < 3; k++)
+		{
+			ab[k] = b[k] - a[k];
+			ac[k] = c[k] - a[k];
+			ap[k] = p[k] - a[k];
+			bp[k] = p[k] - b[k];
+			cp[k] = p[k] - c[k];
+		}
+		double d1 = dot(ab, ap), d2 = dot(ac, ap), d3 = dot(ab, bp), d4 = dot(ac, bp), d5 = dot(ab, cp), d6 = dot(ac, cp);
+		double va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+		double closest[3];
+		for (int k = 0; k < 3; k++)
+		{
+			if (d1 <= 0 && d2 <= 0)
+				closest[k] = a[k];
+			else if (d3 >= 0 && d4 <= d3)
+				closest[k] = b[k];
+			else if (d6 >= 0 && d5 <= d6)
+				closest[k] = c[k];
+			else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+				closest[k] = a[k] + ab[k] * (d1 / (d1 - d3));
+			else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+				closest[k] = a[k] + ac[k] * (d2 / (d2 - d6));
+			else if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+				closest[k] = b[k] + (c[k] - b[k]) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+			else
+				closest[k] = a[k] + ab[k] * (vb / (va + vb + vc)) + ac[k] * (vc / (va + vb + vc));
+		}
+		double d[3] = { p[0] - closest[0], p[1] - closest[1], p[2] - closest[2] };
+		return sqrt(dot(d, d));
+	}
+
+	bool load(const char* fileName, Mesh& mesh)
+	{
+		MappedFile file;
+		Sink sink{ mesh, {}, {}, {}, {}, 0 };
+		if (!file.open(fileName) || ObjParser::parse(file.data(), file.end(), sink) != ObjParser::Result::Ok)
+			return false;
+		// Small enough to measure against every original triangle
+		Mesh original = mesh;
+		mesh.distance = [original](const double* p)
+		{
+			double best = 1e30;
+			for (size_t i = 0; i < original.indices.size(); i += 3)
+			{
+				best = (min)(best, pointTriangleDistance(p, original.vertices[original.indices[i]].position,
+					original.vertices[original.indices[i + 1]].position, original.vertices[original.indices[i + 2]].position));
+			}
+			return best;
+		};
+		return true;
+	}
+
+	// A unit sphere of rings x segments quads, with a UV seam at segment 0, a hard
+	// edge along the equator and three materials by latitude
+	Mesh sphere(size_t triangleCount)
+	{
+		uint32_t segments = (max)(8u, (uint32_t)sqrt(triangleCount / 4.0) * 2);
+		uint32_t rings = (max)(4u, (uint32_t)(triangleCount / (2 * segments)));
+		Mesh mesh;
+		for (uint32_t r = 0; r <= rings; r++)
+		{
+			float theta = 3.14159265f * r / rings;
+			for (uint32_t s = 0; s <= segments; s++)
+			{
+				float phi = 2 * 3.14159265f * s / segments;
+				Vertex v = { { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) }, {}, { (float)s / segments, (float)r / rings } };
+				if (s == segments)
+					memcpy(v.position, mesh.vertices[r * (segments + 1)].position, sizeof(v.position));
+				if (r == 0 || r == rings)
+				{
+					v.position[0] = v.position[2] = 0;
+					v.position[1] = r ? -1.0f : 1.0f;
+				}
+				memcpy(v.normal, v.position, sizeof(v.normal));
+				mesh.vertices.push_back(v);
+			}
+		}
+		// A hard edge along the equator: the southern side has vertices of its own,
+		// which make four at the point where it crosses the UV seam
+		uint32_t equator = rings / 2, south = (uint32_t)mesh.vertices.size();
+		for (uint32_t s = 0; s <= segments; s++)
+		{
+			Vertex v = mesh.vertices[equator * (segments + 1) + s];
+			v.normal[1] = -0.5f;
+			mesh.vertices.push_back(v);
+		}
+		// One vertex per pole, so that the seam ends there
+		auto vertex = [&](uint32_t r, uint32_t s, uint32_t row)
+		{
+			if (r == equator && row == equator)
+				return south + s;
+			return r == 0 ? 0 : r == rings ? rings * (segments + 1) : r * (segments + 1) + s;
+		};
+		for (uint32_t r = 0; r < rings; r++)
+		{
+			for (uint32_t s = 0; s < segments; s++)
+			{
+				uint32_t a = vertex(r, s, r), b = vertex(r, s + 1, r), c = vertex(r + 1, s, r), d = vertex(r + 1, s + 1, r);
+				uint32_t attribute = r * 3 / rings;
+				if (r > 0)
+				{
+					mesh.indices.insert(mesh.indices.end(), { a, b, c });
+					mesh.attributes.push_back(attribute);
+				}
+				if (r + 1 < rings)
+				{
+					mesh.indices.insert(mesh.indices.end(), { b, d, c });
+					mesh.attributes.push_back(attribute);
+				}
+			}
+		}
+		mesh.distance = [](const double* p) { return fabs(sqrt(dot(p, p)) - 1); };
+		mesh.maxUSpan = 0.5f;
+		return mesh;
+	}
+
+	// Largest distance to the original surface of the centroid and edge midpoints of each triangle
+	double measure(const Mesh& mesh, const uint32_t* indices, size_t indexCount)
+	{
+		double worst = 0;
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			const float* p[3];
+			for (int k = 0; k < 3; k++)
+				p[k] = mesh.vertices[indices[i + k]].position;
+			double samples[4][3];
+			for (int k = 0; k < 3; k++)
+			{
+				samples[0][k] = ((double)p[0][k] + p[1][k] + p[2][k]) / 3;
+				samples[1][k] = ((double)p[0][k] + p[1][k]) / 2;
+				samples[2][k] = ((double)p[1][k] + p[2][k]) / 2;
+				samples[3][k] = ((double)p[2][k] + p[0][k]) / 2;
+			}
+			for (auto& s : samples)
+				worst = (max)(worst, mesh.distance(s));
+		}
+		return worst;
+	}
+
+	// Position ids, so that seam vertices at one position compare equal
+	vector<uint32_t> positionIds(const Mesh& mesh)
+	{
+		vector<uint32_t> ids(mesh.vertices.size());
+		unordered_map<uint64_t, uint32_t> first;
+		for (uint32_t v = 0; v < ids.size(); v++)
+		{
+			uint64_t key;
+			const float* p = mesh.vertices[v].position;
+			uint32_t bits[3];
+			memcpy(bits, p, sizeof(bits));
+			key = ((uint64_t)bits[0] * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)bits[1] * 0xC2B2AE3D27D4EB4Full) ^ bits[2];
+			auto it = first.find(key);
+			// A hash collision of different positions only makes fewer seams, which the checks report
+			ids[v] = it != first.end() && memcmp(mesh.vertices[it->second].position, p, sizeof(bits)) == 0 ? it->second : v;
+			if (it == first.end())
+				first[key] = v;
+		}
+		return ids;
+	}
+
+	struct HalfEdge
+	{
+		uint32_t from, to, attribute;
+	};
+
+	// Undirected edges by position, each with the half-edges of its triangles
+	unordered_map<uint64_t, vector<HalfEdge>> edges(const vector<uint32_t>& ids, const uint32_t* indices, size_t indexCount, const uint32_t* attributes)
+	{
+		unordered_map<uint64_t, vector<HalfEdge>> result;
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+				uint32_t pa = ids[a], pb = ids[b];
+				uint64_t key = pa < pb ? (uint64_t)pa << 32 | pb : (uint64_t)pb << 32 | pa;
+				result[key].push_back({ a, b, attributes[i / 3] });
+			}
+		}
+		return result;
+	}
+
+	// Edges between two materials, by position with the attributes of their sides,
+	// and the positions on UV/normal seams, edges with other vertices at both ends
+	struct Outline
+	{
+		vector<pair<uint64_t, pair<uint32_t, uint32_t>>> materials;
+		vector<uint32_t> seams;
+	};
+
+	Outline outline(const unordered_map<uint64_t, vector<HalfEdge>>& edges, const vector<uint32_t>& ids)
+	{
+		Outline result;
+		for (auto& e : edges)
+		{
+			if (e.second.size() != 2)
+				continue;   // open border or non-manifold
+			auto& h0 = e.second[0];
+			auto& h1 = e.second[1];
+			if (h0.attribute != h1.attribute)
+				result.materials.push_back({ e.first, { (min)(h0.attribute, h1.attribute), (max)(h0.attribute, h1.attribute) } });
+			else if (h0.from != h1.to && h0.to != h1.from)
+				result.seams.insert(result.seams.end(), { ids[h0.from], ids[h0.to] });
+		}
+		sort(result.materials.begin(), result.materials.end());
+		sort(result.seams.begin(), result.seams.end());
+		result.seams.erase(unique(result.seams.begin(), result.seams.end()), result.seams.end());
+		return result;
+	}
+
+	// Material boundaries keep every edge, seams only collapse along themselves
+	bool keepsOutline(const Outline& simplified, const Outline& original)
+	{
+		return simplified.materials == original.materials &&
+			includes(original.seams.begin(), original.seams.end(), simplified.seams.begin(), simplified.seams.end());
+	}
+
+	// No triangle takes a vertex from the other side of a UV seam, which would
+	// stretch it across the texture. Poles, on the axis, have one u for all sides.
+	bool keepsSeamSides(const Mesh& mesh, const uint32_t* indices, size_t indexCount)
+	{
+		for (size_t i = 0; mesh.maxUSpan > 0 && i < indexCount; i += 3)
+		{
+			float low = 1e30f, high = -1e30f;
+			for (int k = 0; k < 3; k++)
+			{
+				auto& v = mesh.vertices[indices[i + k]];
+				if (v.position[0] == 0 && v.position[2] == 0)
+					continue;
+				low = (min)(low, v.textureCoordinate[0]);
+				high = (max)(high, v.textureCoordinate[0]);
+			}
+			if (high - low > mesh.maxUSpan)
+				return false;
+		}
+		return true;
+	}
+
+	struct Row
+	{
+		size_t triangles;
+		float error;
+		double measured;
+		double seconds;
+	};
+
+	void print(const char* what, const Mesh& mesh, const Row& row)
+	{
+		size_t triangles = mesh.indices.size() / 3;
+		printf("  %-12s %10zu %7.1f%% %12.3g %12.3g %10.1f %9.2f\n", what, row.triangles, 100.0 * row.triangles / triangles,
+			row.error, row.measured, row.seconds * 1e3, triangles / row.seconds / 1e6);
+	}
+
+	bool closed(const unordered_map<uint64_t, vector<HalfEdge>>& edges)
+	{
+		for (auto& e : edges)
+		{
+			if (e.second.size() != 2)
+				return false;
+		}
+		return true;
+	}
+
+	// Simplifies to a few fractions of the triangles, best of three runs each
+	void reduction(const Mesh& mesh, const vector<uint32_t>& ids)
+	{
+		auto input = edges(ids, mesh.indices.data(), mesh.indices.size(), mesh.attributes.data());
+		auto original = outline(input, ids);
+		const float targets[] = { 0.5f, 0.25f, 0.1f, 0.05f, 0.01f };
+		size_t previous = mesh.indices.size() / 3;
+		for (float target : targets)
+		{
+			Row row = {};
+			vector<uint32_t> indices, attributes;
+			for (int run = 0; run < 3; run++)
+			{
+				indices = mesh.indices;
+				attributes = mesh.attributes;
+				auto start = chrono::steady_clock::now();
+				size_t count = MeshSimplifier::simplify(indices.data(), indices.size(), attributes.data(),
+					&mesh.vertices[0].position, sizeof(Vertex), mesh.vertices.size(), (size_t)(mesh.indices.size() / 3 * target) * 3, FLT_MAX, &row.error);
+				double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+				indices.resize(count);
+				attributes.resize(count / 3);
+				if (run == 0 || seconds < row.seconds)
+					row.seconds = seconds;
+			}
+			row.triangles = indices.size() / 3;
+			row.measured = indices.size() < mesh.indices.size() ? measure(mesh, indices.data(), indices.size()) : 0;
+			char what[16];
+			snprintf(what, sizeof(what), "%g%%", target * 100);
+			print(what, mesh, row);
+
+			auto simplified = edges(ids, indices.data(), indices.size(), attributes.data());
+			check(keepsOutline(outline(simplified, ids), original), "material boundaries keep every edge, seams their line", (unsigned)(target * 100));
+			check(keepsSeamSides(mesh, indices.data(), indices.size()), "triangles keep the vertices of their side of a seam", (unsigned)(target * 100));
+			check(closed(simplified) || !closed(input), "a closed mesh stays closed", (unsigned)(target * 100));
+			check(row.triangles <= previous, "a lower target never keeps more triangles", (unsigned)(target * 100));
+			previous = row.triangles;
+		}
+	}
+
+	// One generateLods() chain of halving levels: one shared vertex buffer, contiguous ranges
+	void lods(const Mesh& mesh, const vector<uint32_t>& ids, size_t levelCount)
+	{
+		vector<MeshSimplifier::Lod> result;
+		vector<uint32_t> indices, attributes;
+		double best = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			auto start = chrono::steady_clock::now();
+			result = MeshSimplifier::generateLods(mesh.indices.data(), mesh.indices.size(), mesh.attributes.data(),
+				&mesh.vertices[0].position, sizeof(Vertex), mesh.vertices.size(), levelCount, 0.5f, indices, &attributes);
+			best = (min)(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+		}
+		size_t triangles = mesh.indices.size() / 3;
+		printf("  generateLods: %zu levels in %.1f ms, %.2f Mtris/s of level 0\n", result.size(), best * 1e3, triangles / best / 1e6);
+
+		bool ranges = !result.empty() && result[0].indexStart == 0 && result[0].indexCount == mesh.indices.size();
+		bool decreasing = true, inBuffer = true;
+		for (size_t i = 1; i < result.size(); i++)
+		{
+			ranges &= result[i].indexStart == result[i - 1].indexStart + result[i - 1].indexCount && result[i].indexCount % 3 == 0;
+			decreasing &= result[i].indexCount < result[i - 1].indexCount && result[i].error >= result[i - 1].error;
+		}
+		ranges &= result.back().indexStart + result.back().indexCount == indices.size();
+		for (auto i : indices)
+			inBuffer &= i < mesh.vertices.size();
+		check(ranges && attributes.size() == indices.size() / 3, "levels are contiguous ranges of one index buffer", 0);
+		check(decreasing, "triangles decrease and the error grows by level", 0);
+		check(inBuffer, "levels index the shared vertex buffer", 0);
+		check(equal(mesh.indices.begin(), mesh.indices.end(), indices.begin()) &&
+			equal(mesh.attributes.begin(), mesh.attributes.end(), attributes.begin()), "level 0 is the input", 0);
+
+		auto original = outline(edges(ids, mesh.indices.data(), mesh.indices.size(), mesh.attributes.data()), ids);
+		for (size_t i = 1; i < result.size(); i++)
+		{
+			auto level = edges(ids, &indices[result[i].indexStart], result[i].indexCount, &attributes[result[i].indexStart / 3]);
+			check(keepsOutline(outline(level, ids), original), "every level keeps the material boundaries and seam lines", (unsigned)i);
+			check(keepsSeamSides(mesh, &indices[result[i].indexStart], result[i].indexCount), "every level keeps the seam sides", (unsigned)i);
+		}
+
+		// Nearer objects, more pixels per unit, never pick a coarser level
+		size_t previous = result.size();
+		bool monotonic = true;
+		for (float scale = 0.01f; scale < 1e7f; scale *= 2)
+		{
+			size_t lod = MeshSimplifier::selectLod(result.data(), result.size(), scale);
+			monotonic &= lod <= previous && (lod == 0 || result[lod].error * scale <= 1.0f);
+			previous = lod;
+		}
+		check(monotonic && previous == 0, "selectLod refines as the projected scale grows", 0);
+	}
+
+	void bench(const char* name, const Mesh& mesh)
+	{
+		auto ids = positionIds(mesh);
+		printf("%s: %zu triangles, %zu vertices\n", name, mesh.indices.size() / 3, mesh.vertices.size());
+		printf("  %-12s %10s %8s %12s %12s %10s %9s\n", "target", "triangles", "kept", "error", "measured", "ms", "Mtris/s");
+		reduction(mesh, ids);
+		lods(mesh, ids, 6);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	size_t sphereTriangles = argc > 1 ? atoi(argv[1]) : 1000000;
+
+	const char* files[] = { "../Mesh/teapot.obj", "../MeshTex/teapot_tex2.obj" };
+	for (auto fileName : files)
+	{
+		Mesh mesh;
+		check(load(fileName, mesh), fileName, 0);
+		bench(fileName, mesh);
+	}
+	for (int i = 2; i < argc; i++)
+	{
+		Mesh mesh;
+		check(load(argv[i], mesh), argv[i], 0);
+		bench(argv[i], mesh);
+	}
+	if (sphereTriangles)
+	{
+		Mesh mesh = sphere(sphereTriangles);
+		char name[64];
+		snprintf(name, sizeof(name), "sphere, 3 materials, hard equator");
+		bench(name, mesh);
+	}
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
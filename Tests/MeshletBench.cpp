@@ -0,0 +1,374 @@
+// Benchmarks MeshletBuilder: builds meshlets for the bundled teapot and a
+// sphere with millions of triangles, then culls a grid of sphere instances,
+// millions of meshlets, against a few cameras. Prints the build speed, meshlet
+// sizes, and the cull time per meshlet with how many are frustum culled, cone
+// (backface) culled and visible.
+// Checks the meshlets are contiguous index ranges within the size limits and of
+// one material, hold every triangle once, and that no meshlet cull() drops has
+// a triangle inside the frustum that faces the camera.
+// Portable; on Linux: g++ -std=c++14 -O2 MeshletBench.cpp -o MeshletBench
+// Usage: MeshletBench [sphere triangles] [instances]
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../_common/MappedFile.h"
+#include "../Mesh/MeshletBuilder.h"
+#include "../Mesh/ObjParser.h"
+
+using namespace std;
+using namespace MeshletBuilder;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 operator-(const Float3& a, const Float3& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	float dot(const Float3& a, const Float3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// As computeBounds(): the outward normal of a clockwise front face
+	Float3 cross(const Float3& a, const Float3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	Float3 normalize(const Float3& a)
+	{
+		float length = sqrtf(dot(a, a));
+		return { a.x / length, a.y / length, a.z / length };
+	}
+
+	struct Mesh
+	{
+		vector<Float3> positions;
+		vector<uint32_t> indices;
+		vector<uint32_t> attributes;
+	};
+
+	// Positions and triangulated faces of an OBJ, one vertex per position
+	struct Sink
+	{
+		Mesh& mesh;
+		uint32_t attribute;
+
+		bool position(float x, float y, float z)
+		{
+			mesh.positions.push_back({ x, y, z });
+			return true;
+		}
+		bool texcoord(float, float)
+		{
+			return true;
+		}
+		bool normal(float, float, float)
+		{
+			return true;
+		}
+		bool face(const ObjParser::FaceVertex* verts, size_t count)
+		{
+			for (size_t j = 2; j < count; j++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { verts[0].position - 1, verts[j - 1].position - 1, verts[j].position - 1 });
+				mesh.attributes.push_back(attribute);
+			}
+			return true;
+		}
+		bool useMaterial(const char*, size_t)
+		{
+			attribute++;
+			return true;
+		}
+		bool materialLibrary(const char*, size_t)
+		{
+			return true;
+		}
+	};
+
+	bool load(const char* fileName, Mesh& mesh)
+	{
+		MappedFile file;
+		Sink sink{ mesh, 0 };
+		return file.open(fileName) && ObjParser::parse(file.data(), file.end(), sink) == ObjParser::Result::Ok;
+	}
+
+	// A unit sphere of rings x segments quads, front faces outward, in three materials by latitude
+	Mesh sphere(size_t triangleCount)
+	{
+		uint32_t segments = max<uint32_t>(8, (uint32_t)sqrt(triangleCount / 4.0) * 2);
+		uint32_t rings = max<uint32_t>(4, (uint32_t)(triangleCount / (2 * segments)));
+		Mesh mesh;
+		for (uint32_t r = 0; r <= rings; r++)
+		{
+			float theta = 3.14159265f * r / rings;
+			for (uint32_t s = 0; s <= segments; s++)
+			{
+				float phi = 2 * 3.14159265f * s / segments;
+				mesh.positions.push_back({ sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) });
+			}
+		}
+		auto triangle = [&](uint32_t a, uint32_t b, uint32_t c, uint32_t attribute)
+		{
+			Float3 n = cross(mesh.positions[b] - mesh.positions[a], mesh.positions[c] - mesh.positions[a]);
+			if (dot(n, mesh.positions[a]) < 0)
+				swap(b, c);
+			mesh.indices.insert(mesh.indices.end(), { a, b, c });
+			mesh.attributes.push_back(attribute);
+		};
+		for (uint32_t r = 0; r < rings; r++)
+		{
+			for (uint32_t s = 0; s < segments; s++)
+			{
+				uint32_t a = r * (segments + 1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+				uint32_t attribute = r * 3 / rings;
+				if (r > 0)
+					triangle(a, c, b, attribute);
+				if (r + 1 < rings)
+					triangle(b, c, d, attribute);
+			}
+		}
+		return mesh;
+	}
+
+	// The index ranges are contiguous, within the limits, of one material, and hold every triangle once
+	void checkMeshlets(const Mesh& mesh, const vector<uint32_t>& indices, const vector<Meshlet>& meshlets, const char* name)
+	{
+		uint32_t next = 0;
+		bool ranges = true, limits = true, materials = true;
+		for (auto& m : meshlets)
+		{
+			ranges &= m.indexStart == next && m.indexCount > 0 && m.indexCount % 3 == 0;
+			next = m.indexStart + m.indexCount;
+			vector<uint32_t> vertices(indices.begin() + m.indexStart, indices.begin() + next);
+			sort(vertices.begin(), vertices.end());
+			auto unique = (uint32_t)(std::unique(vertices.begin(), vertices.end()) - vertices.begin());
+			limits &= m.vertexCount == unique && m.vertexCount <= DefaultMaxVertices && m.indexCount / 3 <= DefaultMaxTriangles;
+			for (uint32_t t = m.indexStart / 3; t < next / 3; t++)
+				materials &= mesh.attributes[t] == m.attribute;
+		}
+		check(ranges && next == indices.size(), "meshlets are contiguous index ranges", 0);
+		check(limits, "meshlets within the vertex and triangle limits", 0);
+		check(materials, "one material per meshlet, attributes still valid", 0);
+
+		// Same triangles, each rotated to start at its smallest index
+		auto triangles = [](const vector<uint32_t>& ib)
+		{
+			vector<array<uint32_t, 3>> t;
+			for (size_t i = 0; i < ib.size(); i += 3)
+			{
+				size_t k = ib[i + 1] < ib[i] ? (ib[i + 2] < ib[i + 1] ? 2 : 1) : (ib[i + 2] < ib[i] ? 2 : 0);
+				t.push_back({ { ib[i + k], ib[i + (k + 1) % 3], ib[i + (k + 2) % 3] } });
+			}
+			sort(t.begin(), t.end());
+			return t;
+		};
+		check(triangles(mesh.indices) == triangles(indices), name, 0);
+	}
+
+	struct Camera
+	{
+		const char* name;
+		Float3 eye;
+		Float3 at;
+		float planes[6][4];
+	};
+
+	// Row-vector LookAtLH * PerspectiveFovLH, as DirectXMath builds them
+	void setPlanes(Camera& camera, float fovY, float aspect, float nearZ, float farZ)
+	{
+		Float3 z = normalize(camera.at - camera.eye);
+		Float3 x = normalize(cross({ 0, 1, 0 }, z));
+		Float3 y = cross(z, x);
+		float view[16] = {
+			x.x, y.x, z.x, 0,
+			x.y, y.y, z.y, 0,
+			x.z, y.z, z.z, 0,
+			-dot(x, camera.eye), -dot(y, camera.eye), -dot(z, camera.eye), 1 };
+		float h = 1 / tanf(fovY / 2), range = farZ / (farZ - nearZ);
+		float proj[16] = {
+			h / aspect, 0, 0, 0,
+			0, h, 0, 0,
+			0, 0, range, 1,
+			0, 0, -range * nearZ, 0 };
+		float m[16] = {};
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				for (int k = 0; k < 4; k++)
+					m[i * 4 + j] += view[i * 4 + k] * proj[k * 4 + j];
+		extractFrustumPlanes(m, camera.planes);
+	}
+
+	bool outside(const float plane[4], const Float3& p, float tolerance)
+	{
+		return plane[0] * p.x + plane[1] * p.y + plane[2] * p.z + plane[3] < tolerance;
+	}
+
+	// A culled meshlet has every triangle outside one plane or facing away from the
+	// eye. Checked in the space of the instance, so the triangles are as built.
+	bool conservative(const Meshlet& m, const vector<Float3>& positions, const vector<uint32_t>& indices, const Camera& camera, const Float3& offset)
+	{
+		const float tolerance = 1e-4f;
+		Float3 eye = camera.eye - offset;
+		float planes[6][4];
+		for (int plane = 0; plane < 6; plane++)
+		{
+			auto& q = camera.planes[plane];
+			planes[plane][0] = q[0];
+			planes[plane][1] = q[1];
+			planes[plane][2] = q[2];
+			planes[plane][3] = q[3] + q[0] * offset.x + q[1] * offset.y + q[2] * offset.z;
+		}
+		for (uint32_t i = m.indexStart; i < m.indexStart + m.indexCount; i += 3)
+		{
+			const Float3& p0 = positions[indices[i]];
+			const Float3& p1 = positions[indices[i + 1]];
+			const Float3& p2 = positions[indices[i + 2]];
+			bool culled = false;
+			for (int plane = 0; plane < 6 && !culled; plane++)
+				culled = outside(planes[plane], p0, tolerance) && outside(planes[plane], p1, tolerance) && outside(planes[plane], p2, tolerance);
+			Float3 n = cross(p1 - p0, p2 - p0);
+			float length = sqrtf(dot(n, n));
+			culled = culled || length == 0 || dot(p0 - eye, n) / length >= -tolerance;
+			if (!culled)
+				return false;
+		}
+		return true;
+	}
+
+	vector<Meshlet> build(const Mesh& mesh, vector<uint32_t>& indices, const char* name, double& seconds)
+	{
+		indices = mesh.indices;
+		auto start = chrono::steady_clock::now();
+		auto meshlets = MeshletBuilder::build(indices.data(), indices.size(), mesh.attributes.data(),
+			mesh.positions.data(), sizeof(Float3), mesh.positions.size());
+		seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		checkMeshlets(mesh, indices, meshlets, name);
+
+		double vertices = 0;
+		for (auto& m : meshlets)
+			vertices += m.vertexCount;
+		size_t triangles = mesh.indices.size() / 3;
+		printf("  %-20s %10zu %9zu %8.1f %8.1f %10.2f\n", name, triangles, meshlets.size(), vertices / meshlets.size(),
+			(double)triangles / meshlets.size(), triangles / seconds / 1e6);
+		return meshlets;
+	}
+};
+
+int main(int argc, char** argv)
+{
+	size_t sphereTriangles = argc > 1 ? atoi(argv[1]) : 2000000;
+	uint32_t instanceCount = argc > 2 ? atoi(argv[2]) : 256;
+	if (sphereTriangles < 64 || instanceCount < 1)
+	{
+		printf("Usage: MeshletBench [sphere triangles] [instances]\n");
+		return 1;
+	}
+
+	printf("build: %zu vertices / %zu triangles at most per meshlet\n", DefaultMaxVertices, DefaultMaxTriangles);
+	printf("  %-20s %10s %9s %8s %8s %10s\n", "mesh", "triangles", "meshlets", "verts", "tris", "Mtris/s");
+	double seconds;
+	Mesh teapot;
+	check(load("../Mesh/teapot.obj", teapot), "load teapot.obj", 0);
+	vector<uint32_t> teapotIndices;
+	build(teapot, teapotIndices, "teapot.obj", seconds);
+	Mesh ball = sphere(sphereTriangles);
+	vector<uint32_t> indices;
+	auto meshlets = build(ball, indices, "sphere", seconds);
+
+	// Instances of the sphere 4 apart on a square grid at y = 0, meshlets moved to world space
+	uint32_t side = (uint32_t)ceil(sqrt((double)instanceCount));
+	vector<Meshlet> scene;
+	vector<Float3> offsets;
+	scene.reserve(meshlets.size() * instanceCount);
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		Float3 offset = { (float)(i % side) * 4, 0, (float)(i / side) * 4 };
+		offsets.push_back(offset);
+		for (auto m : meshlets)
+		{
+			m.center[0] += offset.x;
+			m.center[1] += offset.y;
+			m.center[2] += offset.z;
+			scene.push_back(m);
+		}
+	}
+
+	float extent = side * 4.0f;
+	Camera cameras[] = {
+		{ "corner, across", { -4, 2, -4 }, { extent / 2, 0, extent / 2 }, {} },
+		{ "center, down", { extent / 2, 3, extent / 2 - 2 }, { extent / 2, 0, extent / 2 }, {} },
+		{ "above, all", { extent / 2, extent * 2, extent / 2 - 1 }, { extent / 2, 0, extent / 2 }, {} },
+		{ "outside, away", { -4, 2, -4 }, { -40, 2, -40 }, {} },
+	};
+	printf("cull: %u instances, %zu meshlets\n", instanceCount, scene.size());
+	printf("  %-16s %9s %9s %9s %9s %9s\n", "camera", "ns/mlet", "Mmlets/s", "frustum", "cone", "visible");
+	vector<uint32_t> visible(scene.size());
+	for (auto& camera : cameras)
+	{
+		setPlanes(camera, 3.14159265f / 3, 16.0f / 9, 0.1f, 1000);
+		double best = 1e30;
+		size_t visibleCount = 0;
+		for (int run = 0; run < 3; run++)
+		{
+			auto start = chrono::steady_clock::now();
+			visibleCount = cull(scene.data(), scene.size(), camera.planes, &camera.eye.x, visible.data());
+			best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+		}
+
+		// Split the culled meshlets into frustum and cone culled, and check every 17th culled one
+		size_t frustumCulled = 0;
+		bool safe = true;
+		for (size_t i = 0, v = 0; i < scene.size(); i++)
+		{
+			if (v < visibleCount && visible[v] == i)
+			{
+				v++;
+				continue;
+			}
+			auto& m = scene[i];
+			for (int p = 0; p < 6; p++)
+			{
+				if (outside(camera.planes[p], { m.center[0], m.center[1], m.center[2] }, -m.radius))
+				{
+					frustumCulled++;
+					break;
+				}
+			}
+			size_t instance = i / meshlets.size();
+			if (i % 17 == 0)
+				safe &= conservative(meshlets[i % meshlets.size()], ball.positions, indices, camera, offsets[instance]);
+		}
+		check(safe, camera.name, 0);
+		double n = (double)scene.size();
+		printf("  %-16s %9.2f %9.1f %8.1f%% %8.1f%% %8.1f%%\n", camera.name, best / n, n / best * 1e3,
+			100 * frustumCulled / n, 100 * (n - visibleCount - frustumCulled) / n, 100 * visibleCount / n);
+	}
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
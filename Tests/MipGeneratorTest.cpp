@@ -0,0 +1,425 @@
+// Checks MipGenerator against reference results. Box levels of power-of-two
+// RGBA8 images have to be the exact average of the level 0 texels they cover,
+// however deep the chain; sRGB formats average in linear light; BGRA gives the
+// RGBA result swapped. Both filters keep constant images constant in every
+// format and size, odd ones included, reproduce a linear ramp away from the
+// edges, and give the same bytes on one thread and on many. The response of
+// both filters to sines below and above the new Nyquist frequency is printed;
+// Kaiser has to pass far less of the second and keep nearly as much of the
+// first. Level 0 is copied as is, the row padding of the footprints is left
+// alone, and bad arguments are rejected.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread MipGeneratorTest.cpp -o MipGeneratorTest
+// Usage: MipGeneratorTest
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../_common/MipGenerator.h"
+
+using namespace std;
+
+namespace
+{
+	const uint8_t Untouched = 0xCD;
+
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// A generated chain in an upload-buffer-like block, laid out by DDS::computeFootprints
+	struct Chain
+	{
+		uint32_t format;
+		vector<DDS::Footprint> footprints;
+		vector<uint8_t> data;
+		bool ok;
+
+		const uint8_t* texel(uint32_t mip, uint32_t x, uint32_t y) const
+		{
+			const DDS::Footprint& f = footprints[mip];
+			return &data[static_cast<size_t>(f.offset + static_cast<uint64_t>(y) * f.rowPitch + x * (DDS::bitsPerPixel(format) / 8))];
+		}
+
+		float value(uint32_t mip, uint32_t x, uint32_t y, int c) const
+		{
+			const uint8_t* p = texel(mip, x, y);
+			if (format == DDS::FormatR32Float)
+			{
+				float v;
+				memcpy(&v, p, sizeof(v));
+				return v;
+			}
+			if (format == DDS::FormatR16G16B16A16Float)
+			{
+				uint16_t h;
+				memcpy(&h, p + 2 * c, sizeof(h));
+				return Half::halfToFloat(h);
+			}
+			return p[c];
+		}
+	};
+
+	Chain generate(uint32_t format, const vector<uint8_t>& image, uint32_t width, uint32_t height, MipGenerator::Filter filter,
+		unsigned int threadCount = 0)
+	{
+		Chain chain;
+		chain.format = format;
+		DDS::TextureDesc desc;
+		desc.format = format;
+		desc.width = width;
+		desc.height = height;
+		desc.mipLevels = MipGenerator::fullMipCount(width, height);
+		uint64_t size = DDS::computeFootprints(desc, chain.footprints);
+		chain.data.assign(static_cast<size_t>(size), Untouched);
+		size_t pitch = static_cast<size_t>(width) * (DDS::bitsPerPixel(format) / 8);
+		chain.ok = MipGenerator::generate(format, image.data(), pitch, width, height, chain.data.data(), chain.footprints.data(),
+			desc.mipLevels, filter, threadCount);
+		return chain;
+	}
+
+	vector<uint8_t> randomImage(uint32_t width, uint32_t height, unsigned seed)
+	{
+		mt19937 rng(seed);
+		vector<uint8_t> image(static_cast<size_t>(width) * height * 4);
+		for (auto& v : image)
+			v = static_cast<uint8_t>(rng() & 0xFF);
+		return image;
+	}
+
+	vector<uint8_t> floatImage(uint32_t width, uint32_t height, float (*f)(uint32_t x, uint32_t y))
+	{
+		vector<uint8_t> image(static_cast<size_t>(width) * height * 4);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				float v = f(x, y);
+				memcpy(&image[(static_cast<size_t>(y) * width + x) * 4], &v, sizeof(v));
+			}
+		}
+		return image;
+	}
+
+	// Level 0 identical to the source, row padding and the gaps between levels untouched
+	void checkLayout(const Chain& chain, const vector<uint8_t>& image, const char* what, unsigned seed)
+	{
+		const DDS::Footprint& f0 = chain.footprints[0];
+		bool level0 = true;
+		for (uint32_t y = 0; y < f0.rowCount; y++)
+			level0 &= memcmp(chain.texel(0, 0, y), &image[static_cast<size_t>(y * f0.rowSize)], static_cast<size_t>(f0.rowSize)) == 0;
+		check(level0, what, seed);
+
+		bool padding = true;
+		uint64_t end = 0;
+		for (auto& f : chain.footprints)
+		{
+			for (uint64_t i = end; i < f.offset; i++)
+				padding &= chain.data[static_cast<size_t>(i)] == Untouched;
+			for (uint32_t y = 0; y + 1 < f.rowCount; y++)
+			{
+				for (uint64_t i = f.offset + y * f.rowPitch + f.rowSize; i < f.offset + (y + 1) * f.rowPitch; i++)
+					padding &= chain.data[static_cast<size_t>(i)] == Untouched;
+			}
+			end = f.offset + static_cast<uint64_t>(f.rowPitch) * (f.rowCount - 1) + f.rowSize;
+		}
+		check(padding, "row padding and gaps untouched", seed);
+	}
+
+	// Box: every texel of level k is the rounded mean of the level 0 texels it covers
+	void boxExact(uint32_t width, uint32_t height, unsigned seed)
+	{
+		vector<uint8_t> image = randomImage(width, height, seed);
+		Chain chain = generate(DDS::FormatR8G8B8A8Unorm, image, width, height, MipGenerator::Filter::Box);
+		check(chain.ok, "generate RGBA8", seed);
+		checkLayout(chain, image, "box level 0 copied", seed);
+
+		int worst = 0;
+		for (uint32_t mip = 1; mip < chain.footprints.size(); mip++)
+		{
+			const DDS::Footprint& f = chain.footprints[mip];
+			uint32_t bw = width / f.width, bh = height / f.height;
+			for (uint32_t y = 0; y < f.height; y++)
+			{
+				for (uint32_t x = 0; x < f.width; x++)
+				{
+					for (int c = 0; c < 4; c++)
+					{
+						double sum = 0;
+						for (uint32_t sy = y * bh; sy < (y + 1) * bh; sy++)
+						{
+							for (uint32_t sx = x * bw; sx < (x + 1) * bw; sx++)
+								sum += image[(static_cast<size_t>(sy) * width + sx) * 4 + c];
+						}
+						int expected = static_cast<int>(floor(sum / (bw * bh) + 0.5));
+						worst = (max)(worst, abs(expected - chain.texel(mip, x, y)[c]));
+					}
+				}
+			}
+		}
+		// Float sums may round a mean of exactly n + 0.5 either way
+		check(worst <= 1, "box levels are the mean of the texels they cover", seed);
+	}
+
+	// A 0/255 checkerboard box-filters to linear 0.5: sRGB code 188, not 128; alpha stays
+	// linear. Kaiser does not average it to exactly 0.5, but the sRGB level is still the
+	// linear-light UNORM level encoded to sRGB.
+	void srgbAverage()
+	{
+		const uint32_t size = 16;
+		vector<uint8_t> image(size * size * 4);
+		for (uint32_t i = 0; i < size * size; i++)
+		{
+			uint8_t v = ((i % size + i / size) & 1) ? 255 : 0;
+			image[i * 4 + 0] = image[i * 4 + 1] = image[i * 4 + 2] = image[i * 4 + 3] = v;
+		}
+		const MipGenerator::Filter filters[] = { MipGenerator::Filter::Box, MipGenerator::Filter::Kaiser };
+		for (auto filter : filters)
+		{
+			Chain srgb = generate(DDS::FormatR8G8B8A8UnormSrgb, image, size, size, filter);
+			Chain unorm = generate(DDS::FormatR8G8B8A8Unorm, image, size, size, filter);
+			bool linearLight = true, linear = true;
+			for (uint32_t mip = 1; mip < srgb.footprints.size(); mip++)
+			{
+				for (uint32_t y = 0; y < srgb.footprints[mip].height; y++)
+				{
+					for (uint32_t x = 0; x < srgb.footprints[mip].width; x++)
+					{
+						const uint8_t* s = srgb.texel(mip, x, y);
+						const uint8_t* u = unorm.texel(mip, x, y);
+						if (filter == MipGenerator::Filter::Box)
+						{
+							linearLight &= s[0] == 188 && s[1] == 188 && s[2] == 188 && s[3] == 128;
+							linear &= u[0] == 128 && u[1] == 128 && u[2] == 128 && u[3] == 128;
+						}
+						else
+						{
+							// u holds the linear value to half a UNORM step, about 1.5 sRGB codes
+							for (int c = 0; c < 3; c++)
+								linearLight &= abs(s[c] - MipGenerator::detail::linearToSrgb8(u[c] / 255.0f)) <= 2;
+							linearLight &= s[3] == u[3];
+							linear &= u[0] == u[1] && u[1] == u[2] && u[2] == u[3];
+						}
+					}
+				}
+			}
+			check(linearLight, "sRGB averages in linear light", static_cast<unsigned>(filter));
+			check(linear, "UNORM averages the codes", static_cast<unsigned>(filter));
+		}
+	}
+
+	// BGRA gives the RGBA result with red and blue swapped
+	void bgraSwapped(unsigned seed)
+	{
+		const uint32_t width = 40, height = 24;
+		vector<uint8_t> rgba = randomImage(width, height, seed);
+		vector<uint8_t> bgra = rgba;
+		for (size_t i = 0; i < bgra.size(); i += 4)
+			swap(bgra[i], bgra[i + 2]);
+		const uint32_t formats[2][2] = {
+			{ DDS::FormatR8G8B8A8Unorm, DDS::FormatB8G8R8A8Unorm },
+			{ DDS::FormatR8G8B8A8UnormSrgb, DDS::FormatB8G8R8A8UnormSrgb },
+		};
+		for (auto& pair : formats)
+		{
+			Chain a = generate(pair[0], rgba, width, height, MipGenerator::Filter::Kaiser);
+			Chain b = generate(pair[1], bgra, width, height, MipGenerator::Filter::Kaiser);
+			bool same = a.ok && b.ok;
+			for (uint32_t mip = 1; mip < a.footprints.size(); mip++)
+			{
+				for (uint32_t y = 0; y < a.footprints[mip].height; y++)
+				{
+					for (uint32_t x = 0; x < a.footprints[mip].width; x++)
+					{
+						const uint8_t* p = a.texel(mip, x, y);
+						const uint8_t* q = b.texel(mip, x, y);
+						same &= p[0] == q[2] && p[1] == q[1] && p[2] == q[0] && p[3] == q[3];
+					}
+				}
+			}
+			check(same, "BGRA is RGBA swapped", pair[1]);
+		}
+	}
+
+	// Every filter keeps a constant image constant, at odd sizes too
+	void constantStays()
+	{
+		const uint32_t sizes[][2] = { { 37, 21 }, { 64, 1 }, { 1, 17 }, { 3, 3 } };
+		const MipGenerator::Filter filters[] = { MipGenerator::Filter::Box, MipGenerator::Filter::Kaiser };
+		for (auto& size : sizes)
+		{
+			uint32_t width = size[0], height = size[1];
+			for (auto filter : filters)
+			{
+				unsigned seed = width * 100 + height;
+				vector<uint8_t> rgba8(static_cast<size_t>(width) * height * 4);
+				for (size_t i = 0; i < rgba8.size(); i++)
+					rgba8[i] = static_cast<uint8_t>(37 + 50 * (i % 4));
+				const uint32_t formats8[] = { DDS::FormatR8G8B8A8Unorm, DDS::FormatR8G8B8A8UnormSrgb, DDS::FormatB8G8R8A8UnormSrgb };
+				for (uint32_t format : formats8)
+				{
+					Chain chain = generate(format, rgba8, width, height, filter);
+					bool same = chain.ok;
+					for (uint32_t mip = 1; mip < chain.footprints.size(); mip++)
+					{
+						for (uint32_t y = 0; y < chain.footprints[mip].height; y++)
+						{
+							for (uint32_t x = 0; x < chain.footprints[mip].width; x++)
+								same &= memcmp(chain.texel(mip, x, y), rgba8.data(), 4) == 0;
+						}
+					}
+					check(same, "constant RGBA8 stays constant", seed);
+					checkLayout(chain, rgba8, "level 0 copied", seed);
+				}
+
+				vector<uint8_t> half(static_cast<size_t>(width) * height * 8);
+				const float values[4] = { 1.5f, -0.25f, 1000.0f, 1.0f };
+				for (size_t i = 0; i < half.size() / 2; i++)
+				{
+					uint16_t h = Half::floatToHalf(values[i % 4]);
+					memcpy(&half[i * 2], &h, sizeof(h));
+				}
+				Chain chain = generate(DDS::FormatR16G16B16A16Float, half, width, height, filter);
+				float worst = 0;
+				for (uint32_t mip = 1; mip < chain.footprints.size(); mip++)
+				{
+					for (uint32_t y = 0; y < chain.footprints[mip].height; y++)
+					{
+						for (uint32_t x = 0; x < chain.footprints[mip].width; x++)
+						{
+							for (int c = 0; c < 4; c++)
+								worst = (max)(worst, fabsf(chain.value(mip, x, y, c) - values[c]) / fabsf(values[c]));
+						}
+					}
+				}
+				check(chain.ok && worst <= ldexpf(1.0f, -11), "constant RGBA16F stays constant", seed);
+			}
+		}
+	}
+
+	float ramp(uint32_t x, uint32_t)
+	{
+		return static_cast<float>(x);
+	}
+
+	// Symmetric filters reproduce a linear ramp between the edges: level 1 at x is 2x + 0.5
+	void rampStays()
+	{
+		const uint32_t width = 64, height = 4;
+		vector<uint8_t> image = floatImage(width, height, ramp);
+		const MipGenerator::Filter filters[] = { MipGenerator::Filter::Box, MipGenerator::Filter::Kaiser };
+		for (auto filter : filters)
+		{
+			Chain chain = generate(DDS::FormatR32Float, image, width, height, filter);
+			float worst = 0;
+			for (uint32_t x = 2; x + 2 < width / 2; x++)
+				worst = (max)(worst, fabsf(chain.value(1, x, 1, 0) - (2 * x + 0.5f)));
+			check(chain.ok && worst < 1e-3f, "linear ramp reproduced", static_cast<unsigned>(filter));
+		}
+	}
+
+	// Amplitude of level 1 of a horizontal sine with the given period, away from the edges
+	float response(MipGenerator::Filter filter, float period)
+	{
+		const uint32_t width = 256, height = 4;
+		static float s_period;
+		s_period = period;
+		vector<uint8_t> image = floatImage(width, height, [](uint32_t x, uint32_t)
+		{
+			return sinf(2 * 3.14159265f * x / s_period);
+		});
+		Chain chain = generate(DDS::FormatR32Float, image, width, height, filter);
+		double mean = 0, squares = 0;
+		uint32_t count = 0;
+		for (uint32_t x = 8; x + 8 < width / 2; x++, count++)
+		{
+			double v = chain.value(1, x, 1, 0);
+			mean += v;
+			squares += v * v;
+		}
+		mean /= count;
+		return static_cast<float>(sqrt(2 * (squares / count - mean * mean)));
+	}
+
+	void frequencyResponse()
+	{
+		// Periods in level 0 texels; level 1 can hold periods of 4 and up
+		const float periods[] = { 32, 8, 5, 3, 2.5f, 2.2f };
+		float box[6], kaiser[6];
+		printf("  %-8s", "period");
+		for (int i = 0; i < 6; i++)
+		{
+			box[i] = response(MipGenerator::Filter::Box, periods[i]);
+			kaiser[i] = response(MipGenerator::Filter::Kaiser, periods[i]);
+			printf(" %8g", periods[i]);
+		}
+		printf("\n  %-8s", "box");
+		for (int i = 0; i < 6; i++)
+			printf(" %8.3f", box[i]);
+		printf("\n  %-8s", "kaiser");
+		for (int i = 0; i < 6; i++)
+			printf(" %8.3f", kaiser[i]);
+		printf("\n");
+		check(kaiser[0] > 0.98f && kaiser[1] > 0.85f && kaiser[1] > box[1] - 0.1f, "Kaiser keeps most below Nyquist", 0);
+		for (int i = 3; i < 6; i++)
+			check(kaiser[i] < box[i] / 2, "Kaiser aliases far less above Nyquist", i);
+	}
+
+	// Splitting rows across threads does not change a byte
+	void threadsAgree(unsigned seed)
+	{
+		const uint32_t width = 256, height = 200;
+		vector<uint8_t> image = randomImage(width, height, seed);
+		const MipGenerator::Filter filters[] = { MipGenerator::Filter::Box, MipGenerator::Filter::Kaiser };
+		for (auto filter : filters)
+		{
+			Chain one = generate(DDS::FormatR8G8B8A8UnormSrgb, image, width, height, filter, 1);
+			Chain many = generate(DDS::FormatR8G8B8A8UnormSrgb, image, width, height, filter, 8);
+			check(one.ok && many.ok && one.data == many.data, "one thread and eight agree", seed);
+		}
+	}
+
+	void rejects()
+	{
+		vector<uint8_t> image(16 * 16 * 4);
+		DDS::TextureDesc desc;
+		desc.format = DDS::FormatR8G8B8A8Unorm;
+		desc.width = desc.height = 16;
+		desc.mipLevels = 5;
+		vector<DDS::Footprint> footprints;
+		vector<uint8_t> dest(static_cast<size_t>(DDS::computeFootprints(desc, footprints)));
+		check(MipGenerator::fullMipCount(16, 16) == 5 && MipGenerator::fullMipCount(1, 1) == 1 &&
+			MipGenerator::fullMipCount(256, 1) == 9 && MipGenerator::fullMipCount(5, 3) == 3, "fullMipCount", 0);
+		check(!MipGenerator::generate(DDS::FormatBC1Unorm, image.data(), 64, 16, 16, dest.data(), footprints.data(), 5), "BC1 rejected", 0);
+		check(!MipGenerator::generate(DDS::FormatR8G8B8A8Unorm, image.data(), 64, 0, 16, dest.data(), footprints.data(), 5), "zero width rejected", 0);
+		check(!MipGenerator::generate(DDS::FormatR8G8B8A8Unorm, image.data(), 64, 16, 16, dest.data(), footprints.data(), 0), "no levels rejected", 0);
+		check(!MipGenerator::generate(DDS::FormatR8G8B8A8Unorm, image.data(), 64, 16, 16, dest.data(), footprints.data(), 6), "too many levels rejected", 0);
+		check(MipGenerator::generate(DDS::FormatR8G8B8A8Unorm, image.data(), 64, 16, 16, dest.data(), footprints.data(), 5), "full chain accepted", 0);
+	}
+};
+
+int main()
+{
+	boxExact(64, 32, 1);
+	boxExact(128, 8, 2);
+	boxExact(1, 16, 3);
+	srgbAverage();
+	bgraSwapped(4);
+	constantStays();
+	rampStays();
+	frequencyResponse();
+	threadsAgree(5);
+	rejects();
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,213 @@
+// Checks the chunked OBJ scan is deterministic: the chunks of splitLines() and
+// parseChunked(), merged in file order with prefix sums the way
+// WaveFrontReader::LoadParallel() merges them, give the same elements, faces,
+// index limits and materials as one serial parse() of the whole file, for any
+// chunk or thread count. Inputs are random OBJ text with comments, blank lines,
+// CRLF line ends and every face format, plus an OBJ file when one is given.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread ObjChunkParserTest.cpp -o ObjChunkParserTest
+// Usage: ObjChunkParserTest [seeds] [file.obj]
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../Mesh/ObjChunkParser.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// Records of a whole file, with indices and limits counted from the start of the file
+	struct Merged
+	{
+		vector<float> positions;
+		vector<float> texcoords;
+		vector<float> normals;
+		vector<uint32_t> faceVertices;      // position, texcoord, normal
+		vector<uint32_t> faces;             // firstVertex, vertexCount, limits
+		vector<string> materials;           // first face index and name
+		string mtllib;
+
+		bool operator==(const Merged& other) const
+		{
+			return positions == other.positions && texcoords == other.texcoords && normals == other.normals &&
+				faceVertices == other.faceVertices && faces == other.faces && materials == other.materials &&
+				mtllib == other.mtllib;
+		}
+	};
+
+	Merged merge(const vector<ObjParser::ChunkRecords>& chunks)
+	{
+		Merged m;
+		for (auto& c : chunks)
+		{
+			auto positionBase = (uint32_t)m.positions.size() / 3;
+			auto texcoordBase = (uint32_t)m.texcoords.size() / 2;
+			auto normalBase = (uint32_t)m.normals.size() / 3;
+			auto vertexBase = (uint32_t)m.faceVertices.size() / 3;
+			auto faceBase = (uint32_t)m.faces.size() / 5;
+			m.positions.insert(m.positions.end(), c.positions.begin(), c.positions.end());
+			m.texcoords.insert(m.texcoords.end(), c.texcoords.begin(), c.texcoords.end());
+			m.normals.insert(m.normals.end(), c.normals.begin(), c.normals.end());
+			for (auto& v : c.faceVertices)
+				m.faceVertices.insert(m.faceVertices.end(), { v.position, v.texcoord, v.normal });
+			for (auto& f : c.faces)
+			{
+				m.faces.insert(m.faces.end(), { vertexBase + f.firstVertex, f.vertexCount,
+					positionBase + f.positionLimit, texcoordBase + f.texcoordLimit, normalBase + f.normalLimit });
+			}
+			for (auto& mat : c.materials)
+				m.materials.push_back(to_string(faceBase + mat.faceIndex) + " " + string(mat.name, mat.length));
+			if (c.mtllibName)
+				m.mtllib.assign(c.mtllibName, c.mtllibLength);
+		}
+		return m;
+	}
+
+	Merged parseSerial(const string& text, unsigned seed)
+	{
+		vector<ObjParser::ChunkRecords> chunks(1);
+		auto result = ObjParser::parse(text.data(), text.data() + text.size(), chunks[0]);
+		check(result == ObjParser::Result::Ok, "serial parse", seed);
+		return merge(chunks);
+	}
+
+	// The chunks parseChunked() would scan with chunkCount threads on a large enough file
+	Merged parseSplit(const string& text, size_t chunkCount, unsigned seed)
+	{
+		auto bounds = ObjParser::splitLines(text.data(), text.data() + text.size(), chunkCount);
+		bool whole = bounds.size() >= 2 && bounds.size() <= chunkCount + 1;
+		for (size_t i = 1; whole && i + 1 < bounds.size(); i++)
+			whole = bounds[i - 1] < bounds[i] && bounds[i][-1] == '\n';
+		check(whole, "chunks are whole lines", seed);
+
+		vector<ObjParser::ChunkRecords> chunks(bounds.size() - 1);
+		for (size_t i = 0; i < chunks.size(); i++)
+			check(ObjParser::parse(bounds[i], bounds[i + 1], chunks[i]) == ObjParser::Result::Ok, "chunk parse", seed);
+		return merge(chunks);
+	}
+
+	string randomObj(mt19937& rng, size_t lineCount)
+	{
+		const char* materials[] = { "red", "green", "blue_metal" };
+		ostringstream obj;
+		uint32_t positions = 0, texcoords = 0, normals = 0;
+		if (rng() % 2)
+			obj << "mtllib scene" << rng() % 4 << ".mtl\n";
+		for (size_t line = 0; line < lineCount; line++)
+		{
+			auto number = [&] { return (float)((int)(rng() % 20001) - 10000) / (float)(1 + rng() % 1000); };
+			const char* eol = rng() % 8 ? "\n" : "\r\n";
+			uint32_t kind = rng() % 100;
+			if (kind < 30 || positions == 0)
+			{
+				obj << "v " << number() << " " << number() << " " << number() << eol;
+				positions++;
+			}
+			else if (kind < 40)
+			{
+				obj << "vt " << number() << "\t" << number() << eol;
+				texcoords++;
+			}
+			else if (kind < 50)
+			{
+				obj << "vn " << number() << " " << number() << " " << number() << eol;
+				normals++;
+			}
+			else if (kind < 85)
+			{
+				// v, v/vt, v//vn or v/vt/vn, as far as the elements so far allow
+				uint32_t format = rng() % 4;
+				obj << "f";
+				for (uint32_t i = 3 + (rng() % 5 ? 0 : rng() % 6); i > 0; i--)
+				{
+					obj << " " << 1 + rng() % positions;
+					if ((format & 1) && texcoords)
+						obj << "/" << 1 + rng() % texcoords;
+					if ((format & 2) && normals)
+						obj << ((format & 1) && texcoords ? "/" : "//") << 1 + rng() % normals;
+				}
+				obj << eol;
+			}
+			else if (kind < 88)
+				obj << "usemtl " << materials[rng() % 3] << eol;
+			else if (kind < 92)
+				obj << "# comment v 1 2 3" << eol;
+			else if (kind < 95)
+				obj << eol;
+			else if (kind < 97)
+				obj << "g group" << rng() % 10 << eol << "s " << rng() % 2 << eol;
+			else
+				obj << "   \t" << eol;
+		}
+		if (rng() % 2)
+			obj << "v 1 2 3"; // No line end at the end of the file
+		return obj.str();
+	}
+
+	void testSplit(const string& text, unsigned seed)
+	{
+		auto serial = parseSerial(text, seed);
+		for (size_t chunkCount = 1; chunkCount <= 64; chunkCount++)
+			check(parseSplit(text, chunkCount, seed) == serial, "merged chunks match the serial parse", seed);
+	}
+
+	void testThreads(const string& text, unsigned seed)
+	{
+		auto serial = parseSerial(text, seed);
+		for (unsigned threadCount = 1; threadCount <= 8; threadCount++)
+		{
+			vector<ObjParser::ChunkRecords> chunks;
+			auto result = ObjParser::parseChunked(text.data(), text.data() + text.size(), chunks, threadCount);
+			check(result == ObjParser::Result::Ok, "parseChunked", seed);
+			check(merge(chunks) == serial, "parseChunked matches the serial parse", seed);
+		}
+	}
+};
+
+int main(int argc, char** argv)
+{
+	unsigned seeds = argc > 1 ? atoi(argv[1]) : 200;
+
+	for (unsigned seed = 1; seed <= seeds; seed++)
+	{
+		mt19937 rng(seed);
+		testSplit(randomObj(rng, 1 + rng() % 300), seed);
+	}
+
+	// Large enough for parseChunked() to use every thread
+	{
+		mt19937 rng(0);
+		string text = randomObj(rng, 200000);
+		check(text.size() > 8 * 256 * 1024, "large input", 0);
+		testThreads(text, 0);
+	}
+
+	if (argc > 2)
+	{
+		ifstream file(argv[2], ios::binary);
+		ostringstream text;
+		text << file.rdbuf();
+		check(file && text.str().size() > 0, "read the OBJ file", 0);
+		testSplit(text.str(), 0);
+		testThreads(text.str(), 0);
+	}
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok: %u seeds%s%s\n", seeds, argc > 2 ? " and " : "", argc > 2 ? argv[2] : "");
+	return 0;
+}
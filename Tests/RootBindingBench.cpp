@@ -0,0 +1,269 @@
+// Benchmarks RootBinding without a device. Draws of two scenes are bound three
+// ways: the layout choose() picks, every per-draw buffer as a root CBV, and the
+// descriptor table per draw the samples use (a CBV written for every per-draw
+// buffer, then SetGraphicsRootDescriptorTable). The streams are replayed into
+// CallCounter for API calls and argument bytes per draw; CBV memory, descriptor
+// writes, stream bytes and recording and replay times per draw are printed too.
+// The Binder streams are also replayed into a target that tracks the root
+// arguments and checks every draw sees its own data.
+// Portable; on Linux: g++ -std=c++14 -O2 RootBindingBench.cpp -o RootBindingBench
+// Usage: RootBindingBench [draws]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../_common/RootBinding.h"
+
+using namespace std;
+using namespace RootBinding;
+
+namespace
+{
+	const uint64_t CbGpuAddress = 0x10000000;
+	const uint64_t TableHandle = 0x20000000;
+	const uint32_t DescriptorSize = 32;
+
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	struct Scene
+	{
+		const char* name;
+		vector<Parameter> params;
+		vector<uint32_t> changeEvery;       // draws between changes of a per-draw parameter
+	};
+
+	// Contents of param for draw: the first DWORDs say which param and which change it is
+	void fill(const Scene& scene, uint32_t param, uint32_t draw, uint32_t* data)
+	{
+		uint32_t dwords = (scene.params[param].size + 3) / 4;
+		for (uint32_t i = 0; i < dwords; i++)
+			data[i] = i == 0 ? draw / scene.changeEvery[param] : param * 1000 + i;
+	}
+
+	struct Result
+	{
+		uint64_t calls;
+		uint64_t argumentBytes;
+		uint64_t cbvBytes;
+		uint64_t descriptors;
+		size_t streamBytes;
+		double recordNs;
+		double replayNs;
+	};
+
+	// Tracks the root arguments of a replayed stream and checks them at every draw,
+	// whose startIndex is the draw number
+	struct Verifier : CommandCapture::NullTarget
+	{
+		const Scene* scene;
+		const Layout* layout;
+		const uint8_t* cbMemory;
+		vector<vector<uint32_t>> constants;
+		vector<uint64_t> addresses;
+		uint64_t table = 0;
+		uint32_t draws = 0;
+		bool ok = true;
+
+		Verifier(const Scene& s, const Layout& l, const uint8_t* memory)
+			: scene(&s), layout(&l), cbMemory(memory), constants(l.rootParameters.size()), addresses(l.rootParameters.size(), 0)
+		{
+		}
+
+		void SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset)
+		{
+			auto& c = constants[rootIndex];
+			c.resize(offset + count);
+			memcpy(&c[offset], data, count * 4);
+		}
+		void SetGraphicsRootConstantBufferView(uint32_t rootIndex, uint64_t address)
+		{
+			addresses[rootIndex] = address;
+		}
+		void SetGraphicsRootDescriptorTable(uint32_t, uint64_t handle)
+		{
+			table = handle;
+		}
+		void DrawIndexedInstanced(uint32_t, uint32_t, uint32_t draw, int32_t, uint32_t)
+		{
+			uint32_t expected[MaxRootDWords * 4];
+			for (uint32_t p = 0; p < scene->params.size(); p++)
+			{
+				auto& param = scene->params[p];
+				auto& slot = layout->slots[p];
+				if (!param.perDraw)
+					continue;
+				fill(*scene, p, draw, expected);
+				if (slot.kind == Kind::Constants)
+					ok &= constants[slot.rootIndex].size() * 4 >= param.size && memcmp(constants[slot.rootIndex].data(), expected, param.size) == 0;
+				else
+					ok &= addresses[slot.rootIndex] != 0 && memcmp(cbMemory + (addresses[slot.rootIndex] - CbGpuAddress), expected, param.size) == 0;
+			}
+			ok &= layout->tableRootIndex < 0 || table == TableHandle;
+			ok &= draw == draws++;
+		}
+	};
+
+	Result runBinder(const Scene& scene, uint32_t drawCount, uint32_t maxConstantBytes, const char* label)
+	{
+		Layout layout;
+		Result result = {};
+		if (!choose(scene.params.data(), scene.params.size(), layout, maxConstantBytes))
+		{
+			check(false, label, 0);
+			return result;
+		}
+
+		vector<uint8_t> cbMemory((size_t)drawCount * 256 * scene.params.size() + 64 * 1024);
+		FrameAllocator allocator;
+		allocator.init(cbMemory.data(), CbGpuAddress, cbMemory.size());
+		Binder binder;
+		binder.init(layout, scene.params.data(), &allocator, (size_t)drawCount * 128 * scene.params.size());
+
+		uint32_t data[MaxRootDWords * 4];
+		auto start = chrono::steady_clock::now();
+		binder.reset();
+		binder.setTable(TableHandle);
+		bool bound = true;
+		for (uint32_t draw = 0; draw < drawCount; draw++)
+		{
+			for (uint32_t p = 0; p < scene.params.size(); p++)
+			{
+				if (!scene.params[p].perDraw)
+					continue;
+				fill(scene, p, draw, data);
+				bound &= binder.set(p, data);
+			}
+			binder.drawIndexed(36, 1, draw, 0, 0);
+		}
+		auto recorded = chrono::steady_clock::now();
+		CallCounter counter;
+		bool replayed = CommandCapture::replay(binder.stream().data(), binder.stream().size(), counter);
+		auto end = chrono::steady_clock::now();
+
+		check(bound && binder.stream().droppedCount() == 0 && replayed && counter.draws == drawCount, label, 0);
+		Verifier verifier(scene, layout, cbMemory.data());
+		CommandCapture::replay(binder.stream().data(), binder.stream().size(), verifier);
+		check(verifier.ok && verifier.draws == drawCount, "every draw sees its own data", 0);
+
+		result.calls = counter.calls;
+		result.argumentBytes = counter.bytes;
+		result.cbvBytes = allocator.used();
+		result.streamBytes = binder.stream().size();
+		result.recordNs = chrono::duration<double, nano>(recorded - start).count();
+		result.replayNs = chrono::duration<double, nano>(end - recorded).count();
+		return result;
+	}
+
+	// Every buffer is an entry of a descriptor table, and per-draw buffers get a CBV and a table per draw
+	Result runTables(const Scene& scene, uint32_t drawCount)
+	{
+		vector<uint8_t> cbMemory((size_t)drawCount * 256 * scene.params.size() + 64 * 1024);
+		FrameAllocator allocator;
+		allocator.init(cbMemory.data(), CbGpuAddress, cbMemory.size());
+		CommandCapture::Writer list;
+		list.init((size_t)drawCount * 32);
+		uint32_t perDrawCount = 0;
+		for (auto& param : scene.params)
+			perDrawCount += param.perDraw ? 1 : 0;
+
+		Result result = {};
+		uint32_t data[MaxRootDWords * 4];
+		auto start = chrono::steady_clock::now();
+		for (uint32_t draw = 0; draw < drawCount; draw++)
+		{
+			for (uint32_t p = 0; p < scene.params.size(); p++)
+			{
+				if (!scene.params[p].perDraw)
+					continue;
+				fill(scene, p, draw, data);
+				auto cb = allocator.allocate(scene.params[p].size);
+				if (cb.data)
+					memcpy(cb.data, data, scene.params[p].size);
+				result.descriptors++;           // CreateConstantBufferView into the draw's table
+			}
+			list.SetGraphicsRootDescriptorTable(0, TableHandle + (uint64_t)draw * perDrawCount * DescriptorSize);
+			list.DrawIndexedInstanced(36, 1, draw, 0, 0);
+		}
+		auto recorded = chrono::steady_clock::now();
+		CallCounter counter;
+		CommandCapture::replay(list.data(), list.size(), counter);
+		auto end = chrono::steady_clock::now();
+		check(list.droppedCount() == 0 && counter.draws == drawCount, "table per draw", 0);
+
+		result.calls = counter.calls;
+		result.argumentBytes = counter.bytes;
+		result.cbvBytes = allocator.used();
+		result.streamBytes = list.size();
+		result.recordNs = chrono::duration<double, nano>(recorded - start).count();
+		result.replayNs = chrono::duration<double, nano>(end - recorded).count();
+		return result;
+	}
+
+	void print(const char* label, const Result& r, uint32_t drawCount)
+	{
+		double n = drawCount;
+		printf("  %-12s %6.2f %8.1f %8.1f %7.2f %8.1f %8.1f %8.1f\n", label, r.calls / n, r.argumentBytes / n, r.cbvBytes / n,
+			r.descriptors / n, r.streamBytes / n, r.recordNs / n, r.replayNs / n);
+	}
+
+	void testLayouts()
+	{
+		// ParallelFrameRootConstant: the scene index becomes a root constant, the scene table stays
+		Parameter sample[] = { { 0, 0, 512, false }, { 1, 0, 4, true } };
+		Layout layout;
+		check(choose(sample, 2, layout) && layout.slots[1].kind == Kind::Constants && layout.slots[0].kind == Kind::Table &&
+			layout.rootDWords == 2 && layout.tableRootIndex == 1, "sample layout", 0);
+
+		// 16 bytes per draw each: constants until the root CBVs left need the rest of the budget
+		vector<Parameter> many;
+		for (uint32_t i = 0; i < 30; i++)
+			many.push_back({ i, 0, 16, true });
+		check(choose(many.data(), many.size(), layout) && layout.rootDWords <= MaxRootDWords, "30 small buffers fit", 0);
+		uint32_t constantCount = 0;
+		for (auto& slot : layout.slots)
+			constantCount += slot.kind == Kind::Constants ? 1 : 0;
+		check(constantCount == 2 && layout.rootDWords == MaxRootDWords, "constants while the other buffers still fit as root CBVs", 0);
+		many.clear();
+		for (uint32_t i = 0; i < 33; i++)
+			many.push_back({ i, 0, 256, true });
+		check(choose(many.data(), 32, layout) && !choose(many.data(), 33, layout), "32 root CBVs fit, 33 do not", 0);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	uint32_t drawCount = argc > 1 ? atoi(argv[1]) : 10000;
+
+	testLayouts();
+
+	Scene scenes[] = {
+		// ParallelFrameRootConstant: scene parameters per frame, the scene index per draw
+		{ "sample", { { 0, 0, 512, false }, { 1, 0, 4, true } }, { 1, 1 } },
+		// Per-frame scene and lights, per-draw index and transform, material every 100 draws
+		{ "mixed", { { 0, 0, 512, false }, { 1, 0, 4, true }, { 2, 0, 48, true }, { 3, 0, 128, true }, { 4, 0, 256, false } },
+			{ 1, 1, 100, 1, 1 } },
+	};
+	for (auto& scene : scenes)
+	{
+		printf("%s, %u draws, per draw:\n", scene.name, drawCount);
+		printf("  %-12s %6s %8s %8s %7s %8s %8s %8s\n", "layout", "calls", "argbytes", "cbvbytes", "descs", "stream", "recordns", "replayns");
+		print("choose()", runBinder(scene, drawCount, DefaultMaxConstantBytes, "choose() layout"), drawCount);
+		print("root CBVs", runBinder(scene, drawCount, 0, "root CBV layout"), drawCount);
+		print("table/draw", runTables(scene, drawCount), drawCount);
+	}
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,351 @@
+// Benchmarks loading a mesh from SDKMESH against loading it from OBJ: the
+// SdkMesh::File open and load SdkMeshReader::Load() runs, against the ObjParser
+// scan and VertexDedupTable merge of WaveFrontReader::LoadMapped(). Runs on the
+// bundled teapots and a synthetic grid, which is written to both formats in
+// memory; the grid's SDKMESH is written from its loaded OBJ, so both loads are
+// checked to give the same vertices and indices bit for bit. Prints the file
+// size, the best time of several loads and the MB/s of each. Then checks
+// damaged copies of the grid's SDKMESH are rejected: indices out of range in a
+// subset or outside every subset, unaligned subsets, vertex and index counts
+// whose sizes overflow 64 bits, and section sizes that sum past the file.
+// Portable; on Linux: g++ -std=c++14 -O2 SdkMeshLoadBench.cpp -o SdkMeshLoadBench
+// Usage: SdkMeshLoadBench [synthetic triangles]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../_common/MappedFile.h"
+#include "../Mesh/ObjParser.h"
+#include "../Mesh/SdkMeshFormat.h"
+#include "../Mesh/VertexDedupTable.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// SdkMeshReader::Vertex and WaveFrontReader::Vertex without DirectXMath
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float textureCoordinate[2];
+	};
+
+	struct Mesh
+	{
+		vector<Vertex> vertices;
+		vector<uint32_t> indices;
+		vector<uint32_t> attributes;
+	};
+
+	// Builds vertices as WaveFrontReader::LoadMapped() does: elements are
+	// gathered, every face corner is merged by VertexDedupTable and polygons
+	// are fanned into triangles
+	struct Sink
+	{
+		Mesh& mesh;
+		vector<float> positions;
+		vector<float> texcoords;
+		vector<float> normals;
+		VertexDedupTable<Vertex> table;
+		uint32_t attribute = 0;
+
+		Sink(Mesh& m, size_t fileSize) : mesh(m)
+		{
+			table.reserve(fileSize / 32);
+		}
+
+		bool position(float x, float y, float z)
+		{
+			positions.insert(positions.end(), { x, y, z });
+			return true;
+		}
+		bool texcoord(float u, float v)
+		{
+			texcoords.insert(texcoords.end(), { u, v });
+			return true;
+		}
+		bool normal(float x, float y, float z)
+		{
+			normals.insert(normals.end(), { x, y, z });
+			return true;
+		}
+		bool face(const ObjParser::FaceVertex* verts, size_t count)
+		{
+			uint32_t index[ObjParser::MaxPolygonVertex];
+			for (size_t i = 0; i < count; i++)
+			{
+				auto& c = verts[i];
+				if (c.position == 0 || c.position > positions.size() / 3 || c.texcoord > texcoords.size() / 2 || c.normal > normals.size() / 3)
+					return false;
+				Vertex v;
+				memset(&v, 0, sizeof(v));
+				memcpy(v.position, &positions[(c.position - 1) * 3], sizeof(v.position));
+				if (c.texcoord)
+					memcpy(v.textureCoordinate, &texcoords[(c.texcoord - 1) * 2], sizeof(v.textureCoordinate));
+				if (c.normal)
+					memcpy(v.normal, &normals[(c.normal - 1) * 3], sizeof(v.normal));
+				index[i] = table.findOrAdd(c.position, c.texcoord, c.normal, v, mesh.vertices);
+			}
+			if (count < 3)
+				return false;
+			for (size_t j = 2; j < count; j++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { index[0], index[j - 1], index[j] });
+				mesh.attributes.push_back(attribute);
+			}
+			return true;
+		}
+		bool useMaterial(const char*, size_t)
+		{
+			attribute++;
+			return true;
+		}
+		bool materialLibrary(const char*, size_t)
+		{
+			return true;
+		}
+	};
+
+	bool loadObj(const char* data, size_t size, Mesh& mesh)
+	{
+		mesh = Mesh();
+		Sink sink(mesh, size);
+		return ObjParser::parse(data, data + size, sink) == ObjParser::Result::Ok;
+	}
+
+	bool loadSdkMesh(const char* data, size_t size, Mesh& mesh)
+	{
+		SdkMesh::File file;
+		bool hasNormals, hasTexcoords;
+		return file.open(data, size) && file.load(0, mesh.vertices, mesh.indices, mesh.attributes, hasNormals, hasTexcoords);
+	}
+
+	// Fixed offsets of the tables in the files sdkmesh() writes
+	const size_t VertexBufferOffset = sizeof(SdkMesh::Header);
+	const size_t IndexBufferOffset = VertexBufferOffset + sizeof(SdkMesh::VertexBufferHeader);
+	const size_t MeshOffset = IndexBufferOffset + sizeof(SdkMesh::IndexBufferHeader);
+	const size_t SubsetOffset = MeshOffset + sizeof(SdkMesh::Mesh);
+	const size_t SubsetIndexOffset = SubsetOffset + sizeof(SdkMesh::Subset);
+	const size_t MaterialOffset = SubsetIndexOffset + 8;
+	const size_t DataOffset = MaterialOffset + sizeof(SdkMesh::Material);
+
+	// One mesh with one vertex and one 32-bit index buffer, and one subset and
+	// material covering every triangle
+	vector<char> sdkmesh(const Mesh& mesh)
+	{
+		size_t vertexBytes = mesh.vertices.size() * sizeof(Vertex);
+		size_t indexBytes = mesh.indices.size() * sizeof(uint32_t);
+		vector<char> file(DataOffset + vertexBytes + indexBytes);
+
+		SdkMesh::Header h = {};
+		h.Version = SdkMesh::FileVersion;
+		h.HeaderSize = sizeof(h);
+		h.NonBufferDataSize = DataOffset - sizeof(h);
+		h.BufferDataSize = vertexBytes + indexBytes;
+		h.NumVertexBuffers = h.NumIndexBuffers = h.NumMeshes = h.NumTotalSubsets = h.NumMaterials = 1;
+		h.VertexStreamHeadersOffset = VertexBufferOffset;
+		h.IndexStreamHeadersOffset = IndexBufferOffset;
+		h.MeshDataOffset = MeshOffset;
+		h.SubsetDataOffset = SubsetOffset;
+		h.FrameDataOffset = MaterialOffset;
+		h.MaterialDataOffset = MaterialOffset;
+		memcpy(&file[0], &h, sizeof(h));
+
+		SdkMesh::VertexBufferHeader vb = {};
+		vb.NumVertices = mesh.vertices.size();
+		vb.SizeBytes = vertexBytes;
+		vb.StrideBytes = sizeof(Vertex);
+		vb.Decl[0] = { 0, 0, SdkMesh::DeclTypeFloat3, 0, SdkMesh::DeclUsagePosition, 0 };
+		vb.Decl[1] = { 0, 12, SdkMesh::DeclTypeFloat3, 0, SdkMesh::DeclUsageNormal, 0 };
+		vb.Decl[2] = { 0, 24, SdkMesh::DeclTypeFloat2, 0, SdkMesh::DeclUsageTexcoord, 0 };
+		vb.Decl[3] = { 0xFF, 0, SdkMesh::DeclTypeUnused, 0, 0, 0 };
+		vb.DataOffset = DataOffset;
+		memcpy(&file[VertexBufferOffset], &vb, sizeof(vb));
+
+		SdkMesh::IndexBufferHeader ib = {};
+		ib.NumIndices = mesh.indices.size();
+		ib.SizeBytes = indexBytes;
+		ib.IndexType = SdkMesh::IndexType32Bit;
+		ib.DataOffset = DataOffset + vertexBytes;
+		memcpy(&file[IndexBufferOffset], &ib, sizeof(ib));
+
+		SdkMesh::Mesh m = {};
+		m.NumVertexBuffers = 1;
+		m.NumSubsets = 1;
+		m.SubsetOffset = SubsetIndexOffset;
+		memcpy(&file[MeshOffset], &m, sizeof(m));
+
+		SdkMesh::Subset s = {};
+		s.IndexCount = mesh.indices.size();
+		s.VertexCount = mesh.vertices.size();
+		memcpy(&file[SubsetOffset], &s, sizeof(s));
+
+		memcpy(&file[DataOffset], mesh.vertices.data(), vertexBytes);
+		memcpy(&file[DataOffset + vertexBytes], mesh.indices.data(), indexBytes);
+		return file;
+	}
+
+	// A width x height grid of quads with per-vertex texcoords and normals
+	string obj(size_t triangleCount)
+	{
+		const uint32_t width = 1024;
+		uint32_t height = (uint32_t)(triangleCount / (2 * width)) + 1;
+		string text;
+		char line[128];
+		for (uint32_t y = 0; y <= height; y++)
+		{
+			for (uint32_t x = 0; x <= width; x++)
+			{
+				snprintf(line, sizeof(line), "v %g %g %g\nvt %g %g\nvn 0 0 1\n", x * 0.01f, y * 0.01f, ((x * 7 + y * 13) % 17) * 0.001f,
+					x / (float)width, y / (float)height);
+				text += line;
+			}
+		}
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint32_t a = y * (width + 1) + x + 1, b = a + 1, c = a + width + 1, d = c + 1;
+				snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, d, d, d, c, c, c);
+				text += line;
+			}
+		}
+		return text;
+	}
+
+	template<class F>
+	double bestMs(int runs, F f)
+	{
+		double best = 1e30;
+		for (int run = 0; run < runs; run++)
+		{
+			auto start = chrono::steady_clock::now();
+			f();
+			best = (min)(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+	void print(const char* name, const char* format, size_t size, double ms, const Mesh& mesh)
+	{
+		printf("  %-28s %-8s %9.2f %10.3f %9.1f %10zu %10zu\n", name, format, size / 1e6, ms, size / 1e3 / ms, mesh.vertices.size(), mesh.indices.size() / 3);
+	}
+
+	bool equal(const Mesh& a, const Mesh& b)
+	{
+		return a.vertices.size() == b.vertices.size() && a.indices == b.indices &&
+			memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) == 0;
+	}
+
+	template<class T>
+	T& at(vector<char>& file, size_t offset)
+	{
+		return *reinterpret_cast<T*>(&file[offset]);
+	}
+
+	// Each damage applied to a fresh copy of file must be rejected by open() or load()
+	void checkDamaged(const vector<char>& file)
+	{
+		uint32_t vertexCount = (uint32_t)reinterpret_cast<const SdkMesh::VertexBufferHeader*>(&file[VertexBufferOffset])->NumVertices;
+		size_t indexData = (size_t)reinterpret_cast<const SdkMesh::IndexBufferHeader*>(&file[IndexBufferOffset])->DataOffset;
+		size_t indexCount = (size_t)reinterpret_cast<const SdkMesh::IndexBufferHeader*>(&file[IndexBufferOffset])->NumIndices;
+		struct Damage
+		{
+			const char* what;
+			void (*apply)(vector<char>& file, uint32_t vertexCount, size_t indexData, size_t indexCount);
+		};
+		const Damage damages[] = {
+			{ "index out of range in a subset", [](vector<char>& f, uint32_t n, size_t data, size_t) { at<uint32_t>(f, data + 4) = n; } },
+			{ "index out of range outside every subset", [](vector<char>& f, uint32_t n, size_t data, size_t count) {
+				at<SdkMesh::Subset>(f, SubsetOffset).IndexCount -= 3;
+				at<uint32_t>(f, data + (count - 1) * 4) = n; } },
+			{ "index out of range after VertexStart", [](vector<char>& f, uint32_t, size_t, size_t) { at<SdkMesh::Subset>(f, SubsetOffset).VertexStart = 1; } },
+			{ "VertexStart past 64 bits", [](vector<char>& f, uint32_t, size_t, size_t) { at<SdkMesh::Subset>(f, SubsetOffset).VertexStart = ~0ull; } },
+			{ "IndexStart not a multiple of 3", [](vector<char>& f, uint32_t, size_t, size_t) {
+				at<SdkMesh::Subset>(f, SubsetOffset).IndexStart = 1;
+				at<SdkMesh::Subset>(f, SubsetOffset).IndexCount -= 3; } },
+			{ "IndexCount not a multiple of 3", [](vector<char>& f, uint32_t, size_t, size_t) { at<SdkMesh::Subset>(f, SubsetOffset).IndexCount -= 1; } },
+			{ "IndexStart + IndexCount past 64 bits", [](vector<char>& f, uint32_t, size_t, size_t) {
+				at<SdkMesh::Subset>(f, SubsetOffset).IndexStart = 3;
+				at<SdkMesh::Subset>(f, SubsetOffset).IndexCount = ~0ull; } },
+			{ "StrideBytes * NumVertices past 64 bits", [](vector<char>& f, uint32_t, size_t, size_t) {
+				at<SdkMesh::VertexBufferHeader>(f, VertexBufferOffset).StrideBytes = 1ull << 63;
+				at<SdkMesh::VertexBufferHeader>(f, VertexBufferOffset).NumVertices = 2; } },
+			{ "zero StrideBytes", [](vector<char>& f, uint32_t, size_t, size_t) { at<SdkMesh::VertexBufferHeader>(f, VertexBufferOffset).StrideBytes = 0; } },
+			{ "NumIndices * 4 past 64 bits", [](vector<char>& f, uint32_t, size_t, size_t) { at<SdkMesh::IndexBufferHeader>(f, IndexBufferOffset).NumIndices = 1ull << 62; } },
+			{ "unknown IndexType", [](vector<char>& f, uint32_t, size_t, size_t) { at<SdkMesh::IndexBufferHeader>(f, IndexBufferOffset).IndexType = 2; } },
+			{ "section sizes past 64 bits", [](vector<char>& f, uint32_t, size_t, size_t) { at<SdkMesh::Header>(f, 0).BufferDataSize = ~0ull - 100; } },
+		};
+		for (auto& damage : damages)
+		{
+			vector<char> copy = file;
+			damage.apply(copy, vertexCount, indexData, indexCount);
+			Mesh mesh;
+			check(!loadSdkMesh(copy.data(), copy.size(), mesh), damage.what, 0);
+		}
+	}
+};
+
+int main(int argc, char** argv)
+{
+	size_t triangles = argc > 1 ? atoi(argv[1]) : 1000000;
+	if (triangles < 2048)
+	{
+		printf("Usage: SdkMeshLoadBench [synthetic triangles]\n");
+		return 1;
+	}
+
+	printf("  %-28s %-8s %9s %10s %9s %10s %10s\n", "file", "format", "MB", "ms", "MB/s", "vertices", "triangles");
+	const char* files[] = { "../Mesh/teapot.sdkmesh", "../Mesh/teapot.obj", "../MeshTex/teapot_tex2.obj" };
+	for (auto fileName : files)
+	{
+		MappedFile file;
+		Mesh mesh;
+		bool sdk = strstr(fileName, ".sdkmesh") != nullptr;
+		bool ok = false;
+		double ms = bestMs(100, [&]
+		{
+			mesh = Mesh();
+			ok = file.open(fileName) && (sdk ? loadSdkMesh(file.data(), file.size(), mesh) : loadObj(file.data(), file.size(), mesh));
+		});
+		check(ok && !mesh.indices.empty(), fileName, 0);
+		print(fileName, sdk ? "SDKMESH" : "OBJ", file.size(), ms, mesh);
+	}
+
+	// The grid from memory, so only the parsing and conversion are timed
+	string text = obj(triangles);
+	Mesh fromObj;
+	double objMs = bestMs(3, [&] { loadObj(text.data(), text.size(), fromObj); });
+	check(loadObj(text.data(), text.size(), fromObj), "synthetic OBJ loads", 0);
+	print("synthetic grid", "OBJ", text.size(), objMs, fromObj);
+
+	vector<char> file = sdkmesh(fromObj);
+	Mesh fromSdkMesh;
+	double sdkMs = bestMs(3, [&] { fromSdkMesh = Mesh(); loadSdkMesh(file.data(), file.size(), fromSdkMesh); });
+	check(loadSdkMesh(file.data(), file.size(), fromSdkMesh), "synthetic SDKMESH loads", 0);
+	check(equal(fromObj, fromSdkMesh), "SDKMESH and OBJ give the same vertices and indices", 0);
+	print("synthetic grid", "SDKMESH", file.size(), sdkMs, fromSdkMesh);
+	printf("  SDKMESH loads %.1fx faster than OBJ\n", objMs / sdkMs);
+
+	checkDamaged(file);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,307 @@
+// Benchmarks UploadCopy::copyRowsStreamed and copyRows, which streams from
+// StreamThreshold bytes, against the memcpy per row of MemcpySubresource on
+// texture footprints as GetCopyableFootprints lays them out (row pitch aligned
+// to 256 bytes), from 16 KB to 256 MB, the largest beyond the caches.
+// The destination is timed warm, in the cache as a reused CPU buffer, and cold,
+// flushed from the caches before every copy. Upload heaps are write-combined,
+// which user code cannot map on Linux; a cold destination is the nearest: memcpy
+// has to read every line before writing it, as a partial WC line costs a bus
+// transaction, while streaming stores write whole lines without reading them.
+// Checks every copy, and a few thousand random layouts, byte for byte against
+// memcpy: only the padding after a row, up to the next 64-byte boundary, may be
+// zeroed, and streamed rows with room in their pitch must end on one.
+// Portable; on Linux: g++ -std=c++14 -O2 [-mavx2] UploadCopyBench.cpp -o UploadCopyBench
+// Usage: UploadCopyBench [random layouts]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../_common/UploadCopy.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	const uint8_t Sentinel = 0xA5;
+
+	// A buffer whose data starts offset bytes past a 64-byte boundary, with Guard bytes around it
+	const size_t Guard = 64;
+
+	struct Buffer
+	{
+		vector<uint8_t> storage;
+		size_t offset;
+
+		Buffer(size_t size, size_t offset, uint8_t fill) : storage(size + offset + 3 * Guard, fill), offset(offset)
+		{
+		}
+		uint8_t* data()
+		{
+			auto address = reinterpret_cast<uintptr_t>(storage.data()) + 2 * Guard - 1;
+			return reinterpret_cast<uint8_t*>(address & ~static_cast<uintptr_t>(63)) + offset;
+		}
+	};
+
+	struct Copy
+	{
+		size_t rowSize;
+		uint32_t rowCount;
+		uint32_t sliceCount;
+		size_t destRowPitch, destSlicePitch;
+		size_t srcRowPitch, srcSlicePitch;
+
+		// Up to the end of the last row, as an upload heap may end there
+		size_t destSize() const
+		{
+			return (sliceCount - 1) * destSlicePitch + (rowCount - 1) * destRowPitch + rowSize;
+		}
+		size_t srcSize() const
+		{
+			return (sliceCount - 1) * srcSlicePitch + (rowCount - 1) * srcRowPitch + rowSize;
+		}
+	};
+
+	// End of the padding streamed after row y of slice z: the next 64-byte
+	// boundary, within the row pitch, or the row itself for the last row
+	size_t padEnd(const Copy& c, const uint8_t* dest, size_t z, size_t y)
+	{
+		if (z + 1 == c.sliceCount && y + 1 == c.rowCount)
+			return c.rowSize;
+		auto row = reinterpret_cast<uintptr_t>(dest) + z * c.destSlicePitch + y * c.destRowPitch;
+		size_t lineEnd = ((row + c.rowSize + 63) & ~static_cast<uintptr_t>(63)) - row;
+		return (min)(lineEnd, c.destRowPitch);
+	}
+
+	// Matches memcpy, guard bytes included, except that the padding after a row
+	// that is not the last, up to padEnd(), may be zero
+	bool same(const Copy& c, Buffer& actual, Buffer& expected)
+	{
+		const uint8_t* a = actual.data() - Guard;
+		const uint8_t* e = expected.data() - Guard;
+		for (size_t i = 0; i < c.destSize() + 2 * Guard; i++)
+		{
+			if (a[i] == e[i])
+				continue;
+			if (a[i] != 0 || i < Guard || i >= Guard + c.destSize())
+				return false;
+			size_t at = i - Guard;
+			size_t z = at / c.destSlicePitch, inSlice = at % c.destSlicePitch;
+			size_t y = inSlice / c.destRowPitch, x = inSlice % c.destRowPitch;
+			if (y >= c.rowCount || x < c.rowSize || x >= padEnd(c, actual.data(), z, y))
+				return false;
+		}
+		return true;
+	}
+
+	// Every row that is not the last is zeroed up to padEnd(), so that its last
+	// line is written whole
+	bool padsLines(const Copy& c, Buffer& actual)
+	{
+		for (size_t z = 0; z < c.sliceCount; z++)
+		{
+			for (size_t y = 0; y < c.rowCount; y++)
+			{
+				const uint8_t* row = actual.data() + z * c.destSlicePitch + y * c.destRowPitch;
+				for (size_t x = c.rowSize; x < padEnd(c, actual.data(), z, y); x++)
+				{
+					if (row[x] != 0)
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	UploadCopy::Layout destLayout(const Copy& c, uint8_t* data)
+	{
+		return { data, c.destRowPitch, c.destSlicePitch };
+	}
+
+	UploadCopy::ConstLayout srcLayout(const Copy& c, const uint8_t* data)
+	{
+		return { data, c.srcRowPitch, c.srcSlicePitch };
+	}
+
+	// Random sizes, pitches, slices and destination alignments against memcpy per row
+	void testLayouts(unsigned seed)
+	{
+		mt19937 random(seed);
+		auto uniform = [&](size_t low, size_t high) { return uniform_int_distribution<size_t>(low, high)(random); };
+		const size_t alignments[] = { 1, 4, 16, 256 };
+
+		Copy c;
+		c.rowSize = uniform(0, 3) ? uniform(1, 600) : uniform(1, 5000);
+		c.rowCount = (uint32_t)uniform(1, 12);
+		c.sliceCount = (uint32_t)uniform(1, 3);
+		size_t alignment = alignments[uniform(0, 3)];
+		c.destRowPitch = (c.rowSize + uniform(0, 40) + alignment - 1) / alignment * alignment;
+		c.destSlicePitch = (c.destRowPitch * c.rowCount + uniform(0, 40) + alignment - 1) / alignment * alignment;
+		c.srcRowPitch = c.rowSize + uniform(0, 1) * uniform(0, 20);
+		c.srcSlicePitch = c.srcRowPitch * c.rowCount + uniform(0, 1) * uniform(0, 20);
+		size_t destOffset = uniform(0, 3) ? 0 : uniform(1, 63);
+
+		Buffer src(c.srcSize(), 0, 0);
+		for (size_t i = 0; i < c.srcSize(); i++)
+			src.data()[i] = (uint8_t)(random() | 1);    // never 0, so zeroed bytes stand out
+		Buffer actual(c.destSize(), destOffset, Sentinel);
+		Buffer expected(c.destSize(), destOffset, Sentinel);
+		UploadCopy::copyRowsStreamed(destLayout(c, actual.data()), srcLayout(c, src.data()), c.rowSize, c.rowCount, c.sliceCount);
+		UploadCopy::copyRowsScalar(destLayout(c, expected.data()), srcLayout(c, src.data()), c.rowSize, c.rowCount, c.sliceCount);
+		check(same(c, actual, expected), "random layout streams as memcpy copies", seed);
+#if UPLOAD_COPY_SSE2
+		bool streamed = !(reinterpret_cast<uintptr_t>(actual.data()) & 15) && !(c.destRowPitch & 15) &&
+			(c.sliceCount <= 1 || !(c.destSlicePitch & 15)) && c.rowSize >= 64;
+		check(!streamed || padsLines(c, actual), "streamed rows are padded to a 64-byte boundary", seed);
+#endif
+		Buffer dispatched(c.destSize(), destOffset, Sentinel);
+		UploadCopy::copyRows(destLayout(c, dispatched.data()), srcLayout(c, src.data()), c.rowSize, c.rowCount, c.sliceCount);
+		check(same(c, dispatched, expected), "random layout copies as memcpy does", seed);
+	}
+
+	// Evicts the destination from every cache level
+	void flush(const uint8_t* data, size_t size)
+	{
+#if UPLOAD_COPY_SSE2
+		for (size_t i = 0; i < size; i += 64)
+			_mm_clflush(data + i);
+		_mm_mfence();
+#else
+		(void)data;
+		(void)size;
+#endif
+	}
+
+	typedef void (*CopyFunction)(const UploadCopy::Layout&, const UploadCopy::ConstLayout&, size_t, uint32_t, uint32_t);
+
+	void streamed(const UploadCopy::Layout& dest, const UploadCopy::ConstLayout& src, size_t rowSize, uint32_t rowCount, uint32_t sliceCount)
+	{
+		UploadCopy::copyRowsStreamed(dest, src, rowSize, rowCount, sliceCount);
+	}
+
+	void dispatched(const UploadCopy::Layout& dest, const UploadCopy::ConstLayout& src, size_t rowSize, uint32_t rowCount, uint32_t sliceCount)
+	{
+		UploadCopy::copyRows(dest, src, rowSize, rowCount, sliceCount);
+	}
+
+	// GB/s of the best of three runs of copies totalling about 64 MB
+	double time(const Copy& c, Buffer& dest, Buffer& src, CopyFunction copy, bool cold)
+	{
+		size_t bytes = c.rowSize * c.rowCount * c.sliceCount;
+		size_t repeats = (max)((size_t)1, (64u << 20) / bytes);
+		auto d = destLayout(c, dest.data());
+		auto s = srcLayout(c, src.data());
+		copy(d, s, c.rowSize, c.rowCount, c.sliceCount);
+		double best = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			double seconds = 0;
+			for (size_t i = 0; i < repeats; i++)
+			{
+				if (cold)
+					flush(dest.data(), c.destSize());
+				auto start = chrono::steady_clock::now();
+				copy(d, s, c.rowSize, c.rowCount, c.sliceCount);
+				seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			}
+			best = (min)(best, seconds);
+		}
+		return bytes * repeats / best / 1e9;
+	}
+
+	struct Texture
+	{
+		const char* name;
+		uint32_t width, height, depth;
+		uint32_t bytesPerElement;
+		uint32_t blockSize;             // 4 for BC formats
+	};
+
+	void bench(const Texture& t)
+	{
+		Copy c;
+		uint32_t blocksWide = (t.width + t.blockSize - 1) / t.blockSize;
+		c.rowSize = (size_t)blocksWide * t.bytesPerElement;
+		c.rowCount = (t.height + t.blockSize - 1) / t.blockSize;
+		c.sliceCount = t.depth;
+		c.destRowPitch = (c.rowSize + 255) & ~static_cast<size_t>(255);  // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+		c.destSlicePitch = c.destRowPitch * c.rowCount;
+		c.srcRowPitch = c.rowSize;
+		c.srcSlicePitch = c.rowSize * c.rowCount;
+
+		Buffer src(c.srcSize(), 0, 0);
+		mt19937 random(c.rowSize);
+		for (size_t i = 0; i < c.srcSize(); i += 4)
+			src.data()[i] = (uint8_t)(random() | 1);
+		Buffer dest(c.destSize(), 0, Sentinel);
+		Buffer expected(c.destSize(), 0, Sentinel);
+		UploadCopy::copyRowsStreamed(destLayout(c, dest.data()), srcLayout(c, src.data()), c.rowSize, c.rowCount, c.sliceCount);
+		UploadCopy::copyRowsScalar(destLayout(c, expected.data()), srcLayout(c, src.data()), c.rowSize, c.rowCount, c.sliceCount);
+		check(same(c, dest, expected), t.name, 0);
+		check(padsLines(c, dest), t.name, 0);
+		expected.storage = vector<uint8_t>();
+
+		double warmMemcpy = time(c, dest, src, UploadCopy::copyRowsScalar, false);
+		double warmStream = time(c, dest, src, streamed, false);
+		double warmCopyRows = time(c, dest, src, dispatched, false);
+		double coldMemcpy = time(c, dest, src, UploadCopy::copyRowsScalar, true);
+		double coldStream = time(c, dest, src, streamed, true);
+		double coldCopyRows = time(c, dest, src, dispatched, true);
+		printf("  %-20s %6zu %6zu %8.1f %8.2f %8.2f %8.2f %6.2fx %8.2f %8.2f %8.2f %6.2fx\n", t.name, c.rowSize, c.destRowPitch,
+			c.destSize() / 1048576.0, warmMemcpy, warmStream, warmCopyRows, warmCopyRows / warmMemcpy,
+			coldMemcpy, coldStream, coldCopyRows, coldCopyRows / coldMemcpy);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	unsigned layouts = argc > 1 ? atoi(argv[1]) : 5000;
+
+	for (unsigned seed = 0; seed < layouts; seed++)
+		testLayouts(seed);
+
+#if UPLOAD_COPY_AVX2
+	printf("copyRows: AVX2 streaming stores\n");
+#elif UPLOAD_COPY_SSE2
+	printf("copyRows: SSE2 streaming stores\n");
+#else
+	printf("copyRows: memcpy per row, no streaming stores on this target\n");
+#endif
+	printf("streaming from %zu KB\n", UploadCopy::StreamThreshold / 1024);
+	printf("  %-20s %6s %6s %8s %-35s%-35s\n", "", "", "", "", "  warm, GB/s", "  cold, GB/s");
+	printf("  %-20s %6s %6s %8s %8s %8s %8s %7s %8s %8s %8s %7s\n", "texture", "row", "pitch", "MB",
+		"memcpy", "stream", "copyRows", "", "memcpy", "stream", "copyRows", "");
+	const Texture textures[] = {
+		{ "64x64 RGBA8", 64, 64, 1, 4, 1 },
+		{ "100x100 RGBA8", 100, 100, 1, 4, 1 },
+		{ "301x301 RGB8", 301, 301, 1, 3, 1 },
+		{ "256x256 RGBA8", 256, 256, 1, 4, 1 },
+		{ "64x64x64 RGBA8", 64, 64, 64, 4, 1 },
+		{ "1000x1000 RGBA8", 1000, 1000, 1, 4, 1 },
+		{ "1920x1080 RGBA16F", 1920, 1080, 1, 8, 1 },
+		{ "2048x2048 BC1", 2048, 2048, 1, 8, 4 },
+		{ "4096x4096 BC7", 4096, 4096, 1, 16, 4 },
+		{ "4096x4096 RGBA8", 4096, 4096, 1, 4, 1 },
+		{ "8192x8192 RGBA8", 8192, 8192, 1, 4, 1 },
+	};
+	for (auto& t : textures)
+		bench(t);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
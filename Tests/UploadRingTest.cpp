@@ -0,0 +1,187 @@
+// Checks UploadRing against a fake fence. Every frame allocates staging data
+// of random size and alignment, some larger than half the ring, while the fake
+// GPU completes the frames in order up to a few frames behind and checks each
+// frame's data is still intact. Also checks that dedicated buffers are released
+// by fence and that nothing is left once every frame has completed.
+// Portable; on Linux: g++ -std=c++14 -O2 UploadRingTest.cpp -o UploadRingTest
+// Usage: UploadRingTest [frames]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+#include "../_common/UploadRing.h"
+
+using namespace std;
+
+namespace
+{
+	const uint64_t Capacity = 1024 * 1024;
+	const uint32_t MaxLatency = 3;
+
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// Stands in for ID3D12Resource*: buffer 1 is the ring
+	typedef uint32_t Resource;
+	typedef UploadRing<Resource> Ring;
+
+	struct Buffers
+	{
+		Resource next = 1;
+		int live = 0;
+		uint64_t liveBytes = 0;
+		int failNext = 0;           // creations to fail
+
+		bool create(uint64_t size, Ring::Buffer& buffer)
+		{
+			if (failNext > 0)
+			{
+				failNext--;
+				return false;
+			}
+			buffer.resource = next++;
+			buffer.data = new uint8_t[(size_t)size];
+			buffer.gpuAddress = (uint64_t)buffer.resource << 32;
+			buffer.size = size;
+			live++;
+			liveBytes += size;
+			return true;
+		}
+
+		void release(Ring::Buffer& buffer)
+		{
+			delete[] static_cast<uint8_t*>(buffer.data);
+			live--;
+			liveBytes -= buffer.size;
+		}
+	};
+
+	struct Staging
+	{
+		const uint8_t* data;
+		uint64_t size;
+		uint8_t value;
+	};
+
+	bool intact(const vector<Staging>& frame)
+	{
+		for (auto& s : frame)
+		{
+			for (uint64_t i = 0; i < s.size; i++)
+			{
+				if (s.data[i] != s.value)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void testFrames(unsigned seed, uint32_t frameCount)
+	{
+		mt19937 rng(seed);
+		Buffers buffers;
+		{
+			Ring ring;
+			bool created = ring.init(Capacity,
+				[&](uint64_t size, Ring::Buffer& buffer) { return buffers.create(size, buffer); },
+				[&](Ring::Buffer& buffer) { buffers.release(buffer); });
+			check(created && ring.capacity() == Capacity, "ring created", seed);
+
+			deque<vector<Staging>> inFlight;
+			uint64_t completed = 0;
+			int overflows = 0;
+			for (uint64_t frame = 1; frame <= frameCount; frame++)
+			{
+				// The fake fence completes frames in order, 0 to MaxLatency frames behind
+				uint64_t target = frame > MaxLatency ? frame - 1 - rng() % MaxLatency : 0;
+				for (; completed < target; completed++)
+				{
+					check(intact(inFlight.front()), "staging data intact until its frame completes", seed);
+					inFlight.pop_front();
+				}
+				ring.reclaim(completed);
+
+				vector<Staging> staging;
+				for (uint32_t i = 1 + rng() % 40; i > 0; i--)
+				{
+					uint64_t size = rng() % 100 ? 1 + rng() % 20000 : Capacity / 2 + rng() % (2 * Capacity);
+					uint64_t alignment = 256ull << (rng() % 3 ? 0 : rng() % 9);
+					auto a = ring.allocate(size, alignment);
+					if (!a.data)
+					{
+						check(false, "allocation succeeds", seed);
+						continue;
+					}
+					if (a.resource == 1)
+					{
+						check(a.offset % alignment == 0 && a.offset + size <= Capacity, "ring allocation aligned and inside the ring", seed);
+						check(size <= Capacity / 2, "large allocations get their own buffer", seed);
+					}
+					else
+					{
+						check(a.offset == 0, "dedicated buffer starts at 0", seed);
+						overflows++;
+					}
+					check(a.gpuAddress == ((uint64_t)a.resource << 32) + a.offset, "GPU address", seed);
+					uint8_t value = (uint8_t)rng();
+					memset(a.data, value, (size_t)size);
+					staging.push_back({ static_cast<uint8_t*>(a.data), size, value });
+				}
+				ring.close(frame);
+				inFlight.push_back(staging);
+			}
+			check(overflows > 0, "some allocations overflow the ring", seed);
+
+			for (; !inFlight.empty(); inFlight.pop_front())
+				check(intact(inFlight.front()), "staging data intact until its frame completes", seed);
+			ring.reclaim(frameCount);
+			check(buffers.live == 1 && ring.overflowSize() == 0 && ring.used() == 0, "everything released but the ring", seed);
+		}
+		check(buffers.live == 0, "ring released with the UploadRing", seed);
+	}
+
+	void testCreateFailure()
+	{
+		Buffers buffers;
+		Ring ring;
+		ring.init(64 * 1024,
+			[&](uint64_t size, Ring::Buffer& buffer) { return buffers.create(size, buffer); },
+			[&](Ring::Buffer& buffer) { buffers.release(buffer); });
+		buffers.failNext = 1;
+		check(!ring.allocate(48 * 1024).data, "failed creation gives an empty allocation", 0);
+		check(ring.allocate(48 * 1024).data != nullptr, "next creation succeeds", 0);
+
+		// Allocations closed with the same fence value are retired together
+		ring.close(1);
+		ring.allocate(16 * 1024);
+		ring.close(1);
+		ring.reclaim(0);
+		check(buffers.live == 2 && ring.used() != 0, "nothing freed before the fence completes", 0);
+		ring.reclaim(1);
+		check(buffers.live == 1 && ring.used() == 0, "frame freed once its fence completes", 0);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	uint32_t frameCount = argc > 1 ? atoi(argv[1]) : 1000;
+
+	testCreateFailure();
+	for (unsigned seed = 1; seed <= 8; seed++)
+		testFrames(seed, frameCount);
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok: %u frames x 8 seeds\n", frameCount);
+	return 0;
+}
@@ -0,0 +1,399 @@
+// Benchmarks OBJ vertex deduplication: VertexDedupTable, presized from the face
+// corner count and left to grow, against the unordered_multimap keyed on the
+// position index WaveFrontReader used before, and ObjParser::mergeChunks() as
+// WaveFrontReader::LoadParallel() runs it, on a JobSystem of 1, 4 and every
+// hardware thread with one chunk per thread. Runs on the bundled teapots, any
+// OBJ files given, and a synthetic grid whose positions are split by texture
+// seams and hard normal edges. Prints the corners, unique vertices, dedup rate,
+// ns per corner and heap allocations per corner, and checks every method gives
+// the same vertices and indices. For the chunked runs the serial merge share is
+// printed too: lookups of the serial step per corner, which bounds the speedup
+// over one thread. Times are the best of three runs.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread VertexDedupBench.cpp -o VertexDedupBench
+// Usage: VertexDedupBench [synthetic triangles] [file.obj ...]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../_common/MappedFile.h"
+#include "../Mesh/ObjChunkMerge.h"
+#include "../Mesh/ObjParser.h"
+#include "../Mesh/VertexDedupTable.h"
+
+using namespace std;
+
+namespace
+{
+	uint64_t g_allocations = 0;
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// WaveFrontReader::Vertex without DirectXMath
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float textureCoordinate[2];
+	};
+
+	// Elements and face corners of a mesh, each corner an OBJ index triple
+	struct Mesh
+	{
+		vector<float> positions;
+		vector<float> texcoords;
+		vector<float> normals;
+		vector<ObjParser::FaceVertex> corners;
+
+		Vertex vertex(const ObjParser::FaceVertex& c) const
+		{
+			Vertex v;
+			memset(&v, 0, sizeof(v));
+			memcpy(v.position, &positions[(c.position - 1) * 3], sizeof(v.position));
+			if (c.texcoord)
+				memcpy(v.textureCoordinate, &texcoords[(c.texcoord - 1) * 2], sizeof(v.textureCoordinate));
+			if (c.normal)
+				memcpy(v.normal, &normals[(c.normal - 1) * 3], sizeof(v.normal));
+			return v;
+		}
+	};
+
+	// Triangulates faces into corners as WaveFrontReader::AddPolygon() does with ccw
+	struct Sink
+	{
+		Mesh& mesh;
+
+		bool position(float x, float y, float z)
+		{
+			mesh.positions.insert(mesh.positions.end(), { x, y, z });
+			return true;
+		}
+		bool texcoord(float u, float v)
+		{
+			mesh.texcoords.insert(mesh.texcoords.end(), { u, v });
+			return true;
+		}
+		bool normal(float x, float y, float z)
+		{
+			mesh.normals.insert(mesh.normals.end(), { x, y, z });
+			return true;
+		}
+		bool face(const ObjParser::FaceVertex* verts, size_t count)
+		{
+			for (size_t j = 2; j < count; j++)
+				mesh.corners.insert(mesh.corners.end(), { verts[0], verts[j - 1], verts[j] });
+			return true;
+		}
+		bool useMaterial(const char*, size_t)
+		{
+			return true;
+		}
+		bool materialLibrary(const char*, size_t)
+		{
+			return true;
+		}
+	};
+
+	bool load(const char* fileName, Mesh& mesh)
+	{
+		MappedFile file;
+		Sink sink{ mesh };
+		return file.open(fileName) && ObjParser::parse(file.data(), file.end(), sink) == ObjParser::Result::Ok;
+	}
+
+	// A width x height grid of positions. Every 16th column is a texture seam
+	// and every 8th row a hard edge, so positions there have 2 or 4 vertices.
+	// Every 4th row of quads uses copies of the texture coordinates, as exporters
+	// writing them per face do, which must merge with the vertices of the others.
+	Mesh grid(size_t triangleCount)
+	{
+		const uint32_t width = 2048;
+		uint32_t height = (uint32_t)(triangleCount / (2 * (width - 1))) + 2;
+		Mesh mesh;
+		uint32_t count = width * height;
+		mesh.positions.resize(count * 3);
+		mesh.texcoords.resize(count * 2 * 3);
+		mesh.normals.resize(count * 3 * 2);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint32_t i = y * width + x;
+				float* p = &mesh.positions[i * 3];
+				p[0] = x * 0.01f;
+				p[1] = y * 0.01f;
+				p[2] = (float)((x * 7 + y * 13) % 17) * 0.001f;
+				float* t = &mesh.texcoords[i * 2];
+				t[0] = (x % 16) / 16.0f;
+				t[1] = y / (float)height;
+				t[count * 2] = 1.0f;            // the seam side of the quads to the left
+				t[count * 2 + 1] = t[1];
+				t[count * 4] = t[0];                // the copies
+				t[count * 4 + 1] = t[1];
+				float* n = &mesh.normals[i * 3];
+				n[0] = 0;
+				n[1] = 0;
+				n[2] = 1;
+				n[count * 3 + 1] = 1;           // the hard edge side of the quads below
+			}
+		}
+
+		auto corner = [&](uint32_t x, uint32_t y, uint32_t quadX, uint32_t quadY)
+		{
+			uint32_t i = y * width + x;
+			uint32_t t = i + (x % 16 == 0 && quadX < x ? count : quadY % 4 == 3 ? 2 * count : 0);
+			uint32_t n = i + (y % 8 == 0 && quadY < y ? count : 0);
+			return ObjParser::FaceVertex{ i + 1, t + 1, n + 1 };
+		};
+		mesh.corners.reserve(triangleCount * 3);
+		for (uint32_t y = 0; y + 1 < height && mesh.corners.size() < triangleCount * 3; y++)
+		{
+			for (uint32_t x = 0; x + 1 < width && mesh.corners.size() < triangleCount * 3; x++)
+			{
+				auto a = corner(x, y, x, y), b = corner(x + 1, y, x, y), c = corner(x, y + 1, x, y), d = corner(x + 1, y + 1, x, y);
+				mesh.corners.insert(mesh.corners.end(), { a, c, b, b, c, d });
+			}
+		}
+		return mesh;
+	}
+
+	struct Result
+	{
+		vector<Vertex> vertices;
+		vector<uint32_t> indices;
+		double ns;
+		uint64_t allocations;
+	};
+
+	// The vertices and indices are presized for every method, so allocations are the cache's
+	template<class F>
+	Result run(const Mesh& mesh, F addVertex)
+	{
+		Result result;
+		result.vertices.reserve(mesh.corners.size());
+		result.indices.reserve(mesh.corners.size());
+		uint64_t allocations = g_allocations;
+		auto start = chrono::steady_clock::now();
+		for (auto& c : mesh.corners)
+		{
+			Vertex v = mesh.vertex(c);
+			result.indices.push_back(addVertex(c, v, result.vertices));
+		}
+		auto end = chrono::steady_clock::now();
+		result.allocations = g_allocations - allocations;
+		result.ns = chrono::duration<double, nano>(end - start).count();
+		return result;
+	}
+
+	void print(const char* method, const Mesh& mesh, const Result& r, double baseNs)
+	{
+		double n = (double)mesh.corners.size();
+		printf("  %-16s %10zu %10zu %6.1f%% %8.1f %7.2fx %8.3f\n", method, mesh.corners.size(), r.vertices.size(),
+			100.0 * (1.0 - r.vertices.size() / n), r.ns / n, baseNs / r.ns, r.allocations / n);
+	}
+
+	bool same(const Result& a, const Result& b)
+	{
+		return a.indices == b.indices && a.vertices.size() == b.vertices.size() &&
+			memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) == 0;
+	}
+
+	// Best of three runs, each with a new cache from init()
+	template<class Init, class Add>
+	Result best(const Mesh& mesh, Init init, Add add)
+	{
+		Result result;
+		for (int i = 0; i < 3; i++)
+		{
+			auto cache = init();
+			Result r = run(mesh, [&](const ObjParser::FaceVertex& c, const Vertex& v, vector<Vertex>& vertices)
+			{
+				return add(cache, c, v, vertices);
+			});
+			if (i == 0 || r.ns < result.ns)
+				result = move(r);
+		}
+		return result;
+	}
+
+	typedef unordered_multimap<uint32_t, uint32_t> Multimap;
+	typedef VertexDedupTable<Vertex> Table;
+
+	// WaveFrontReader::AddVertex() before VertexDedupTable
+	uint32_t addMultimap(Multimap& cache, const ObjParser::FaceVertex& c, const Vertex& v, vector<Vertex>& vertices)
+	{
+		auto f = cache.equal_range(c.position);
+		for (auto it = f.first; it != f.second; ++it)
+		{
+			if (memcmp(&v, &vertices[it->second], sizeof(Vertex)) == 0)
+				return it->second;
+		}
+		auto index = (uint32_t)vertices.size();
+		vertices.push_back(v);
+		cache.insert({ c.position, index });
+		return index;
+	}
+
+	uint32_t addTable(Table& table, const ObjParser::FaceVertex& c, const Vertex& v, vector<Vertex>& vertices)
+	{
+		return table.findOrAdd(c.position, c.texcoord, c.normal, v, vertices);
+	}
+
+	// The triangles split into chunkCount chunks of ObjParser::ChunkRecords. The
+	// elements stay in mesh, so the chunks hold faces only.
+	vector<ObjParser::ChunkRecords> split(const Mesh& mesh, size_t chunkCount)
+	{
+		vector<ObjParser::ChunkRecords> chunks(chunkCount);
+		size_t triangles = mesh.corners.size() / 3;
+		for (size_t c = 0; c < chunkCount; c++)
+		{
+			auto& chunk = chunks[c];
+			for (size_t t = triangles * c / chunkCount; t < triangles * (c + 1) / chunkCount; t++)
+				chunk.face(&mesh.corners[t * 3], 3);
+		}
+		return chunks;
+	}
+
+	// Lookups of the serial merge per corner: the unique vertices of every chunk
+	double serialShare(const Mesh& mesh, const vector<ObjParser::ChunkRecords>& chunks)
+	{
+		size_t lookups = 0;
+		for (auto& chunk : chunks)
+		{
+			Table table;
+			vector<Vertex> vertices;
+			for (auto& fv : chunk.faceVertices)
+				table.findOrAdd(fv.position, fv.texcoord, fv.normal, mesh.vertex(fv), vertices);
+			lookups += vertices.size();
+		}
+		return mesh.corners.empty() ? 0 : (double)lookups / mesh.corners.size();
+	}
+
+	// mergeChunks() with one chunk per thread, best of three
+	Result chunked(const Mesh& mesh, unsigned threadCount, double& share)
+	{
+		JobSystem jobs;
+		jobs.init(threadCount);
+		auto chunks = split(mesh, jobs.threadCount());
+		share = serialShare(mesh, chunks);
+		size_t positionCount = mesh.positions.size() / 3, texcoordCount = mesh.texcoords.size() / 2, normalCount = mesh.normals.size() / 3;
+		auto makeVertex = [&](size_t, const ObjParser::FaceRecord&, const ObjParser::FaceVertex& fv, Vertex& v)
+		{
+			if (fv.position == 0 || fv.position > positionCount || fv.texcoord > texcoordCount || fv.normal > normalCount)
+				return false;
+			v = mesh.vertex(fv);
+			return true;
+		};
+		Result result;
+		for (int i = 0; i < 3; i++)
+		{
+			Result r;
+			uint64_t allocations = g_allocations;
+			auto start = chrono::steady_clock::now();
+			auto merged = ObjParser::mergeChunks(chunks, jobs, true, 0xFFFFFFFE, makeVertex, r.vertices, r.indices);
+			r.ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+			r.allocations = g_allocations - allocations;
+			check(merged == ObjParser::MergeResult::Ok, "mergeChunks", threadCount);
+			if (i == 0 || r.ns < result.ns)
+				result = move(r);
+		}
+		jobs.shutdown();
+		return result;
+	}
+
+	void bench(const char* name, const Mesh& mesh)
+	{
+		printf("%s\n", name);
+		Result multimap = best(mesh, [] { return Multimap(); }, addMultimap);
+		Result presized = best(mesh, [&]
+		{
+			Table table;
+			table.reserve(mesh.corners.size());
+			return table;
+		}, addTable);
+		Result growing = best(mesh, [] { return Table(); }, addTable);
+		check(same(multimap, presized) && same(multimap, growing), name, 0);
+		check(presized.allocations == 0, "no allocation per insert in a presized table", 0);
+		print("multimap", mesh, multimap, multimap.ns);
+		print("table presized", mesh, presized, multimap.ns);
+		print("table growing", mesh, growing, multimap.ns);
+
+		unsigned hardware = (max)(1u, thread::hardware_concurrency());
+		const unsigned threadCounts[] = { 1, 4, hardware };
+		for (auto& threads : threadCounts)
+		{
+			if (&threads == &threadCounts[2] && (hardware == 1 || hardware == 4))
+				continue;
+			double share;
+			Result r = chunked(mesh, threads, share);
+			char method[32];
+			snprintf(method, sizeof(method), "chunked, %u thr", threads);
+			check(same(multimap, r), method, threads);
+			print(method, mesh, r, multimap.ns);
+			printf("  %-16s %10s %10s %6.1f%% serial merge lookups per corner, speedup over 1 thread at most about %.1fx\n", "", "", "",
+				share * 100, threads == 1 || share == 0 ? 1.0 : (min)((double)threads, 1 / share));
+		}
+	}
+};
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+int main(int argc, char** argv)
+{
+	size_t triangleCount = argc > 1 ? atoi(argv[1]) : 10000000;
+
+	printf("  %-16s %10s %10s %7s %8s %8s %8s\n", "method", "corners", "vertices", "dedup", "ns/corn", "speedup", "allocs");
+	const char* files[] = { "../Mesh/teapot.obj", "../MeshTex/teapot_tex2.obj" };
+	for (auto fileName : files)
+	{
+		Mesh mesh;
+		check(load(fileName, mesh), fileName, 0);
+		bench(fileName, mesh);
+	}
+	for (int i = 2; i < argc; i++)
+	{
+		Mesh mesh;
+		check(load(argv[i], mesh), argv[i], 0);
+		bench(argv[i], mesh);
+	}
+	if (triangleCount)
+	{
+		Mesh mesh = grid(triangleCount);
+		char name[64];
+		snprintf(name, sizeof(name), "synthetic grid, %zu triangles", mesh.corners.size() / 3);
+		bench(name, mesh);
+	}
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,189 @@
+// Checks VertexQuantizer and reports its error on the bundled teapots: the
+// largest position, normal and texcoord error quantize() returns, which has to
+// match measureError() on what it wrote and stay within half a 16-bit UNORM
+// step of the bounds per axis, the octahedral normal bound and half-float
+// rounding. Random unit normals, normals on the axes and in the octahedron
+// folds, and flat bounds (zero extents on an axis) are checked the same way.
+// Portable; on Linux: g++ -std=c++14 -O2 VertexQuantizerTest.cpp -o VertexQuantizerTest
+// Usage: VertexQuantizerTest [file.obj ...]
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../Mesh/MeshCook.h"
+
+using namespace std;
+
+namespace
+{
+	int g_failures = 0;
+
+	void check(bool condition, const char* what, unsigned seed)
+	{
+		if (!condition && g_failures++ < 20)
+			printf("FAILED: %s (seed %u)\n", what, seed);
+	}
+
+	// Octahedral encoding with 16-bit SNORM components is good to about 0.005
+	// degrees, but acosf() of a float cosine near 1 only resolves about 0.02
+	const float MaxNormalDegrees = 0.05f;
+
+	// Half a UNORM16 step on every axis of the bounds, and float rounding of the
+	// dequantized coordinate
+	float positionBound(const float center[3], const float extents[3])
+	{
+		float d2 = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			float d = extents[k] / 65535.0f + (fabsf(center[k]) + extents[k]) * ldexpf(1.0f, -22);
+			d2 += d * d;
+		}
+		return sqrtf(d2);
+	}
+
+	// Half-float rounding: half an ulp of 11 significant bits, or of the smallest normal
+	float texcoordBound(const vector<MeshCook::Vertex>& vertices)
+	{
+		float largest = 0;
+		for (auto& v : vertices)
+			largest = (max)(largest, (max)(fabsf(v.textureCoordinate.x), fabsf(v.textureCoordinate.y)));
+		return (max)(largest * ldexpf(1.0f, -11), ldexpf(1.0f, -25));
+	}
+
+	bool same(const VertexQuantizer::QuantizationError& a, const VertexQuantizer::QuantizationError& b)
+	{
+		return a.maxPosition == b.maxPosition && a.maxNormalDegrees == b.maxNormalDegrees && a.maxTexcoord == b.maxTexcoord;
+	}
+
+	void print(const char* name, size_t count, const VertexQuantizer::QuantizationError& err, float positionLimit, float texcoordLimit)
+	{
+		printf("  %-28s %8zu %12g %12g %12g %12g %12g\n", name, count, err.maxPosition, positionLimit, err.maxNormalDegrees,
+			err.maxTexcoord, texcoordLimit);
+	}
+
+	// Quantizes vertices against bounds, reports and checks the error
+	void quantize(const char* name, const vector<MeshCook::Vertex>& vertices, const float center[3], const float extents[3], unsigned seed)
+	{
+		vector<VertexQuantizer::CompactVertex> compact(vertices.size());
+		auto err = VertexQuantizer::quantize(vertices.data(), vertices.size(), center, extents, compact.data());
+		float positionLimit = positionBound(center, extents);
+		float texcoordLimit = texcoordBound(vertices);
+		print(name, vertices.size(), err, positionLimit, texcoordLimit);
+
+		auto measured = VertexQuantizer::measureError(vertices.data(), compact.data(), compact.size(), center, extents);
+		check(same(err, measured), "quantize() returns what measureError() measures", seed);
+		check(err.maxPosition <= positionLimit, "position within half a step", seed);
+		check(err.maxNormalDegrees <= MaxNormalDegrees, "normal within the octahedral bound", seed);
+		check(err.maxTexcoord <= texcoordLimit, "texcoord within half-float rounding", seed);
+		bool finite = true;
+		for (auto& v : compact)
+		{
+			float n[3];
+			VertexQuantizer::decodeOctahedral(v.normal, n);
+			finite &= isfinite(n[0]) && isfinite(n[1]) && isfinite(n[2]) && v.position[3] == 65535;
+		}
+		check(finite, "decoded normals finite, w = 1", seed);
+	}
+
+	void quantizeFile(const char* fileName)
+	{
+		MeshCook::Mesh mesh;
+		MeshCook::Result error;
+		uint32_t hash = 0;
+		if (!MeshCook::load(fileName, mesh, hash, error))
+		{
+			check(false, fileName, 0);
+			return;
+		}
+		const char* name = strrchr(fileName, '/');
+		quantize(name ? name + 1 : fileName, mesh.vertices, mesh.boundsCenter, mesh.boundsExtents, 0);
+	}
+
+	MeshCook::Vertex vertex(float x, float y, float z, float nx, float ny, float nz, float u, float v)
+	{
+		return { { x, y, z }, { nx, ny, nz }, { u, v } };
+	}
+
+	// Positions in a box, unit normals spread over the sphere, texcoords in [-4, 4)
+	void quantizeRandom(unsigned seed)
+	{
+		mt19937 rng(seed);
+		uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		const float center[3] = { 3.0f, -20.0f, 0.5f };
+		const float extents[3] = { 10.0f, 0.25f, 100.0f };
+		vector<MeshCook::Vertex> vertices;
+		for (int i = 0; i < 100000; i++)
+		{
+			float n[3];
+			float len;
+			do
+			{
+				n[0] = unit(rng), n[1] = unit(rng), n[2] = unit(rng);
+				len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			} while (len < 0.01f || len > 1.0f);
+			vertices.push_back(vertex(center[0] + extents[0] * unit(rng), center[1] + extents[1] * unit(rng), center[2] + extents[2] * unit(rng),
+				n[0] / len, n[1] / len, n[2] / len, unit(rng) * 4, unit(rng) * 4));
+		}
+		quantize("random", vertices, center, extents, seed);
+	}
+
+	// The axes, the folds of the octahedron (z = 0, x or y = 0) and a zero normal
+	void quantizeSpecial()
+	{
+		const float s = sqrtf(0.5f);
+		vector<MeshCook::Vertex> vertices = {
+			vertex(-1, -1, -1, 1, 0, 0, 0, 0),
+			vertex(1, 1, 1, -1, 0, 0, 1, 1),
+			vertex(0, 0, 0, 0, 1, 0, 0.5f, 0.5f),
+			vertex(0, 0, 0, 0, -1, 0, 1e-6f, -1e-6f),
+			vertex(0, 0, 0, 0, 0, 1, 0, 0),
+			vertex(0, 0, 0, 0, 0, -1, 0, 0),
+			vertex(0, 0, 0, s, s, 0, 0, 0),
+			vertex(0, 0, 0, -s, s, 0, 0, 0),
+			vertex(0, 0, 0, s, 0, -s, 0, 0),
+			vertex(0, 0, 0, 0, -s, -s, 0, 0),
+			vertex(0, 0, 0, 0, 0, 0, 0, 0),
+		};
+		const float center[3] = { 0, 0, 0 };
+		const float extents[3] = { 1, 1, 1 };
+		quantize("axes and folds", vertices, center, extents, 0);
+
+		vector<VertexQuantizer::CompactVertex> compact(vertices.size());
+		VertexQuantizer::quantize(vertices.data(), vertices.size(), center, extents, compact.data());
+		check(compact[0].position[0] == 0 && compact[1].position[0] == 65535 && compact[2].position[0] == 32768, "bounds map to 0 and 65535", 0);
+		check(compact.back().normal[0] == 0 && compact.back().normal[1] == 0, "zero normal encodes as zero", 0);
+
+		// A flat mesh: no extent on y
+		vector<MeshCook::Vertex> flat = { vertex(0, 5, 0, 0, 1, 0, 0, 0), vertex(2, 5, 0, 0, 1, 0, 1, 0), vertex(0, 5, 2, 0, 1, 0, 0, 1) };
+		const float flatCenter[3] = { 1, 5, 1 };
+		const float flatExtents[3] = { 1, 0, 1 };
+		quantize("flat bounds", flat, flatCenter, flatExtents, 0);
+	}
+};
+
+int main(int argc, char** argv)
+{
+	printf("  %-28s %8s %12s %12s %12s %12s %12s\n", "mesh", "vertices", "position", "limit", "normal deg", "texcoord", "limit");
+	if (argc > 1)
+	{
+		for (int i = 1; i < argc; i++)
+			quantizeFile(argv[i]);
+	}
+	else
+	{
+		quantizeFile("../Mesh/teapot.obj");
+		quantizeFile("../MeshTex/teapot_tex2.obj");
+	}
+	quantizeRandom(1);
+	quantizeSpecial();
+
+	if (g_failures)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
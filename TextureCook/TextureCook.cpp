@@ -0,0 +1,94 @@
+// Cooks an RGBA8 DDS texture into a block-compressed DX10 DDS with
+// TextureCook::cook(), in place of texconv for the BC formats. An output
+// already cooked from the same texels with the same settings is kept.
+// Portable; on Linux: g++ -std=c++14 -O2 -pthread TextureCook.cpp -o TextureCook
+// Usage: TextureCook input.dds output.dds [bc1|bc1_srgb|bc3|bc3_srgb|bc4|bc5|bc7|bc7_srgb] [fast|normal|high] [threads=N]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../_common/TextureCook.h"
+
+namespace
+{
+	struct FormatName
+	{
+		const char* name;
+		uint32_t format;
+	};
+
+	const FormatName g_formats[] = {
+		{ "bc1", DDS::FormatBC1Unorm },
+		{ "bc1_srgb", DDS::FormatBC1UnormSrgb },
+		{ "bc3", DDS::FormatBC3Unorm },
+		{ "bc3_srgb", DDS::FormatBC3UnormSrgb },
+		{ "bc4", DDS::FormatBC4Unorm },
+		{ "bc5", DDS::FormatBC5Unorm },
+		{ "bc7", DDS::FormatBC7Unorm },
+		{ "bc7_srgb", DDS::FormatBC7UnormSrgb },
+	};
+
+	const FormatName g_qualities[] = {
+		{ "fast", static_cast<uint32_t>(BC::Quality::Fast) },
+		{ "normal", static_cast<uint32_t>(BC::Quality::Normal) },
+		{ "high", static_cast<uint32_t>(BC::Quality::High) },
+	};
+
+	template<size_t N>
+	bool find(const FormatName (&names)[N], const char* name, uint32_t& value)
+	{
+		for (auto& n : names)
+		{
+			if (strcmp(n.name, name) == 0)
+			{
+				value = n.format;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: TextureCook input.dds output.dds [bc1|bc1_srgb|bc3|bc3_srgb|bc4|bc5|bc7|bc7_srgb] [fast|normal|high] [threads=N]\n");
+		return 1;
+	}
+
+	uint32_t format = DDS::FormatBC1Unorm;
+	uint32_t quality = static_cast<uint32_t>(BC::Quality::Normal);
+	unsigned threadCount = 0; // one per core
+	for (int i = 3; i < argc; i++)
+	{
+		if (strncmp(argv[i], "threads=", 8) == 0)
+		{
+			threadCount = (unsigned)atoi(argv[i] + 8);
+		}
+		else if (!find(g_formats, argv[i], format) && !find(g_qualities, argv[i], quality))
+		{
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	switch (TextureCook::cook(argv[1], argv[2], format, static_cast<BC::Quality>(quality), threadCount))
+	{
+	case TextureCook::Result::Cooked:
+		printf("Cooked %s\n", argv[2]);
+		return 0;
+	case TextureCook::Result::UpToDate:
+		printf("%s is up to date\n", argv[2]);
+		return 0;
+	case TextureCook::Result::SourceNotFound:
+		fprintf(stderr, "Cannot read %s\n", argv[1]);
+		return 1;
+	case TextureCook::Result::UnsupportedFormat:
+		fprintf(stderr, "%s is not a 2D RGBA8 texture\n", argv[1]);
+		return 1;
+	case TextureCook::Result::WriteFailed:
+	default:
+		fprintf(stderr, "Cannot write %s\n", argv[2]);
+		return 1;
+	}
+}
@@ -3,13 +3,17 @@
 #include <wrl/client.h>
 #include <fstream>
 #include <vector>
-#include <tuple>
 #include <algorithm>
 #include <stdexcept>
 #include <dxgi1_3.h>
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include "../_common/dxcommon.h"
+#include "../_common/BCDecoder.h"
+#include "../_common/DDSTexture.h"
+#include "../_common/MipGenerator.h"
+#include "../_common/TextureCook.h"
+#include "../_common/UploadRing.h"
 
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3d12.lib")
@@ -19,6 +23,15 @@ using namespace std;
 using Microsoft::WRL::ComPtr;
 
 #define USE_BC1_TEXTURE 1
+// Compress d3d12.dds to BC1 at startup (skipped while the cooked file is up to date)
+// instead of loading the texconv-made d3d12_bc1.dds
+#define USE_TEXTURE_COOK 1
+// Build the mip chain on the CPU from mip 0 instead of using the mips in the file
+// (always done for single-level files). Needs an uncompressed texture.
+#define USE_CPU_MIP_GENERATION 0
+// Decode the BC texture on the CPU and upload RGBA8 even when the device can sample
+// the BC format (the decode is always done when it cannot)
+#define USE_BC_DECODE_FALLBACK 0
 
 namespace
 {
@@ -56,16 +69,14 @@ class D3D
 
 	ComPtr<ID3D12RootSignature> mRootSignature;
 	ComPtr<ID3D12PipelineState> mPso;
-	ComPtr<ID3D12Resource> mTexUpload;
+	UploadRing<ID3D12Resource*> mUploadRing; // Staging memory, released by fence value
+	UploadRing<ID3D12Resource*>::Allocation mTexUpload = {};
 	ComPtr<ID3D12Resource> mTexDefault;
-	vector<tuple<unsigned int, unsigned int, unsigned int>> mTexMipSize; // <0>width, <1>height, <2>uploadHeapOffset
-
-	unsigned int texAlign(unsigned int s) {
-		return (s + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1u) & ~(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
-	};
-	unsigned int pitchAlign(unsigned int w) {
-		return (w + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1u) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
-	};
+	DDS::File mTexFile;
+	DDS::TextureDesc mTexDesc;
+	vector<DDS::Subresource> mTexSubresources; // File texels, or the decoded ones below
+	vector<vector<uint8_t>> mTexDecoded;
+	vector<DDS::Footprint> mTexFootprints; // Upload heap layout per mip
 
 public:
 	D3D(int width, int height, HWND hWnd)
@@ -211,110 +222,104 @@ public:
 		vs->Release();
 		ps->Release();
 
-		{
-			// Calcurate Mip
-			unsigned int initialWidth = 256, initialHeight = 256;
-			unsigned int bytePerPixel = 4;
-#if USE_BC1_TEXTURE
-			unsigned int bcByte = 8;
-#endif
-			auto minSize = min(initialHeight, initialWidth);
-			DWORD mipCount;
-			unsigned int copyDestOffset = 0;
-			unsigned int copyDestTotalSize = 0;
-			if (minSize == 1)
-			{
-				mTexMipSize.resize(1);
-				mTexMipSize[0] = make_tuple(1, 1, copyDestOffset);
-			}
-			else
+#define UPLOAD_RING_SIZE (4 * 1024 * 1024) // Larger uploads get their own buffer
+		bool uploadRingCreated = mUploadRing.init(UPLOAD_RING_SIZE,
+			[this](uint64_t size, UploadRing<ID3D12Resource*>::Buffer& buffer)
 			{
-				_BitScanReverse(&mipCount, minSize - 1);
-				mTexMipSize.resize(mipCount + 2);
-				int w = initialWidth;
-				int h = initialHeight;
-				mTexMipSize[0] = make_tuple(w, h, copyDestOffset);
-				for (auto i = 1u; i < mTexMipSize.size(); i++)
+				ID3D12Resource* resource = nullptr;
+				if (FAILED(mDev->CreateCommittedResource(
+					&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+					D3D12_HEAP_FLAG_NONE,
+					&CD3DX12_RESOURCE_DESC::Buffer(size),
+					D3D12_RESOURCE_STATE_GENERIC_READ,
+					nullptr,
+					IID_PPV_ARGS(&resource))))
+					return false;
+				resource->SetName(L"UploadRing");
+				void* data = nullptr;
+				if (FAILED(resource->Map(0, nullptr, &data)))
 				{
-					int cw = w, ch = h;
-#if USE_BC1_TEXTURE
-					cw = (w + 3) / 4;
-					ch = (h + 3) / 4;
-#endif
-					copyDestOffset += texAlign(pitchAlign(bytePerPixel * cw) * ch);
-					mTexMipSize[i] = make_tuple(w /= 2, h /= 2, copyDestOffset);
+					resource->Release();
+					return false;
 				}
-			}
-			auto& lastSlice = mTexMipSize[mTexMipSize.size() - 1];
-			copyDestTotalSize = get<2>(lastSlice) + texAlign(pitchAlign(bytePerPixel * get<0>(lastSlice)) * get<1>(lastSlice));
-
-			// Read DDS File
-			int totalTexSize = 0;
-#if USE_BC1_TEXTURE
-			for_each(mTexMipSize.cbegin(),
-				mTexMipSize.cend(),
-				[&](auto m) {
-				totalTexSize += ((get<0>(m) + 3) / 4) * ((get<1>(m) + 3) / 4) * bcByte;
+				buffer = { resource, data, resource->GetGPUVirtualAddress(), size };
+				return true;
+			},
+			[](UploadRing<ID3D12Resource*>::Buffer& buffer)
+			{
+				buffer.resource->Unmap(0, nullptr);
+				buffer.resource->Release();
 			});
-#else
-			for_each(mTexMipSize.cbegin(),
-				mTexMipSize.cend(),
-				[&](auto m) { totalTexSize += get<0>(m) * get<1>(m) * bytePerPixel; });
-#endif
-			vector<char> texData(totalTexSize);
+		if (!uploadRingCreated)
+			throw runtime_error("Failed to create upload ring.");
 
-#if USE_BC1_TEXTURE
-			ifstream ifs("d3d12_bc1.dds", ios::binary);
+		{
+			// Read DDS File
+#if USE_BC1_TEXTURE && USE_TEXTURE_COOK
+			auto cookResult = TextureCook::cook("d3d12.dds", "d3d12_bc1.cooked.dds", DDS::FormatBC1Unorm, BC::Quality::High);
+			if (cookResult != TextureCook::Result::Cooked && cookResult != TextureCook::Result::UpToDate)
+				throw runtime_error("Texture cooking failed.");
+			if (!mTexFile.open("d3d12_bc1.cooked.dds"))
+#elif USE_BC1_TEXTURE
+			if (!mTexFile.open("d3d12_bc1.dds"))
 #else
-			ifstream ifs("d3d12.dds", ios::binary);
+			if (!mTexFile.open("d3d12.dds"))
 #endif
-			if (!ifs)
 				throw runtime_error("Texture not found.");
-			ifs.seekg(128, ios::beg); // Skip DDS header
-			ifs.read(texData.data(), texData.size());
-			auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(copyDestTotalSize, D3D12_RESOURCE_FLAG_NONE, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
-			CHK(mDev->CreateCommittedResource(
-				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-				D3D12_HEAP_FLAG_NONE,
-				&resourceDesc,
-				D3D12_RESOURCE_STATE_GENERIC_READ,
-				nullptr,
-				IID_PPV_ARGS(mTexUpload.ReleaseAndGetAddressOf())));
-			mTexUpload->SetName(L"Texure");
-
-			int copySrcOffset = 0;
-			char *dest;
-			CHK(mTexUpload->Map(0, nullptr, reinterpret_cast<void**>(&dest)));
-			for (auto i = 0u; i < mTexMipSize.size(); ++i)
+			mTexDesc = mTexFile.desc();
+			if (mTexDesc.dimension != DDS::DimensionTexture2D || mTexDesc.arraySize != 1)
+				throw runtime_error("Texture format is not supported.");
+			mTexSubresources = mTexFile.subresources();
+
+			D3D12_FEATURE_DATA_FORMAT_SUPPORT formatSupport = { static_cast<DXGI_FORMAT>(mTexDesc.format) };
+			if (DDS::isBlockCompressed(mTexDesc.format) && (USE_BC_DECODE_FALLBACK ||
+				FAILED(mDev->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &formatSupport, sizeof(formatSupport))) ||
+				!(formatSupport.Support1 & D3D12_FORMAT_SUPPORT1_TEXTURE2D)))
 			{
-				auto curSlice = mTexMipSize[i];
-				auto cw = get<0>(curSlice), ch = get<1>(curSlice);
-#if USE_BC1_TEXTURE
-				cw = (cw + 3) / 4;
-				ch = (ch + 3) / 4;
-#endif
-				for (auto h = 0u; h < ch; ++h)
+				// Upload decoded texels instead
+				auto pixelBytes = BC::decodedPixelBytes(mTexDesc.format);
+				if (!BC::decode(mTexDesc, mTexSubresources, mTexDecoded))
+					throw runtime_error("Texture format is not supported.");
+				mTexDesc.format = BC::decodedFormat(mTexDesc.format);
+				for (auto i = 0u; i < mTexSubresources.size(); ++i)
 				{
-					auto r = get<2>(curSlice) + pitchAlign(bytePerPixel * cw) * h;
-#if USE_BC1_TEXTURE
-					auto s = bcByte * cw;
-#else
-					auto s = bytePerPixel * cw;
-#endif
-					memcpy_s(dest + r, s, texData.data() + copySrcOffset, s); // To maximize WC memory writing performance, size should be aligned by 16 byte on x86.
-					copySrcOffset += s;
+					auto& s = mTexSubresources[i];
+					s.data = mTexDecoded[i].data();
+					s.rowSize = s.width * pixelBytes;
+					s.rowCount = s.height;
+					s.slicePitch = static_cast<size_t>(s.rowSize) * s.rowCount;
+				}
+			}
+			bool generateMips = (USE_CPU_MIP_GENERATION || mTexDesc.mipLevels == 1) && MipGenerator::isSupported(mTexDesc.format);
+			if (generateMips)
+				mTexDesc.mipLevels = MipGenerator::fullMipCount(mTexDesc.width, mTexDesc.height);
+
+			// Upload heap layout of every mip, relative to the start of the staging allocation
+			auto copyDestTotalSize = DDS::computeFootprints(mTexDesc, mTexFootprints);
+			mTexUpload = mUploadRing.allocate(copyDestTotalSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+			if (!mTexUpload.data)
+				throw runtime_error("Failed to allocate upload memory.");
+
+			auto* dest = static_cast<uint8_t*>(mTexUpload.data);
+			if (generateMips)
+			{
+				auto& level0 = mTexSubresources[0];
+				MipGenerator::generate(mTexDesc.format, level0.data, level0.rowSize, mTexDesc.width, mTexDesc.height,
+					dest, mTexFootprints.data(), mTexDesc.mipLevels, MipGenerator::Filter::Kaiser);
+			}
+			else
+			{
+				for (auto i = 0u; i < mTexFootprints.size(); ++i)
+				{
+					DDS::copySubresource(dest, mTexFootprints[i], mTexSubresources[i]);
 				}
 			}
-			mTexUpload->Unmap(0, nullptr);
 		}
 
-		DXGI_FORMAT texFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
-#if USE_BC1_TEXTURE
-		texFormat = DXGI_FORMAT_BC1_UNORM;
-#endif
+		DXGI_FORMAT texFormat = static_cast<DXGI_FORMAT>(mTexDesc.format);
 		{
 			auto resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-				texFormat, get<0>(mTexMipSize[0]), get<1>(mTexMipSize[0]), 1, (UINT16)mTexMipSize.size(),
+				texFormat, mTexDesc.width, mTexDesc.height, 1, (UINT16)mTexDesc.mipLevels,
 				1, 0, D3D12_RESOURCE_FLAG_NONE,
 				D3D12_TEXTURE_LAYOUT_UNKNOWN, 0);
 			CHK(mDev->CreateCommittedResource(
@@ -329,7 +334,7 @@ public:
 		srvDesc.Format = texFormat;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-		srvDesc.Texture2D.MipLevels = mTexMipSize.size();
+		srvDesc.Texture2D.MipLevels = mTexDesc.mipLevels;
 		srvDesc.Texture2D.MostDetailedMip = 0;
 		srvDesc.Texture2D.PlaneSlice = 0;
 		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
@@ -369,51 +374,32 @@ public:
 		// Copy texture from upload heap to default heap
 		if (mFrameCount == 1)
 		{
-			for (auto i = 0u; i < mTexMipSize.size(); i++)
+			for (auto i = 0u; i < mTexFootprints.size(); i++)
 			{
+				const DDS::Footprint& footprint = mTexFootprints[i];
 				D3D12_TEXTURE_COPY_LOCATION srcLoc = {};
-				srcLoc.pResource = mTexUpload.Get();
+				srcLoc.pResource = mTexUpload.resource;
 				srcLoc.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-				srcLoc.PlacedFootprint.Offset = get<2>(mTexMipSize[i]);
-#if USE_BC1_TEXTURE
-				srcLoc.PlacedFootprint.Footprint.Format = DXGI_FORMAT_BC1_UNORM;
-				srcLoc.PlacedFootprint.Footprint.Width = max(4, get<0>(mTexMipSize[i]));
-				srcLoc.PlacedFootprint.Footprint.Height = max(4, get<1>(mTexMipSize[i]));
-				auto cw = (get<0>(mTexMipSize[i]) + 3) / 4;
-				srcLoc.PlacedFootprint.Footprint.RowPitch = pitchAlign(cw * 8);
-#else
-				srcLoc.PlacedFootprint.Footprint.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-				srcLoc.PlacedFootprint.Footprint.Width = get<0>(mTexMipSize[i]);
-				srcLoc.PlacedFootprint.Footprint.Height = get<1>(mTexMipSize[i]);
-				srcLoc.PlacedFootprint.Footprint.RowPitch = pitchAlign(get<0>(mTexMipSize[i]) * 4);
-#endif
-				srcLoc.PlacedFootprint.Footprint.Depth = 1;
+				srcLoc.PlacedFootprint.Offset = mTexUpload.offset + footprint.offset;
+				srcLoc.PlacedFootprint.Footprint.Format = static_cast<DXGI_FORMAT>(footprint.format);
+				srcLoc.PlacedFootprint.Footprint.Width = footprint.width;
+				srcLoc.PlacedFootprint.Footprint.Height = footprint.height;
+				srcLoc.PlacedFootprint.Footprint.Depth = footprint.depth;
+				srcLoc.PlacedFootprint.Footprint.RowPitch = footprint.rowPitch;
 				D3D12_TEXTURE_COPY_LOCATION destLoc = {};
 				destLoc.pResource = mTexDefault.Get();
 				destLoc.SubresourceIndex = i;
 				destLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
 				D3D12_BOX box = {};
-#if USE_BC1_TEXTURE
-				box.right = max(4, get<0>(mTexMipSize[i]));
-				box.bottom = max(4, get<1>(mTexMipSize[i]));
-#else
-				box.right = get<0>(mTexMipSize[i]);
-				box.bottom = get<1>(mTexMipSize[i]);
-#endif
-				box.back = 1;
+				box.right = footprint.width; // BC footprints are already rounded up to whole blocks
+				box.bottom = footprint.height;
+				box.back = footprint.depth;
 				mCmdList->CopyTextureRegion(&destLoc, 0, 0, 0, &srcLoc, &box);
 			}
 
 			setResourceBarrier(mCmdList.Get(), mTexDefault.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 		}
 
-		// Release intermediate texture
-		// Attention: Texture deleting must do while it is NOT referred by command list, or you will get segfalut or device removing.
-		if (mFrameCount == 2)
-		{
-			mTexUpload.Reset();
-		}
-
 		// Barrier Present -> RenderTarget
 		setResourceBarrier(mCmdList.Get(), d3dBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
 
@@ -471,10 +457,14 @@ public:
 		// Wait for queue flushed
 		// This code would occur CPU stall!
 		CHK(mCmdQueue->Signal(mFence.Get(), mFrameCount));
+		mUploadRing.close(mFrameCount);
 		DWORD wait = WaitForSingleObject(mFenceEveneHandle, 10000);
 		if (wait != WAIT_OBJECT_0)
 			throw runtime_error("Failed WaitForSingleObject().");
 
+		// Staging memory is released only once the copies reading it have executed
+		mUploadRing.reclaim(mFence->GetCompletedValue());
+
 		CHK(mCmdAlloc->Reset());
 		CHK(mCmdList->Reset(mCmdAlloc.Get(), nullptr));
 	}
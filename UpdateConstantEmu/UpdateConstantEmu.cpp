@@ -6,6 +6,8 @@
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include "../_common/dxcommon.h"
+#include "../_common/BufferUpdater.h"
+#include "../_common/UploadRing.h"
 
 #include <DirectXMath.h>
 using DirectX::XMFLOAT3; // for WaveFrontReader
@@ -53,7 +55,8 @@ class D3D
 	ComPtr<ID3D12DescriptorHeap> mDescHeapRtv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapDsv;
 	ComPtr<ID3D12DescriptorHeap> mDescHeapCbvSrvUav;
-	void* mCBUploadPtr = nullptr;
+	UploadRing<ID3D12Resource*> mUploadRing; // Update data of every frame in flight
+	BufferUpdater<ID3D12Resource*> mBufferUpdater; // UpdateSubresource emulation
 
 	ComPtr<ID3D12RootSignature> mRootSignature;
 	ComPtr<ID3D12PipelineState> mPso;
@@ -64,8 +67,7 @@ class D3D
 	UINT mVBIndexOffset = 0;
 	ComPtr<ID3D12Resource> mDB;
 	ComPtr<ID3D12Resource> mCB;
-
-	ComPtr<ID3D12Resource> mUpdateBuffer;
+	BufferUpdater<ID3D12Resource*>::Handle mCBHandle = 0;
 
 public:
 	D3D(int width, int height, HWND hWnd)
@@ -294,21 +296,41 @@ public:
 		mDev->CreateConstantBufferView(
 			&cbvDesc,
 			mDescHeapCbvSrvUav->GetCPUDescriptorHandleForHeapStart());
-
-		CHK(mDev->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(cbSize * MaxFrameLatency),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(mUpdateBuffer.ReleaseAndGetAddressOf())));
-		mUpdateBuffer->SetName(L"UpdateBuffer");
-
-		CHK(mUpdateBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mCBUploadPtr)));
+		mCBHandle = mBufferUpdater.registerBuffer(mCB.Get(), cbSize);
+
+#define UPLOAD_RING_SIZE (64 * 1024) // Larger updates get their own buffer
+		bool uploadRingCreated = mUploadRing.init(UPLOAD_RING_SIZE,
+			[this](uint64_t size, UploadRing<ID3D12Resource*>::Buffer& buffer)
+			{
+				ID3D12Resource* resource = nullptr;
+				if (FAILED(mDev->CreateCommittedResource(
+					&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+					D3D12_HEAP_FLAG_NONE,
+					&CD3DX12_RESOURCE_DESC::Buffer(size),
+					D3D12_RESOURCE_STATE_GENERIC_READ,
+					nullptr,
+					IID_PPV_ARGS(&resource))))
+					return false;
+				resource->SetName(L"UploadRing");
+				void* data = nullptr;
+				if (FAILED(resource->Map(0, nullptr, &data)))
+				{
+					resource->Release();
+					return false;
+				}
+				buffer = { resource, data, resource->GetGPUVirtualAddress(), size };
+				return true;
+			},
+			[](UploadRing<ID3D12Resource*>::Buffer& buffer)
+			{
+				buffer.resource->Unmap(0, nullptr);
+				buffer.resource->Release();
+			});
+		if (!uploadRingCreated)
+			throw runtime_error("Failed to create upload ring.");
 	}
 	~D3D()
 	{
-		mUpdateBuffer->Unmap(0, nullptr);
 		CloseHandle(mFenceEveneHandle);
 	}
 	ID3D12Device* GetDevice() const
@@ -333,6 +355,7 @@ public:
 
 			CHK(mCmdAlloc[cmdIndex]->Reset());
 		}
+		mUploadRing.reclaim(mFence->GetCompletedValue());
 
 		CHK(cmdList->Reset(mCmdAlloc[cmdIndex].Get(), nullptr));
 
@@ -350,14 +373,23 @@ public:
 
 			auto worldTransMat = XMMatrixTranspose(worldMat);
 
-			// mCBUploadPtr is Write-Combine memory
-			// Shift offset to guarantee that the pointer has not referred by executing command list.
-			char* ptr = reinterpret_cast<char*>(mCBUploadPtr) + CB_SIZE * cmdIndex;
-			memcpy_s(ptr, 64, &mvpMat, 64);
-			memcpy_s(ptr + 64, 64, &worldTransMat, 64);
+			// Like ID3D11DeviceContext::UpdateSubresource with a destination box
+			mBufferUpdater.update(mCBHandle, 0, &mvpMat, 64);
+			mBufferUpdater.update(mCBHandle, 64, &worldTransMat, 64);
+
+			// Copy the changed ranges of every buffer through the ring, which is Write-Combine memory
+			auto updateSize = mBufferUpdater.prepare();
+			if (updateSize)
+			{
+				auto update = mUploadRing.allocate(updateSize);
+				if (!update.data)
+					throw runtime_error("Failed to allocate upload memory.");
+				mBufferUpdater.flush(update.data, [&](ID3D12Resource* dst, uint64_t dstOffset, uint64_t stagingOffset, uint64_t size)
+				{
+					cmdList->CopyBufferRegion(dst, dstOffset, update.resource, update.offset + stagingOffset, size);
+				});
+			}
 		}
-		// Copy UpdateBuffer to ConstantBuffer
-		cmdList->CopyBufferRegion(mCB.Get(), 0, mUpdateBuffer.Get(), CB_SIZE * cmdIndex, CB_SIZE);
 
 		// Get current RTV descriptor
 		auto descHandleRtvStep = mDev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -415,6 +447,7 @@ public:
 		ID3D12CommandList* const cmdLists = cmdList;
 		cmdQueue->ExecuteCommandLists(1, &cmdLists);
 		CHK(cmdQueue->Signal(mFence.Get(), mFrameCount));
+		mUploadRing.close(mFrameCount);
 
 		// Present
 		CHK(mSwapChain->Present(1, 0));
@@ -0,0 +1,704 @@
+#pragma once
+
+// Block compression for BC1, BC3, BC4, BC5 and BC7 (UNORM / sRGB) from 8-bit RGBA.
+//   BC1/BC3 color : principal-axis range fit, least-squares refinement
+//   BC4/BC5       : min/max fit in both interpolation modes, endpoint search
+//   BC7           : mode 6 only (one subset, RGBA 7.7.7.7 + p-bit, 4-bit indices)
+// Candidate endpoints are scored by fitIndices, which evaluates four pixels
+// at a time with SSE2 when available. Surfaces are compressed in parallel by
+// rows of blocks. Channels are weighted equally and sRGB data is compressed
+// in gamma space, like texconv's defaults.
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "DDSTexture.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BC_COMPRESSOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace BC
+{
+	enum class Quality
+	{
+		Fast,       // Bounding box endpoints, one mode
+		Normal,     // Principal axis fit, one refinement
+		High,       // More refinement and mode/endpoint search
+	};
+
+	inline bool isSupported(uint32_t format)
+	{
+		switch (format)
+		{
+		case DDS::FormatBC1Unorm:
+		case DDS::FormatBC1UnormSrgb:
+		case DDS::FormatBC3Unorm:
+		case DDS::FormatBC3UnormSrgb:
+		case DDS::FormatBC4Unorm:
+		case DDS::FormatBC5Unorm:
+		case DDS::FormatBC7Unorm:
+		case DDS::FormatBC7UnormSrgb:
+			return true;
+		}
+		return false;
+	}
+
+	// 4x4 pixels as planar floats (0-255), so four pixels fit one SSE register
+	struct Block
+	{
+		alignas(16) float v[4][16];
+	};
+
+	namespace detail
+	{
+		// Chooses the nearest palette entry for every pixel over the given channels
+		// (16-byte aligned planes). Returns the summed squared error.
+		inline float fitIndices(const float* const* channels, int channelCount, const float (*palette)[4], int paletteSize,
+			uint8_t indices[16])
+		{
+			float total = 0;
+#if BC_COMPRESSOR_SSE2
+			for (int i = 0; i < 16; i += 4)
+			{
+				__m128 best = _mm_set1_ps(FLT_MAX);
+				__m128i bestIndex = _mm_setzero_si128();
+				for (int p = 0; p < paletteSize; ++p)
+				{
+					__m128 d = _mm_setzero_ps();
+					for (int c = 0; c < channelCount; ++c)
+					{
+						__m128 t = _mm_sub_ps(_mm_load_ps(channels[c] + i), _mm_set1_ps(palette[p][c]));
+						d = _mm_add_ps(d, _mm_mul_ps(t, t));
+					}
+					__m128i less = _mm_castps_si128(_mm_cmplt_ps(d, best));
+					best = _mm_min_ps(d, best);
+					bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(p)), _mm_andnot_si128(less, bestIndex));
+				}
+				alignas(16) float e[4];
+				alignas(16) int32_t index[4];
+				_mm_store_ps(e, best);
+				_mm_store_si128(reinterpret_cast<__m128i*>(index), bestIndex);
+				for (int k = 0; k < 4; ++k)
+				{
+					indices[i + k] = static_cast<uint8_t>(index[k]);
+					total += e[k];
+				}
+			}
+#else
+			for (int i = 0; i < 16; ++i)
+			{
+				float best = FLT_MAX;
+				for (int p = 0; p < paletteSize; ++p)
+				{
+					float d = 0;
+					for (int c = 0; c < channelCount; ++c)
+					{
+						float t = channels[c][i] - palette[p][c];
+						d += t * t;
+					}
+					if (d < best)
+					{
+						best = d;
+						indices[i] = static_cast<uint8_t>(p);
+					}
+				}
+				total += best;
+			}
+#endif
+			return total;
+		}
+
+		// Mean and dominant direction of the pixels (power iteration on the covariance).
+		// include may be null; excluded pixels do not contribute.
+		inline void principalAxis(const Block& b, int channelCount, const bool* include, float mean[4], float axis[4])
+		{
+			float n = 0;
+			for (int c = 0; c < 4; ++c)
+				mean[c] = axis[c] = 0;
+			for (int i = 0; i < 16; ++i)
+			{
+				if (include && !include[i])
+					continue;
+				for (int c = 0; c < channelCount; ++c)
+					mean[c] += b.v[c][i];
+				n += 1;
+			}
+			if (n == 0)
+				return;
+			for (int c = 0; c < channelCount; ++c)
+				mean[c] /= n;
+
+			float cov[4][4] = {};
+			for (int i = 0; i < 16; ++i)
+			{
+				if (include && !include[i])
+					continue;
+				for (int r = 0; r < channelCount; ++r)
+				{
+					for (int c = r; c < channelCount; ++c)
+						cov[r][c] += (b.v[r][i] - mean[r]) * (b.v[c][i] - mean[c]);
+				}
+			}
+			for (int r = 0; r < channelCount; ++r)
+			{
+				for (int c = 0; c < r; ++c)
+					cov[r][c] = cov[c][r];
+			}
+
+			// Start from the diagonal, which is never orthogonal to the main axis of natural blocks
+			float v[4] = { 1, 1, 1, 1 };
+			for (int iteration = 0; iteration < 8; ++iteration)
+			{
+				float w[4] = {}, len = 0;
+				for (int r = 0; r < channelCount; ++r)
+				{
+					for (int c = 0; c < channelCount; ++c)
+						w[r] += cov[r][c] * v[c];
+					len = (std::max)(len, fabsf(w[r]));
+				}
+				if (len < 1e-8f)
+					break;
+				for (int c = 0; c < channelCount; ++c)
+					v[c] = w[c] / len;
+			}
+			float len = 0;
+			for (int c = 0; c < channelCount; ++c)
+				len += v[c] * v[c];
+			len = sqrtf(len);
+			for (int c = 0; c < channelCount; ++c)
+				axis[c] = v[c] / len;
+		}
+
+		// Endpoints at the extreme projections of the pixels onto the axis
+		inline void rangeFit(const Block& b, int channelCount, const bool* include, float e0[4], float e1[4])
+		{
+			float mean[4], axis[4];
+			principalAxis(b, channelCount, include, mean, axis);
+			float tMin = FLT_MAX, tMax = -FLT_MAX;
+			for (int i = 0; i < 16; ++i)
+			{
+				if (include && !include[i])
+					continue;
+				float t = 0;
+				for (int c = 0; c < channelCount; ++c)
+					t += (b.v[c][i] - mean[c]) * axis[c];
+				tMin = (std::min)(tMin, t);
+				tMax = (std::max)(tMax, t);
+			}
+			if (tMin > tMax)
+				tMin = tMax = 0;
+			for (int c = 0; c < channelCount; ++c)
+			{
+				e0[c] = (std::max)(0.0f, (std::min)(255.0f, mean[c] + axis[c] * tMax));
+				e1[c] = (std::max)(0.0f, (std::min)(255.0f, mean[c] + axis[c] * tMin));
+			}
+		}
+
+		// Per channel bounding box, inset by 1/16 of the range to account for the interpolated entries
+		inline void boxFit(const Block& b, int channelCount, const bool* include, float e0[4], float e1[4])
+		{
+			for (int c = 0; c < channelCount; ++c)
+			{
+				float lo = 255, hi = 0;
+				for (int i = 0; i < 16; ++i)
+				{
+					if (include && !include[i])
+						continue;
+					lo = (std::min)(lo, b.v[c][i]);
+					hi = (std::max)(hi, b.v[c][i]);
+				}
+				if (lo > hi)
+					lo = hi = 0;
+				float inset = (hi - lo) / 16;
+				e0[c] = hi - inset;
+				e1[c] = lo + inset;
+			}
+		}
+
+		// Least-squares endpoints for fixed indices; weights[i] is the share of e1 in palette entry i.
+		// Returns false when the system is singular (all pixels on one entry).
+		inline bool leastSquares(const Block& b, int channelCount, const bool* include, const uint8_t indices[16],
+			const float* weights, float e0[4], float e1[4])
+		{
+			float aa = 0, ab = 0, bb = 0, ax[4] = {}, bx[4] = {};
+			for (int i = 0; i < 16; ++i)
+			{
+				if (include && !include[i])
+					continue;
+				float beta = weights[indices[i]], alpha = 1 - beta;
+				aa += alpha * alpha;
+				ab += alpha * beta;
+				bb += beta * beta;
+				for (int c = 0; c < channelCount; ++c)
+				{
+					ax[c] += alpha * b.v[c][i];
+					bx[c] += beta * b.v[c][i];
+				}
+			}
+			float det = aa * bb - ab * ab;
+			if (fabsf(det) < 1e-6f)
+				return false;
+			for (int c = 0; c < channelCount; ++c)
+			{
+				e0[c] = (std::max)(0.0f, (std::min)(255.0f, (ax[c] * bb - bx[c] * ab) / det));
+				e1[c] = (std::max)(0.0f, (std::min)(255.0f, (bx[c] * aa - ax[c] * ab) / det));
+			}
+			return true;
+		}
+
+		// --- BC1 color ---
+
+		inline uint16_t to565(const float c[4])
+		{
+			int r = static_cast<int>(c[0] * 31 / 255 + 0.5f);
+			int g = static_cast<int>(c[1] * 63 / 255 + 0.5f);
+			int b = static_cast<int>(c[2] * 31 / 255 + 0.5f);
+			return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+		}
+
+		inline void from565(uint16_t v, float c[4])
+		{
+			int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			c[0] = static_cast<float>((r << 3) | (r >> 2));
+			c[1] = static_cast<float>((g << 2) | (g >> 4));
+			c[2] = static_cast<float>((b << 3) | (b >> 2));
+			c[3] = 255;
+		}
+
+		// Palette of a BC1 color block, as decoded (integer interpolation)
+		inline void bc1Palette(uint16_t c0, uint16_t c1, bool threeColor, float palette[4][4])
+		{
+			from565(c0, palette[0]);
+			from565(c1, palette[1]);
+			for (int c = 0; c < 3; ++c)
+			{
+				int a = static_cast<int>(palette[0][c]), b = static_cast<int>(palette[1][c]);
+				if (threeColor)
+				{
+					palette[2][c] = static_cast<float>((a + b + 1) / 2);
+					palette[3][c] = 0;
+				}
+				else
+				{
+					palette[2][c] = static_cast<float>((2 * a + b + 1) / 3);
+					palette[3][c] = static_cast<float>((a + 2 * b + 1) / 3);
+				}
+			}
+			palette[2][3] = 255;
+			palette[3][3] = threeColor ? 0.0f : 255.0f;
+		}
+
+		struct ColorBlock
+		{
+			uint16_t c0, c1;
+			uint8_t indices[16];
+			float error;
+		};
+
+		// Quantizes the endpoints and fits indices. Four-color blocks need c0 > c1, three-color ones c0 <= c1.
+		inline ColorBlock bc1Evaluate(const Block& b, const bool* opaque, const float e0[4], const float e1[4], bool threeColor)
+		{
+			ColorBlock block;
+			block.c0 = to565(e0);
+			block.c1 = to565(e1);
+			if (threeColor ? block.c0 > block.c1 : block.c0 < block.c1)
+				std::swap(block.c0, block.c1);
+
+			float palette[4][4];
+			bc1Palette(block.c0, block.c1, threeColor, palette);
+			const float* channels[3] = { b.v[0], b.v[1], b.v[2] };
+			// Three-color blocks use index 3 for transparency only
+			int colors = threeColor || block.c0 == block.c1 ? 3 : 4;
+			block.error = fitIndices(channels, 3, palette, colors, block.indices);
+			if (opaque)
+			{
+				for (int i = 0; i < 16; ++i)
+				{
+					if (!opaque[i])
+					{
+						// Remove the color error of transparent pixels again
+						float d = 0;
+						for (int c = 0; c < 3; ++c)
+						{
+							float t = b.v[c][i] - palette[block.indices[i]][c];
+							d += t * t;
+						}
+						block.error -= d;
+						block.indices[i] = 3;
+					}
+				}
+			}
+			return block;
+		}
+
+		inline void bc1Refine(const Block& b, const bool* opaque, bool threeColor, int iterations, ColorBlock& best)
+		{
+			static const float FourColorWeights[4] = { 0, 1, 1.0f / 3, 2.0f / 3 };
+			static const float ThreeColorWeights[4] = { 0, 1, 0.5f, 0 };
+			for (int iteration = 0; iteration < iterations; ++iteration)
+			{
+				float e0[4], e1[4];
+				if (!leastSquares(b, 3, opaque, best.indices, threeColor ? ThreeColorWeights : FourColorWeights, e0, e1))
+					break;
+				ColorBlock candidate = bc1Evaluate(b, opaque, e0, e1, threeColor);
+				if (candidate.error >= best.error)
+					break;
+				best = candidate;
+			}
+		}
+
+		inline void bc1Write(const ColorBlock& block, uint8_t* out)
+		{
+			uint32_t bits = 0;
+			for (int i = 0; i < 16; ++i)
+				bits |= static_cast<uint32_t>(block.indices[i]) << (2 * i);
+			memcpy(out, &block.c0, 2);
+			memcpy(out + 2, &block.c1, 2);
+			memcpy(out + 4, &bits, 4);
+		}
+
+		// allowAlpha selects the three-color mode for blocks with alpha < 128 (BC1 only; BC3 is always four-color)
+		inline void compressColor(const Block& b, Quality quality, bool allowAlpha, uint8_t* out)
+		{
+			bool opaque[16];
+			bool transparent = false;
+			for (int i = 0; i < 16; ++i)
+			{
+				opaque[i] = !allowAlpha || b.v[3][i] >= 128;
+				transparent |= !opaque[i];
+			}
+			const bool* mask = transparent ? opaque : nullptr;
+
+			float e0[4], e1[4];
+			if (quality == Quality::Fast)
+				boxFit(b, 3, mask, e0, e1);
+			else
+				rangeFit(b, 3, mask, e0, e1);
+			ColorBlock best = bc1Evaluate(b, mask, e0, e1, transparent);
+			if (quality != Quality::Fast)
+				bc1Refine(b, mask, transparent, quality == Quality::High ? 4 : 1, best);
+			if (quality == Quality::High && !transparent && allowAlpha)
+			{
+				// The three-color mode's midpoint is sometimes the better fit for opaque blocks
+				// (index 3, transparent black, is never chosen: fitting stops at three colors)
+				ColorBlock three = bc1Evaluate(b, nullptr, e0, e1, true);
+				bc1Refine(b, nullptr, true, 4, three);
+				if (three.error < best.error)
+					best = three;
+			}
+			bc1Write(best, out);
+		}
+
+		// --- BC4 single channel ---
+
+		inline void bc4Palette(int a0, int a1, float palette[8][4])
+		{
+			palette[0][0] = static_cast<float>(a0);
+			palette[1][0] = static_cast<float>(a1);
+			if (a0 > a1)
+			{
+				for (int i = 1; i < 7; ++i)
+					palette[i + 1][0] = static_cast<float>(((7 - i) * a0 + i * a1 + 3) / 7);
+			}
+			else
+			{
+				for (int i = 1; i < 5; ++i)
+					palette[i + 1][0] = static_cast<float>(((5 - i) * a0 + i * a1 + 2) / 5);
+				palette[6][0] = 0;
+				palette[7][0] = 255;
+			}
+		}
+
+		inline float bc4Evaluate(const float* values, int a0, int a1, uint8_t indices[16])
+		{
+			float palette[8][4];
+			bc4Palette(a0, a1, palette);
+			return fitIndices(&values, 1, palette, 8, indices);
+		}
+
+		inline void compressSingle(const float* values, Quality quality, uint8_t* out)
+		{
+			int lo = 255, hi = 0, innerLo = 255, innerHi = 0;
+			for (int i = 0; i < 16; ++i)
+			{
+				int v = static_cast<int>(values[i]);
+				lo = (std::min)(lo, v);
+				hi = (std::max)(hi, v);
+				if (v != 0 && v != 255)
+				{
+					innerLo = (std::min)(innerLo, v);
+					innerHi = (std::max)(innerHi, v);
+				}
+			}
+
+			// Eight-entry mode: a0 > a1
+			int bestA0 = hi, bestA1 = lo;
+			uint8_t indices[16], bestIndices[16];
+			float best = bc4Evaluate(values, bestA0, bestA1, bestIndices);
+			auto tryEndpoints = [&](int a0, int a1)
+			{
+				if (a0 < 0 || a0 > 255 || a1 < 0 || a1 > 255)
+					return;
+				float error = bc4Evaluate(values, a0, a1, indices);
+				if (error < best)
+				{
+					best = error;
+					bestA0 = a0;
+					bestA1 = a1;
+					memcpy(bestIndices, indices, 16);
+				}
+			};
+			if (quality != Quality::Fast && best > 0)
+			{
+				// Six-entry mode (a0 <= a1) with exact 0 and 255 for the outliers
+				if (innerLo <= innerHi)
+					tryEndpoints(innerLo, innerHi);
+				if (quality == Quality::High)
+				{
+					// Pull the endpoints in, the extremes are rarely worth a full palette step
+					int range = hi - lo;
+					int step = (std::max)(1, range / 28);
+					for (int d0 = 0; d0 <= 3; ++d0)
+					{
+						for (int d1 = 0; d1 <= 3; ++d1)
+						{
+							if (hi - d0 * step > lo + d1 * step)
+								tryEndpoints(hi - d0 * step, lo + d1 * step);
+						}
+					}
+				}
+			}
+
+			out[0] = static_cast<uint8_t>(bestA0);
+			out[1] = static_cast<uint8_t>(bestA1);
+			uint64_t bits = 0;
+			for (int i = 0; i < 16; ++i)
+				bits |= static_cast<uint64_t>(bestIndices[i]) << (3 * i);
+			for (int k = 0; k < 6; ++k)
+				out[2 + k] = static_cast<uint8_t>(bits >> (8 * k));
+		}
+
+		// --- BC7 mode 6 ---
+
+		static const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct Mode6Block
+		{
+			int e[2][4];                // 8-bit endpoint values, (7-bit << 1) | p-bit
+			uint8_t indices[16];
+			float error;
+		};
+
+		inline void mode6Palette(const int e[2][4], float palette[16][4])
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				for (int c = 0; c < 4; ++c)
+					palette[i][c] = static_cast<float>(((64 - BC7Weights4[i]) * e[0][c] + BC7Weights4[i] * e[1][c] + 32) >> 6);
+			}
+		}
+
+		inline int quantizeMode6(float v, int pbit)
+		{
+			int q = static_cast<int>((v - pbit) / 2 + 0.5f);
+			return ((std::max)(0, (std::min)(127, q)) << 1) | pbit;
+		}
+
+		// Quantizes float endpoints. With searchPBits all four p-bit combinations are fitted,
+		// otherwise each endpoint takes the p-bit that represents it best.
+		inline Mode6Block mode6Evaluate(const Block& b, const float e0[4], const float e1[4], bool searchPBits)
+		{
+			const float* channels[4] = { b.v[0], b.v[1], b.v[2], b.v[3] };
+			const float* ends[2] = { e0, e1 };
+			int bestGuess = 0;
+			if (!searchPBits)
+			{
+				for (int k = 0; k < 2; ++k)
+				{
+					float error[2] = {};
+					for (int pbit = 0; pbit < 2; ++pbit)
+					{
+						for (int c = 0; c < 4; ++c)
+						{
+							float d = quantizeMode6(ends[k][c], pbit) - ends[k][c];
+							error[pbit] += d * d;
+						}
+					}
+					bestGuess |= (error[1] < error[0] ? 1 : 0) << k;
+				}
+			}
+
+			Mode6Block best;
+			best.error = FLT_MAX;
+			for (int p = searchPBits ? 0 : bestGuess; p < (searchPBits ? 4 : bestGuess + 1); ++p)
+			{
+				Mode6Block candidate;
+				for (int k = 0; k < 2; ++k)
+				{
+					for (int c = 0; c < 4; ++c)
+						candidate.e[k][c] = quantizeMode6(ends[k][c], (p >> k) & 1);
+				}
+				float palette[16][4];
+				mode6Palette(candidate.e, palette);
+				candidate.error = fitIndices(channels, 4, palette, 16, candidate.indices);
+				if (candidate.error < best.error)
+					best = candidate;
+			}
+			return best;
+		}
+
+		struct BitWriter
+		{
+			uint64_t bits[2] = {};
+			int position = 0;
+
+			void write(uint32_t value, int count)
+			{
+				for (int i = 0; i < count; ++i, ++position)
+				{
+					if ((value >> i) & 1)
+						bits[position >> 6] |= 1ull << (position & 63);
+				}
+			}
+		};
+
+		inline void compressMode6(const Block& b, Quality quality, uint8_t* out)
+		{
+			float e0[4], e1[4];
+			if (quality == Quality::Fast)
+				boxFit(b, 4, nullptr, e0, e1);
+			else
+				rangeFit(b, 4, nullptr, e0, e1);
+			Mode6Block best = mode6Evaluate(b, e0, e1, quality == Quality::High);
+
+			float weights[16];
+			for (int i = 0; i < 16; ++i)
+				weights[i] = BC7Weights4[i] / 64.0f;
+			int iterations = quality == Quality::High ? 3 : quality == Quality::Normal ? 1 : 0;
+			for (int iteration = 0; iteration < iterations && best.error > 0; ++iteration)
+			{
+				if (!leastSquares(b, 4, nullptr, best.indices, weights, e0, e1))
+					break;
+				Mode6Block candidate = mode6Evaluate(b, e0, e1, quality == Quality::High);
+				if (candidate.error >= best.error)
+					break;
+				best = candidate;
+			}
+
+			// The anchor (pixel 0) index must have its top bit clear
+			if (best.indices[0] & 8)
+			{
+				for (int c = 0; c < 4; ++c)
+					std::swap(best.e[0][c], best.e[1][c]);
+				for (int i = 0; i < 16; ++i)
+					best.indices[i] = static_cast<uint8_t>(15 - best.indices[i]);
+			}
+
+			BitWriter w;
+			w.write(1 << 6, 7);         // Mode 6
+			for (int c = 0; c < 4; ++c)
+			{
+				w.write(best.e[0][c] >> 1, 7);
+				w.write(best.e[1][c] >> 1, 7);
+			}
+			w.write(best.e[0][0] & 1, 1);
+			w.write(best.e[1][0] & 1, 1);
+			w.write(best.indices[0], 3);
+			for (int i = 1; i < 16; ++i)
+				w.write(best.indices[i], 4);
+			memcpy(out, w.bits, 16);
+		}
+
+		// Reads the 4x4 block at (bx, by), replicating edge pixels of partial blocks
+		inline void loadBlock(const uint8_t* src, size_t rowPitch, uint32_t width, uint32_t height, bool bgra,
+			uint32_t bx, uint32_t by, Block& b)
+		{
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				const uint8_t* row = src + (std::min)(by * 4 + y, height - 1) * rowPitch;
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					const uint8_t* p = row + (std::min)(bx * 4 + x, width - 1) * 4;
+					int i = y * 4 + x;
+					b.v[0][i] = p[bgra ? 2 : 0];
+					b.v[1][i] = p[1];
+					b.v[2][i] = p[bgra ? 0 : 2];
+					b.v[3][i] = p[3];
+				}
+			}
+		}
+
+		template<class Work>
+		void parallelFor(uint32_t count, unsigned int threadCount, Work work)
+		{
+			uint32_t bands = (std::max)(1u, std::min<uint32_t>(threadCount, count));
+			std::vector<std::thread> threads;
+			for (uint32_t i = 1; i < bands; ++i)
+				threads.emplace_back(work, count * i / bands, count * (i + 1) / bands);
+			work(0u, count / bands);
+			for (auto& t : threads)
+				t.join();
+		}
+	};
+
+	// Compresses one block into 8 (BC1, BC4) or 16 bytes.
+	inline void compressBlock(uint32_t format, const Block& b, Quality quality, uint8_t* out)
+	{
+		switch (format)
+		{
+		case DDS::FormatBC1Unorm:
+		case DDS::FormatBC1UnormSrgb:
+			detail::compressColor(b, quality, true, out);
+			break;
+		case DDS::FormatBC3Unorm:
+		case DDS::FormatBC3UnormSrgb:
+			detail::compressSingle(b.v[3], quality, out);
+			detail::compressColor(b, quality, false, out + 8);
+			break;
+		case DDS::FormatBC4Unorm:
+			detail::compressSingle(b.v[0], quality, out);
+			break;
+		case DDS::FormatBC5Unorm:
+			detail::compressSingle(b.v[0], quality, out);
+			detail::compressSingle(b.v[1], quality, out + 8);
+			break;
+		case DDS::FormatBC7Unorm:
+		case DDS::FormatBC7UnormSrgb:
+			detail::compressMode6(b, quality, out);
+			break;
+		}
+	}
+
+	// Compresses an RGBA8 (bgra: BGRA8) surface. dst receives rows of blocks dstRowPitch bytes apart,
+	// so it can be a tightly packed DDS mip or a placed footprint. BC4 takes red, BC5 red and green.
+	inline bool compress(uint32_t format, const void* src, size_t srcRowPitch, uint32_t width, uint32_t height, bool bgra,
+		uint8_t* dst, size_t dstRowPitch, Quality quality = Quality::Normal, unsigned int threadCount = 0)
+	{
+		if (!isSupported(format) || width == 0 || height == 0)
+			return false;
+		if (threadCount == 0)
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+		uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		uint32_t blockBytes = DDS::blockBytes(format);
+		detail::parallelFor(blocksY, threadCount, [&](uint32_t begin, uint32_t end)
+		{
+			Block b;
+			for (uint32_t by = begin; by < end; ++by)
+			{
+				uint8_t* row = dst + by * dstRowPitch;
+				for (uint32_t bx = 0; bx < blocksX; ++bx)
+				{
+					detail::loadBlock(static_cast<const uint8_t*>(src), srcRowPitch, width, height, bgra, bx, by, b);
+					compressBlock(format, b, quality, row + bx * blockBytes);
+				}
+			}
+		});
+		return true;
+	}
+};
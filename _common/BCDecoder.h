@@ -0,0 +1,735 @@
+#pragma once
+
+// Block decompression for BC1-BC7, following the D3D11 functional spec.
+//   BC1-BC3, BC7, BC4/BC5 UNORM -> R8G8B8A8 UNORM (sRGB formats stay sRGB)
+//   BC4/BC5 SNORM               -> R8G8B8A8 SNORM
+//   BC6H                        -> R16G16B16A16 FLOAT
+// 8-bit results match the float reference decoder rounded to the nearest
+// value. BC7 palettes are interpolated four channels at a time with SSE2.
+// Surfaces and whole subresource chains are split into bands of block rows
+// that worker threads take from a shared counter, so one large mip does not
+// serialize the chain.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "DDSTexture.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BC_DECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace BC
+{
+	// Format of the decoded texels, FormatUnknown when format is not a BC format
+	inline uint32_t decodedFormat(uint32_t format)
+	{
+		switch (format)
+		{
+		case 70: case 71: case 73: case 74: case 76: case 77: case 79: case 80: case 82: case 83:
+		case 97: case 98:
+			return DDS::FormatR8G8B8A8Unorm;
+		case 72: case 75: case 78: case 99:
+			return DDS::FormatR8G8B8A8UnormSrgb;
+		case 81: case 84:
+			return DDS::FormatR8G8B8A8Snorm;
+		case 94: case 95: case 96:
+			return DDS::FormatR16G16B16A16Float;
+		}
+		return DDS::FormatUnknown;
+	}
+
+	namespace detail
+	{
+		struct BitReader
+		{
+			uint64_t bits[2];
+			int position = 0;
+
+			explicit BitReader(const uint8_t* block)
+			{
+				memcpy(bits, block, 16);
+			}
+
+			uint32_t read(int count)
+			{
+				if (count == 0)
+					return 0;
+				int shift = position & 63;
+				uint64_t value = bits[position >> 6] >> shift;
+				if (shift + count > 64)
+					value |= bits[1] << (64 - shift);
+				position += count;
+				return static_cast<uint32_t>(value & ((1ull << count) - 1));
+			}
+		};
+
+		static const uint8_t Weights2[4] = { 0, 21, 43, 64 };
+		static const uint8_t Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+		static const uint8_t Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// Subset of each pixel (bit i) for the 64 two-subset partitions
+		static const uint16_t Partitions2[64] = {
+			0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+			0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+			0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+			0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+			0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+			0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+			0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+			0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+		};
+
+		// Subset of each pixel for the 64 three-subset partitions
+		static const uint8_t Partitions3[64][16] = {
+			{ 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 },
+			{ 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+			{ 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 },
+			{ 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+			{ 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 },
+			{ 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+			{ 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 },
+			{ 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+			{ 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 },
+			{ 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+			{ 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 },
+			{ 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+			{ 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 },
+			{ 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+			{ 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 },
+			{ 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+			{ 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 },
+			{ 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+			{ 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 },
+			{ 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+			{ 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 },
+			{ 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+			{ 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 },
+			{ 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+			{ 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 },
+			{ 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+			{ 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 },
+			{ 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+			{ 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 },
+			{ 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+			{ 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 },
+			{ 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 },
+		};
+
+		// Anchor (implicit top index bit) of subset 1 for two-subset partitions
+		static const uint8_t Anchors2[64] = {
+			15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+			15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+			15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+			 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+		};
+
+		// Anchors of subsets 1 and 2 for three-subset partitions
+		static const uint8_t Anchors3[2][64] = {
+			{
+				 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+				 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+				 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+				 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+			},
+			{
+				15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+				15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+				15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+				15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+			},
+		};
+
+		inline int subsetOf(int subsets, int partition, int pixel)
+		{
+			if (subsets == 2)
+				return (Partitions2[partition] >> pixel) & 1;
+			if (subsets == 3)
+				return Partitions3[partition][pixel];
+			return 0;
+		}
+
+		inline bool isAnchor(int subsets, int partition, int pixel)
+		{
+			if (pixel == 0)
+				return true;
+			if (subsets == 2)
+				return pixel == Anchors2[partition];
+			if (subsets == 3)
+				return pixel == Anchors3[0][partition] || pixel == Anchors3[1][partition];
+			return false;
+		}
+
+		// --- BC1-BC5 ---
+
+		inline void decodeColor(const uint8_t* block, bool alwaysFourColor, uint8_t out[16][4])
+		{
+			uint16_t c0, c1;
+			uint32_t indices;
+			memcpy(&c0, block, 2);
+			memcpy(&c1, block + 2, 2);
+			memcpy(&indices, block + 4, 4);
+
+			uint8_t palette[4][4];
+			auto expand = [](uint16_t v, uint8_t c[4])
+			{
+				int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+				c[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+				c[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+				c[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+				c[3] = 255;
+			};
+			expand(c0, palette[0]);
+			expand(c1, palette[1]);
+			bool fourColor = alwaysFourColor || c0 > c1;
+			for (int c = 0; c < 3; ++c)
+			{
+				int a = palette[0][c], b = palette[1][c];
+				if (fourColor)
+				{
+					palette[2][c] = static_cast<uint8_t>((2 * a + b + 1) / 3);
+					palette[3][c] = static_cast<uint8_t>((a + 2 * b + 1) / 3);
+				}
+				else
+				{
+					palette[2][c] = static_cast<uint8_t>((a + b + 1) / 2);
+					palette[3][c] = 0;
+				}
+			}
+			palette[2][3] = 255;
+			palette[3][3] = fourColor ? 255 : 0;
+			for (int i = 0; i < 16; ++i)
+				memcpy(out[i], palette[(indices >> (2 * i)) & 3], 4);
+		}
+
+		// One BC4 channel; snorm values are written as int8 bit patterns
+		inline void decodeSingle(const uint8_t* block, bool snorm, uint8_t* out, int stride)
+		{
+			int palette[8];
+			int a0 = snorm ? (std::max)(-127, static_cast<int>(static_cast<int8_t>(block[0]))) : block[0];
+			int a1 = snorm ? (std::max)(-127, static_cast<int>(static_cast<int8_t>(block[1]))) : block[1];
+			// Rounds to nearest, halves away from zero, like the float reference
+			auto lerp = [](int a, int b, int i, int n)
+			{
+				int v = (n - i) * a + i * b;
+				return v >= 0 ? (v + n / 2) / n : -((-v + n / 2) / n);
+			};
+			palette[0] = a0;
+			palette[1] = a1;
+			if (a0 > a1)
+			{
+				for (int i = 1; i < 7; ++i)
+					palette[i + 1] = lerp(a0, a1, i, 7);
+			}
+			else
+			{
+				for (int i = 1; i < 5; ++i)
+					palette[i + 1] = lerp(a0, a1, i, 5);
+				palette[6] = snorm ? -127 : 0;
+				palette[7] = snorm ? 127 : 255;
+			}
+			uint64_t indices = 0;
+			for (int k = 0; k < 6; ++k)
+				indices |= static_cast<uint64_t>(block[2 + k]) << (8 * k);
+			for (int i = 0; i < 16; ++i)
+				out[i * stride] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+		}
+
+		// --- BC7 ---
+
+		struct BC7Mode
+		{
+			uint8_t subsets, partitionBits, rotationBits, indexSelectionBits;
+			uint8_t colorBits, alphaBits, endpointPBits, sharedPBits, indexBits, secondaryIndexBits;
+		};
+
+		static const BC7Mode BC7Modes[8] = {
+			{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+			{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+			{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+			{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+			{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+			{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+			{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+			{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+		};
+
+		inline const uint8_t* weightsFor(int bits)
+		{
+			return bits == 2 ? Weights2 : bits == 3 ? Weights3 : Weights4;
+		}
+
+		// palette[i] = ((64 - w[i]) * e0 + w[i] * e1 + 32) >> 6 for all four channels
+		inline void interpolate(const uint8_t e0[4], const uint8_t e1[4], const uint8_t* weights, int count, uint8_t palette[16][4])
+		{
+#if BC_DECODER_SSE2
+			__m128i zero = _mm_setzero_si128();
+			uint32_t p0, p1;
+			memcpy(&p0, e0, 4);
+			memcpy(&p1, e1, 4);
+			// Two palette entries per register: 2 x 4 channels as 16-bit lanes
+			__m128i a = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(p0)), zero);
+			__m128i b = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(p1)), zero);
+			__m128i round = _mm_set1_epi16(32);
+			for (int i = 0; i < count; i += 2)
+			{
+				int w0 = weights[i], w1 = i + 1 < count ? weights[i + 1] : 0;
+				__m128i w = _mm_setr_epi16(static_cast<short>(w0), static_cast<short>(w0), static_cast<short>(w0), static_cast<short>(w0),
+					static_cast<short>(w1), static_cast<short>(w1), static_cast<short>(w1), static_cast<short>(w1));
+				__m128i iw = _mm_sub_epi16(_mm_set1_epi16(64), w);
+				__m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a, iw), _mm_mullo_epi16(b, w)), round);
+				v = _mm_packus_epi16(_mm_srli_epi16(v, 6), zero);
+				if (i + 1 < count)
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(palette[i]), v);
+				else
+				{
+					uint32_t last = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+					memcpy(palette[i], &last, 4);
+				}
+			}
+#else
+			for (int i = 0; i < count; ++i)
+			{
+				for (int c = 0; c < 4; ++c)
+					palette[i][c] = static_cast<uint8_t>(((64 - weights[i]) * e0[c] + weights[i] * e1[c] + 32) >> 6);
+			}
+#endif
+		}
+
+		inline void decodeBC7(const uint8_t* block, uint8_t out[16][4])
+		{
+			BitReader bits(block);
+			int mode = 0;
+			while (mode < 8 && !bits.read(1))
+				++mode;
+			if (mode == 8)
+			{
+				// Reserved mode decodes to transparent black
+				memset(out, 0, 64);
+				return;
+			}
+			const BC7Mode& m = BC7Modes[mode];
+			int partition = bits.read(m.partitionBits);
+			int rotation = bits.read(m.rotationBits);
+			int indexSelection = bits.read(m.indexSelectionBits);
+
+			int endpoints = m.subsets * 2;
+			uint8_t e[6][4];
+			for (int c = 0; c < 3; ++c)
+			{
+				for (int k = 0; k < endpoints; ++k)
+					e[k][c] = static_cast<uint8_t>(bits.read(m.colorBits));
+			}
+			for (int k = 0; k < endpoints; ++k)
+				e[k][3] = static_cast<uint8_t>(m.alphaBits ? bits.read(m.alphaBits) : 255);
+
+			// Append p-bits and expand to 8 bits by replicating the top bits
+			int pbits[6] = {};
+			if (m.endpointPBits)
+			{
+				for (int k = 0; k < endpoints; ++k)
+					pbits[k] = bits.read(1);
+			}
+			else if (m.sharedPBits)
+			{
+				for (int s = 0; s < m.subsets; ++s)
+					pbits[s * 2] = pbits[s * 2 + 1] = bits.read(1);
+			}
+			bool hasPBits = m.endpointPBits || m.sharedPBits;
+			for (int k = 0; k < endpoints; ++k)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					int n = c < 3 ? m.colorBits : m.alphaBits;
+					if (n == 0)
+						continue;
+					int v = e[k][c];
+					if (hasPBits)
+					{
+						v = (v << 1) | pbits[k];
+						++n;
+					}
+					v <<= 8 - n;
+					e[k][c] = static_cast<uint8_t>(v | (v >> n));
+				}
+			}
+
+			uint8_t indices[16], secondary[16] = {};
+			for (int i = 0; i < 16; ++i)
+				indices[i] = static_cast<uint8_t>(bits.read(m.indexBits - (isAnchor(m.subsets, partition, i) ? 1 : 0)));
+			if (m.secondaryIndexBits)
+			{
+				for (int i = 0; i < 16; ++i)
+					secondary[i] = static_cast<uint8_t>(bits.read(m.secondaryIndexBits - (i == 0 ? 1 : 0)));
+			}
+
+			if (!m.secondaryIndexBits)
+			{
+				uint8_t palettes[3][16][4];
+				for (int s = 0; s < m.subsets; ++s)
+					interpolate(e[s * 2], e[s * 2 + 1], weightsFor(m.indexBits), 1 << m.indexBits, palettes[s]);
+				for (int i = 0; i < 16; ++i)
+					memcpy(out[i], palettes[subsetOf(m.subsets, partition, i)][indices[i]], 4);
+			}
+			else
+			{
+				// Modes 4 and 5: separate color and alpha indices, optionally swapped
+				int colorBits = indexSelection ? m.secondaryIndexBits : m.indexBits;
+				int alphaBits = indexSelection ? m.indexBits : m.secondaryIndexBits;
+				const uint8_t* colorIndices = indexSelection ? secondary : indices;
+				const uint8_t* alphaIndices = indexSelection ? indices : secondary;
+				uint8_t colors[16][4], alphas[16][4];
+				interpolate(e[0], e[1], weightsFor(colorBits), 1 << colorBits, colors);
+				interpolate(e[0], e[1], weightsFor(alphaBits), 1 << alphaBits, alphas);
+				for (int i = 0; i < 16; ++i)
+				{
+					memcpy(out[i], colors[colorIndices[i]], 3);
+					out[i][3] = alphas[alphaIndices[i]][3];
+				}
+			}
+
+			if (rotation)
+			{
+				for (int i = 0; i < 16; ++i)
+					std::swap(out[i][3], out[i][rotation - 1]);
+			}
+		}
+
+		// --- BC6H ---
+
+		enum BC6Field : uint8_t { R0, G0, B0, R1, G1, B1, R2, G2, B2, R3, G3, B3 };
+
+		// A run of header bits: field bits first..last (either direction) in stream order
+		struct BC6Run
+		{
+			uint8_t field, first, last;
+		};
+
+		struct BC6Mode
+		{
+			uint8_t endpointBits, deltaBits[3];
+			bool transformed, twoRegions;
+			BC6Run runs[24];
+		};
+
+		// Header layouts of the 14 modes, after the mode bits (D3D11 functional spec, BC6H mode reference)
+		static const BC6Mode BC6Modes[14] = {
+			{ 10, { 5, 5, 5 }, true, true, { { G2, 4, 4 }, { B2, 4, 4 }, { B3, 4, 4 }, { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 4 },
+				{ G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 },
+				{ B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 } } },
+			{ 7, { 6, 6, 6 }, true, true, { { G2, 5, 5 }, { G3, 4, 4 }, { G3, 5, 5 }, { R0, 0, 6 }, { B3, 0, 0 }, { B3, 1, 1 }, { B2, 4, 4 },
+				{ G0, 0, 6 }, { B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 6 }, { B3, 3, 3 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 5 },
+				{ G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 } } },
+			{ 11, { 5, 4, 4 }, true, true, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 4 }, { R0, 10, 10 }, { G2, 0, 3 }, { G1, 0, 3 },
+				{ G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 },
+				{ R3, 0, 4 }, { B3, 3, 3 } } },
+			{ 11, { 4, 5, 4 }, true, true, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 }, { G3, 4, 4 }, { G2, 0, 3 },
+				{ G1, 0, 4 }, { G0, 10, 10 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 3 }, { B3, 0, 0 },
+				{ B3, 2, 2 }, { R3, 0, 3 }, { G2, 4, 4 }, { B3, 3, 3 } } },
+			{ 11, { 4, 4, 5 }, true, true, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 }, { B2, 4, 4 }, { G2, 0, 3 },
+				{ G1, 0, 3 }, { G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B0, 10, 10 }, { B2, 0, 3 }, { R2, 0, 3 }, { B3, 1, 1 },
+				{ B3, 2, 2 }, { R3, 0, 3 }, { B3, 4, 4 }, { B3, 3, 3 } } },
+			{ 9, { 5, 5, 5 }, true, true, { { R0, 0, 8 }, { B2, 4, 4 }, { G0, 0, 8 }, { G2, 4, 4 }, { B0, 0, 8 }, { B3, 4, 4 }, { R1, 0, 4 },
+				{ G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 },
+				{ B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 } } },
+			{ 8, { 6, 5, 5 }, true, true, { { R0, 0, 7 }, { G3, 4, 4 }, { B2, 4, 4 }, { G0, 0, 7 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 7 },
+				{ B3, 3, 3 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 },
+				{ B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 } } },
+			{ 8, { 5, 6, 5 }, true, true, { { R0, 0, 7 }, { B3, 0, 0 }, { B2, 4, 4 }, { G0, 0, 7 }, { G2, 5, 5 }, { G2, 4, 4 }, { B0, 0, 7 },
+				{ G3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 },
+				{ B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 } } },
+			{ 8, { 5, 5, 6 }, true, true, { { R0, 0, 7 }, { B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 7 }, { B2, 5, 5 }, { G2, 4, 4 }, { B0, 0, 7 },
+				{ B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 5 },
+				{ B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 } } },
+			{ 6, { 6, 6, 6 }, false, true, { { R0, 0, 5 }, { G3, 4, 4 }, { B3, 0, 0 }, { B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 5 }, { G2, 5, 5 },
+				{ B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 5 }, { G3, 5, 5 }, { B3, 3, 3 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 5 },
+				{ G2, 0, 3 }, { G1, 0, 5 }, { G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 } } },
+			{ 10, { 10, 10, 10 }, false, false, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 9 }, { G1, 0, 9 }, { B1, 0, 9 } } },
+			{ 11, { 9, 9, 9 }, true, false, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 8 }, { R0, 10, 10 }, { G1, 0, 8 },
+				{ G0, 10, 10 }, { B1, 0, 8 }, { B0, 10, 10 } } },
+			{ 12, { 8, 8, 8 }, true, false, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 7 }, { R0, 11, 10 }, { G1, 0, 7 },
+				{ G0, 11, 10 }, { B1, 0, 7 }, { B0, 11, 10 } } },
+			{ 16, { 4, 4, 4 }, true, false, { { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 15, 10 }, { G1, 0, 3 },
+				{ G0, 15, 10 }, { B1, 0, 3 }, { B0, 15, 10 } } },
+		};
+
+		// Mode number (index into BC6Modes) from the 2 or 5 mode bits, -1 for reserved values
+		inline int bc6Mode(BitReader& bits)
+		{
+			uint32_t m = bits.read(2);
+			if (m < 2)
+				return static_cast<int>(m);
+			m |= bits.read(3) << 2;
+			switch (m)
+			{
+			case 0x02: return 2;
+			case 0x06: return 3;
+			case 0x0A: return 4;
+			case 0x0E: return 5;
+			case 0x12: return 6;
+			case 0x16: return 7;
+			case 0x1A: return 8;
+			case 0x1E: return 9;
+			case 0x03: return 10;
+			case 0x07: return 11;
+			case 0x0B: return 12;
+			case 0x0F: return 13;
+			}
+			return -1;
+		}
+
+		inline int signExtend(int v, int bits)
+		{
+			int shift = 32 - bits;
+			return static_cast<int>(static_cast<uint32_t>(v) << shift) >> shift;
+		}
+
+		inline int bc6Unquantize(int v, int bits, bool isSigned)
+		{
+			if (!isSigned)
+			{
+				if (bits >= 15 || v == 0)
+					return v;
+				if (v == (1 << bits) - 1)
+					return 0xFFFF;
+				return ((v << 16) + 0x8000) >> bits;
+			}
+			if (bits >= 16)
+				return v;
+			bool negative = v < 0;
+			int a = negative ? -v : v;
+			int u;
+			if (a == 0)
+				u = 0;
+			else if (a >= (1 << (bits - 1)) - 1)
+				u = 0x7FFF;
+			else
+				u = ((a << 15) + 0x4000) >> (bits - 1);
+			return negative ? -u : u;
+		}
+
+		// Final scale of an interpolated value to half-float bits
+		inline uint16_t bc6ToHalf(int v, bool isSigned)
+		{
+			if (!isSigned)
+				return static_cast<uint16_t>((v * 31) >> 6);
+			if (v < 0)
+				return static_cast<uint16_t>(0x8000 | (((-v) * 31) >> 5));
+			return static_cast<uint16_t>((v * 31) >> 5);
+		}
+
+		inline void decodeBC6H(const uint8_t* block, bool isSigned, uint16_t out[16][4])
+		{
+			BitReader bits(block);
+			int modeIndex = bc6Mode(bits);
+			if (modeIndex < 0)
+			{
+				// Reserved modes decode to black
+				for (int i = 0; i < 16; ++i)
+				{
+					out[i][0] = out[i][1] = out[i][2] = 0;
+					out[i][3] = 0x3C00;
+				}
+				return;
+			}
+			const BC6Mode& m = BC6Modes[modeIndex];
+			int e[12] = {};
+			for (const BC6Run& run : m.runs)
+			{
+				if (run.first == 0 && run.last == 0 && run.field == R0)
+					break;                  // End of the run list
+				int step = run.first <= run.last ? 1 : -1;
+				for (int b = run.first;; b += step)
+				{
+					e[run.field] |= static_cast<int>(bits.read(1)) << b;
+					if (b == run.last)
+						break;
+				}
+			}
+			int partition = m.twoRegions ? static_cast<int>(bits.read(5)) : 0;
+			int endpoints = m.twoRegions ? 4 : 2;
+
+			for (int c = 0; c < 3; ++c)
+			{
+				if (isSigned)
+					e[c] = signExtend(e[c], m.endpointBits);
+				for (int k = 1; k < endpoints; ++k)
+				{
+					int& v = e[k * 3 + c];
+					if (m.transformed)
+					{
+						v = signExtend(v, m.deltaBits[c]);
+						v = (e[c] + v) & ((1 << m.endpointBits) - 1);
+						if (isSigned)
+							v = signExtend(v, m.endpointBits);
+					}
+					else if (isSigned)
+					{
+						v = signExtend(v, m.endpointBits);
+					}
+				}
+			}
+			for (int k = 0; k < endpoints * 3; ++k)
+				e[k] = bc6Unquantize(e[k], m.endpointBits, isSigned);
+
+			int indexBits = m.twoRegions ? 3 : 4;
+			const uint8_t* weights = weightsFor(indexBits);
+			for (int i = 0; i < 16; ++i)
+			{
+				int subset = m.twoRegions ? subsetOf(2, partition, i) : 0;
+				int index = static_cast<int>(bits.read(indexBits - (isAnchor(m.twoRegions ? 2 : 1, partition, i) ? 1 : 0)));
+				int w = weights[index];
+				for (int c = 0; c < 3; ++c)
+				{
+					int a = e[subset * 6 + c], b = e[subset * 6 + 3 + c];
+					out[i][c] = bc6ToHalf(((64 - w) * a + w * b + 32) >> 6, isSigned);
+				}
+				out[i][3] = 0x3C00;             // 1.0
+			}
+		}
+	};
+
+	// Decodes one block to 16 texels in decodedFormat(format) (4 or 8 bytes each, row-major).
+	inline bool decodeBlock(uint32_t format, const uint8_t* block, void* texels)
+	{
+		auto* out = static_cast<uint8_t(*)[4]>(texels);
+		switch (format)
+		{
+		case 70: case 71: case 72:
+			detail::decodeColor(block, false, out);
+			return true;
+		case 73: case 74: case 75:
+			detail::decodeColor(block + 8, true, out);
+			for (int i = 0; i < 16; ++i)
+				out[i][3] = static_cast<uint8_t>(((block[i / 2] >> (4 * (i & 1))) & 15) * 17);
+			return true;
+		case 76: case 77: case 78:
+			detail::decodeColor(block + 8, true, out);
+			detail::decodeSingle(block, false, &out[0][3], 4);
+			return true;
+		case 79: case 80: case 81:
+			detail::decodeSingle(block, format == 81, &out[0][0], 4);
+			for (int i = 0; i < 16; ++i)
+			{
+				out[i][1] = out[i][2] = 0;
+				out[i][3] = format == 81 ? 127 : 255;
+			}
+			return true;
+		case 82: case 83: case 84:
+			detail::decodeSingle(block, format == 84, &out[0][0], 4);
+			detail::decodeSingle(block + 8, format == 84, &out[0][1], 4);
+			for (int i = 0; i < 16; ++i)
+			{
+				out[i][2] = 0;
+				out[i][3] = format == 84 ? 127 : 255;
+			}
+			return true;
+		case 94: case 95: case 96:
+			detail::decodeBC6H(block, format == 96, static_cast<uint16_t(*)[4]>(texels));
+			return true;
+		case 97: case 98: case 99:
+			detail::decodeBC7(block, out);
+			return true;
+		}
+		return false;
+	}
+
+	// Bytes per decoded texel
+	inline uint32_t decodedPixelBytes(uint32_t format)
+	{
+		return decodedFormat(format) == DDS::FormatR16G16B16A16Float ? 8 : 4;
+	}
+
+	// One surface to decode: src in blocks, dst in decodedFormat texels
+	struct DecodeJob
+	{
+		const uint8_t* src;
+		size_t srcRowPitch;         // bytes per row of blocks
+		uint32_t width, height;
+		uint8_t* dst;
+		size_t dstRowPitch;
+	};
+
+	namespace detail
+	{
+		inline void decodeRows(uint32_t format, const DecodeJob& job, uint32_t beginRow, uint32_t endRow)
+		{
+			uint32_t blockBytes = DDS::blockBytes(format);
+			uint32_t pixelBytes = decodedPixelBytes(format);
+			uint32_t blocksX = (job.width + 3) / 4;
+			alignas(16) uint8_t texels[16 * 8];
+			for (uint32_t by = beginRow; by < endRow; ++by)
+			{
+				for (uint32_t bx = 0; bx < blocksX; ++bx)
+				{
+					decodeBlock(format, job.src + by * job.srcRowPitch + bx * blockBytes, texels);
+					// Partial edge blocks are clipped to the surface
+					uint32_t w = (std::min)(4u, job.width - bx * 4), h = (std::min)(4u, job.height - by * 4);
+					for (uint32_t y = 0; y < h; ++y)
+						memcpy(job.dst + (by * 4 + y) * job.dstRowPitch + bx * 4 * pixelBytes, texels + y * 4 * pixelBytes, w * pixelBytes);
+				}
+			}
+		}
+	};
+
+	// Decodes several surfaces (e.g. a mip chain) at once. Work is handed out in bands of
+	// block rows across all jobs, so large and small levels share the threads evenly.
+	inline bool decode(uint32_t format, const DecodeJob* jobs, size_t jobCount, unsigned int threadCount = 0)
+	{
+		if (decodedFormat(format) == DDS::FormatUnknown)
+			return false;
+		if (threadCount == 0)
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+
+		static const uint32_t BandRows = 8;
+		struct Band
+		{
+			size_t job;
+			uint32_t begin, end;
+		};
+		std::vector<Band> bands;
+		for (size_t j = 0; j < jobCount; ++j)
+		{
+			uint32_t rows = (jobs[j].height + 3) / 4;
+			for (uint32_t r = 0; r < rows; r += BandRows)
+				bands.push_back({ j, r, (std::min)(rows, r + BandRows) });
+		}
+
+		std::atomic<size_t> next(0);
+		auto work = [&]()
+		{
+			for (size_t i = next++; i < bands.size(); i = next++)
+				detail::decodeRows(format, jobs[bands[i].job], bands[i].begin, bands[i].end);
+		};
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < std::min<size_t>(threadCount, bands.size()); ++i)
+			threads.emplace_back(work);
+		work();
+		for (auto& t : threads)
+			t.join();
+		return true;
+	}
+
+	// Decodes every subresource of a BC texture into tightly packed images
+	// (pixels[i] holds subresource i with rows of width * decodedPixelBytes bytes).
+	inline bool decode(const DDS::TextureDesc& desc, const std::vector<DDS::Subresource>& subresources,
+		std::vector<std::vector<uint8_t>>& pixels, unsigned int threadCount = 0)
+	{
+		uint32_t pixelBytes = decodedPixelBytes(desc.format);
+		std::vector<DecodeJob> jobs;
+		pixels.resize(subresources.size());
+		for (size_t i = 0; i < subresources.size(); ++i)
+		{
+			const DDS::Subresource& s = subresources[i];
+			size_t rowPitch = static_cast<size_t>(s.width) * pixelBytes;
+			pixels[i].resize(rowPitch * s.height * s.depth);
+			for (uint32_t z = 0; z < s.depth; ++z)
+				jobs.push_back({ s.data + z * s.slicePitch, s.rowSize, s.width, s.height, pixels[i].data() + z * rowPitch * s.height, rowPitch });
+		}
+		return decode(desc.format, jobs.data(), jobs.size(), threadCount);
+	}
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+// UpdateSubresource-style updates of GPU buffers.
+// Every registered buffer has a CPU copy of its contents. update() compares the
+// new bytes with the copy and returns at once when nothing changed; otherwise it
+// stores them and marks their 16-byte blocks dirty. Any number of calls between
+// two flushes cost one memcmp/memcpy each. prepare() turns the dirty blocks into
+// copy ranges, merging ranges closer than MergeGap, and flush() packs them into
+// one staging allocation and reports one copy per range, all ranges of a
+// destination together and in ascending order.
+// Buffers see the contents of the last flush, so flush before recording the
+// commands that read them. Not thread-safe.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+template<class Resource>
+class BufferUpdater
+{
+public:
+	typedef uint32_t Handle;
+
+	static const uint64_t BlockSize = 16;       // one shader constant register
+	static const uint64_t MergeGap = 64;        // unchanged bytes copied rather than splitting a copy
+
+	struct Stats
+	{
+		uint64_t calls;
+		uint64_t skipped;                       // calls that changed nothing
+		uint64_t copies;
+		uint64_t uploadedBytes;
+	};
+
+private:
+	struct Buffer
+	{
+		Resource resource;
+		std::vector<uint8_t> contents;
+		std::vector<uint64_t> dirty;            // one bit per block
+		bool queued;
+	};
+
+	struct Range
+	{
+		Handle buffer;
+		uint64_t begin, end;
+	};
+
+	std::vector<Buffer> mBuffers;
+	std::vector<Handle> mDirtyBuffers;          // in order of their first update
+	std::vector<Range> mRanges;
+	uint64_t mStagingSize = 0;
+	Stats mStats = {};
+
+public:
+	BufferUpdater() = default;
+	BufferUpdater(const BufferUpdater&) = delete;
+	BufferUpdater& operator=(const BufferUpdater&) = delete;
+
+	// initialData (size bytes) is uploaded with the next flush; without it the
+	// buffer is assumed to be zero, as committed resources are
+	Handle registerBuffer(Resource resource, uint64_t size, const void* initialData = nullptr)
+	{
+		uint64_t blockCount = (size + BlockSize - 1) / BlockSize;
+		mBuffers.push_back({ resource, std::vector<uint8_t>(static_cast<size_t>(size)),
+			std::vector<uint64_t>(static_cast<size_t>((blockCount + 63) / 64)), false });
+		Handle handle = static_cast<Handle>(mBuffers.size() - 1);
+		if (initialData)
+		{
+			auto& buffer = mBuffers.back();
+			memcpy(buffer.contents.data(), initialData, static_cast<size_t>(size));
+			markDirty(handle, 0, size);
+		}
+		return handle;
+	}
+
+	// Returns false when the range is outside the buffer
+	bool update(Handle handle, uint64_t offset, const void* data, uint64_t size)
+	{
+		auto& buffer = mBuffers[handle];
+		if (offset > buffer.contents.size() || size > buffer.contents.size() - offset)
+			return false;
+		mStats.calls++;
+		uint8_t* contents = buffer.contents.data() + offset;
+		if (size == 0 || memcmp(contents, data, static_cast<size_t>(size)) == 0)
+		{
+			mStats.skipped++;
+			return true;
+		}
+		memcpy(contents, data, static_cast<size_t>(size));
+		markDirty(handle, offset, size);
+		return true;
+	}
+
+	const void* contents(Handle handle) const
+	{
+		return mBuffers[handle].contents.data();
+	}
+
+	// Builds the copy ranges. Returns the staging bytes flush() writes, 0 when nothing changed.
+	uint64_t prepare()
+	{
+		mRanges.clear();
+		mStagingSize = 0;
+		for (Handle handle : mDirtyBuffers)
+		{
+			auto& buffer = mBuffers[handle];
+			uint64_t size = buffer.contents.size();
+			const uint64_t none = ~0ull;
+			uint64_t begin = none, end = 0;
+			for (size_t w = 0; w < buffer.dirty.size(); ++w)
+			{
+				uint64_t bits = buffer.dirty[w];
+				buffer.dirty[w] = 0;
+				while (bits)
+				{
+					// Next run of set bits in this word
+					unsigned first = countTrailingZeros(bits);
+					uint64_t shifted = bits >> first;
+					unsigned length = ~shifted ? countTrailingZeros(~shifted) : 64 - first;
+					bits = length + first < 64 ? bits & (~0ull << (first + length)) : 0;
+
+					uint64_t runBegin = (w * 64 + first) * BlockSize;
+					uint64_t runEnd = (w * 64 + first + length) * BlockSize;
+					if (runEnd > size)
+						runEnd = size;
+					if (begin != none && runBegin - end <= MergeGap)
+					{
+						end = runEnd;
+						continue;
+					}
+					if (begin != none)
+						addRange(handle, begin, end);
+					begin = runBegin;
+					end = runEnd;
+				}
+			}
+			if (begin != none)
+				addRange(handle, begin, end);
+			buffer.queued = false;
+		}
+		mDirtyBuffers.clear();
+		return mStagingSize;
+	}
+
+	// staging holds the prepare()d size (upload heap, written sequentially).
+	// Calls copy(Resource dst, uint64_t dstOffset, uint64_t stagingOffset, uint64_t size) per range.
+	template<class Copy>
+	void flush(void* staging, Copy copy)
+	{
+		auto* dst = static_cast<uint8_t*>(staging);
+		uint64_t stagingOffset = 0;
+		for (auto& range : mRanges)
+		{
+			auto& buffer = mBuffers[range.buffer];
+			uint64_t size = range.end - range.begin;
+			memcpy(dst + stagingOffset, buffer.contents.data() + range.begin, static_cast<size_t>(size));
+			copy(buffer.resource, range.begin, stagingOffset, size);
+			stagingOffset += size;
+		}
+		mStats.copies += mRanges.size();
+		mStats.uploadedBytes += mStagingSize;
+		mRanges.clear();
+		mStagingSize = 0;
+	}
+
+	const Stats& stats() const
+	{
+		return mStats;
+	}
+
+	void resetStats()
+	{
+		mStats = {};
+	}
+
+private:
+	void markDirty(Handle handle, uint64_t offset, uint64_t size)
+	{
+		auto& buffer = mBuffers[handle];
+		uint64_t first = offset / BlockSize;
+		uint64_t last = (offset + size - 1) / BlockSize;
+		for (uint64_t w = first / 64; w <= last / 64; ++w)
+		{
+			uint64_t lo = w == first / 64 ? first % 64 : 0;
+			uint64_t hi = w == last / 64 ? last % 64 : 63;
+			uint64_t mask = (hi == 63 ? ~0ull : (1ull << (hi + 1)) - 1) & (~0ull << lo);
+			buffer.dirty[static_cast<size_t>(w)] |= mask;
+		}
+		if (!buffer.queued)
+		{
+			buffer.queued = true;
+			mDirtyBuffers.push_back(handle);
+		}
+	}
+
+	void addRange(Handle handle, uint64_t begin, uint64_t end)
+	{
+		mRanges.push_back({ handle, begin, end });
+		mStagingSize += end - begin;
+	}
+
+	static unsigned countTrailingZeros(uint64_t bits)
+	{
+		unsigned n = 0;
+		while (!(bits & 1))
+		{
+			bits >>= 1;
+			n++;
+		}
+		return n;
+	}
+};
@@ -0,0 +1,997 @@
+#pragma once
+
+// Compact capture of what command lists record.
+// Writer stands in for a command list: its methods carry the D3D12 names, take
+// plain values, and encode each command as a one-byte tag and LEB128 varints.
+// GPU addresses and descriptor handles are stored as zigzag deltas from the
+// previous one of their kind, so consecutive descriptors and constant buffer
+// slices take a byte or two. Objects (pipeline states, resources, heaps, ...) are
+// interned per stream: the first use stores the pointer after a new id, later
+// uses the id alone. A stream is self-contained and written into a buffer sized
+// once by init(), so recording does not allocate; when the buffer is full the
+// stream keeps the commands before and counts the rest as dropped.
+// One Writer per recording thread, like command lists.
+// Reader decodes a stream into Commands, and replay() calls the method of the
+// same name on a target with the Writer's signatures: D3D12Target over an
+// ID3D12GraphicsCommandList (CommandCaptureD3D12.h), NullDevice::CommandList,
+// another Writer, or a NullTarget that handles only some commands.
+// recordAndReplay() does both, and records straight onto the target when the
+// stream overflows.
+// Ring keeps the streams of the last frames. analyze() counts the state sets
+// that leave a list's state as it was, and diff() the commands that differ
+// between two frames.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace CommandCapture
+{
+	enum class Op : uint8_t
+	{
+		ResourceBarrier, SetPipelineState, SetGraphicsRootSignature, SetComputeRootSignature, SetDescriptorHeaps,
+		SetGraphicsRootDescriptorTable, SetGraphicsRootConstantBufferView, SetGraphicsRoot32BitConstants,
+		IASetPrimitiveTopology, IASetVertexBuffer, IASetIndexBuffer, RSSetViewport, RSSetScissorRect, OMSetRenderTarget,
+		ClearRenderTargetView, ClearDepthStencilView, DrawInstanced, DrawIndexedInstanced, Dispatch,
+		ExecuteIndirect, CopyBufferRegion,
+		Count
+	};
+
+	const uint32_t OpCount = static_cast<uint32_t>(Op::Count);
+	const uint32_t MaxObjects = 1024;           // distinct objects per stream
+	const uint32_t MaxHeaps = 2;                // a CBV/SRV/UAV heap and a sampler heap
+	const uint32_t MaxConstants = 64;           // DWORDs, the root signature limit
+	const uint32_t MaxSlots = 16;               // root parameters and vertex buffer slots tracked by analyze()
+
+	inline const char* opName(Op op)
+	{
+		static const char* const names[] = {
+			"ResourceBarrier", "SetPipelineState", "SetGraphicsRootSignature", "SetComputeRootSignature", "SetDescriptorHeaps",
+			"SetGraphicsRootDescriptorTable", "SetGraphicsRootConstantBufferView", "SetGraphicsRoot32BitConstants",
+			"IASetPrimitiveTopology", "IASetVertexBuffer", "IASetIndexBuffer", "RSSetViewport", "RSSetScissorRect", "OMSetRenderTarget",
+			"ClearRenderTargetView", "ClearDepthStencilView", "DrawInstanced", "DrawIndexedInstanced", "Dispatch",
+			"ExecuteIndirect", "CopyBufferRegion",
+		};
+		return op < Op::Count ? names[static_cast<uint32_t>(op)] : "?";
+	}
+
+	// A decoded command, its fields in encoding order
+	struct Command
+	{
+		Op op;
+		uint8_t objectCount;
+		uint8_t cpuCount;
+		uint8_t gpuCount;
+		uint8_t valueCount;
+		uint8_t floatCount;
+		const void* objects[3];
+		uint64_t cpu[2];                        // CPU descriptor handles, 0 for none
+		uint64_t gpu[1];                        // GPU virtual addresses and GPU descriptor handles
+		uint64_t values[5];
+		float floats[6];
+		const uint8_t* constants;               // SetGraphicsRoot32BitConstants: values[1] DWORDs in the stream, unaligned
+	};
+
+	namespace detail
+	{
+		struct Layout
+		{
+			uint8_t objects, cpu, gpu, values, floats;
+		};
+
+		// Per Op. SetDescriptorHeaps stores its count before the heaps, and
+		// SetGraphicsRoot32BitConstants its DWORDs after the values.
+		const Layout Layouts[] = {
+			{ 1, 0, 0, 2, 0 },      // ResourceBarrier: resource; before, after
+			{ 1, 0, 0, 0, 0 },      // SetPipelineState
+			{ 1, 0, 0, 0, 0 },      // SetGraphicsRootSignature
+			{ 1, 0, 0, 0, 0 },      // SetComputeRootSignature
+			{ 0, 0, 0, 1, 0 },      // SetDescriptorHeaps: count, then the heaps
+			{ 0, 0, 1, 1, 0 },      // SetGraphicsRootDescriptorTable: handle; rootIndex
+			{ 0, 0, 1, 1, 0 },      // SetGraphicsRootConstantBufferView: address; rootIndex
+			{ 0, 0, 0, 3, 0 },      // SetGraphicsRoot32BitConstants: rootIndex, count, offset
+			{ 0, 0, 0, 1, 0 },      // IASetPrimitiveTopology
+			{ 0, 0, 1, 3, 0 },      // IASetVertexBuffer: address; slot, size, stride
+			{ 0, 0, 1, 2, 0 },      // IASetIndexBuffer: address; size, format
+			{ 0, 0, 0, 0, 6 },      // RSSetViewport
+			{ 0, 0, 0, 4, 0 },      // RSSetScissorRect
+			{ 0, 2, 0, 0, 0 },      // OMSetRenderTarget: rtv, dsv
+			{ 0, 1, 0, 0, 4 },      // ClearRenderTargetView: rtv; color
+			{ 0, 1, 0, 2, 1 },      // ClearDepthStencilView: dsv; flags, stencil; depth
+			{ 0, 0, 0, 4, 0 },      // DrawInstanced
+			{ 0, 0, 0, 5, 0 },      // DrawIndexedInstanced
+			{ 0, 0, 0, 3, 0 },      // Dispatch
+			{ 3, 0, 0, 3, 0 },      // ExecuteIndirect: signature, arguments, count buffer; maxCount, argumentOffset, countOffset
+			{ 2, 0, 0, 3, 0 },      // CopyBufferRegion: dst, src; dstOffset, srcOffset, size
+		};
+		static_assert(sizeof(Layouts) / sizeof(Layouts[0]) == OpCount, "a layout per Op");
+
+		inline uint64_t zigzag(uint64_t delta)
+		{
+			return (delta << 1) ^ (0 - (delta >> 63));
+		}
+
+		inline uint64_t unzigzag(uint64_t value)
+		{
+			return (value >> 1) ^ (0 - (value & 1));
+		}
+	};
+
+	class Writer
+	{
+	public:
+		// Bound of a command's bytes besides root constants
+		static const size_t MaxCommandBytes = 160;
+
+	private:
+		static const uint32_t TableSize = MaxObjects * 2;
+
+		struct Entry
+		{
+			const void* object;
+			uint32_t id;
+			uint32_t generation;                // valid when it matches mGeneration
+		};
+
+		std::vector<uint8_t> mBuffer;
+		std::vector<Entry> mTable;              // open addressing on the pointer
+		size_t mSize = 0;
+		uint32_t mGeneration = 1;
+		uint32_t mObjectCount = 0;
+		uint64_t mLastCpu = 0;
+		uint64_t mLastGpu = 0;
+		uint32_t mCommands = 0;
+		uint32_t mDropped = 0;
+		bool mFull = false;
+
+	public:
+		// Allocates the buffer; capacity in bytes
+		void init(size_t capacity)
+		{
+			mBuffer.assign(capacity > MaxCommandBytes ? capacity : MaxCommandBytes, 0);
+			mTable.assign(TableSize, Entry{ nullptr, 0, 0 });
+			mGeneration = 0;
+			reset();
+		}
+
+		// Starts a new stream, as a command list's Reset()
+		void reset()
+		{
+			mSize = 0;
+			mGeneration++;
+			mObjectCount = 0;
+			mLastCpu = mLastGpu = 0;
+			mCommands = mDropped = 0;
+			mFull = false;
+		}
+
+		const uint8_t* data() const { return mBuffer.data(); }
+		size_t size() const { return mSize; }
+		uint32_t commandCount() const { return mCommands; }
+		// Commands that did not fit
+		uint32_t droppedCount() const { return mDropped; }
+
+		void ResourceBarrier(const void* resource, uint32_t before, uint32_t after)
+		{
+			uint8_t* p = begin(Op::ResourceBarrier, 0);
+			if (!p)
+				return;
+			p = object(p, resource);
+			p = value(p, before);
+			end(value(p, after));
+		}
+
+		void SetPipelineState(const void* state)
+		{
+			uint8_t* p = begin(Op::SetPipelineState, 0);
+			if (p)
+				end(object(p, state));
+		}
+
+		void SetGraphicsRootSignature(const void* signature)
+		{
+			uint8_t* p = begin(Op::SetGraphicsRootSignature, 0);
+			if (p)
+				end(object(p, signature));
+		}
+
+		void SetComputeRootSignature(const void* signature)
+		{
+			uint8_t* p = begin(Op::SetComputeRootSignature, 0);
+			if (p)
+				end(object(p, signature));
+		}
+
+		// Heap is ID3D12DescriptorHeap and the like
+		template<class Heap>
+		void SetDescriptorHeaps(uint32_t count, Heap* const* heaps)
+		{
+			uint8_t* p = count <= MaxHeaps ? begin(Op::SetDescriptorHeaps, 0) : drop();
+			if (!p)
+				return;
+			p = value(p, count);
+			for (uint32_t i = 0; i < count; ++i)
+				p = object(p, heaps[i]);
+			end(p);
+		}
+
+		void SetGraphicsRootDescriptorTable(uint32_t rootIndex, uint64_t gpuDescriptorHandle)
+		{
+			uint8_t* p = begin(Op::SetGraphicsRootDescriptorTable, 0);
+			if (p)
+				end(value(gpu(p, gpuDescriptorHandle), rootIndex));
+		}
+
+		void SetGraphicsRootConstantBufferView(uint32_t rootIndex, uint64_t gpuAddress)
+		{
+			uint8_t* p = begin(Op::SetGraphicsRootConstantBufferView, 0);
+			if (p)
+				end(value(gpu(p, gpuAddress), rootIndex));
+		}
+
+		void SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset)
+		{
+			uint8_t* p = count <= MaxConstants ? begin(Op::SetGraphicsRoot32BitConstants, count * 4) : drop();
+			if (!p)
+				return;
+			p = value(p, rootIndex);
+			p = value(p, count);
+			p = value(p, offset);
+			memcpy(p, data, count * 4);
+			end(p + count * 4);
+		}
+
+		void IASetPrimitiveTopology(uint32_t topology)
+		{
+			uint8_t* p = begin(Op::IASetPrimitiveTopology, 0);
+			if (p)
+				end(value(p, topology));
+		}
+
+		// One view
+		void IASetVertexBuffer(uint32_t slot, uint64_t gpuAddress, uint32_t size, uint32_t stride)
+		{
+			uint8_t* p = begin(Op::IASetVertexBuffer, 0);
+			if (!p)
+				return;
+			p = gpu(p, gpuAddress);
+			p = value(p, slot);
+			p = value(p, size);
+			end(value(p, stride));
+		}
+
+		// format is a DXGI_FORMAT
+		void IASetIndexBuffer(uint64_t gpuAddress, uint32_t size, uint32_t format)
+		{
+			uint8_t* p = begin(Op::IASetIndexBuffer, 0);
+			if (!p)
+				return;
+			p = gpu(p, gpuAddress);
+			p = value(p, size);
+			end(value(p, format));
+		}
+
+		void RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth)
+		{
+			uint8_t* p = begin(Op::RSSetViewport, 0);
+			if (!p)
+				return;
+			const float viewport[] = { topLeftX, topLeftY, width, height, minDepth, maxDepth };
+			memcpy(p, viewport, sizeof(viewport));
+			end(p + sizeof(viewport));
+		}
+
+		void RSSetScissorRect(int32_t left, int32_t top, int32_t right, int32_t bottom)
+		{
+			uint8_t* p = begin(Op::RSSetScissorRect, 0);
+			if (!p)
+				return;
+			p = value(p, static_cast<uint32_t>(left));
+			p = value(p, static_cast<uint32_t>(top));
+			p = value(p, static_cast<uint32_t>(right));
+			end(value(p, static_cast<uint32_t>(bottom)));
+		}
+
+		// One render target; dsv is 0 for none
+		void OMSetRenderTarget(uint64_t rtv, uint64_t dsv)
+		{
+			uint8_t* p = begin(Op::OMSetRenderTarget, 0);
+			if (p)
+				end(cpu(cpu(p, rtv), dsv));
+		}
+
+		void ClearRenderTargetView(uint64_t rtv, const float color[4])
+		{
+			uint8_t* p = begin(Op::ClearRenderTargetView, 0);
+			if (!p)
+				return;
+			p = cpu(p, rtv);
+			memcpy(p, color, 16);
+			end(p + 16);
+		}
+
+		// flags are D3D12_CLEAR_FLAGS
+		void ClearDepthStencilView(uint64_t dsv, uint32_t flags, float depth, uint32_t stencil)
+		{
+			uint8_t* p = begin(Op::ClearDepthStencilView, 0);
+			if (!p)
+				return;
+			p = cpu(p, dsv);
+			p = value(p, flags);
+			p = value(p, stencil);
+			memcpy(p, &depth, 4);
+			end(p + 4);
+		}
+
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance)
+		{
+			uint8_t* p = begin(Op::DrawInstanced, 0);
+			if (!p)
+				return;
+			p = value(p, vertexCount);
+			p = value(p, instanceCount);
+			p = value(p, startVertex);
+			end(value(p, startInstance));
+		}
+
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+		{
+			uint8_t* p = begin(Op::DrawIndexedInstanced, 0);
+			if (!p)
+				return;
+			p = value(p, indexCount);
+			p = value(p, instanceCount);
+			p = value(p, startIndex);
+			p = value(p, static_cast<uint32_t>(baseVertex));
+			end(value(p, startInstance));
+		}
+
+		void Dispatch(uint32_t x, uint32_t y, uint32_t z)
+		{
+			uint8_t* p = begin(Op::Dispatch, 0);
+			if (!p)
+				return;
+			p = value(p, x);
+			p = value(p, y);
+			end(value(p, z));
+		}
+
+		// countBuffer may be null
+		void ExecuteIndirect(const void* signature, uint32_t maxCommandCount, const void* arguments, uint64_t argumentOffset,
+			const void* countBuffer, uint64_t countOffset)
+		{
+			uint8_t* p = begin(Op::ExecuteIndirect, 0);
+			if (!p)
+				return;
+			p = object(p, signature);
+			p = object(p, arguments);
+			p = object(p, countBuffer);
+			p = value(p, maxCommandCount);
+			p = value(p, argumentOffset);
+			end(value(p, countOffset));
+		}
+
+		void CopyBufferRegion(const void* dst, uint64_t dstOffset, const void* src, uint64_t srcOffset, uint64_t size)
+		{
+			uint8_t* p = begin(Op::CopyBufferRegion, 0);
+			if (!p)
+				return;
+			p = object(p, dst);
+			p = object(p, src);
+			p = value(p, dstOffset);
+			p = value(p, srcOffset);
+			end(value(p, size));
+		}
+
+	private:
+		// Writes the tag; nullptr when the command does not fit
+		uint8_t* begin(Op op, size_t extraBytes)
+		{
+			if (mFull || mBuffer.size() - mSize < MaxCommandBytes + extraBytes)
+				return drop();
+			uint8_t* p = mBuffer.data() + mSize;
+			*p++ = static_cast<uint8_t>(op);
+			return p;
+		}
+
+		void end(uint8_t* p)
+		{
+			// The object table may have filled up within the command
+			if (mFull)
+			{
+				mDropped++;
+				return;
+			}
+			mSize = p - mBuffer.data();
+			mCommands++;
+		}
+
+		uint8_t* drop()
+		{
+			mFull = true;
+			mDropped++;
+			return nullptr;
+		}
+
+		static uint8_t* value(uint8_t* p, uint64_t v)
+		{
+			while (v >= 0x80)
+			{
+				*p++ = static_cast<uint8_t>(v) | 0x80;
+				v >>= 7;
+			}
+			*p++ = static_cast<uint8_t>(v);
+			return p;
+		}
+
+		uint8_t* cpu(uint8_t* p, uint64_t handle)
+		{
+			p = value(p, detail::zigzag(handle - mLastCpu));
+			mLastCpu = handle;
+			return p;
+		}
+
+		uint8_t* gpu(uint8_t* p, uint64_t address)
+		{
+			p = value(p, detail::zigzag(address - mLastGpu));
+			mLastGpu = address;
+			return p;
+		}
+
+		// Id 0 is null; a new id is followed by the pointer
+		uint8_t* object(uint8_t* p, const void* object)
+		{
+			if (!object)
+				return value(p, 0);
+			uint64_t key = reinterpret_cast<uintptr_t>(object);
+			uint32_t index = static_cast<uint32_t>((key >> 4) * 0x9E3779B97F4A7C15ull >> 40) & (TableSize - 1);
+			for (;; index = (index + 1) & (TableSize - 1))
+			{
+				Entry& entry = mTable[index];
+				if (entry.generation != mGeneration)
+				{
+					if (mObjectCount == MaxObjects)
+					{
+						mFull = true;
+						return p;
+					}
+					entry = { object, ++mObjectCount, mGeneration };
+					p = value(p, entry.id);
+					memcpy(p, &key, 8);
+					return p + 8;
+				}
+				if (entry.object == object)
+					return value(p, entry.id);
+			}
+		}
+	};
+
+	class Reader
+	{
+		const uint8_t* mCursor;
+		const uint8_t* mEnd;
+		const void* mObjects[MaxObjects + 1];   // by id
+		uint32_t mObjectCount = 0;
+		uint64_t mLastCpu = 0;
+		uint64_t mLastGpu = 0;
+		bool mFailed = false;
+
+	public:
+		Reader(const uint8_t* data, size_t size) : mCursor(data), mEnd(data + size)
+		{
+			mObjects[0] = nullptr;
+		}
+
+		// false at the end of the stream or on a malformed one
+		bool next(Command& command)
+		{
+			if (mFailed || mCursor == mEnd)
+				return false;
+			uint8_t tag = *mCursor++;
+			if (tag >= OpCount)
+				return fail();
+			const detail::Layout& layout = detail::Layouts[tag];
+			command.op = static_cast<Op>(tag);
+			command.objectCount = layout.objects;
+			command.cpuCount = layout.cpu;
+			command.gpuCount = layout.gpu;
+			command.valueCount = layout.values;
+			command.floatCount = layout.floats;
+			command.constants = nullptr;
+
+			if (command.op == Op::SetDescriptorHeaps)
+			{
+				if (!value(command.values[0]) || command.values[0] > MaxHeaps)
+					return fail();
+				command.objectCount = static_cast<uint8_t>(command.values[0]);
+			}
+			for (uint32_t i = 0; i < command.objectCount; ++i)
+			{
+				if (!object(command.objects[i]))
+					return fail();
+			}
+			for (uint32_t i = 0; i < layout.cpu; ++i)
+			{
+				uint64_t delta;
+				if (!value(delta))
+					return fail();
+				command.cpu[i] = mLastCpu += detail::unzigzag(delta);
+			}
+			for (uint32_t i = 0; i < layout.gpu; ++i)
+			{
+				uint64_t delta;
+				if (!value(delta))
+					return fail();
+				command.gpu[i] = mLastGpu += detail::unzigzag(delta);
+			}
+			if (command.op != Op::SetDescriptorHeaps)
+			{
+				for (uint32_t i = 0; i < layout.values; ++i)
+				{
+					if (!value(command.values[i]))
+						return fail();
+				}
+			}
+			if (layout.floats)
+			{
+				if (static_cast<size_t>(mEnd - mCursor) < layout.floats * 4u)
+					return fail();
+				memcpy(command.floats, mCursor, layout.floats * 4);
+				mCursor += layout.floats * 4;
+			}
+			if (command.op == Op::SetGraphicsRoot32BitConstants)
+			{
+				uint64_t bytes = command.values[1] * 4;
+				if (command.values[1] > MaxConstants || static_cast<uint64_t>(mEnd - mCursor) < bytes)
+					return fail();
+				command.constants = mCursor;
+				mCursor += bytes;
+			}
+			return true;
+		}
+
+		bool failed() const { return mFailed; }
+
+	private:
+		bool fail()
+		{
+			mFailed = true;
+			return false;
+		}
+
+		bool value(uint64_t& v)
+		{
+			if (mCursor != mEnd && *mCursor < 0x80)
+			{
+				v = *mCursor++;
+				return true;
+			}
+			v = 0;
+			for (uint32_t shift = 0; shift < 64 && mCursor != mEnd; shift += 7)
+			{
+				uint8_t byte = *mCursor++;
+				v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+				if (!(byte & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		bool object(const void*& object)
+		{
+			uint64_t id;
+			if (!value(id))
+				return false;
+			if (id == mObjectCount + 1 && id <= MaxObjects)
+			{
+				uint64_t key;
+				if (mEnd - mCursor < 8)
+					return false;
+				memcpy(&key, mCursor, 8);
+				mCursor += 8;
+				mObjects[++mObjectCount] = reinterpret_cast<const void*>(static_cast<uintptr_t>(key));
+			}
+			else if (id > mObjectCount)
+			{
+				return false;
+			}
+			object = mObjects[id];
+			return true;
+		}
+	};
+
+	// Calls target's method for command, with the Writer's signatures
+	template<class Target>
+	void dispatch(const Command& c, Target& target)
+	{
+		auto u = [&](uint32_t i) { return static_cast<uint32_t>(c.values[i]); };
+		const float* f = c.floats;
+		switch (c.op)
+		{
+		case Op::ResourceBarrier: target.ResourceBarrier(c.objects[0], u(0), u(1)); break;
+		case Op::SetPipelineState: target.SetPipelineState(c.objects[0]); break;
+		case Op::SetGraphicsRootSignature: target.SetGraphicsRootSignature(c.objects[0]); break;
+		case Op::SetComputeRootSignature: target.SetComputeRootSignature(c.objects[0]); break;
+		case Op::SetDescriptorHeaps: target.SetDescriptorHeaps(c.objectCount, c.objects); break;
+		case Op::SetGraphicsRootDescriptorTable: target.SetGraphicsRootDescriptorTable(u(0), c.gpu[0]); break;
+		case Op::SetGraphicsRootConstantBufferView: target.SetGraphicsRootConstantBufferView(u(0), c.gpu[0]); break;
+		case Op::SetGraphicsRoot32BitConstants: target.SetGraphicsRoot32BitConstants(u(0), u(1), c.constants, u(2)); break;
+		case Op::IASetPrimitiveTopology: target.IASetPrimitiveTopology(u(0)); break;
+		case Op::IASetVertexBuffer: target.IASetVertexBuffer(u(0), c.gpu[0], u(1), u(2)); break;
+		case Op::IASetIndexBuffer: target.IASetIndexBuffer(c.gpu[0], u(0), u(1)); break;
+		case Op::RSSetViewport: target.RSSetViewport(f[0], f[1], f[2], f[3], f[4], f[5]); break;
+		case Op::RSSetScissorRect:
+			target.RSSetScissorRect(static_cast<int32_t>(u(0)), static_cast<int32_t>(u(1)), static_cast<int32_t>(u(2)), static_cast<int32_t>(u(3)));
+			break;
+		case Op::OMSetRenderTarget: target.OMSetRenderTarget(c.cpu[0], c.cpu[1]); break;
+		case Op::ClearRenderTargetView: target.ClearRenderTargetView(c.cpu[0], f); break;
+		case Op::ClearDepthStencilView: target.ClearDepthStencilView(c.cpu[0], u(0), f[0], u(1)); break;
+		case Op::DrawInstanced: target.DrawInstanced(u(0), u(1), u(2), u(3)); break;
+		case Op::DrawIndexedInstanced: target.DrawIndexedInstanced(u(0), u(1), u(2), static_cast<int32_t>(u(3)), u(4)); break;
+		case Op::Dispatch: target.Dispatch(u(0), u(1), u(2)); break;
+		case Op::ExecuteIndirect: target.ExecuteIndirect(c.objects[0], u(0), c.objects[1], c.values[1], c.objects[2], c.values[2]); break;
+		case Op::CopyBufferRegion: target.CopyBufferRegion(c.objects[0], c.values[0], c.objects[1], c.values[1], c.values[2]); break;
+		default: break;
+		}
+	}
+
+	// Issues a stream's commands on target; false when the stream is malformed
+	template<class Target>
+	bool replay(const uint8_t* data, size_t size, Target& target)
+	{
+		Reader reader(data, size);
+		Command command;
+		while (reader.next(command))
+			dispatch(command, target);
+		return !reader.failed();
+	}
+
+	// Target that ignores every command; derive from it to handle a few
+	struct NullTarget
+	{
+		void ResourceBarrier(const void*, uint32_t, uint32_t) {}
+		void SetPipelineState(const void*) {}
+		void SetGraphicsRootSignature(const void*) {}
+		void SetComputeRootSignature(const void*) {}
+		template<class Heap>
+		void SetDescriptorHeaps(uint32_t, Heap* const*) {}
+		void SetGraphicsRootDescriptorTable(uint32_t, uint64_t) {}
+		void SetGraphicsRootConstantBufferView(uint32_t, uint64_t) {}
+		void SetGraphicsRoot32BitConstants(uint32_t, uint32_t, const void*, uint32_t) {}
+		void IASetPrimitiveTopology(uint32_t) {}
+		void IASetVertexBuffer(uint32_t, uint64_t, uint32_t, uint32_t) {}
+		void IASetIndexBuffer(uint64_t, uint32_t, uint32_t) {}
+		void RSSetViewport(float, float, float, float, float, float) {}
+		void RSSetScissorRect(int32_t, int32_t, int32_t, int32_t) {}
+		void OMSetRenderTarget(uint64_t, uint64_t) {}
+		void ClearRenderTargetView(uint64_t, const float[4]) {}
+		void ClearDepthStencilView(uint64_t, uint32_t, float, uint32_t) {}
+		void DrawInstanced(uint32_t, uint32_t, uint32_t, uint32_t) {}
+		void DrawIndexedInstanced(uint32_t, uint32_t, uint32_t, int32_t, uint32_t) {}
+		void Dispatch(uint32_t, uint32_t, uint32_t) {}
+		void ExecuteIndirect(const void*, uint32_t, const void*, uint64_t, const void*, uint64_t) {}
+		void CopyBufferRegion(const void*, uint64_t, const void*, uint64_t, uint64_t) {}
+	};
+
+	// Records into writer with record(writer), then replays the stream onto target.
+	// A stream that overflows is not replayed: record(target) records straight onto
+	// target instead, so the list is complete either way, and writer keeps the
+	// commands that fit. Returns false then.
+	template<class Target, class Record>
+	bool recordAndReplay(Writer& writer, Target& target, Record record)
+	{
+		writer.reset();
+		record(writer);
+		if (writer.droppedCount())
+		{
+			record(target);
+			return false;
+		}
+		replay(writer.data(), writer.size(), target);
+		return true;
+	}
+
+	struct Span
+	{
+		const uint8_t* data;
+		size_t size;
+	};
+
+	// Copies of the streams of the last frames, in a buffer allocated by init().
+	// Appending evicts the oldest streams whose room it needs.
+	class Ring
+	{
+		struct Record
+		{
+			uint64_t frame;
+			uint32_t index;                     // within the frame
+			size_t offset;
+			size_t size;
+		};
+
+		std::vector<uint8_t> mBytes;
+		std::vector<Record> mRecords;           // circular, oldest at mFirst
+		size_t mFirst = 0;
+		size_t mCount = 0;
+		size_t mHead = 0;                       // where the next stream goes
+
+	public:
+		void init(size_t capacity, uint32_t maxStreams)
+		{
+			mBytes.assign(capacity, 0);
+			mRecords.assign((std::max)(maxStreams, 1u), Record{});
+			mFirst = mCount = mHead = 0;
+		}
+
+		// Streams of a frame go in submission order, frames in increasing order.
+		// false when the stream is larger than the ring.
+		bool append(uint64_t frame, const uint8_t* data, size_t size)
+		{
+			if (size > mBytes.size())
+				return false;
+			if (mHead + size > mBytes.size())
+			{
+				// Wrap; the streams past the head are the oldest
+				while (mCount && front().offset >= mHead)
+					pop();
+				mHead = 0;
+			}
+			while (mCount && (mCount == mRecords.size() || (front().offset < mHead + size && front().offset + front().size > mHead)))
+				pop();
+			uint32_t index = 0;
+			if (mCount)
+			{
+				const Record& last = mRecords[(mFirst + mCount - 1) % mRecords.size()];
+				if (last.frame == frame)
+					index = last.index + 1;
+			}
+			memcpy(mBytes.data() + mHead, data, size);
+			mRecords[(mFirst + mCount) % mRecords.size()] = { frame, index, mHead, size };
+			mCount++;
+			mHead += size;
+			return true;
+		}
+
+		// The streams of frame in submission order; false when some were evicted or there are none
+		bool frame(uint64_t frame, std::vector<Span>& streams) const
+		{
+			streams.clear();
+			for (size_t i = 0; i < mCount; ++i)
+			{
+				const Record& record = mRecords[(mFirst + i) % mRecords.size()];
+				if (record.frame != frame)
+					continue;
+				if (streams.empty() && record.index != 0)
+					return false;
+				streams.push_back({ mBytes.data() + record.offset, record.size });
+			}
+			return !streams.empty();
+		}
+
+		// 0 when empty
+		uint64_t lastFrame() const
+		{
+			return mCount ? mRecords[(mFirst + mCount - 1) % mRecords.size()].frame : 0;
+		}
+
+	private:
+		const Record& front() const
+		{
+			return mRecords[mFirst];
+		}
+
+		void pop()
+		{
+			mFirst = (mFirst + 1) % mRecords.size();
+			mCount--;
+		}
+	};
+
+	inline bool same(const Command& a, const Command& b)
+	{
+		if (a.op != b.op || a.objectCount != b.objectCount)
+			return false;
+		for (uint32_t i = 0; i < a.objectCount; ++i)
+		{
+			if (a.objects[i] != b.objects[i])
+				return false;
+		}
+		for (uint32_t i = 0; i < a.cpuCount; ++i)
+		{
+			if (a.cpu[i] != b.cpu[i])
+				return false;
+		}
+		for (uint32_t i = 0; i < a.gpuCount; ++i)
+		{
+			if (a.gpu[i] != b.gpu[i])
+				return false;
+		}
+		uint32_t valueCount = a.op == Op::SetDescriptorHeaps ? 0 : a.valueCount;
+		for (uint32_t i = 0; i < valueCount; ++i)
+		{
+			if (a.values[i] != b.values[i])
+				return false;
+		}
+		if (memcmp(a.floats, b.floats, a.floatCount * 4) != 0)
+			return false;
+		return !a.constants || memcmp(a.constants, b.constants, static_cast<size_t>(a.values[1]) * 4) == 0;
+	}
+
+	// Command counts, and state sets that left the list's state as it was
+	struct Analysis
+	{
+		uint32_t streams;
+		uint64_t bytes;
+		uint32_t commands[OpCount];
+		uint32_t redundant[OpCount];
+	};
+
+	// Adds a command list's stream; the state starts unset, as on a new list.
+	// false when the stream is malformed.
+	inline bool analyze(const uint8_t* data, size_t size, Analysis& analysis)
+	{
+		// Last value per state Op and slot (root parameter or vertex buffer slot)
+		std::vector<Command> state(OpCount * MaxSlots);
+		std::vector<bool> set(OpCount * MaxSlots, false);
+		auto clearRootArguments = [&]
+		{
+			for (Op op : { Op::SetGraphicsRootDescriptorTable, Op::SetGraphicsRootConstantBufferView, Op::SetGraphicsRoot32BitConstants })
+				std::fill_n(set.begin() + static_cast<uint32_t>(op) * MaxSlots, MaxSlots, false);
+		};
+
+		analysis.streams++;
+		analysis.bytes += size;
+		Reader reader(data, size);
+		Command command;
+		while (reader.next(command))
+		{
+			uint32_t op = static_cast<uint32_t>(command.op);
+			analysis.commands[op]++;
+			uint32_t slot = 0;
+			switch (command.op)
+			{
+			case Op::SetGraphicsRootDescriptorTable:
+			case Op::SetGraphicsRootConstantBufferView:
+			case Op::SetGraphicsRoot32BitConstants:
+			case Op::IASetVertexBuffer:
+				slot = static_cast<uint32_t>(command.values[0]);
+				break;
+			case Op::SetPipelineState:
+			case Op::SetGraphicsRootSignature:
+			case Op::SetComputeRootSignature:
+			case Op::SetDescriptorHeaps:
+			case Op::IASetPrimitiveTopology:
+			case Op::IASetIndexBuffer:
+			case Op::RSSetViewport:
+			case Op::RSSetScissorRect:
+			case Op::OMSetRenderTarget:
+				break;
+			default:
+				continue;                       // not state
+			}
+			if (slot >= MaxSlots)
+				continue;
+			uint32_t index = op * MaxSlots + slot;
+			if (set[index] && same(state[index], command))
+			{
+				analysis.redundant[op]++;
+				continue;
+			}
+			// A new root signature or heap leaves the root arguments unset
+			if (command.op == Op::SetGraphicsRootSignature || command.op == Op::SetDescriptorHeaps)
+				clearRootArguments();
+			state[index] = command;
+			set[index] = true;
+		}
+		return !reader.failed();
+	}
+
+	// Commands that differ between two frames. Streams are paired in submission
+	// order; within a pair, past the common prefix and suffix, commands are
+	// compared by position and the longer side's extra ones are added or removed.
+	struct Diff
+	{
+		uint32_t streams[2];
+		uint32_t commands[2];
+		uint32_t changed;
+		uint32_t added;                         // in the second frame only
+		uint32_t removed;                       // in the first frame only
+		uint32_t changedByOp[OpCount];          // by the second frame's command, the first's when removed
+		int32_t firstStream;                    // of the first difference, -1 when the frames match
+		int32_t firstCommand;
+	};
+
+	// false when a stream is malformed
+	inline bool diff(const Span* a, uint32_t countA, const Span* b, uint32_t countB, Diff& result)
+	{
+		result = {};
+		result.streams[0] = countA;
+		result.streams[1] = countB;
+		result.firstStream = result.firstCommand = -1;
+		std::vector<Command> commands[2];
+		for (uint32_t s = 0; s < (std::max)(countA, countB); ++s)
+		{
+			for (int side = 0; side < 2; ++side)
+			{
+				commands[side].clear();
+				const Span* spans = side ? b : a;
+				if (s >= (side ? countB : countA))
+					continue;
+				Reader reader(spans[s].data, spans[s].size);
+				Command command;
+				while (reader.next(command))
+					commands[side].push_back(command);
+				if (reader.failed())
+					return false;
+				result.commands[side] += static_cast<uint32_t>(commands[side].size());
+			}
+			auto& first = commands[0];
+			auto& second = commands[1];
+			size_t prefix = 0;
+			while (prefix < first.size() && prefix < second.size() && same(first[prefix], second[prefix]))
+				prefix++;
+			size_t suffix = 0;
+			while (suffix < first.size() - prefix && suffix < second.size() - prefix &&
+				same(first[first.size() - 1 - suffix], second[second.size() - 1 - suffix]))
+				suffix++;
+			size_t firstRest = first.size() - prefix - suffix;
+			size_t secondRest = second.size() - prefix - suffix;
+			if ((firstRest || secondRest) && result.firstStream < 0)
+			{
+				result.firstStream = static_cast<int32_t>(s);
+				result.firstCommand = static_cast<int32_t>(prefix);
+			}
+			for (size_t i = 0; i < secondRest; ++i)
+			{
+				if (i >= firstRest)
+					result.added++;
+				else if (!same(first[prefix + i], second[prefix + i]))
+					result.changed++;
+				else
+					continue;
+				result.changedByOp[static_cast<uint32_t>(second[prefix + i].op)]++;
+			}
+			for (size_t i = secondRest; i < firstRest; ++i)
+			{
+				result.removed++;
+				result.changedByOp[static_cast<uint32_t>(first[prefix + i].op)]++;
+			}
+		}
+		return true;
+	}
+
+	// One line per Op with commands; returns the length written, as snprintf
+	inline size_t print(const Analysis& analysis, char* text, size_t size)
+	{
+		size_t length = snprintf(text, size, "%u streams, %llu bytes\n", analysis.streams, static_cast<unsigned long long>(analysis.bytes));
+		for (uint32_t op = 0; op < OpCount; ++op)
+		{
+			if (!analysis.commands[op])
+				continue;
+			length += snprintf(text + (std::min)(length, size), size - (std::min)(length, size), "  %-34s %6u, %6u redundant\n",
+				opName(static_cast<Op>(op)), analysis.commands[op], analysis.redundant[op]);
+		}
+		return length;
+	}
+
+	inline size_t print(const Diff& diff, char* text, size_t size)
+	{
+		size_t length = snprintf(text, size, "%u -> %u streams, %u -> %u commands: %u changed, %u added, %u removed\n",
+			diff.streams[0], diff.streams[1], diff.commands[0], diff.commands[1], diff.changed, diff.added, diff.removed);
+		if (diff.firstStream >= 0)
+		{
+			length += snprintf(text + (std::min)(length, size), size - (std::min)(length, size), "  first difference: stream %d, command %d\n",
+				diff.firstStream, diff.firstCommand);
+		}
+		for (uint32_t op = 0; op < OpCount; ++op)
+		{
+			if (!diff.changedByOp[op])
+				continue;
+			length += snprintf(text + (std::min)(length, size), size - (std::min)(length, size), "  %-34s %6u\n",
+				opName(static_cast<Op>(op)), diff.changedByOp[op]);
+		}
+		return length;
+	}
+};
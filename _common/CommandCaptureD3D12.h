@@ -0,0 +1,115 @@
+#pragma once
+
+// CommandCapture target over an ID3D12GraphicsCommandList. It replays streams onto
+// the list, and lets recording code written against the Writer's signatures
+// record straight onto the list.
+
+#include <d3d12.h>
+#include "CommandCapture.h"
+
+namespace CommandCapture
+{
+	class D3D12Target
+	{
+		ID3D12GraphicsCommandList* mList;
+
+		template<class T>
+		static T* cast(const void* object)
+		{
+			return static_cast<T*>(const_cast<void*>(object));
+		}
+
+	public:
+		explicit D3D12Target(ID3D12GraphicsCommandList* list) : mList(list) {}
+
+		void ResourceBarrier(const void* resource, uint32_t before, uint32_t after)
+		{
+			D3D12_RESOURCE_BARRIER desc = {};
+			desc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			desc.Transition.pResource = cast<ID3D12Resource>(resource);
+			desc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+			desc.Transition.StateBefore = (D3D12_RESOURCE_STATES)before;
+			desc.Transition.StateAfter = (D3D12_RESOURCE_STATES)after;
+			desc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+			mList->ResourceBarrier(1, &desc);
+		}
+		void SetPipelineState(const void* state) { mList->SetPipelineState(cast<ID3D12PipelineState>(state)); }
+		void SetGraphicsRootSignature(const void* signature) { mList->SetGraphicsRootSignature(cast<ID3D12RootSignature>(signature)); }
+		void SetComputeRootSignature(const void* signature) { mList->SetComputeRootSignature(cast<ID3D12RootSignature>(signature)); }
+		template<class Heap>
+		void SetDescriptorHeaps(uint32_t count, Heap* const* heaps)
+		{
+			ID3D12DescriptorHeap* descHeaps[MaxHeaps];
+			for (auto i = 0u; i < count; i++)
+			{
+				descHeaps[i] = cast<ID3D12DescriptorHeap>(heaps[i]);
+			}
+			mList->SetDescriptorHeaps(count, descHeaps);
+		}
+		void SetGraphicsRootDescriptorTable(uint32_t rootIndex, uint64_t handle)
+		{
+			D3D12_GPU_DESCRIPTOR_HANDLE table = { handle };
+			mList->SetGraphicsRootDescriptorTable(rootIndex, table);
+		}
+		void SetGraphicsRootConstantBufferView(uint32_t rootIndex, uint64_t address) { mList->SetGraphicsRootConstantBufferView(rootIndex, address); }
+		void SetGraphicsRoot32BitConstants(uint32_t rootIndex, uint32_t count, const void* data, uint32_t offset)
+		{
+			mList->SetGraphicsRoot32BitConstants(rootIndex, count, data, offset);
+		}
+		void IASetPrimitiveTopology(uint32_t topology) { mList->IASetPrimitiveTopology((D3D12_PRIMITIVE_TOPOLOGY)topology); }
+		void IASetVertexBuffer(uint32_t slot, uint64_t address, uint32_t size, uint32_t stride)
+		{
+			D3D12_VERTEX_BUFFER_VIEW view = { address, size, stride };
+			mList->IASetVertexBuffers(slot, 1, &view);
+		}
+		void IASetIndexBuffer(uint64_t address, uint32_t size, uint32_t format)
+		{
+			D3D12_INDEX_BUFFER_VIEW view = { address, size, (DXGI_FORMAT)format };
+			mList->IASetIndexBuffer(&view);
+		}
+		void RSSetViewport(float x, float y, float width, float height, float minDepth, float maxDepth)
+		{
+			D3D12_VIEWPORT viewport = { x, y, width, height, minDepth, maxDepth };
+			mList->RSSetViewports(1, &viewport);
+		}
+		void RSSetScissorRect(int32_t left, int32_t top, int32_t right, int32_t bottom)
+		{
+			D3D12_RECT scissor = { left, top, right, bottom };
+			mList->RSSetScissorRects(1, &scissor);
+		}
+		void OMSetRenderTarget(uint64_t rtv, uint64_t dsv)
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = { (SIZE_T)rtv }, dsvHandle = { (SIZE_T)dsv };
+			mList->OMSetRenderTargets(1, &rtvHandle, true, dsv ? &dsvHandle : nullptr);
+		}
+		void ClearRenderTargetView(uint64_t rtv, const float color[4])
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE handle = { (SIZE_T)rtv };
+			mList->ClearRenderTargetView(handle, color, 0, nullptr);
+		}
+		void ClearDepthStencilView(uint64_t dsv, uint32_t flags, float depth, uint32_t stencil)
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE handle = { (SIZE_T)dsv };
+			mList->ClearDepthStencilView(handle, (D3D12_CLEAR_FLAGS)flags, depth, (UINT8)stencil, 0, nullptr);
+		}
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance)
+		{
+			mList->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+		}
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+		{
+			mList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+		}
+		void Dispatch(uint32_t x, uint32_t y, uint32_t z) { mList->Dispatch(x, y, z); }
+		void ExecuteIndirect(const void* signature, uint32_t maxCommandCount, const void* arguments, uint64_t argumentOffset,
+			const void* countBuffer, uint64_t countOffset)
+		{
+			mList->ExecuteIndirect(cast<ID3D12CommandSignature>(signature), maxCommandCount, cast<ID3D12Resource>(arguments), argumentOffset,
+				cast<ID3D12Resource>(countBuffer), countOffset);
+		}
+		void CopyBufferRegion(const void* dst, uint64_t dstOffset, const void* src, uint64_t srcOffset, uint64_t size)
+		{
+			mList->CopyBufferRegion(cast<ID3D12Resource>(dst), dstOffset, cast<ID3D12Resource>(src), srcOffset, size);
+		}
+	};
+};
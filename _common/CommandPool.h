@@ -0,0 +1,260 @@
+#pragma once
+
+// Pool of command allocators and command lists.
+// acquire() hands out an allocator with a list open on it, creating either when
+// none is free. After the list is executed, submit() takes both back: the list
+// is free again at once, the allocator once the fence value it was submitted
+// with has completed and reclaim() has seen it. The allocator is reset on its
+// next acquire(), so a frame never waits for one.
+// An allocator keeps the memory of the largest recording made on it, and D3D12
+// cannot report it, so submit() takes an estimate of the recorded bytes; the
+// pool keeps the peak per allocator. Allocators left unused for IdleLimit
+// reclaims, and allocators whose recent recordings fall below a quarter of
+// their peak, are released, as are lists unused for IdleLimit reclaims.
+// Allocator and List are ID3D12CommandAllocator* and ID3D12GraphicsCommandList*
+// in the samples; the pool only calls the callbacks on them.
+// acquire() and submit() are thread-safe.
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+template<class Allocator, class List>
+class CommandPool
+{
+public:
+	static const uint64_t IdleLimit = 120;      // reclaims, about two seconds of frames
+
+	struct Callbacks
+	{
+		std::function<bool(Allocator& allocator)> createAllocator;
+		std::function<bool(Allocator allocator, List& list)> createList;    // open on allocator
+		std::function<void(Allocator allocator)> resetAllocator;
+		std::function<void(List list, Allocator allocator)> resetList;      // reopen on allocator
+		std::function<void(Allocator allocator)> releaseAllocator;
+		std::function<void(List list)> releaseList;
+	};
+
+	struct Pair
+	{
+		Allocator allocator;
+		List list;                      // nullptr when creation failed
+		uint32_t slot;
+	};
+
+	struct Stats
+	{
+		uint32_t allocators;            // alive, free or in use
+		uint32_t lists;
+		uint64_t created;               // allocators created since init()
+		uint64_t released;
+		uint64_t pinnedBytes;           // sum of the peaks of the live allocators
+	};
+
+private:
+	struct Slot
+	{
+		Allocator allocator;
+		bool alive;
+		uint64_t peakBytes;             // largest recording since creation
+		uint64_t recentBytes;           // decaying maximum of recent recordings
+		uint64_t uses;
+		uint64_t freeSince;             // reclaim count when it became free
+	};
+
+	struct Pending
+	{
+		uint64_t fenceValue;
+		uint32_t slot;
+	};
+
+	struct FreeList
+	{
+		List list;
+		uint64_t freeSince;
+	};
+
+	std::mutex mMutex;
+	Callbacks mCallbacks;
+	std::vector<Slot> mSlots;
+	std::vector<uint32_t> mDeadSlots;
+	std::vector<uint32_t> mFree;        // completed allocators, most recently used last
+	std::deque<Pending> mPending;       // in submission order
+	std::vector<FreeList> mFreeLists;   // most recently used last
+	uint32_t mListCount = 0;
+	uint64_t mReclaims = 0;
+	Stats mStats = {};
+
+public:
+	CommandPool() = default;
+	CommandPool(const CommandPool&) = delete;
+	CommandPool& operator=(const CommandPool&) = delete;
+	// The GPU must be done with every submitted list, and no pair may be acquired
+	~CommandPool()
+	{
+		clear();
+	}
+
+	void init(const Callbacks& callbacks)
+	{
+		clear();
+		mCallbacks = callbacks;
+	}
+
+	Pair acquire()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		Pair pair = {};
+		if (!mFree.empty())
+		{
+			pair.slot = mFree.back();
+			mFree.pop_back();
+			pair.allocator = mSlots[pair.slot].allocator;
+			mCallbacks.resetAllocator(pair.allocator);
+		}
+		else
+		{
+			if (!mCallbacks.createAllocator(pair.allocator))
+				return {};
+			if (mDeadSlots.empty())
+			{
+				mSlots.push_back({});
+				mDeadSlots.push_back(static_cast<uint32_t>(mSlots.size() - 1));
+			}
+			pair.slot = mDeadSlots.back();
+			mDeadSlots.pop_back();
+			mSlots[pair.slot] = { pair.allocator, true, 0, 0, 0, 0 };
+			mStats.created++;
+			mStats.allocators++;
+		}
+
+		if (!mFreeLists.empty())
+		{
+			pair.list = mFreeLists.back().list;
+			mFreeLists.pop_back();
+			mCallbacks.resetList(pair.list, pair.allocator);
+		}
+		else if (mCallbacks.createList(pair.allocator, pair.list))
+		{
+			mListCount++;
+		}
+		else
+		{
+			// Keep the allocator for the next acquire()
+			mSlots[pair.slot].freeSince = mReclaims;
+			mFree.push_back(pair.slot);
+			return {};
+		}
+		return pair;
+	}
+
+	// Call after the list is closed and executed, before the fence is signaled
+	// with fenceValue. Fence values must not decrease between calls.
+	void submit(const Pair& pair, uint64_t fenceValue, uint64_t recordedBytes)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFreeLists.push_back({ pair.list, mReclaims });
+		auto& slot = mSlots[pair.slot];
+		slot.peakBytes = (std::max)(slot.peakBytes, recordedBytes);
+		slot.recentBytes = (std::max)(recordedBytes, slot.recentBytes - slot.recentBytes / 8);
+		slot.uses++;
+		mPending.push_back({ fenceValue, pair.slot });
+	}
+
+	// Frees the allocators submitted with a fence value not greater than completedValue
+	// and releases what has been idle too long. Call once per frame.
+	void reclaim(uint64_t completedValue)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mReclaims++;
+		while (!mPending.empty() && mPending.front().fenceValue <= completedValue)
+		{
+			uint32_t index = mPending.front().slot;
+			mPending.pop_front();
+			auto& slot = mSlots[index];
+			if (slot.recentBytes < slot.peakBytes / 4)
+			{
+				// Recent recordings are much smaller; a new allocator pins less memory
+				releaseSlot(index);
+				continue;
+			}
+			slot.freeSince = mReclaims;
+			mFree.push_back(index);
+		}
+
+		// The oldest free entries are at the front
+		size_t idle = 0;
+		while (idle < mFree.size() && mReclaims - mSlots[mFree[idle]].freeSince > IdleLimit)
+			releaseSlot(mFree[idle++]);
+		mFree.erase(mFree.begin(), mFree.begin() + idle);
+		idle = 0;
+		while (idle < mFreeLists.size() && mReclaims - mFreeLists[idle].freeSince > IdleLimit)
+		{
+			mCallbacks.releaseList(mFreeLists[idle++].list);
+			mListCount--;
+		}
+		mFreeLists.erase(mFreeLists.begin(), mFreeLists.begin() + idle);
+	}
+
+	Stats stats()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		Stats stats = mStats;
+		stats.lists = mListCount;
+		stats.pinnedBytes = 0;
+		for (auto& slot : mSlots)
+		{
+			if (slot.alive)
+				stats.pinnedBytes += slot.peakBytes;
+		}
+		return stats;
+	}
+
+	// Calls f(uint32_t slot, uint64_t peakBytes, uint64_t uses) for every live allocator
+	template<class F>
+	void forEachAllocator(F f)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (size_t i = 0; i < mSlots.size(); ++i)
+		{
+			if (mSlots[i].alive)
+				f(static_cast<uint32_t>(i), mSlots[i].peakBytes, mSlots[i].uses);
+		}
+	}
+
+private:
+	void releaseSlot(uint32_t index)
+	{
+		auto& slot = mSlots[index];
+		mCallbacks.releaseAllocator(slot.allocator);
+		slot = {};
+		mDeadSlots.push_back(index);
+		mStats.released++;
+		mStats.allocators--;
+	}
+
+	void clear()
+	{
+		for (auto& slot : mSlots)
+		{
+			if (slot.alive && mCallbacks.releaseAllocator)
+				mCallbacks.releaseAllocator(slot.allocator);
+		}
+		for (auto& entry : mFreeLists)
+		{
+			if (mCallbacks.releaseList)
+				mCallbacks.releaseList(entry.list);
+		}
+		mSlots.clear();
+		mDeadSlots.clear();
+		mFree.clear();
+		mPending.clear();
+		mFreeLists.clear();
+		mListCount = 0;
+		mReclaims = 0;
+		mStats = {};
+	}
+};
@@ -0,0 +1,567 @@
+#pragma once
+
+// DDS reader and D3D12 upload layout.
+// Parses DDS_HEADER and DDS_HEADER_DXT10 (1D/2D/3D textures, arrays, cubemaps,
+// uncompressed and BC1-BC7 formats), splits the payload into subresources and
+// computes the placed footprints CopyTextureRegion expects: rows aligned to
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT (256) and subresources to
+// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT (512), the same numbers
+// ID3D12Device::GetCopyableFootprints returns.
+// Formats are DXGI_FORMAT values, kept as plain integers so this builds without
+// the Windows SDK.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "MappedFile.h"
+#include "UploadCopy.h"
+
+namespace DDS
+{
+	static const uint32_t Magic = 0x20534444; // "DDS "
+	static const uint32_t PitchAlignment = 256;
+	static const uint32_t PlacementAlignment = 512;
+	static const uint32_t MaxArraySize = 2048;          // D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION
+
+	// DXGI_FORMAT values used by the legacy header mapping
+	enum Format : uint32_t
+	{
+		FormatUnknown = 0,
+		FormatR32G32B32A32Float = 2,
+		FormatR16G16B16A16Float = 10,
+		FormatR16G16B16A16Unorm = 11,
+		FormatR16G16B16A16Snorm = 13,
+		FormatR32G32Float = 16,
+		FormatR10G10B10A2Unorm = 24,
+		FormatR8G8B8A8Unorm = 28,
+		FormatR8G8B8A8UnormSrgb = 29,
+		FormatR8G8B8A8Snorm = 31,
+		FormatR16G16Float = 34,
+		FormatR16G16Unorm = 35,
+		FormatR16G16Snorm = 37,
+		FormatR32Float = 41,
+		FormatR8G8Unorm = 49,
+		FormatR8G8Snorm = 51,
+		FormatR16Float = 54,
+		FormatR16Unorm = 56,
+		FormatR8Unorm = 61,
+		FormatA8Unorm = 65,
+		FormatBC1Unorm = 71,
+		FormatBC1UnormSrgb = 72,
+		FormatBC2Unorm = 74,
+		FormatBC2UnormSrgb = 75,
+		FormatBC3Unorm = 77,
+		FormatBC3UnormSrgb = 78,
+		FormatBC4Unorm = 80,
+		FormatBC4Snorm = 81,
+		FormatBC5Unorm = 83,
+		FormatBC5Snorm = 84,
+		FormatB5G6R5Unorm = 85,
+		FormatB5G5R5A1Unorm = 86,
+		FormatB8G8R8A8Unorm = 87,
+		FormatB8G8R8X8Unorm = 88,
+		FormatB8G8R8A8UnormSrgb = 91,
+		FormatBC6HUF16 = 95,
+		FormatBC6HSF16 = 96,
+		FormatBC7Unorm = 98,
+		FormatBC7UnormSrgb = 99,
+		FormatB4G4R4A4Unorm = 115,
+	};
+
+	enum Dimension : uint32_t
+	{
+		DimensionTexture1D = 2,     // D3D12_RESOURCE_DIMENSION values
+		DimensionTexture2D = 3,
+		DimensionTexture3D = 4,
+	};
+
+	struct PixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rBitMask;
+		uint32_t gBitMask;
+		uint32_t bBitMask;
+		uint32_t aBitMask;
+	};
+
+	struct Header
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		PixelFormat pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+	static_assert(sizeof(Header) == 124, "DDS::Header must be 124 bytes");
+
+	struct HeaderDXT10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+	static_assert(sizeof(HeaderDXT10) == 20, "DDS::HeaderDXT10 must be 20 bytes");
+
+	static const uint32_t FlagDepth = 0x800000;          // DDSD_DEPTH
+	static const uint32_t PixelFlagAlpha = 0x1;          // DDPF_ALPHA
+	static const uint32_t PixelFlagFourCC = 0x4;         // DDPF_FOURCC
+	static const uint32_t PixelFlagRGB = 0x40;           // DDPF_RGB
+	static const uint32_t PixelFlagLuminance = 0x20000;  // DDPF_LUMINANCE
+	static const uint32_t PixelFlagBumpDuDv = 0x80000;   // DDPF_BUMPDUDV
+	static const uint32_t Caps2Cubemap = 0x200;
+	static const uint32_t Caps2CubemapAllFaces = 0xFC00;
+	static const uint32_t Caps2Volume = 0x200000;
+	static const uint32_t MiscTextureCube = 0x4;         // D3D11_RESOURCE_MISC_TEXTURECUBE
+
+	inline uint32_t fourCC(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(static_cast<uint8_t>(a)) | (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+			(static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+	}
+
+	inline bool isBlockCompressed(uint32_t format)
+	{
+		return (format >= 70 && format <= 84) || (format >= 94 && format <= 99);
+	}
+
+	// Bytes per 4x4 block for BC formats, 0 otherwise
+	inline uint32_t blockBytes(uint32_t format)
+	{
+		if ((format >= 70 && format <= 72) || (format >= 79 && format <= 81))
+			return 8;
+		return isBlockCompressed(format) ? 16 : 0;
+	}
+
+	// Bits per pixel for uncompressed formats, 0 for unsupported ones (video, packed 4:2:2, R1)
+	inline uint32_t bitsPerPixel(uint32_t format)
+	{
+		if (format >= 1 && format <= 4) return 128;
+		if (format >= 5 && format <= 8) return 96;
+		if (format >= 9 && format <= 22) return 64;
+		if (format >= 23 && format <= 47) return 32;
+		if (format >= 48 && format <= 59) return 16;
+		if (format >= 60 && format <= 65) return 8;
+		if (format == 67) return 32;
+		if (format == 85 || format == 86 || format == 115) return 16;
+		if (format >= 87 && format <= 93) return 32;
+		return 0;
+	}
+
+	struct TextureDesc
+	{
+		uint32_t dimension = DimensionTexture2D;
+		uint32_t format = FormatUnknown;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t depth = 1;
+		uint32_t arraySize = 1;     // Counts faces, i.e. 6 per cube (D3D12 DepthOrArraySize)
+		uint32_t mipLevels = 1;
+		bool cubemap = false;
+
+		uint32_t subresourceCount() const
+		{
+			return mipLevels * (dimension == DimensionTexture3D ? 1 : arraySize);
+		}
+	};
+
+	// One subresource as stored in the file (tightly packed rows)
+	struct Subresource
+	{
+		const uint8_t* data;
+		uint32_t width, height, depth;
+		uint32_t rowCount;          // rows of pixels, or of blocks for BC formats
+		uint32_t rowSize;           // bytes per row
+		size_t slicePitch;          // rowSize * rowCount
+	};
+
+	// Same fields as D3D12_PLACED_SUBRESOURCE_FOOTPRINT plus the GetCopyableFootprints outputs
+	struct Footprint
+	{
+		uint64_t offset;
+		uint32_t format;
+		uint32_t width, height, depth;
+		uint32_t rowPitch;
+		uint32_t rowCount;
+		uint64_t rowSize;
+	};
+
+	inline uint32_t mipSize(uint32_t size, uint32_t mip)
+	{
+		size >>= mip;
+		return size ? size : 1;
+	}
+
+	// Bytes per row and number of rows of one mip level; false for unsupported formats
+	// and rows of 4 GB or more.
+	inline bool surfaceInfo(uint32_t format, uint32_t width, uint32_t height, uint32_t& rowSize, uint32_t& rowCount)
+	{
+		uint64_t bytes;
+		if (uint32_t bb = blockBytes(format))
+		{
+			bytes = ((static_cast<uint64_t>(width) + 3) / 4) * bb;
+			rowCount = static_cast<uint32_t>((static_cast<uint64_t>(height) + 3) / 4);
+		}
+		else
+		{
+			uint32_t bpp = bitsPerPixel(format);
+			if (!bpp)
+				return false;
+			bytes = (static_cast<uint64_t>(width) * bpp + 7) / 8;
+			rowCount = height;
+		}
+		if (bytes > UINT32_MAX)
+			return false;
+		rowSize = static_cast<uint32_t>(bytes);
+		return true;
+	}
+
+	namespace detail
+	{
+		inline bool masks(const PixelFormat& pf, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+		{
+			return pf.rBitMask == r && pf.gBitMask == g && pf.bBitMask == b && pf.aBitMask == a;
+		}
+
+		// Maps a legacy (pre-DX10) pixel format, following the DirectXTex DDS loader
+		inline uint32_t legacyFormat(const PixelFormat& pf)
+		{
+			if (pf.flags & PixelFlagFourCC)
+			{
+				switch (pf.fourCC)
+				{
+				case 0x31545844: return FormatBC1Unorm;             // DXT1
+				case 0x32545844:                                    // DXT2
+				case 0x33545844: return FormatBC2Unorm;             // DXT3
+				case 0x34545844:                                    // DXT4
+				case 0x35545844: return FormatBC3Unorm;             // DXT5
+				case 0x31495441:                                    // ATI1
+				case 0x55344342: return FormatBC4Unorm;             // BC4U
+				case 0x53344342: return FormatBC4Snorm;             // BC4S
+				case 0x32495441:                                    // ATI2
+				case 0x55354342: return FormatBC5Unorm;             // BC5U
+				case 0x53354342: return FormatBC5Snorm;             // BC5S
+				case 36: return FormatR16G16B16A16Unorm;            // D3DFMT_A16B16G16R16
+				case 110: return FormatR16G16B16A16Snorm;           // D3DFMT_Q16W16V16U16
+				case 111: return FormatR16Float;                    // D3DFMT_R16F
+				case 112: return FormatR16G16Float;                 // D3DFMT_G16R16F
+				case 113: return FormatR16G16B16A16Float;           // D3DFMT_A16B16G16R16F
+				case 114: return FormatR32Float;                    // D3DFMT_R32F
+				case 115: return FormatR32G32Float;                 // D3DFMT_G32R32F
+				case 116: return FormatR32G32B32A32Float;           // D3DFMT_A32B32G32R32F
+				}
+				return FormatUnknown;
+			}
+
+			if (pf.flags & PixelFlagRGB)
+			{
+				switch (pf.rgbBitCount)
+				{
+				case 32:
+					if (masks(pf, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000)) return FormatR8G8B8A8Unorm;
+					if (masks(pf, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000)) return FormatB8G8R8A8Unorm;
+					if (masks(pf, 0x00FF0000, 0x0000FF00, 0x000000FF, 0)) return FormatB8G8R8X8Unorm;
+					// D3DFMT_A2B10G10R10; the DX9 masks are swapped for historical reasons
+					if (masks(pf, 0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000)) return FormatR10G10B10A2Unorm;
+					if (masks(pf, 0x0000FFFF, 0xFFFF0000, 0, 0)) return FormatR16G16Unorm;
+					if (masks(pf, 0xFFFFFFFF, 0, 0, 0)) return FormatR32Float;
+					break;
+				case 16:
+					if (masks(pf, 0x7C00, 0x03E0, 0x001F, 0x8000)) return FormatB5G5R5A1Unorm;
+					if (masks(pf, 0xF800, 0x07E0, 0x001F, 0)) return FormatB5G6R5Unorm;
+					if (masks(pf, 0x0F00, 0x00F0, 0x000F, 0xF000)) return FormatB4G4R4A4Unorm;
+					break;
+				}
+				return FormatUnknown;
+			}
+
+			if (pf.flags & PixelFlagLuminance)
+			{
+				if (pf.rgbBitCount == 8 && pf.rBitMask == 0xFF) return FormatR8Unorm;
+				if (pf.rgbBitCount == 16 && pf.rBitMask == 0xFFFF) return FormatR16Unorm;
+				if (pf.rgbBitCount == 16 && masks(pf, 0x00FF, 0, 0, 0xFF00)) return FormatR8G8Unorm;
+				return FormatUnknown;
+			}
+
+			if (pf.flags & PixelFlagAlpha)
+				return pf.rgbBitCount == 8 ? FormatA8Unorm : FormatUnknown;
+
+			if (pf.flags & PixelFlagBumpDuDv)
+			{
+				if (pf.rgbBitCount == 16 && masks(pf, 0x00FF, 0xFF00, 0, 0)) return FormatR8G8Snorm;
+				if (pf.rgbBitCount == 32 && masks(pf, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000)) return FormatR8G8B8A8Snorm;
+				if (pf.rgbBitCount == 32 && masks(pf, 0x0000FFFF, 0xFFFF0000, 0, 0)) return FormatR16G16Snorm;
+			}
+			return FormatUnknown;
+		}
+	};
+
+	// Parses the headers of an in-memory DDS file. On success desc describes the
+	// texture and subresources (desc.subresourceCount() entries, D3D12 order:
+	// mip + slice * mipLevels) point into data.
+	inline bool parse(const void* data, size_t size, TextureDesc& desc, std::vector<Subresource>& subresources)
+	{
+		subresources.clear();
+		auto* bytes = static_cast<const uint8_t*>(data);
+		if (size < 4 + sizeof(Header))
+			return false;
+		uint32_t magic;
+		memcpy(&magic, bytes, sizeof(magic));
+		Header header;
+		memcpy(&header, bytes + 4, sizeof(header));
+		if (magic != Magic || header.size != sizeof(Header) || header.pixelFormat.size != sizeof(PixelFormat))
+			return false;
+
+		size_t offset = 4 + sizeof(Header);
+		desc = TextureDesc();
+		desc.width = header.width;
+		desc.height = header.height;
+		desc.mipLevels = header.mipMapCount ? header.mipMapCount : 1;
+
+		if ((header.pixelFormat.flags & PixelFlagFourCC) && header.pixelFormat.fourCC == fourCC('D', 'X', '1', '0'))
+		{
+			if (size < offset + sizeof(HeaderDXT10))
+				return false;
+			HeaderDXT10 dx10;
+			memcpy(&dx10, bytes + offset, sizeof(dx10));
+			offset += sizeof(HeaderDXT10);
+
+			desc.format = dx10.dxgiFormat;
+			desc.arraySize = dx10.arraySize;
+			if (desc.arraySize == 0 || desc.arraySize > MaxArraySize)
+				return false;
+			switch (dx10.resourceDimension)
+			{
+			case DimensionTexture1D:
+				desc.dimension = DimensionTexture1D;
+				desc.height = 1;
+				break;
+			case DimensionTexture2D:
+				if (dx10.miscFlag & MiscTextureCube)
+				{
+					desc.cubemap = true;
+					desc.arraySize *= 6;
+					if (desc.arraySize > MaxArraySize)
+						return false;
+				}
+				break;
+			case DimensionTexture3D:
+				if (!(header.flags & FlagDepth) || desc.arraySize > 1)
+					return false;
+				desc.dimension = DimensionTexture3D;
+				desc.depth = header.depth;
+				break;
+			default:
+				return false;
+			}
+		}
+		else
+		{
+			desc.format = detail::legacyFormat(header.pixelFormat);
+			if (header.flags & FlagDepth)
+			{
+				desc.dimension = DimensionTexture3D;
+				desc.depth = header.depth;
+			}
+			else if (header.caps2 & Caps2Cubemap)
+			{
+				// Partial cubemaps are not supported by D3D10+
+				if ((header.caps2 & Caps2CubemapAllFaces) != Caps2CubemapAllFaces)
+					return false;
+				desc.cubemap = true;
+				desc.arraySize = 6;
+			}
+		}
+
+		if (desc.format == FormatUnknown || desc.width == 0 || desc.height == 0 || desc.depth == 0)
+			return false;
+		uint32_t rowSize, rowCount;
+		if (!surfaceInfo(desc.format, 1, 1, rowSize, rowCount))
+			return false;
+		uint32_t maxDim = desc.width > desc.height ? desc.width : desc.height;
+		if (desc.depth > maxDim)
+			maxDim = desc.depth;
+		uint32_t fullChain = 1;
+		while (maxDim >>= 1)
+			++fullChain;
+		if (desc.mipLevels > fullChain)
+			return false;
+
+		// The payload must hold every subresource before any is allocated for.
+		// Every product is checked against the bytes left, so none can overflow.
+		uint32_t sliceCount = desc.dimension == DimensionTexture3D ? 1 : desc.arraySize;
+		uint64_t available = size - offset, sliceBytes = 0;
+		for (uint32_t mip = 0; mip < desc.mipLevels; ++mip)
+		{
+			uint32_t depth = desc.dimension == DimensionTexture3D ? mipSize(desc.depth, mip) : 1;
+			if (!surfaceInfo(desc.format, mipSize(desc.width, mip), mipSize(desc.height, mip), rowSize, rowCount))
+				return false;
+			uint64_t bytes = static_cast<uint64_t>(rowSize) * rowCount;
+			if (bytes > available || depth > available / bytes)
+				return false;
+			bytes *= depth;
+			if (bytes > available - sliceBytes)
+				return false;
+			sliceBytes += bytes;
+		}
+		if (sliceCount > available / sliceBytes)
+			return false;
+
+		// The file stores slices outermost and mips inside them, which is D3D12's subresource order.
+		// A volume stores all depth slices of a mip together.
+		subresources.reserve(static_cast<size_t>(sliceCount) * desc.mipLevels);
+		for (uint32_t slice = 0; slice < sliceCount; ++slice)
+		{
+			for (uint32_t mip = 0; mip < desc.mipLevels; ++mip)
+			{
+				Subresource s = {};
+				s.width = mipSize(desc.width, mip);
+				s.height = mipSize(desc.height, mip);
+				s.depth = desc.dimension == DimensionTexture3D ? mipSize(desc.depth, mip) : 1;
+				surfaceInfo(desc.format, s.width, s.height, s.rowSize, s.rowCount);
+				s.slicePitch = static_cast<size_t>(s.rowSize) * s.rowCount;
+				size_t bytesNeeded = s.slicePitch * s.depth;
+				if (offset + bytesNeeded > size)
+				{
+					subresources.clear();
+					return false;
+				}
+				s.data = bytes + offset;
+				offset += bytesNeeded;
+				subresources.push_back(s);
+			}
+		}
+		return true;
+	}
+
+	// Placed footprints for every subresource in an upload buffer starting at baseOffset,
+	// like GetCopyableFootprints. Returns the total size needed.
+	inline uint64_t computeFootprints(const TextureDesc& desc, std::vector<Footprint>& footprints, uint64_t baseOffset = 0)
+	{
+		footprints.clear();
+		uint64_t offset = baseOffset;
+		uint64_t end = baseOffset;
+		uint32_t sliceCount = desc.dimension == DimensionTexture3D ? 1 : desc.arraySize;
+		bool bc = isBlockCompressed(desc.format);
+		for (uint32_t slice = 0; slice < sliceCount; ++slice)
+		{
+			for (uint32_t mip = 0; mip < desc.mipLevels; ++mip)
+			{
+				Footprint f;
+				offset = (end + PlacementAlignment - 1) & ~static_cast<uint64_t>(PlacementAlignment - 1);
+				f.offset = offset;
+				f.format = desc.format;
+				f.width = mipSize(desc.width, mip);
+				f.height = mipSize(desc.height, mip);
+				f.depth = desc.dimension == DimensionTexture3D ? mipSize(desc.depth, mip) : 1;
+				uint32_t rowSize = 0, rowCount = 0;
+				surfaceInfo(desc.format, f.width, f.height, rowSize, rowCount);
+				if (bc)
+				{
+					// Copies of BC formats work on whole blocks
+					f.width = (f.width + 3) & ~3u;
+					f.height = (f.height + 3) & ~3u;
+				}
+				f.rowPitch = (rowSize + PitchAlignment - 1) & ~(PitchAlignment - 1);
+				f.rowCount = rowCount;
+				f.rowSize = rowSize;
+				footprints.push_back(f);
+				end = offset + static_cast<uint64_t>(f.rowPitch) * (static_cast<uint64_t>(rowCount) * f.depth - 1) + rowSize;
+			}
+		}
+		return end - baseOffset;
+	}
+
+	// Headers for saving desc as a DX10 DDS file: Magic, Header and HeaderDXT10 in that order,
+	// followed by the subresources tightly packed in parse() order.
+	inline void makeHeaders(const TextureDesc& desc, Header& header, HeaderDXT10& dx10)
+	{
+		header = Header();
+		header.size = sizeof(Header);
+		// CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+		header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;
+		header.width = desc.width;
+		header.height = desc.height;
+		header.mipMapCount = desc.mipLevels;
+		uint32_t rowSize = 0, rowCount = 0;
+		surfaceInfo(desc.format, desc.width, desc.height, rowSize, rowCount);
+		if (isBlockCompressed(desc.format))
+		{
+			header.flags |= 0x80000;    // LINEARSIZE
+			header.pitchOrLinearSize = rowSize * rowCount;
+		}
+		else
+		{
+			header.flags |= 0x8;        // PITCH
+			header.pitchOrLinearSize = rowSize;
+		}
+		header.pixelFormat.size = sizeof(PixelFormat);
+		header.pixelFormat.flags = PixelFlagFourCC;
+		header.pixelFormat.fourCC = fourCC('D', 'X', '1', '0');
+		header.caps = 0x1000;           // TEXTURE
+		if (desc.mipLevels > 1)
+			header.caps |= 0x8 | 0x400000; // COMPLEX | MIPMAP
+
+		dx10 = HeaderDXT10();
+		dx10.dxgiFormat = desc.format;
+		dx10.resourceDimension = desc.dimension;
+		dx10.arraySize = desc.arraySize;
+		if (desc.dimension == DimensionTexture3D)
+		{
+			header.flags |= FlagDepth;
+			header.depth = desc.depth;
+			header.caps2 = Caps2Volume;
+		}
+		else if (desc.cubemap)
+		{
+			header.caps |= 0x8;
+			header.caps2 = Caps2Cubemap | Caps2CubemapAllFaces;
+			dx10.miscFlag = MiscTextureCube;
+			dx10.arraySize = desc.arraySize / 6;
+		}
+	}
+
+	// Copies one subresource into its footprint; dest is the start of the (write-combined) upload buffer.
+	inline void copySubresource(uint8_t* dest, const Footprint& footprint, const Subresource& src)
+	{
+		UploadCopy::Layout d = { dest + footprint.offset, footprint.rowPitch, static_cast<size_t>(footprint.rowPitch) * footprint.rowCount };
+		UploadCopy::ConstLayout s = { src.data, src.rowSize, src.slicePitch };
+		UploadCopy::copyRows(d, s, src.rowSize, src.rowCount, src.depth);
+	}
+
+	// A mapped DDS file. Subresource data points into the mapping.
+	class File
+	{
+		MappedFile mFile;
+		TextureDesc mDesc;
+		std::vector<Subresource> mSubresources;
+
+	public:
+		template<class Char>
+		bool open(const Char* fileName)
+		{
+			mSubresources.clear();
+			if (!mFile.open(fileName))
+				return false;
+			return parse(mFile.data(), mFile.size(), mDesc, mSubresources);
+		}
+
+		const TextureDesc& desc() const { return mDesc; }
+		const std::vector<Subresource>& subresources() const { return mSubresources; }
+		const Subresource& subresource(size_t i) const { return mSubresources[i]; }
+	};
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+// Splitting a sorted draw list into command lists for parallel recording.
+// partition() cuts the list into contiguous batches, so the draw order is kept,
+// and balances their estimated recording cost: the largest batch is as small as
+// possible for the batch count. A draw costs a fixed amount plus an amount per
+// thousand indices, and a state change whenever its state key differs from the
+// draw before it. The first draw of every batch pays the state change, as a new
+// command list starts without state. Batches are not made cheaper than
+// minBatchCost, so small lists do not pay for more command lists than they need.
+// OrderedSubmitter takes the batches in whatever order their recording ends and
+// submits every batch as soon as it and all batches before it are recorded.
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace DrawBatching
+{
+	struct Draw
+	{
+		uint32_t indexCount;
+		uint32_t stateKey;                  // pipeline state, root signature, ... of the draw
+	};
+
+	struct CostModel
+	{
+		uint32_t perDraw = 100;
+		uint32_t perThousandIndices = 10;
+		uint32_t perStateChange = 400;
+		uint64_t minBatchCost = 4000;       // about the cost of one more command list
+	};
+
+	struct Batch
+	{
+		uint32_t first;
+		uint32_t count;
+		uint64_t cost;
+	};
+
+	namespace detail
+	{
+		inline uint64_t drawCost(const Draw& draw, const CostModel& model)
+		{
+			return model.perDraw + static_cast<uint64_t>(draw.indexCount) * model.perThousandIndices / 1000;
+		}
+
+		// Whether draw i pays a state change when it follows draw i - 1 in the same list
+		inline bool paysState(const Draw* draws, size_t i)
+		{
+			return i == 0 || draws[i].stateKey != draws[i - 1].stateKey;
+		}
+
+		// prefix[i] is the cost of draws [0, i) in one list. The cost of [first, end)
+		// is prefix[end] - prefix[first] plus the state change of the first draw
+		// when it does not pay one anyway.
+		inline uint64_t rangeCost(const Draw* draws, const std::vector<uint64_t>& prefix,
+			size_t first, size_t end, const CostModel& model)
+		{
+			return prefix[end] - prefix[first] + (paysState(draws, first) ? 0 : model.perStateChange);
+		}
+
+		// Longest batches of at most limit each. Returns false when one draw exceeds it
+		// or more than maxBatches are needed.
+		inline bool split(const Draw* draws, const std::vector<uint64_t>& prefix, const CostModel& model,
+			uint64_t limit, size_t maxBatches, std::vector<Batch>* batches)
+		{
+			size_t count = prefix.size() - 1;
+			size_t batchCount = 0;
+			for (size_t first = 0; first < count;)
+			{
+				if (rangeCost(draws, prefix, first, first + 1, model) > limit || ++batchCount > maxBatches)
+					return false;
+				// Last end whose prefix stays within the limit
+				uint64_t bound = limit + prefix[first] - (paysState(draws, first) ? 0 : model.perStateChange);
+				size_t end = std::upper_bound(prefix.begin() + first + 1, prefix.end(), bound) - prefix.begin() - 1;
+				if (batches)
+					batches->push_back({ static_cast<uint32_t>(first), static_cast<uint32_t>(end - first),
+						rangeCost(draws, prefix, first, end, model) });
+				first = end;
+			}
+			return true;
+		}
+	};
+
+	// Estimated cost of recording draws [first, first + count) into one command list
+	inline uint64_t batchCost(const Draw* draws, size_t first, size_t count, const CostModel& model)
+	{
+		uint64_t cost = 0;
+		for (size_t i = first; i < first + count; ++i)
+			cost += detail::drawCost(draws[i], model) + (i == first || detail::paysState(draws, i) ? model.perStateChange : 0);
+		return cost;
+	}
+
+	// Fills batches with at most maxBatches batches covering all draws in order
+	inline void partition(const Draw* draws, size_t count, size_t maxBatches, const CostModel& model, std::vector<Batch>& batches)
+	{
+		batches.clear();
+		if (count == 0)
+			return;
+		maxBatches = std::max<size_t>(maxBatches, 1);
+
+		std::vector<uint64_t> prefix(count + 1);
+		uint64_t largest = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t cost = detail::drawCost(draws[i], model);
+			prefix[i + 1] = prefix[i] + cost + (detail::paysState(draws, i) ? model.perStateChange : 0);
+			largest = (std::max)(largest, cost + model.perStateChange);
+		}
+		uint64_t total = prefix[count];
+		size_t batchCount = static_cast<size_t>(std::min<uint64_t>(maxBatches,
+			std::max<uint64_t>(1, total / std::max<uint64_t>(model.minBatchCost, 1))));
+
+		// Smallest limit that fits in batchCount batches; every batch adds at most
+		// one state change to the total, so the search starts below the answer
+		// and ends above it
+		uint64_t lo = (std::max)(largest, (total + batchCount - 1) / batchCount);
+		uint64_t hi = total + model.perStateChange;
+		while (lo < hi)
+		{
+			uint64_t mid = lo + (hi - lo) / 2;
+			if (detail::split(draws, prefix, model, mid, batchCount, nullptr))
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		detail::split(draws, prefix, model, lo, batchCount, &batches);
+	}
+
+	// Thread-safe. Calls submit(uint32_t firstBatch, uint32_t batchCount) for every run
+	// of batches that became ready, in batch order and never two at once.
+	class OrderedSubmitter
+	{
+		std::mutex mMutex;
+		std::vector<uint8_t> mReady;
+		uint32_t mNext = 0;                 // first batch not submitted
+
+	public:
+		OrderedSubmitter() = default;
+		OrderedSubmitter(const OrderedSubmitter&) = delete;
+		OrderedSubmitter& operator=(const OrderedSubmitter&) = delete;
+
+		void reset(uint32_t batchCount)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mReady.assign(batchCount, 0);
+			mNext = 0;
+		}
+
+		template<class Submit>
+		void complete(uint32_t batch, Submit submit)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mReady[batch] = 1;
+			uint32_t first = mNext;
+			while (mNext < mReady.size() && mReady[mNext])
+				mNext++;
+			if (mNext > first)
+				submit(first, mNext - first);
+		}
+
+		// True when every batch since reset() has been submitted
+		bool finished()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mNext == mReady.size();
+		}
+	};
+};
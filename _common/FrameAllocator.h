@@ -0,0 +1,108 @@
+#pragma once
+
+// Linear per-frame allocator over one persistently mapped upload buffer.
+// Allocations are bumped from a ring with an atomic fetch-add, so any thread
+// recording the frame can take constants without a lock. Every allocation is
+// 256-byte aligned (D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) and can be
+// bound directly as a CBV. The space of a frame is handed back once the fence
+// value passed to endFrame() has completed and reclaim() has seen it.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+class FrameAllocator
+{
+public:
+	static const uint64_t Alignment = 256;
+
+	struct Allocation
+	{
+		void* data;                 // nullptr when the ring is full
+		uint64_t offset;            // from the start of the buffer
+		uint64_t gpuAddress;
+	};
+
+private:
+	struct Frame
+	{
+		uint64_t fenceValue;
+		uint64_t end;
+	};
+
+	uint8_t* mData = nullptr;
+	uint64_t mGpuAddress = 0;
+	uint64_t mCapacity = 0;
+	// Positions only grow; the buffer offset is position % mCapacity
+	std::atomic<uint64_t> mHead{ 0 };
+	uint64_t mTail = 0;             // start of the oldest frame still in flight
+	std::deque<Frame> mFrames;
+
+public:
+	FrameAllocator() = default;
+	FrameAllocator(const FrameAllocator&) = delete;
+	FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+	// data stays mapped while the allocator is used; capacity is rounded down to Alignment
+	void init(void* data, uint64_t gpuAddress, uint64_t capacity)
+	{
+		mData = static_cast<uint8_t*>(data);
+		mGpuAddress = gpuAddress;
+		mCapacity = capacity & ~(Alignment - 1);
+		mHead = 0;
+		mTail = 0;
+		mFrames.clear();
+	}
+
+	// Thread-safe. Returns an empty allocation when the frames in flight leave no room.
+	// Threads racing for the last bytes may move the head past the end of the free space;
+	// that space comes back with the frame.
+	Allocation allocate(uint64_t size)
+	{
+		size = (size + Alignment - 1) & ~(Alignment - 1);
+		if (size == 0 || size > mCapacity)
+			return {};
+		for (;;)
+		{
+			if (mHead.load(std::memory_order_relaxed) + size > mTail + mCapacity)
+				return {};
+			uint64_t begin = mHead.fetch_add(size, std::memory_order_relaxed);
+			if (begin + size > mTail + mCapacity)
+				return {};
+			uint64_t offset = begin % mCapacity;
+			if (offset + size <= mCapacity)
+				return { mData + offset, offset, mGpuAddress + offset };
+			// Would wrap around the end of the buffer: skip the rest and retry from the start
+		}
+	}
+
+	// Closes the frame recorded so far. Not thread-safe with allocate().
+	void endFrame(uint64_t fenceValue)
+	{
+		mFrames.push_back({ fenceValue, mHead.load(std::memory_order_relaxed) });
+	}
+
+	// Frees the frames whose fence value is not greater than completedValue.
+	// Not thread-safe with allocate().
+	void reclaim(uint64_t completedValue)
+	{
+		while (!mFrames.empty() && mFrames.front().fenceValue <= completedValue)
+		{
+			mTail = mFrames.front().end;
+			mFrames.pop_front();
+		}
+	}
+
+	uint64_t capacity() const
+	{
+		return mCapacity;
+	}
+
+	// Bytes held by the frames in flight and the open frame
+	uint64_t used() const
+	{
+		uint64_t head = mHead.load(std::memory_order_relaxed);
+		return head - mTail < mCapacity ? head - mTail : mCapacity;
+	}
+};
@@ -0,0 +1,354 @@
+#pragma once
+
+// Pipelined frame pacing.
+// A frame goes through three stages, each on its own thread: simulate runs on a
+// pipeline thread, record on a second one, and submit on the thread calling
+// tick(), so the swap chain is presented from the window thread. Frame n can be
+// simulated while n - 1 is recorded and n - 2 is submitted.
+// The fence is signaled with the frame number. A fourth thread waits on it
+// (waitForFence blocks until the value completes) and wakes the recorder, so no
+// stage blocks on the GPU except through the frame latency: frame n is recorded
+// once frame n - latency has completed. The latency can change at any time
+// between 1 and MaxLatency.
+// Every stage gets the slot frame % MaxLatency for its per-frame resources. The
+// slot is free for simulate once the frame MaxLatency before has been recorded,
+// and for record once that frame has completed on the GPU, so simulate should
+// only write CPU-side state.
+// Per frame, the pipeline keeps the stage times, the time the recorder waited
+// for the GPU and an estimate of the GPU idle time: from the completion of the
+// previous frame, as seen by the fence thread, to the start of the submission.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class FramePipeline
+{
+public:
+	static const uint32_t MaxLatency = 4;
+	static const uint32_t HistorySize = 256;    // frames of metrics kept, of which the last half are complete
+
+	struct Stages
+	{
+		std::function<void(uint64_t frame, uint32_t slot)> simulate;
+		std::function<void(uint64_t frame, uint32_t slot)> record;
+		std::function<void(uint64_t frame, uint32_t slot)> submit;      // must signal the fence with frame
+		std::function<void(uint64_t fenceValue)> waitForFence;          // returns once the value has completed
+	};
+
+	// Microseconds
+	struct FrameMetrics
+	{
+		uint64_t frame;
+		double simulate;
+		double recordWait;          // recorder blocked on the GPU by the frame latency
+		double record;
+		double submitWait;          // submitter waiting for the recording
+		double submit;
+		double gpuIdle;             // estimated
+		double latency;             // simulation start to GPU completion
+	};
+
+	// Averages over completed frames, in microseconds
+	struct Summary
+	{
+		uint32_t frames;
+		double frameInterval;       // between GPU completions
+		double latency;
+		double recordWait;
+		double record;
+		double gpuIdle;
+		double gpuIdleFraction;     // of the frame interval
+	};
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Frame
+	{
+		FrameMetrics metrics;
+		Clock::time_point simulateStart;
+		Clock::time_point submitStart;
+		Clock::time_point completed;
+	};
+
+	Stages mStages;
+	std::mutex mMutex;
+	std::condition_variable mChanged;
+	std::thread mSimulateThread;
+	std::thread mRecordThread;
+	std::thread mFenceThread;
+	// Last frame through each stage
+	uint64_t mSimulated = 0;
+	uint64_t mRecorded = 0;
+	uint64_t mSubmitted = 0;
+	uint64_t mCompleted = 0;
+	uint32_t mLatency = 2;
+	bool mQuit = false;
+	bool mRunning = false;
+	std::exception_ptr mError;
+	Frame mHistory[HistorySize] = {};
+
+public:
+	FramePipeline() = default;
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+	~FramePipeline()
+	{
+		stop();
+	}
+
+	// Frames count from 1
+	void start(const Stages& stages, uint32_t latency)
+	{
+		stop();
+		mStages = stages;
+		mSimulated = mRecorded = mSubmitted = mCompleted = 0;
+		mLatency = clampLatency(latency);
+		mQuit = false;
+		mError = nullptr;
+		for (auto& frame : mHistory)
+			frame = {};
+		mRunning = true;
+		mSimulateThread = std::thread([this] { stage(&FramePipeline::simulateNext); });
+		mRecordThread = std::thread([this] { stage(&FramePipeline::recordNext); });
+		mFenceThread = std::thread([this] { stage(&FramePipeline::completeNext); });
+	}
+
+	// Waits for the GPU to finish every submitted frame; recorded frames not submitted are dropped
+	void stop()
+	{
+		if (!mRunning)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mChanged.notify_all();
+		mSimulateThread.join();
+		mRecordThread.join();
+		mFenceThread.join();
+		mRunning = false;
+	}
+
+	// Submits the next frame once it is recorded. Rethrows the first exception of any stage.
+	void tick()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		uint64_t frame = mSubmitted + 1;
+		auto waitStart = Clock::now();
+		mChanged.wait(lock, [&] { return mQuit || mRecorded >= frame; });
+		if (mQuit)
+		{
+			lock.unlock();
+			stop();
+			if (mError)
+				std::rethrow_exception(mError);
+			return;
+		}
+		auto& history = mHistory[frame % HistorySize];
+		history.submitStart = Clock::now();
+		history.metrics.submitWait = microseconds(waitStart, history.submitStart);
+		lock.unlock();
+
+		try
+		{
+			mStages.submit(frame, slot(frame));
+		}
+		catch (...)
+		{
+			fail();
+			stop();
+			throw;
+		}
+
+		lock.lock();
+		history.metrics.submit = microseconds(history.submitStart, Clock::now());
+		mSubmitted = frame;
+		lock.unlock();
+		mChanged.notify_all();
+	}
+
+	// Takes effect from the next frame to be recorded
+	void setLatency(uint32_t latency)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mLatency = clampLatency(latency);
+		}
+		mChanged.notify_all();
+	}
+
+	uint32_t latency()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mLatency;
+	}
+
+	// Last frame the GPU has completed
+	uint64_t completedFrame()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mCompleted;
+	}
+
+	// Metrics of a completed frame among the last HistorySize / 2; false when not available
+	bool metrics(uint64_t frame, FrameMetrics& metrics)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (frame == 0 || frame > mCompleted || frame + HistorySize / 2 <= mCompleted)
+			return false;
+		metrics = mHistory[frame % HistorySize].metrics;
+		return true;
+	}
+
+	// Over the last frameCount completed frames, at most HistorySize / 2 - 1
+	Summary summary(uint32_t frameCount)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		Summary summary = {};
+		uint64_t last = mCompleted;
+		uint64_t count = std::min<uint64_t>({ frameCount, HistorySize / 2 - 1, last > 0 ? last - 1 : 0 });
+		if (count == 0)
+			return summary;
+		summary.frames = static_cast<uint32_t>(count);
+		for (uint64_t frame = last - count + 1; frame <= last; ++frame)
+		{
+			auto& metrics = mHistory[frame % HistorySize].metrics;
+			summary.latency += metrics.latency;
+			summary.recordWait += metrics.recordWait;
+			summary.record += metrics.record;
+			summary.gpuIdle += metrics.gpuIdle;
+		}
+		double span = microseconds(mHistory[(last - count) % HistorySize].completed, mHistory[last % HistorySize].completed);
+		summary.gpuIdleFraction = span > 0 ? summary.gpuIdle / span : 0;
+		summary.frameInterval = span / count;
+		summary.latency /= count;
+		summary.recordWait /= count;
+		summary.record /= count;
+		summary.gpuIdle /= count;
+		return summary;
+	}
+
+private:
+	static uint32_t clampLatency(uint32_t latency)
+	{
+		return latency < 1 ? 1 : latency > MaxLatency ? MaxLatency : latency;
+	}
+
+	static uint32_t slot(uint64_t frame)
+	{
+		return static_cast<uint32_t>(frame % MaxLatency);
+	}
+
+	static double microseconds(Clock::time_point begin, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::micro>(end - begin).count();
+	}
+
+	void fail()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mError)
+				mError = std::current_exception();
+			mQuit = true;
+		}
+		mChanged.notify_all();
+	}
+
+	// Runs next until it returns false or throws
+	void stage(bool (FramePipeline::*next)())
+	{
+		try
+		{
+			while ((this->*next)())
+			{
+			}
+		}
+		catch (...)
+		{
+			fail();
+		}
+	}
+
+	bool simulateNext()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		uint64_t frame = mSimulated + 1;
+		// One frame ahead of the recorder
+		mChanged.wait(lock, [&] { return mQuit || frame <= mRecorded + 2; });
+		if (mQuit)
+			return false;
+		auto& history = mHistory[frame % HistorySize];
+		history = {};
+		history.metrics.frame = frame;
+		history.simulateStart = Clock::now();
+		lock.unlock();
+
+		mStages.simulate(frame, slot(frame));
+
+		lock.lock();
+		history.metrics.simulate = microseconds(history.simulateStart, Clock::now());
+		mSimulated = frame;
+		lock.unlock();
+		mChanged.notify_all();
+		return true;
+	}
+
+	bool recordNext()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		uint64_t frame = mRecorded + 1;
+		mChanged.wait(lock, [&] { return mQuit || frame <= mSimulated; });
+		auto waitStart = Clock::now();
+		mChanged.wait(lock, [&] { return mQuit || frame <= mCompleted + mLatency; });
+		if (mQuit)
+			return false;
+		auto& history = mHistory[frame % HistorySize];
+		auto recordStart = Clock::now();
+		history.metrics.recordWait = microseconds(waitStart, recordStart);
+		lock.unlock();
+
+		mStages.record(frame, slot(frame));
+
+		lock.lock();
+		history.metrics.record = microseconds(recordStart, Clock::now());
+		mRecorded = frame;
+		lock.unlock();
+		mChanged.notify_all();
+		return true;
+	}
+
+	bool completeNext()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		uint64_t frame = mCompleted + 1;
+		// Submitted frames are waited for even when quitting
+		mChanged.wait(lock, [&] { return mQuit || frame <= mSubmitted; });
+		if (frame > mSubmitted)
+			return false;
+		lock.unlock();
+
+		mStages.waitForFence(frame);
+
+		lock.lock();
+		auto& history = mHistory[frame % HistorySize];
+		history.completed = Clock::now();
+		history.metrics.latency = microseconds(history.simulateStart, history.completed);
+		if (frame > 1)
+		{
+			auto previous = mHistory[(frame - 1) % HistorySize].completed;
+			history.metrics.gpuIdle = (std::max)(0.0, microseconds(previous, history.submitStart));
+		}
+		mCompleted = frame;
+		lock.unlock();
+		mChanged.notify_all();
+		return true;
+	}
+};
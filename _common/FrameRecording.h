@@ -0,0 +1,106 @@
+#pragma once
+
+// What the Multithread frame loop records, shared with Headless.
+// A frame is a prologue list that takes the back buffer to the render target
+// state and clears the targets, batches of draws recorded in parallel into a
+// command list each, and an epilogue list that returns the back buffer to the
+// present state. recordBatches() records the batches on the job system and
+// submits every batch once it and the batches before it are recorded.
+// The record functions take any list with the CommandCapture::Writer's
+// signatures: a D3D12Target, a NullDevice::CommandList or a Writer, so both
+// loops record the same commands. Lists, descriptors and constants stay with
+// the caller; objects are passed as the device's pointers.
+
+#include <cstdint>
+#include <vector>
+#include "DrawBatching.h"
+#include "JobSystem.h"
+
+namespace FrameRecording
+{
+	// Values of the D3D12 enums the commands carry
+	const uint32_t StatePresent = 0;            // D3D12_RESOURCE_STATE_PRESENT
+	const uint32_t StateRenderTarget = 0x4;     // D3D12_RESOURCE_STATE_RENDER_TARGET
+	const uint32_t ClearFlagDepth = 1;          // D3D12_CLEAR_FLAG_DEPTH
+	const uint32_t TopologyTriangleList = 4;    // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+
+	// State every batch of a frame sets
+	struct Pass
+	{
+		const void* rootSignature;
+		const void* pipelineState;
+		const void* descriptorHeap;             // shader visible, a CBV per draw
+		uint64_t table;                         // GPU handle of draw 0's CBV
+		uint32_t tableStep;                     // handle increment between draws
+		uint64_t rtv;
+		uint64_t dsv;
+		uint32_t width;
+		uint32_t height;
+		uint64_t vertexBuffer;
+		uint32_t vertexBufferSize;
+		uint32_t vertexStride;
+		uint64_t indexBuffer;
+		uint32_t indexBufferSize;
+		uint32_t indexFormat;                   // DXGI_FORMAT
+	};
+
+	struct Draw
+	{
+		uint32_t indexCount;
+		uint32_t startIndex;
+	};
+
+	template<class List>
+	void recordPrologue(List& list, const void* backBuffer, uint64_t rtv, uint64_t dsv, const float clearColor[4])
+	{
+		// Barrier Present -> RenderTarget
+		list.ResourceBarrier(backBuffer, StatePresent, StateRenderTarget);
+		list.ClearDepthStencilView(dsv, ClearFlagDepth, 1.0f, 0);
+		list.ClearRenderTargetView(rtv, clearColor);
+	}
+
+	// Records draws [batch.first, batch.first + batch.count) with their CBVs
+	template<class List>
+	void recordBatch(List& list, const Pass& pass, const Draw* draws, const DrawBatching::Batch& batch)
+	{
+		list.OMSetRenderTarget(pass.rtv, pass.dsv);
+
+		// Viewport & Scissor
+		list.RSSetViewport(0.0f, 0.0f, (float)pass.width, (float)pass.height, 0.0f, 1.0f);
+		list.RSSetScissorRect(0, 0, (int32_t)pass.width, (int32_t)pass.height);
+
+		list.SetGraphicsRootSignature(pass.rootSignature);
+		const void* descHeaps[] = { pass.descriptorHeap };
+		list.SetDescriptorHeaps(1, descHeaps);
+		list.SetPipelineState(pass.pipelineState);
+		list.IASetPrimitiveTopology(TopologyTriangleList);
+		list.IASetVertexBuffer(0, pass.vertexBuffer, pass.vertexBufferSize, pass.vertexStride);
+		list.IASetIndexBuffer(pass.indexBuffer, pass.indexBufferSize, pass.indexFormat);
+		for (uint32_t i = batch.first; i < batch.first + batch.count; i++)
+		{
+			list.SetGraphicsRootDescriptorTable(0, pass.table + (uint64_t)i * pass.tableStep);
+			list.DrawIndexedInstanced(draws[i].indexCount, 1, draws[i].startIndex, 0, 0);
+		}
+	}
+
+	template<class List>
+	void recordEpilogue(List& list, const void* backBuffer)
+	{
+		// Barrier RenderTarget -> Present
+		list.ResourceBarrier(backBuffer, StateRenderTarget, StatePresent);
+	}
+
+	// Calls record(batch) for every batch on the job system, and submit(first, count)
+	// for the recorded batches in order, one call at a time
+	template<class Record, class Submit>
+	void recordBatches(JobSystem& jobs, const std::vector<DrawBatching::Batch>& batches, DrawBatching::OrderedSubmitter& submitter,
+		Record record, Submit submit)
+	{
+		submitter.reset((uint32_t)batches.size());
+		jobs.parallelFor(0u, (uint32_t)batches.size(), 1, [&](uint32_t batch)
+		{
+			record(batch);
+			submitter.complete(batch, submit);
+		});
+	}
+};
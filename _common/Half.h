@@ -0,0 +1,78 @@
+#pragma once
+
+// IEEE 754 binary16 conversion (round to nearest even), for vertex and texture data.
+
+#include <cstdint>
+#include <cstring>
+
+namespace Half
+{
+	inline uint16_t floatToHalf(float f)
+	{
+		uint32_t x;
+		memcpy(&x, &f, sizeof(x));
+		uint32_t sign = (x >> 16) & 0x8000;
+		uint32_t absx = x & 0x7FFFFFFF;
+
+		if (absx >= 0x7F800000)
+			return static_cast<uint16_t>(sign | (absx > 0x7F800000 ? 0x7E00 : 0x7C00)); // NaN / Inf
+		if (absx >= 0x477FF000)
+			return static_cast<uint16_t>(sign | 0x7C00); // Overflow after rounding
+		if (absx < 0x38800000)
+		{
+			// Denormal: shift the implicit-1 mantissa into place with round-to-nearest-even
+			if (absx < 0x33000000)
+				return static_cast<uint16_t>(sign);
+			uint32_t shift = 113 - (absx >> 23);
+			uint32_t mant = (absx & 0x7FFFFF) | 0x800000;
+			uint32_t h = mant >> (shift + 13);
+			uint32_t rem = mant & ((1u << (shift + 13)) - 1);
+			uint32_t half = 1u << (shift + 12);
+			if (rem > half || (rem == half && (h & 1)))
+				++h;
+			return static_cast<uint16_t>(sign | h);
+		}
+		uint32_t h = ((absx - 0x38000000) >> 13);
+		uint32_t rem = absx & 0x1FFF;
+		if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+			++h;
+		return static_cast<uint16_t>(sign | h);
+	}
+
+	inline float halfToFloat(uint16_t h)
+	{
+		uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+		uint32_t exp = (h >> 10) & 0x1F;
+		uint32_t mant = h & 0x3FF;
+		uint32_t x;
+		if (exp == 0x1F)
+		{
+			x = sign | 0x7F800000 | (mant << 13);
+		}
+		else if (exp == 0)
+		{
+			if (mant == 0)
+			{
+				x = sign;
+			}
+			else
+			{
+				// Normalize the denormal
+				exp = 113;
+				while (!(mant & 0x400))
+				{
+					mant <<= 1;
+					--exp;
+				}
+				x = sign | (exp << 23) | ((mant & 0x3FF) << 13);
+			}
+		}
+		else
+		{
+			x = sign | ((exp + 112) << 23) | (mant << 13);
+		}
+		float f;
+		memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+// Batched per-instance constants from SoA transforms.
+// Instances keep translation, rotation (unit quaternion) and scale in separate
+// arrays, so a batch of instances loads straight into SIMD registers. For each
+// instance the world matrix S * R * T and world * viewProj are built with the
+// view-projection loaded once for the whole call, transposed for HLSL and
+// streamed to the upload heap: AVX2 handles 8 instances per step when the CPU
+// has it, SSE2 4, and every instance's 128 bytes are written as two full cache
+// lines with non-temporal stores. Other architectures, unaligned destinations
+// and the last few instances take the scalar path.
+// The AVX2 path lives in InstanceTransformAvx2.cpp, the one file built with
+// /arch:AVX2 (-mavx2), so every project using this header compiles it too and
+// otherwise stays at the baseline instruction set.
+// Row-vector convention, the same as DirectXMath.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define INSTANCE_TRANSFORM_SSE2 1
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#define INSTANCE_TRANSFORM_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace InstanceTransform
+{
+	// Bytes written per instance: transpose(world * viewProj), then transpose(world)
+	static const size_t ConstantSize = 128;
+
+	struct Instances
+	{
+		std::vector<float> x, y, z;             // translation
+		std::vector<float> qx, qy, qz, qw;      // rotation, unit quaternion
+		std::vector<float> sx, sy, sz;          // scale
+
+		// New instances get the identity transform
+		void resize(size_t count)
+		{
+			x.resize(count, 0.0f);
+			y.resize(count, 0.0f);
+			z.resize(count, 0.0f);
+			qx.resize(count, 0.0f);
+			qy.resize(count, 0.0f);
+			qz.resize(count, 0.0f);
+			qw.resize(count, 1.0f);
+			sx.resize(count, 1.0f);
+			sy.resize(count, 1.0f);
+			sz.resize(count, 1.0f);
+		}
+
+		size_t size() const
+		{
+			return x.size();
+		}
+	};
+
+	namespace detail
+	{
+		// The arrays of Instances as plain pointers. InstanceTransformAvx2.cpp
+		// must not use inline code other files also emit (std::vector's), or the
+		// linker could keep its AVX2 copy for all of them.
+		struct Arrays
+		{
+			const float *x, *y, *z;
+			const float *qx, *qy, *qz, *qw;
+			const float *sx, *sy, *sz;
+		};
+
+		// World rows 0..2 (the fourth column is 0, 0, 0, 1) and MVP of lane values
+		template<class V, class Ops>
+		void worldAndMvp(const Arrays& in, size_t i, const float viewProj[16], V world[3][3], V t[3], V mvp[4][4])
+		{
+			V x = Ops::load(&in.qx[i]), y = Ops::load(&in.qy[i]), z = Ops::load(&in.qz[i]), w = Ops::load(&in.qw[i]);
+			V one = Ops::set1(1.0f);
+			V x2 = Ops::add(x, x), y2 = Ops::add(y, y), z2 = Ops::add(z, z);
+			V xx = Ops::mul(x, x2), yy = Ops::mul(y, y2), zz = Ops::mul(z, z2);
+			V xy = Ops::mul(x, y2), xz = Ops::mul(x, z2), yz = Ops::mul(y, z2);
+			V wx = Ops::mul(w, x2), wy = Ops::mul(w, y2), wz = Ops::mul(w, z2);
+			V sx = Ops::load(&in.sx[i]), sy = Ops::load(&in.sy[i]), sz = Ops::load(&in.sz[i]);
+			world[0][0] = Ops::mul(sx, Ops::sub(one, Ops::add(yy, zz)));
+			world[0][1] = Ops::mul(sx, Ops::add(xy, wz));
+			world[0][2] = Ops::mul(sx, Ops::sub(xz, wy));
+			world[1][0] = Ops::mul(sy, Ops::sub(xy, wz));
+			world[1][1] = Ops::mul(sy, Ops::sub(one, Ops::add(xx, zz)));
+			world[1][2] = Ops::mul(sy, Ops::add(yz, wx));
+			world[2][0] = Ops::mul(sz, Ops::add(xz, wy));
+			world[2][1] = Ops::mul(sz, Ops::sub(yz, wx));
+			world[2][2] = Ops::mul(sz, Ops::sub(one, Ops::add(xx, yy)));
+			t[0] = Ops::load(&in.x[i]);
+			t[1] = Ops::load(&in.y[i]);
+			t[2] = Ops::load(&in.z[i]);
+
+			for (int c = 0; c < 4; ++c)
+			{
+				V vp0 = Ops::set1(viewProj[c]), vp1 = Ops::set1(viewProj[4 + c]), vp2 = Ops::set1(viewProj[8 + c]);
+				for (int r = 0; r < 3; ++r)
+					mvp[r][c] = Ops::add(Ops::add(Ops::mul(world[r][0], vp0), Ops::mul(world[r][1], vp1)), Ops::mul(world[r][2], vp2));
+				mvp[3][c] = Ops::add(Ops::add(Ops::add(Ops::mul(t[0], vp0), Ops::mul(t[1], vp1)), Ops::mul(t[2], vp2)), Ops::set1(viewProj[12 + c]));
+			}
+		}
+
+		struct Scalar
+		{
+			static float load(const float* p) { return *p; }
+			static float set1(float v) { return v; }
+			static float add(float a, float b) { return a + b; }
+			static float sub(float a, float b) { return a - b; }
+			static float mul(float a, float b) { return a * b; }
+		};
+
+		inline void transformScalar(const Arrays& in, size_t i, const float viewProj[16], uint8_t* dst, float* worldViewProj)
+		{
+			float world[3][3], t[3], mvp[4][4];
+			worldAndMvp<float, Scalar>(in, i, viewProj, world, t, mvp);
+			float out[32];
+			for (int c = 0; c < 4; ++c)
+				for (int r = 0; r < 4; ++r)
+				{
+					out[c * 4 + r] = mvp[r][c];
+					out[16 + c * 4 + r] = r < 3 ? (c < 3 ? world[r][c] : 0.0f) : (c < 3 ? t[c] : 1.0f);
+				}
+			memcpy(dst, out, sizeof(out));
+			if (worldViewProj)
+				memcpy(worldViewProj, mvp, sizeof(mvp));
+		}
+
+#if INSTANCE_TRANSFORM_SSE2
+		struct Sse
+		{
+			typedef __m128 V;
+			static const size_t Width = 4;
+			static V load(const float* p) { return _mm_loadu_ps(p); }
+			static V set1(float v) { return _mm_set1_ps(v); }
+			static V add(V a, V b) { return _mm_add_ps(a, b); }
+			static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+			static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+			static void stream(float* p, V v) { _mm_stream_ps(p, v); }
+			static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+
+			// v[k] holds float k of every lane; afterwards v[l] holds floats 0..3 of lane l
+			static void transpose(V v[4])
+			{
+				_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+			}
+		};
+#endif
+
+#if INSTANCE_TRANSFORM_AVX2
+		struct Avx
+		{
+			typedef __m256 V;
+			static const size_t Width = 8;
+			static V load(const float* p) { return _mm256_loadu_ps(p); }
+			static V set1(float v) { return _mm256_set1_ps(v); }
+			static V add(V a, V b) { return _mm256_add_ps(a, b); }
+			static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+			static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+			static void stream(float* p, V v) { _mm256_stream_ps(p, v); }
+			static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+
+			// v[k] holds float k of every lane; afterwards v[l] holds floats 0..7 of lane l
+			static void transpose(V v[8])
+			{
+				V t0 = _mm256_unpacklo_ps(v[0], v[1]), t1 = _mm256_unpackhi_ps(v[0], v[1]);
+				V t2 = _mm256_unpacklo_ps(v[2], v[3]), t3 = _mm256_unpackhi_ps(v[2], v[3]);
+				V t4 = _mm256_unpacklo_ps(v[4], v[5]), t5 = _mm256_unpackhi_ps(v[4], v[5]);
+				V t6 = _mm256_unpacklo_ps(v[6], v[7]), t7 = _mm256_unpackhi_ps(v[6], v[7]);
+				V u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+				V u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+				V u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+				V u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+				v[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+				v[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+				v[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+				v[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+				v[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+				v[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+				v[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+				v[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+			}
+		};
+#endif
+
+#if INSTANCE_TRANSFORM_SSE2
+		// Simd::Width instances starting at i; dst is aligned to the vector size
+		template<class Simd>
+		void transformBatch(const Arrays& in, size_t i, const float viewProj[16], uint8_t* dst, size_t dstStride, float* worldViewProj)
+		{
+			typedef typename Simd::V V;
+			const size_t W = Simd::Width;
+			V world[3][3], t[3], mvp[4][4];
+			worldAndMvp<V, Simd>(in, i, viewProj, world, t, mvp);
+
+			// The 32 output floats of every lane, in memory order
+			V out[32];
+			V zero = Simd::set1(0.0f), one = Simd::set1(1.0f);
+			for (int c = 0; c < 4; ++c)
+				for (int r = 0; r < 4; ++r)
+				{
+					out[c * 4 + r] = mvp[r][c];
+					out[16 + c * 4 + r] = r < 3 ? (c < 3 ? world[r][c] : zero) : (c < 3 ? t[c] : one);
+				}
+			for (size_t k = 0; k < 32; k += W)
+				Simd::transpose(out + k);
+			// One instance at a time, so each cache line is completed before the next is started
+			for (size_t l = 0; l < W; ++l)
+			{
+				auto* d = reinterpret_cast<float*>(dst + l * dstStride);
+				for (size_t k = 0; k < 32; k += W)
+					Simd::stream(d + k, out[k + l]);
+			}
+
+			if (worldViewProj)
+			{
+				for (int r = 0; r < 4; ++r)
+					for (int c = 0; c < 4; ++c)
+						out[r * 4 + c] = mvp[r][c];
+				for (size_t k = 0; k < 16; k += W)
+				{
+					Simd::transpose(out + k);
+					for (size_t l = 0; l < W; ++l)
+						Simd::store(worldViewProj + l * 16 + k, out[k + l]);
+				}
+			}
+		}
+
+		// In InstanceTransformAvx2.cpp: batches of 8 instances from the start of
+		// the range while they fit, returns how many were written
+		size_t computeConstantsAvx2(const Arrays& in, size_t first, size_t count, const float viewProj[16],
+			uint8_t* dst, size_t dstStride, float* worldViewProj);
+
+		// AVX2, and the OS saving the YMM registers
+		inline bool detectAvx2()
+		{
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+			__cpuid(info, 1);
+			// OSXSAVE and AVX, then XMM and YMM state enabled in XCR0
+			if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 6) != 6)
+				return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & 0x20) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") != 0;
+#endif
+		}
+
+		inline bool hasAvx2()
+		{
+			static const bool avx2 = detectAvx2();
+			return avx2;
+		}
+#endif
+	};
+
+	// Writes the constants of instances first .. first + count - 1 to dst, one every
+	// dstStride bytes (dst is the first instance's). When worldViewProj is given, the
+	// untransposed world * viewProj of each instance is also stored there, 16 floats
+	// per instance, in cached memory for CPU-side culling.
+	// viewProj is row-major. Disjoint ranges can be computed on different threads.
+	// Issues a store fence before returning.
+	inline void computeConstants(const Instances& instances, size_t first, size_t count, const float viewProj[16],
+		void* dst, size_t dstStride, float* worldViewProj = nullptr)
+	{
+		const detail::Arrays in = {
+			instances.x.data(), instances.y.data(), instances.z.data(),
+			instances.qx.data(), instances.qy.data(), instances.qz.data(), instances.qw.data(),
+			instances.sx.data(), instances.sy.data(), instances.sz.data(),
+		};
+		auto* d = static_cast<uint8_t*>(dst);
+		size_t i = 0;
+#if INSTANCE_TRANSFORM_SSE2
+		auto aligned = [&](size_t alignment)
+		{
+			return !(reinterpret_cast<uintptr_t>(d) & (alignment - 1)) && !(dstStride & (alignment - 1));
+		};
+		if (aligned(32) && detail::hasAvx2())
+			i = detail::computeConstantsAvx2(in, first, count, viewProj, d, dstStride, worldViewProj);
+		if (aligned(16))
+		{
+			for (; i + detail::Sse::Width <= count; i += detail::Sse::Width)
+				detail::transformBatch<detail::Sse>(in, first + i, viewProj, d + i * dstStride, dstStride,
+					worldViewProj ? worldViewProj + i * 16 : nullptr);
+		}
+#endif
+		for (; i < count; ++i)
+			detail::transformScalar(in, first + i, viewProj, d + i * dstStride,
+				worldViewProj ? worldViewProj + i * 16 : nullptr);
+#if INSTANCE_TRANSFORM_SSE2
+		_mm_sfence();
+#endif
+	}
+
+	// point transformed by the inverse world matrix of instance i (e.g. the camera in object space)
+	inline void toObjectSpace(const Instances& in, size_t i, const float point[3], float out[3])
+	{
+		float p[3] = { point[0] - in.x[i], point[1] - in.y[i], point[2] - in.z[i] };
+		// Rotate by the conjugate quaternion: p + 2w(u x p) + 2u x (u x p) with u = -q.xyz
+		float ux = -in.qx[i], uy = -in.qy[i], uz = -in.qz[i], w = in.qw[i];
+		float cx = uy * p[2] - uz * p[1], cy = uz * p[0] - ux * p[2], cz = ux * p[1] - uy * p[0];
+		float ccx = uy * cz - uz * cy, ccy = uz * cx - ux * cz, ccz = ux * cy - uy * cx;
+		out[0] = (p[0] + 2 * (w * cx + ccx)) / in.sx[i];
+		out[1] = (p[1] + 2 * (w * cy + ccy)) / in.sy[i];
+		out[2] = (p[2] + 2 * (w * cz + ccz)) / in.sz[i];
+	}
+};
@@ -0,0 +1,29 @@
+// The AVX2 path of InstanceTransform::computeConstants(), which calls it only
+// when the CPU has AVX2. This is the one file built with /arch:AVX2 (-mavx2);
+// add it to every project that includes InstanceTransform.h.
+
+#include "InstanceTransform.h"
+
+#if INSTANCE_TRANSFORM_SSE2
+
+#if !INSTANCE_TRANSFORM_AVX2
+#error InstanceTransformAvx2.cpp must be compiled with /arch:AVX2 or -mavx2
+#endif
+
+namespace InstanceTransform
+{
+	namespace detail
+	{
+		size_t computeConstantsAvx2(const Arrays& in, size_t first, size_t count, const float viewProj[16],
+			uint8_t* dst, size_t dstStride, float* worldViewProj)
+		{
+			size_t i = 0;
+			for (; i + Avx::Width <= count; i += Avx::Width)
+				transformBatch<Avx>(in, first + i, viewProj, dst + i * dstStride, dstStride,
+					worldViewProj ? worldViewProj + i * 16 : nullptr);
+			return i;
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,538 @@
+#pragma once
+
+// Work-stealing job system.
+// Every worker owns a Chase-Lev deque: it pushes and pops its own jobs at the
+// bottom without locks while idle workers steal from the top. Threads that are
+// not workers hand jobs in through a shared queue. Completion is tracked with
+// Counters: run() adds one to a counter and the job takes it away when done.
+// A job given to runAfter() is a continuation, scheduled when its dependency
+// counter reaches zero, so nothing blocks on a dependency. wait() runs other
+// jobs until the counter reaches zero and rethrows the first exception thrown
+// by the jobs it counted.
+// The thread calling init() is worker 0; it only runs jobs inside wait().
+// With stats enabled, every job records the time from run() to its start and
+// its run time into log2 histograms.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem
+{
+public:
+	// Counts of durations in [2^i, 2^(i+1)) nanoseconds
+	struct Histogram
+	{
+		static const int BucketCount = 40;
+		uint64_t buckets[BucketCount];
+		uint64_t count;
+		uint64_t totalNs;
+
+		void add(uint64_t ns)
+		{
+			int bucket = 0;
+			while (bucket + 1 < BucketCount && (ns >> (bucket + 1)))
+				bucket++;
+			buckets[bucket]++;
+			count++;
+			totalNs += ns;
+		}
+
+		void merge(const Histogram& other)
+		{
+			for (int i = 0; i < BucketCount; ++i)
+				buckets[i] += other.buckets[i];
+			count += other.count;
+			totalNs += other.totalNs;
+		}
+
+		// Upper bound of the bucket holding the given fraction of the samples
+		uint64_t percentile(double fraction) const
+		{
+			uint64_t target = static_cast<uint64_t>(fraction * count);
+			uint64_t seen = 0;
+			for (int i = 0; i < BucketCount; ++i)
+			{
+				seen += buckets[i];
+				if (seen > target)
+					return 2ull << i;
+			}
+			return 0;
+		}
+	};
+
+	struct Stats
+	{
+		Histogram queueLatency;     // run() to start
+		Histogram runTime;
+		uint64_t steals;
+	};
+
+private:
+	struct Job;
+
+public:
+	class Counter
+	{
+		friend class JobSystem;
+
+		static const uint64_t CountMask = 0xFFFFFFFF;
+		static const uint64_t Settling = 1ull << 32;    // the last job is scheduling continuations
+
+		std::atomic<uint64_t> mState{ 0 };
+		std::mutex mMutex;
+		std::vector<Job*> mContinuations;
+		std::exception_ptr mError;
+
+	public:
+		Counter() = default;
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool done() const
+		{
+			return mState.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+private:
+	struct Job
+	{
+		std::function<void()> function;
+		Counter* counter;
+		std::chrono::steady_clock::time_point queued;
+	};
+
+	// Chase-Lev deque (Le, Pop, Cohen, Zappa Nardelli, "Correct and efficient
+	// work-stealing for weak memory models", 2013)
+	class Deque
+	{
+		struct Array
+		{
+			int64_t capacity;
+			std::unique_ptr<std::atomic<Job*>[]> slots;
+
+			explicit Array(int64_t size) : capacity(size), slots(new std::atomic<Job*>[static_cast<size_t>(size)]) {}
+			// Acquire/release slots publish the job itself, not only the index
+			Job* get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_acquire); }
+			void put(int64_t i, Job* job) { slots[i & (capacity - 1)].store(job, std::memory_order_release); }
+		};
+
+		std::atomic<int64_t> mTop{ 0 };
+		std::atomic<int64_t> mBottom{ 0 };
+		std::atomic<Array*> mArray;
+		std::vector<std::unique_ptr<Array>> mArrays;   // outgrown arrays stay readable for thieves
+
+	public:
+		Deque()
+		{
+			mArrays.emplace_back(new Array(256));
+			mArray.store(mArrays.back().get(), std::memory_order_relaxed);
+		}
+
+		// Owner only
+		void push(Job* job)
+		{
+			int64_t b = mBottom.load(std::memory_order_relaxed);
+			int64_t t = mTop.load(std::memory_order_acquire);
+			Array* a = mArray.load(std::memory_order_relaxed);
+			if (b - t > a->capacity - 1)
+			{
+				mArrays.emplace_back(new Array(a->capacity * 2));
+				Array* grown = mArrays.back().get();
+				for (int64_t i = t; i < b; ++i)
+					grown->put(i, a->get(i));
+				mArray.store(grown, std::memory_order_release);
+				a = grown;
+			}
+			a->put(b, job);
+			std::atomic_thread_fence(std::memory_order_release);
+			mBottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		// Owner only; newest first
+		Job* pop()
+		{
+			int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+			Array* a = mArray.load(std::memory_order_relaxed);
+			mBottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = mTop.load(std::memory_order_relaxed);
+			if (t > b)
+			{
+				mBottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			Job* job = a->get(b);
+			if (t == b)
+			{
+				// Last job: race the thieves for it
+				if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					job = nullptr;
+				mBottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		// Any thread; oldest first
+		Job* steal()
+		{
+			int64_t t = mTop.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = mBottom.load(std::memory_order_acquire);
+			if (t >= b)
+				return nullptr;
+			Array* a = mArray.load(std::memory_order_acquire);
+			Job* job = a->get(t);
+			if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return job;
+		}
+	};
+
+	struct Worker
+	{
+		Deque deque;
+		Stats stats;
+		uint32_t random;
+	};
+
+	std::vector<std::unique_ptr<Worker>> mWorkers;
+	std::vector<std::thread> mThreads;
+	std::mutex mInjectMutex;
+	std::vector<Job*> mInjected;                // from threads that are not workers
+	std::atomic<int> mInjectedCount{ 0 };
+	std::atomic<int64_t> mQueued{ 0 };          // jobs pushed and not yet taken
+	std::atomic<int> mSleeping{ 0 };
+	std::mutex mSleepMutex;
+	std::condition_variable mWake;
+	std::atomic<bool> mQuit{ false };
+	bool mStatsEnabled = false;
+
+	static int& workerIndex(const JobSystem* system)
+	{
+		// Index of the calling thread in the system it last worked for
+		thread_local const JobSystem* tSystem = nullptr;
+		thread_local int tIndex = -1;
+		if (tSystem != system)
+		{
+			tSystem = system;
+			tIndex = -1;
+		}
+		return tIndex;
+	}
+
+public:
+	JobSystem() = default;
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem()
+	{
+		shutdown();
+	}
+
+	// threadCount includes the calling thread; 0 uses every hardware thread
+	void init(unsigned threadCount = 0, bool enableStats = false)
+	{
+		shutdown();
+		if (threadCount == 0)
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+		mStatsEnabled = enableStats;
+		mQuit = false;
+		for (unsigned i = 0; i < threadCount; ++i)
+		{
+			mWorkers.emplace_back(new Worker());
+			mWorkers.back()->stats = {};
+			mWorkers.back()->random = 0x9E3779B9u * (i + 1);
+		}
+		workerIndex(this) = 0;
+		for (unsigned i = 1; i < threadCount; ++i)
+			mThreads.emplace_back([this, i] { workerMain(i); });
+	}
+
+	// Waits for the workers to exit; jobs still queued are discarded
+	void shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+			mQuit = true;
+		}
+		mWake.notify_all();
+		for (auto& thread : mThreads)
+			thread.join();
+		mThreads.clear();
+		for (auto& worker : mWorkers)
+		{
+			while (Job* job = worker->deque.pop())
+				delete job;
+		}
+		for (Job* job : mInjected)
+			delete job;
+		mInjected.clear();
+		mInjectedCount = 0;
+		mWorkers.clear();
+		mQueued = 0;
+	}
+
+	unsigned threadCount() const
+	{
+		return static_cast<unsigned>(mWorkers.size());
+	}
+
+	// Schedules job; counter, if any, stays above zero until it has run.
+	// An exception escaping a job without a counter terminates the program, like std::thread.
+	void run(std::function<void()> job, Counter* counter = nullptr)
+	{
+		if (counter)
+			counter->mState.fetch_add(1, std::memory_order_relaxed);
+		schedule(new Job{ std::move(job), counter, {} });
+	}
+
+	// Schedules job once dependency reaches zero (at once if it already has)
+	void runAfter(Counter& dependency, std::function<void()> job, Counter* counter = nullptr)
+	{
+		if (counter)
+			counter->mState.fetch_add(1, std::memory_order_relaxed);
+		Job* continuation = new Job{ std::move(job), counter, {} };
+		{
+			std::lock_guard<std::mutex> lock(dependency.mMutex);
+			if (dependency.mState.load(std::memory_order_acquire) & Counter::CountMask)
+			{
+				dependency.mContinuations.push_back(continuation);
+				return;
+			}
+		}
+		schedule(continuation);
+	}
+
+	// Runs jobs until counter reaches zero, then rethrows the first exception of its jobs
+	void wait(Counter& counter)
+	{
+		int index = workerIndex(this);
+		unsigned idle = 0;
+		while (!counter.done())
+		{
+			if (runOne(index))
+				idle = 0;
+			else if (++idle > 64)
+				std::this_thread::yield();
+		}
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(counter.mMutex);
+			std::swap(error, counter.mError);
+		}
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	// Calls f(i) for i in [begin, end), grain indices per job, and waits
+	template<class F>
+	void parallelFor(uint32_t begin, uint32_t end, uint32_t grain, F f)
+	{
+		Counter counter;
+		grain = (std::max)(grain, 1u);
+		for (uint32_t first = begin; first < end; first += grain)
+		{
+			uint32_t last = (std::min)(end, first + grain);
+			run([&f, first, last]
+			{
+				for (uint32_t i = first; i < last; ++i)
+					f(i);
+			}, &counter);
+		}
+		wait(counter);
+	}
+
+	// Sum over the workers; call while no jobs run
+	Stats stats() const
+	{
+		Stats total = {};
+		for (auto& worker : mWorkers)
+		{
+			total.queueLatency.merge(worker->stats.queueLatency);
+			total.runTime.merge(worker->stats.runTime);
+			total.steals += worker->stats.steals;
+		}
+		return total;
+	}
+
+	void resetStats()
+	{
+		for (auto& worker : mWorkers)
+			worker->stats = {};
+	}
+
+private:
+	void workerMain(int index)
+	{
+		workerIndex(this) = index;
+		unsigned idle = 0;
+		while (!mQuit.load(std::memory_order_relaxed))
+		{
+			if (runOne(index))
+			{
+				idle = 0;
+				continue;
+			}
+			if (++idle < 64)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			// Nothing to do: sleep until run() queues a job
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mSleeping++;
+			mWake.wait(lock, [this] { return mQuit.load() || mQueued.load() > 0; });
+			mSleeping--;
+			idle = 0;
+		}
+	}
+
+	void schedule(Job* job)
+	{
+		if (mStatsEnabled)
+			job->queued = std::chrono::steady_clock::now();
+		int index = workerIndex(this);
+		mQueued.fetch_add(1);
+		if (index >= 0)
+		{
+			mWorkers[index]->deque.push(job);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(mInjectMutex);
+			mInjected.push_back(job);
+			mInjectedCount++;
+		}
+		if (mSleeping.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+			mWake.notify_one();
+		}
+	}
+
+	Job* take(int index)
+	{
+		Job* job = nullptr;
+		if (index >= 0)
+			job = mWorkers[index]->deque.pop();
+		if (!job && mQueued.load(std::memory_order_relaxed) > 0)
+		{
+			if (mInjectedCount.load(std::memory_order_relaxed) > 0)
+			{
+				std::lock_guard<std::mutex> lock(mInjectMutex);
+				if (!mInjected.empty())
+				{
+					job = mInjected.back();
+					mInjected.pop_back();
+					mInjectedCount--;
+				}
+			}
+			// Steal, starting from a random victim
+			size_t count = mWorkers.size();
+			size_t start = 0;
+			if (index >= 0)
+			{
+				uint32_t& r = mWorkers[index]->random;
+				r ^= r << 13;
+				r ^= r >> 17;
+				r ^= r << 5;
+				start = r % count;
+			}
+			for (size_t i = 0; i < count && !job; ++i)
+			{
+				size_t victim = (start + i) % count;
+				if (static_cast<int>(victim) == index)
+					continue;
+				job = mWorkers[victim]->deque.steal();
+				if (job && index >= 0)
+					mWorkers[index]->stats.steals++;
+			}
+		}
+		if (job)
+			mQueued.fetch_sub(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	bool runOne(int index)
+	{
+		Job* job = take(index);
+		if (!job)
+			return false;
+
+		std::chrono::steady_clock::time_point start;
+		if (mStatsEnabled)
+			start = std::chrono::steady_clock::now();
+		Counter* counter = job->counter;
+		if (counter)
+		{
+			try
+			{
+				job->function();
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(counter->mMutex);
+				if (!counter->mError)
+					counter->mError = std::current_exception();
+			}
+		}
+		else
+		{
+			job->function();
+		}
+		if (mStatsEnabled && index >= 0)
+		{
+			auto end = std::chrono::steady_clock::now();
+			auto& stats = mWorkers[index]->stats;
+			stats.queueLatency.add(std::chrono::duration_cast<std::chrono::nanoseconds>(start - job->queued).count());
+			stats.runTime.add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		}
+		delete job;
+		if (counter)
+			finish(*counter);
+		return true;
+	}
+
+	void finish(Counter& counter)
+	{
+		// Reaching zero sets Settling in the same step, so wait() cannot return while the
+		// continuations are still being taken from the counter
+		uint64_t state = counter.mState.load(std::memory_order_relaxed);
+		uint64_t next;
+		for (;;)
+		{
+			bool last = (state & Counter::CountMask) == 1;
+			if (last && (state & Counter::Settling))
+			{
+				// The counter was reused while an earlier zero is still settling
+				std::this_thread::yield();
+				state = counter.mState.load(std::memory_order_relaxed);
+				continue;
+			}
+			next = last ? (state - 1) | Counter::Settling : state - 1;
+			if (counter.mState.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+				break;
+		}
+		if (!(next & Counter::Settling) || (state & Counter::Settling))
+			return;
+
+		std::vector<Job*> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter.mMutex);
+			continuations.swap(counter.mContinuations);
+		}
+		counter.mState.fetch_and(~Counter::Settling, std::memory_order_release);
+		for (Job* job : continuations)
+			schedule(job);
+	}
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+// Read-only memory-mapped file.
+// Works on Win32 and POSIX so that asset code can be shared with Linux tools.
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile
+{
+	const char* mData = nullptr;
+	size_t mSize = 0;
+#ifdef _WIN32
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	bool open(const wchar_t* fileName)
+	{
+		close();
+		mFile = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		return mapOpenedFile();
+	}
+	bool open(const char* fileName)
+	{
+		close();
+		mFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		return mapOpenedFile();
+	}
+#else
+	bool open(const char* fileName)
+	{
+		close();
+		mFile = ::open(fileName, O_RDONLY);
+		if (mFile < 0)
+			return false;
+		struct stat st;
+		if (fstat(mFile, &st) != 0)
+		{
+			close();
+			return false;
+		}
+		mSize = static_cast<size_t>(st.st_size);
+		if (mSize == 0)
+			return true; // mmap() rejects empty files, but an empty view is valid
+		void* p = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+		if (p == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+		madvise(p, mSize, MADV_SEQUENTIAL);
+		mData = static_cast<const char*>(p);
+		return true;
+	}
+#endif
+
+	void close()
+	{
+#ifdef _WIN32
+		if (mData)
+			UnmapViewOfFile(mData);
+		if (mMapping)
+			CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE)
+			CloseHandle(mFile);
+		mMapping = nullptr;
+		mFile = INVALID_HANDLE_VALUE;
+#else
+		if (mData)
+			munmap(const_cast<char*>(mData), mSize);
+		if (mFile >= 0)
+			::close(mFile);
+		mFile = -1;
+#endif
+		mData = nullptr;
+		mSize = 0;
+	}
+
+	bool isOpen() const
+	{
+#ifdef _WIN32
+		return mFile != INVALID_HANDLE_VALUE;
+#else
+		return mFile >= 0;
+#endif
+	}
+	const char* data() const
+	{
+		return mData;
+	}
+	const char* end() const
+	{
+		return mData + mSize;
+	}
+	size_t size() const
+	{
+		return mSize;
+	}
+
+private:
+#ifdef _WIN32
+	bool mapOpenedFile()
+	{
+		if (mFile == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(mFile, &size))
+		{
+			close();
+			return false;
+		}
+		mSize = static_cast<size_t>(size.QuadPart);
+		if (mSize == 0)
+			return true; // CreateFileMapping() rejects empty files, but an empty view is valid
+		mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mMapping)
+		{
+			close();
+			return false;
+		}
+		mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+		if (!mData)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+#endif
+};
@@ -0,0 +1,395 @@
+#pragma once
+
+// CPU mip chain generation.
+// Builds every mip level of an RGBA8 (UNORM / sRGB, RGBA or BGRA order),
+// RGBA16F or R32F image with a separable box or Kaiser-windowed sinc filter.
+// Levels are filtered in linear light as float4 (sRGB formats are decoded
+// first) from the previous float level, so rounding does not accumulate down
+// the chain. Rows are split across threads and every level is written straight
+// into its DDS::Footprint in the upload buffer.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "DDSTexture.h"
+#include "Half.h"
+#include "UploadCopy.h"
+
+namespace MipGenerator
+{
+	enum class Filter
+	{
+		Box,        // Area average, 2x2 for even sizes
+		Kaiser,     // Windowed sinc (width 3, alpha 4); far less aliasing, slightly softer, may ring slightly
+	};
+
+	inline bool isSupported(uint32_t format)
+	{
+		switch (format)
+		{
+		case DDS::FormatR8G8B8A8Unorm:
+		case DDS::FormatR8G8B8A8UnormSrgb:
+		case DDS::FormatB8G8R8A8Unorm:
+		case DDS::FormatB8G8R8A8UnormSrgb:
+		case DDS::FormatR16G16B16A16Float:
+		case DDS::FormatR32Float:
+			return true;
+		}
+		return false;
+	}
+
+	inline uint32_t fullMipCount(uint32_t width, uint32_t height)
+	{
+		uint32_t count = 1;
+		for (uint32_t size = (std::max)(width, height); size > 1; size >>= 1)
+			++count;
+		return count;
+	}
+
+	namespace detail
+	{
+		struct Float4
+		{
+			float v[4];
+		};
+
+		inline const float* srgbToLinearTable()
+		{
+			struct Table
+			{
+				float v[256];
+				Table()
+				{
+					for (int i = 0; i < 256; ++i)
+					{
+						float c = i / 255.0f;
+						v[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+					}
+				}
+			};
+			static const Table table;
+			return table.v;
+		}
+
+		// Exact linear -> sRGB8 conversion: a coarse table gives a starting code, then the
+		// decision thresholds between neighbouring codes are checked.
+		inline uint8_t linearToSrgb8(float c)
+		{
+			static const int Buckets = 4096;
+			struct Table
+			{
+				float threshold[257];   // linear value where code i starts (i = 1..255)
+				uint8_t start[Buckets + 1];
+				Table()
+				{
+					threshold[0] = -1;
+					for (int i = 1; i < 256; ++i)
+					{
+						float e = (i - 0.5f) / 255.0f;
+						threshold[i] = e <= 0.04045f ? e / 12.92f : powf((e + 0.055f) / 1.055f, 2.4f);
+					}
+					threshold[256] = 2;
+					int code = 0;
+					for (int b = 0; b <= Buckets; ++b)
+					{
+						while (code < 255 && threshold[code + 1] <= static_cast<float>(b) / Buckets)
+							++code;
+						start[b] = static_cast<uint8_t>(code);
+					}
+				}
+			};
+			static const Table table;
+			c = (std::max)(0.0f, (std::min)(1.0f, c));
+			int code = table.start[static_cast<int>(c * Buckets)];
+			while (c >= table.threshold[code + 1])
+				++code;
+			return static_cast<uint8_t>(code);
+		}
+
+		inline uint8_t toUnorm8(float c)
+		{
+			c = (std::max)(0.0f, (std::min)(1.0f, c));
+			return static_cast<uint8_t>(c * 255.0f + 0.5f);
+		}
+
+		inline void decodeRow(uint32_t format, const uint8_t* src, uint32_t width, Float4* dst)
+		{
+			bool bgra = format == DDS::FormatB8G8R8A8Unorm || format == DDS::FormatB8G8R8A8UnormSrgb;
+			switch (format)
+			{
+			case DDS::FormatR8G8B8A8Unorm:
+			case DDS::FormatB8G8R8A8Unorm:
+				for (uint32_t x = 0; x < width; ++x, src += 4)
+				{
+					dst[x].v[0] = src[bgra ? 2 : 0] / 255.0f;
+					dst[x].v[1] = src[1] / 255.0f;
+					dst[x].v[2] = src[bgra ? 0 : 2] / 255.0f;
+					dst[x].v[3] = src[3] / 255.0f;
+				}
+				break;
+			case DDS::FormatR8G8B8A8UnormSrgb:
+			case DDS::FormatB8G8R8A8UnormSrgb:
+			{
+				const float* table = srgbToLinearTable();
+				for (uint32_t x = 0; x < width; ++x, src += 4)
+				{
+					dst[x].v[0] = table[src[bgra ? 2 : 0]];
+					dst[x].v[1] = table[src[1]];
+					dst[x].v[2] = table[src[bgra ? 0 : 2]];
+					dst[x].v[3] = src[3] / 255.0f; // Alpha is always linear
+				}
+				break;
+			}
+			case DDS::FormatR16G16B16A16Float:
+				for (uint32_t x = 0; x < width; ++x, src += 8)
+				{
+					uint16_t h[4];
+					memcpy(h, src, sizeof(h));
+					for (int c = 0; c < 4; ++c)
+						dst[x].v[c] = Half::halfToFloat(h[c]);
+				}
+				break;
+			case DDS::FormatR32Float:
+				for (uint32_t x = 0; x < width; ++x, src += 4)
+				{
+					memcpy(&dst[x].v[0], src, sizeof(float));
+					dst[x].v[1] = dst[x].v[2] = 0;
+					dst[x].v[3] = 1;
+				}
+				break;
+			}
+		}
+
+		inline void encodeRow(uint32_t format, const Float4* src, uint32_t width, uint8_t* dst)
+		{
+			bool bgra = format == DDS::FormatB8G8R8A8Unorm || format == DDS::FormatB8G8R8A8UnormSrgb;
+			switch (format)
+			{
+			case DDS::FormatR8G8B8A8Unorm:
+			case DDS::FormatB8G8R8A8Unorm:
+				for (uint32_t x = 0; x < width; ++x, dst += 4)
+				{
+					dst[bgra ? 2 : 0] = toUnorm8(src[x].v[0]);
+					dst[1] = toUnorm8(src[x].v[1]);
+					dst[bgra ? 0 : 2] = toUnorm8(src[x].v[2]);
+					dst[3] = toUnorm8(src[x].v[3]);
+				}
+				break;
+			case DDS::FormatR8G8B8A8UnormSrgb:
+			case DDS::FormatB8G8R8A8UnormSrgb:
+				for (uint32_t x = 0; x < width; ++x, dst += 4)
+				{
+					dst[bgra ? 2 : 0] = linearToSrgb8(src[x].v[0]);
+					dst[1] = linearToSrgb8(src[x].v[1]);
+					dst[bgra ? 0 : 2] = linearToSrgb8(src[x].v[2]);
+					dst[3] = toUnorm8(src[x].v[3]);
+				}
+				break;
+			case DDS::FormatR16G16B16A16Float:
+				for (uint32_t x = 0; x < width; ++x, dst += 8)
+				{
+					uint16_t h[4];
+					for (int c = 0; c < 4; ++c)
+						h[c] = Half::floatToHalf(src[x].v[c]);
+					memcpy(dst, h, sizeof(h));
+				}
+				break;
+			case DDS::FormatR32Float:
+				for (uint32_t x = 0; x < width; ++x, dst += 4)
+					memcpy(dst, &src[x].v[0], sizeof(float));
+				break;
+			}
+		}
+
+		// Modified Bessel function of the first kind, order 0
+		inline double besselI0(double x)
+		{
+			double sum = 1, term = 1, q = x * x / 4;
+			for (int k = 1; k < 32 && term > sum * 1e-12; ++k)
+			{
+				term *= q / (k * k);
+				sum += term;
+			}
+			return sum;
+		}
+
+		// 1D resampling weights, taps entries per destination texel (unused taps have weight 0).
+		struct FilterTable
+		{
+			int taps = 0;
+			std::vector<int> index;
+			std::vector<float> weight;
+		};
+
+		inline FilterTable buildTable(uint32_t srcSize, uint32_t dstSize, Filter filter)
+		{
+			const double KaiserWidth = 3, KaiserAlpha = 4;
+			double scale = static_cast<double>(srcSize) / dstSize;
+			double radius = filter == Filter::Box ? scale * 0.5 : KaiserWidth * scale * 0.5;
+
+			FilterTable table;
+			table.taps = static_cast<int>(ceil(radius * 2)) + 1;
+			table.index.assign(static_cast<size_t>(dstSize) * table.taps, 0);
+			table.weight.assign(static_cast<size_t>(dstSize) * table.taps, 0.0f);
+			double i0Alpha = besselI0(KaiserAlpha);
+			std::vector<double> w(table.taps);
+			for (uint32_t x = 0; x < dstSize; ++x)
+			{
+				double center = (x + 0.5) * scale;
+				int first = static_cast<int>(floor(center - radius));
+				double total = 0;
+				for (int k = 0; k < table.taps; ++k)
+				{
+					double s0 = first + k, s1 = s0 + 1;
+					if (filter == Filter::Box)
+					{
+						// Overlap of source texel [s0, s1) with the destination footprint
+						w[k] = (std::max)(0.0, (std::min)(s1, center + radius) - (std::max)(s0, center - radius));
+					}
+					else
+					{
+						double t = (s0 + 0.5 - center) / scale;         // destination texel units
+						double sinc = t == 0 ? 1 : sin(3.14159265358979 * t) / (3.14159265358979 * t);
+						double r = t / (KaiserWidth * 0.5);
+						w[k] = r * r < 1 ? sinc * besselI0(KaiserAlpha * sqrt(1 - r * r)) / i0Alpha : 0;
+					}
+					total += w[k];
+				}
+				for (int k = 0; k < table.taps; ++k)
+				{
+					// Clamp to edge
+					int src = (std::max)(0, (std::min)(static_cast<int>(srcSize) - 1, first + k));
+					table.index[x * table.taps + k] = src;
+					table.weight[x * table.taps + k] = static_cast<float>(w[k] / total);
+				}
+			}
+			return table;
+		}
+
+		// Horizontal pass: dst[x] = sum of weight * src[index] over the taps of x
+		inline void filterRow(const FilterTable& table, const Float4* src, uint32_t count, Float4* dst)
+		{
+			for (uint32_t x = 0; x < count; ++x)
+			{
+				const int* index = &table.index[x * table.taps];
+				const float* weight = &table.weight[x * table.taps];
+#if UPLOAD_COPY_SSE2
+				__m128 acc = _mm_setzero_ps();
+				for (int k = 0; k < table.taps; ++k)
+					acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src[index[k]].v), _mm_set1_ps(weight[k])));
+				_mm_storeu_ps(dst[x].v, acc);
+#else
+				Float4 acc = {};
+				for (int k = 0; k < table.taps; ++k)
+				{
+					const Float4& s = src[index[k]];
+					for (int c = 0; c < 4; ++c)
+						acc.v[c] += s.v[c] * weight[k];
+				}
+				dst[x] = acc;
+#endif
+			}
+		}
+
+		// Runs work(begin, end) over [0, count) on up to threadCount threads
+		template<class Work>
+		void parallelRows(uint32_t count, unsigned int threadCount, Work work)
+		{
+			// Bands smaller than this are not worth a thread
+			static const uint32_t MinRowsPerThread = 16;
+			uint32_t bands = (std::max)(1u, std::min<uint32_t>(threadCount, count / MinRowsPerThread));
+			std::vector<std::thread> threads;
+			for (uint32_t i = 1; i < bands; ++i)
+				threads.emplace_back(work, count * i / bands, count * (i + 1) / bands);
+			work(0u, count / bands);
+			for (auto& t : threads)
+				t.join();
+		}
+	};
+
+	// Writes mipLevels levels into dest (the mapped upload buffer) at footprints[0..mipLevels),
+	// as computed by DDS::computeFootprints for a desc with that many mips. Level 0 is copied
+	// from src, the rest are filtered from it.
+	inline bool generate(uint32_t format, const void* src, size_t srcRowPitch, uint32_t width, uint32_t height,
+		uint8_t* dest, const DDS::Footprint* footprints, uint32_t mipLevels, Filter filter = Filter::Box, unsigned int threadCount = 0)
+	{
+		if (!isSupported(format) || width == 0 || height == 0 || mipLevels == 0 || mipLevels > fullMipCount(width, height))
+			return false;
+		if (threadCount == 0)
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+
+		uint32_t bytesPerPixel = DDS::bitsPerPixel(format) / 8;
+		UploadCopy::Layout level0 = { dest + footprints[0].offset, footprints[0].rowPitch, 0 };
+		UploadCopy::ConstLayout source = { src, srcRowPitch, 0 };
+		UploadCopy::copyRows(level0, source, static_cast<size_t>(width) * bytesPerPixel, height);
+		if (mipLevels == 1)
+			return true;
+
+		// Level 0 is decoded row by row in the first horizontal pass; later levels are kept as float4.
+		// The buffers are left uninitialized, every element is written before it is read.
+		std::unique_ptr<detail::Float4[]> level, horizontal, next;
+		uint32_t w = width, h = height;
+		for (uint32_t mip = 1; mip < mipLevels; ++mip)
+		{
+			uint32_t nw = (std::max)(1u, w / 2), nh = (std::max)(1u, h / 2);
+			auto columns = detail::buildTable(w, nw, filter);
+			auto rows = detail::buildTable(h, nh, filter);
+			horizontal.reset(new detail::Float4[static_cast<size_t>(nw) * h]);
+			next.reset(new detail::Float4[static_cast<size_t>(nw) * nh]);
+
+			detail::parallelRows(h, threadCount, [&](uint32_t begin, uint32_t end)
+			{
+				std::vector<detail::Float4> decoded(mip == 1 ? w : 0);
+				for (uint32_t y = begin; y < end; ++y)
+				{
+					if (mip == 1)
+						detail::decodeRow(format, static_cast<const uint8_t*>(src) + y * srcRowPitch, w, decoded.data());
+					const detail::Float4* in = mip == 1 ? decoded.data() : level.get() + static_cast<size_t>(y) * w;
+					detail::filterRow(columns, in, nw, &horizontal[static_cast<size_t>(y) * nw]);
+				}
+			});
+
+			const DDS::Footprint& footprint = footprints[mip];
+			detail::parallelRows(nh, threadCount, [&](uint32_t begin, uint32_t end)
+			{
+				// Encode into a cached row first, the upload buffer is write-combined
+				std::vector<uint8_t> encoded(static_cast<size_t>(nw) * bytesPerPixel);
+				for (uint32_t y = begin; y < end; ++y)
+				{
+					detail::Float4* out = &next[static_cast<size_t>(y) * nw];
+					// Vertical pass, accumulated a whole row per tap
+					const int* index = &rows.index[y * rows.taps];
+					const float* weight = &rows.weight[y * rows.taps];
+					std::fill(out, out + nw, detail::Float4());
+					for (int k = 0; k < rows.taps; ++k)
+					{
+						const detail::Float4* in = &horizontal[static_cast<size_t>(index[k]) * nw];
+						float wk = weight[k];
+						for (uint32_t x = 0; x < nw; ++x)
+						{
+#if UPLOAD_COPY_SSE2
+							_mm_storeu_ps(out[x].v, _mm_add_ps(_mm_loadu_ps(out[x].v), _mm_mul_ps(_mm_loadu_ps(in[x].v), _mm_set1_ps(wk))));
+#else
+							for (int c = 0; c < 4; ++c)
+								out[x].v[c] += in[x].v[c] * wk;
+#endif
+						}
+					}
+					detail::encodeRow(format, out, nw, encoded.data());
+					UploadCopy::Layout d = { dest + footprint.offset + static_cast<size_t>(y) * footprint.rowPitch, footprint.rowPitch, 0 };
+					UploadCopy::ConstLayout s = { encoded.data(), encoded.size(), 0 };
+					UploadCopy::copyRows(d, s, encoded.size(), 1);
+				}
+			});
+
+			level.swap(next);
+			w = nw;
+			h = nh;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,537 @@
+#pragma once
+
+// Headless stand-in for the parts of D3D12 the samples' frame loops use.
+// Objects and methods carry the D3D12 names (Map, ResourceBarrier,
+// DrawIndexedInstanced, ExecuteIndirect, Signal, ...), so a frame loop ports by
+// swapping the types, and it runs without a GPU or a window: on Linux CI, for
+// thousands of frames, to time the CPU side.
+// Command lists are CommandCapture::Writers: they take the Writer's signatures,
+// with NullDevice objects for the pointers, and record its stream, so recording
+// code runs unchanged on a D3D12Target, a NullDevice list or a capture.
+// ExecuteCommandLists() replays the streams at once: it tracks resource states and
+// counts barriers that do not match them, performs buffer copies on the buffers'
+// memory (every buffer has some, so readbacks see copied data), reads the count
+// buffers of ExecuteIndirect and counts what the GPU would have done.
+// Fences complete deterministically: a signal completes once latency later
+// signals have been queued (0 completes it at once), or when the CPU waits for it.
+// Not thread-safe, except that separate command lists can record concurrently.
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "CommandCapture.h"
+
+namespace NullDevice
+{
+	// Values of D3D12_RESOURCE_STATES
+	typedef uint32_t ResourceStates;
+	const ResourceStates StateCommon = 0;
+	const ResourceStates StatePresent = 0;
+	const ResourceStates StateVertexAndConstantBuffer = 0x1;
+	const ResourceStates StateIndexBuffer = 0x2;
+	const ResourceStates StateRenderTarget = 0x4;
+	const ResourceStates StateUnorderedAccess = 0x8;
+	const ResourceStates StateDepthWrite = 0x10;
+	const ResourceStates StatePixelShaderResource = 0x80;
+	const ResourceStates StateIndirectArgument = 0x200;
+	const ResourceStates StateCopyDest = 0x400;
+	const ResourceStates StateCopySource = 0x800;
+	const ResourceStates StateGenericRead = 0xac3;
+
+	// Values of the D3D12 and DXGI enums the commands carry
+	const uint32_t FormatR16Uint = 57;          // DXGI_FORMAT_R16_UINT
+	const uint32_t FormatR32Uint = 42;          // DXGI_FORMAT_R32_UINT
+	const uint32_t TopologyTriangleList = 4;    // D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+	const uint32_t ClearFlagDepth = 1;          // D3D12_CLEAR_FLAG_DEPTH
+
+	enum class HeapType : uint8_t { Default, Upload, Readback };
+	enum class DescriptorHeapType : uint8_t { CbvSrvUav, Sampler, Rtv, Dsv };
+
+	struct CpuDescriptorHandle { uint64_t ptr; };
+	struct GpuDescriptorHandle { uint64_t ptr; };
+
+	class Device;
+	class CommandQueue;
+
+	// Every object has an id, its index in the device's table of that kind
+	struct Object
+	{
+		uint32_t id;
+	};
+
+	class Resource : public Object
+	{
+		friend class Device;
+		friend class CommandQueue;
+		HeapType mHeap;
+		uint64_t mSize;                         // bytes; 0 for textures
+		uint64_t mGpuAddress;
+		ResourceStates mState;                  // as of the last executed command
+		std::vector<uint8_t> mMemory;           // buffers only
+
+	public:
+		// nullptr for the default heap and for textures, like a failed Map()
+		void* Map()
+		{
+			return mHeap != HeapType::Default && !mMemory.empty() ? mMemory.data() : nullptr;
+		}
+		void Unmap() {}
+		uint64_t GetGPUVirtualAddress() const { return mGpuAddress; }
+		uint64_t GetSize() const { return mSize; }
+		ResourceStates GetState() const { return mState; }
+		// For checks: the buffer's memory, whatever its heap
+		const uint8_t* Contents() const { return mMemory.empty() ? nullptr : mMemory.data(); }
+	};
+
+	const uint32_t NoObject = ~0u;
+
+	struct Descriptor
+	{
+		enum Kind : uint8_t { Empty, Cbv, Srv, Uav, Rtv, Dsv } kind;
+		uint32_t resource;                      // ~0u for a CBV
+		uint64_t gpuAddress;                    // CBV only
+		uint32_t size;
+	};
+
+	class DescriptorHeap : public Object
+	{
+		friend class Device;
+		DescriptorHeapType mType;
+		bool mShaderVisible;
+		std::vector<Descriptor> mDescriptors;
+
+	public:
+		CpuDescriptorHandle GetCPUDescriptorHandleForHeapStart() const { return { handleBase(id) }; }
+		GpuDescriptorHandle GetGPUDescriptorHandleForHeapStart() const { return { mShaderVisible ? handleBase(id) : 0 }; }
+		static uint64_t handleBase(uint32_t id) { return static_cast<uint64_t>(id + 1) << 32; }
+	};
+
+	class PipelineState : public Object {};
+	class RootSignature : public Object {};
+
+	class CommandSignature : public Object
+	{
+		friend class Device;
+		uint32_t mByteStride;
+	public:
+		uint32_t GetByteStride() const { return mByteStride; }
+	};
+
+	class Fence : public Object
+	{
+		friend class Device;
+		friend class CommandQueue;
+		CommandQueue* mQueue;
+		uint64_t mCompleted;
+	public:
+		uint64_t GetCompletedValue() const { return mCompleted; }
+		// Completes the queue's signals up to value; false when value was never signaled
+		bool Wait(uint64_t value);
+	};
+
+	class CommandAllocator : public Object
+	{
+	public:
+		void Reset() {}
+	};
+
+	// Records with the CommandCapture::Writer methods; Close() before executing
+	class CommandList : public Object, public CommandCapture::Writer
+	{
+		bool mOpen = true;
+
+	public:
+		static const size_t DefaultCapacity = 1024 * 1024;
+
+		void Reset(CommandAllocator*, PipelineState* initialState)
+		{
+			reset();
+			mOpen = true;
+			if (initialState)
+				SetPipelineState(initialState);
+		}
+		void Close() { mOpen = false; }
+		bool IsOpen() const { return mOpen; }
+	};
+
+	class CommandQueue
+	{
+	public:
+		struct Stats
+		{
+			uint64_t lists;
+			uint64_t commands;
+			uint64_t streamBytes;
+			uint64_t draws;                     // direct and indirect
+			uint64_t dispatches;
+			uint64_t indirectCommands;
+			uint64_t barriers;
+			uint64_t copies;
+			uint64_t copiedBytes;
+			uint64_t errors;                    // state mismatches, draws without state, bad ranges, open or full lists
+		};
+
+	private:
+		class Executor;
+
+		struct Signal
+		{
+			Fence* fence;
+			uint64_t value;
+		};
+
+		Device* mDevice;
+		std::deque<Signal> mSignals;            // queued, not completed
+		uint32_t mLatency = 0;
+		Stats mStats = {};
+
+	public:
+		explicit CommandQueue(Device* device) : mDevice(device) {}
+
+		// Signals stay pending until latency later signals are queued
+		void SetLatency(uint32_t latency)
+		{
+			mLatency = latency;
+			retire(mLatency);
+		}
+
+		void ExecuteCommandLists(uint32_t count, CommandList* const* lists);
+
+		void Signal(Fence* fence, uint64_t value)
+		{
+			fence->mQueue = this;
+			mSignals.push_back({ fence, value });
+			retire(mLatency);
+		}
+
+		// Completes every pending signal, as if the GPU went idle
+		void Flush()
+		{
+			retire(0);
+		}
+
+		const Stats& GetStats() const { return mStats; }
+		void ResetStats() { mStats = {}; }
+
+	private:
+		friend class Fence;
+
+		void retire(size_t keep)
+		{
+			while (mSignals.size() > keep)
+			{
+				auto& signal = mSignals.front();
+				if (signal.fence->mCompleted < signal.value)
+					signal.fence->mCompleted = signal.value;
+				mSignals.pop_front();
+			}
+		}
+
+		bool completeUntil(Fence* fence, uint64_t value)
+		{
+			if (fence->mCompleted >= value)
+				return true;
+			size_t last = 0;
+			bool found = false;
+			for (size_t i = 0; i < mSignals.size(); ++i)
+			{
+				if (mSignals[i].fence == fence && mSignals[i].value >= value)
+				{
+					last = i;
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+				return false;
+			retire(mSignals.size() - last - 1);
+			return true;
+		}
+
+		void execute(const CommandList& list);
+	};
+
+	inline bool Fence::Wait(uint64_t value)
+	{
+		if (mCompleted >= value)
+			return true;
+		return mQueue && mQueue->completeUntil(this, value);
+	}
+
+	class SwapChain
+	{
+		friend class Device;
+		std::vector<Resource*> mBuffers;
+		uint32_t mCurrent = 0;
+		uint64_t mPresents = 0;
+		uint64_t mErrors = 0;
+
+	public:
+		Resource* GetBuffer(uint32_t index) const { return mBuffers[index]; }
+		uint32_t GetCurrentBackBufferIndex() const { return mCurrent; }
+		// The back buffer must have been returned to the present state by executed commands
+		void Present()
+		{
+			if (mBuffers[mCurrent]->GetState() != StatePresent)
+				mErrors++;
+			mCurrent = (mCurrent + 1) % mBuffers.size();
+			mPresents++;
+		}
+		uint64_t GetPresentCount() const { return mPresents; }
+		uint64_t GetErrorCount() const { return mErrors; }
+	};
+
+	class Device
+	{
+		friend class CommandQueue;
+
+		static const uint64_t AddressAlignment = 64 * 1024;
+
+		std::vector<std::unique_ptr<Resource>> mResources;
+		std::vector<std::unique_ptr<DescriptorHeap>> mDescriptorHeaps;
+		std::vector<std::unique_ptr<PipelineState>> mPipelineStates;
+		std::vector<std::unique_ptr<RootSignature>> mRootSignatures;
+		std::vector<std::unique_ptr<CommandSignature>> mCommandSignatures;
+		std::vector<std::unique_ptr<Fence>> mFences;
+		std::vector<std::unique_ptr<CommandAllocator>> mAllocators;
+		std::vector<std::unique_ptr<CommandList>> mLists;
+		std::vector<std::unique_ptr<SwapChain>> mSwapChains;
+		CommandQueue mQueue{ this };
+		uint64_t mNextAddress = AddressAlignment;
+		uint64_t mDescriptorWrites = 0;
+
+		template<class T>
+		static T* add(std::vector<std::unique_ptr<T>>& table)
+		{
+			table.emplace_back(new T());
+			table.back()->id = static_cast<uint32_t>(table.size() - 1);
+			return table.back().get();
+		}
+
+		Descriptor* descriptor(CpuDescriptorHandle handle)
+		{
+			uint64_t heap = (handle.ptr >> 32) - 1;
+			uint64_t index = (handle.ptr & 0xffffffffu) / DescriptorSize;
+			if (heap >= mDescriptorHeaps.size() || index >= mDescriptorHeaps[heap]->mDescriptors.size())
+				return nullptr;
+			mDescriptorWrites++;
+			return &mDescriptorHeaps[heap]->mDescriptors[index];
+		}
+
+	public:
+		static const uint32_t DescriptorSize = 32;
+
+		Device() = default;
+		Device(const Device&) = delete;
+		Device& operator=(const Device&) = delete;
+
+		Resource* CreateBuffer(HeapType heap, uint64_t size, ResourceStates initialState)
+		{
+			Resource* resource = add(mResources);
+			resource->mHeap = heap;
+			resource->mSize = size;
+			resource->mGpuAddress = mNextAddress;
+			resource->mState = initialState;
+			resource->mMemory.resize(static_cast<size_t>(size));
+			mNextAddress += (size + AddressAlignment - 1) & ~(AddressAlignment - 1);
+			return resource;
+		}
+
+		// Render targets, depth buffers and textures; their contents are not kept
+		Resource* CreateTexture2D(uint32_t width, uint32_t height, uint32_t bytesPerPixel, ResourceStates initialState)
+		{
+			Resource* resource = add(mResources);
+			resource->mHeap = HeapType::Default;
+			resource->mSize = 0;
+			resource->mGpuAddress = mNextAddress;
+			resource->mState = initialState;
+			uint64_t size = static_cast<uint64_t>(width) * height * bytesPerPixel;
+			mNextAddress += (size + AddressAlignment - 1) & ~(AddressAlignment - 1);
+			return resource;
+		}
+
+		DescriptorHeap* CreateDescriptorHeap(DescriptorHeapType type, uint32_t count, bool shaderVisible)
+		{
+			DescriptorHeap* heap = add(mDescriptorHeaps);
+			heap->mType = type;
+			heap->mShaderVisible = shaderVisible;
+			heap->mDescriptors.resize(count, Descriptor{ Descriptor::Empty, NoObject, 0, 0 });
+			return heap;
+		}
+
+		uint32_t GetDescriptorHandleIncrementSize(DescriptorHeapType) const { return DescriptorSize; }
+
+		void CreateConstantBufferView(uint64_t gpuAddress, uint32_t size, CpuDescriptorHandle handle)
+		{
+			if (auto* d = descriptor(handle))
+				*d = { Descriptor::Cbv, NoObject, gpuAddress, size };
+		}
+		void CreateShaderResourceView(Resource* resource, CpuDescriptorHandle handle)
+		{
+			if (auto* d = descriptor(handle))
+				*d = { Descriptor::Srv, resource->id, 0, 0 };
+		}
+		void CreateUnorderedAccessView(Resource* resource, CpuDescriptorHandle handle)
+		{
+			if (auto* d = descriptor(handle))
+				*d = { Descriptor::Uav, resource->id, 0, 0 };
+		}
+		void CreateRenderTargetView(Resource* resource, CpuDescriptorHandle handle)
+		{
+			if (auto* d = descriptor(handle))
+				*d = { Descriptor::Rtv, resource->id, 0, 0 };
+		}
+		void CreateDepthStencilView(Resource* resource, CpuDescriptorHandle handle)
+		{
+			if (auto* d = descriptor(handle))
+				*d = { Descriptor::Dsv, resource->id, 0, 0 };
+		}
+
+		PipelineState* CreatePipelineState() { return add(mPipelineStates); }
+		RootSignature* CreateRootSignature() { return add(mRootSignatures); }
+		CommandSignature* CreateCommandSignature(uint32_t byteStride)
+		{
+			CommandSignature* signature = add(mCommandSignatures);
+			signature->mByteStride = byteStride;
+			return signature;
+		}
+		Fence* CreateFence(uint64_t initialValue)
+		{
+			Fence* fence = add(mFences);
+			fence->mQueue = nullptr;
+			fence->mCompleted = initialValue;
+			return fence;
+		}
+		CommandAllocator* CreateCommandAllocator() { return add(mAllocators); }
+		// Open, like D3D12. capacity bounds the bytes recorded between resets; the
+		// commands past it are dropped and the list fails to execute.
+		CommandList* CreateCommandList(CommandAllocator*, PipelineState* initialState, size_t capacity = CommandList::DefaultCapacity)
+		{
+			CommandList* list = add(mLists);
+			list->init(capacity);
+			if (initialState)
+				list->SetPipelineState(initialState);
+			return list;
+		}
+		SwapChain* CreateSwapChain(uint32_t width, uint32_t height, uint32_t bufferCount)
+		{
+			mSwapChains.emplace_back(new SwapChain());
+			SwapChain* swapChain = mSwapChains.back().get();
+			for (uint32_t i = 0; i < bufferCount; ++i)
+				swapChain->mBuffers.push_back(CreateTexture2D(width, height, 4, StatePresent));
+			return swapChain;
+		}
+
+		CommandQueue* GetQueue() { return &mQueue; }
+		uint64_t GetDescriptorWriteCount() const { return mDescriptorWrites; }
+	};
+
+	inline void CommandQueue::ExecuteCommandLists(uint32_t count, CommandList* const* lists)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			mStats.lists++;
+			if (lists[i]->IsOpen())
+			{
+				mStats.errors++;
+				continue;
+			}
+			execute(*lists[i]);
+		}
+	}
+
+	// Replay target doing what the GPU would with a list's commands
+	class CommandQueue::Executor : public CommandCapture::NullTarget
+	{
+		Stats& mStats;
+		bool mPipelineSet = false;
+		bool mRootSignatureSet = false;
+
+		static Resource* resource(const void* object)
+		{
+			return static_cast<Resource*>(const_cast<void*>(object));
+		}
+
+		void draw(uint64_t count)
+		{
+			if (!mPipelineSet || !mRootSignatureSet)
+				mStats.errors++;
+			mStats.draws += count;
+		}
+
+	public:
+		explicit Executor(Stats& stats) : mStats(stats) {}
+
+		void ResourceBarrier(const void* object, uint32_t before, uint32_t after)
+		{
+			if (Resource* r = resource(object))
+			{
+				if (r->mState != before)
+					mStats.errors++;
+				r->mState = after;
+			}
+			mStats.barriers++;
+		}
+		void SetPipelineState(const void*) { mPipelineSet = true; }
+		void SetGraphicsRootSignature(const void*) { mRootSignatureSet = true; }
+		void SetComputeRootSignature(const void*) { mRootSignatureSet = true; }
+		void DrawInstanced(uint32_t, uint32_t, uint32_t, uint32_t) { draw(1); }
+		void DrawIndexedInstanced(uint32_t, uint32_t, uint32_t, int32_t, uint32_t) { draw(1); }
+		void Dispatch(uint32_t, uint32_t, uint32_t)
+		{
+			if (!mPipelineSet || !mRootSignatureSet)
+				mStats.errors++;
+			mStats.dispatches++;
+		}
+		void ExecuteIndirect(const void*, uint32_t maxCommandCount, const void* argumentBuffer, uint64_t,
+			const void* countBuffer, uint64_t countOffset)
+		{
+			Resource* arguments = resource(argumentBuffer);
+			uint32_t commands = maxCommandCount;
+			if (Resource* counts = resource(countBuffer))
+			{
+				if (countOffset + 4 <= counts->mMemory.size())
+				{
+					uint32_t value;
+					memcpy(&value, &counts->mMemory[static_cast<size_t>(countOffset)], 4);
+					commands = value < commands ? value : commands;
+				}
+				else
+				{
+					mStats.errors++;
+				}
+			}
+			if (!arguments || !(arguments->mState & StateIndirectArgument))
+				mStats.errors++;
+			mStats.indirectCommands += commands;
+			draw(commands);
+		}
+		void CopyBufferRegion(const void* dstBuffer, uint64_t dstOffset, const void* srcBuffer, uint64_t srcOffset, uint64_t size)
+		{
+			Resource* dst = resource(dstBuffer);
+			Resource* src = resource(srcBuffer);
+			if (!dst || !src || dstOffset + size > dst->mMemory.size() || srcOffset + size > src->mMemory.size())
+			{
+				mStats.errors++;
+				return;
+			}
+			memmove(&dst->mMemory[static_cast<size_t>(dstOffset)], &src->mMemory[static_cast<size_t>(srcOffset)], static_cast<size_t>(size));
+			mStats.copies++;
+			mStats.copiedBytes += size;
+		}
+	};
+
+	inline void CommandQueue::execute(const CommandList& list)
+	{
+		mStats.commands += list.commandCount();
+		mStats.streamBytes += list.size();
+		// A full list lost commands
+		if (list.droppedCount())
+			mStats.errors++;
+		Executor executor(mStats);
+		if (!CommandCapture::replay(list.data(), list.size(), executor))
+			mStats.errors++;
+	}
+};
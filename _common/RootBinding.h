@@ -0,0 +1,293 @@
+#pragma once
+
+// Root signature layout selection and recorded root bindings.
+// choose() places each constant buffer of a shader as root constants, a root CBV
+// or an entry of the shared descriptor table, within the 64 DWORD root signature
+// budget. Data that changes every draw goes into the root signature itself,
+// smallest first as constants; per-frame data goes into the table, which costs a
+// single DWORD however many entries it holds.
+// Binder records the bindings of each draw into a CommandCapture stream, skipping
+// values that are already bound. CommandCapture::replay() sends the stream to a
+// D3D12Target over an ID3D12GraphicsCommandList, or to CallCounter, which tallies
+// API calls and argument bytes without a device.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "CommandCapture.h"
+#include "FrameAllocator.h"
+
+namespace RootBinding
+{
+	static const uint32_t MaxRootDWords = 64;           // D3D12 root signature limit
+	static const uint32_t DefaultMaxConstantBytes = 64; // larger per-draw data goes through a root CBV
+	static const size_t DefaultStreamBytes = 64 * 1024;
+
+	enum class Kind
+	{
+		Constants,      // SetGraphicsRoot32BitConstants, 1 DWORD per 4 bytes
+		RootCbv,        // SetGraphicsRootConstantBufferView, 2 DWORDs
+		Table,          // entry of the shared descriptor table, 1 DWORD for the table
+	};
+
+	// A constant buffer of the shaders (register bN in space)
+	struct Parameter
+	{
+		uint32_t shaderRegister;
+		uint32_t space;
+		uint32_t size;          // bytes
+		bool perDraw;           // changes between draws rather than once per frame
+	};
+
+	struct Slot
+	{
+		Kind kind;
+		uint32_t rootIndex;
+		uint32_t tableOffset;   // descriptor offset in the table (Table only)
+	};
+
+	// Root parameter in root signature order; a table lists its entries in descriptor order
+	struct RootParameter
+	{
+		Kind kind;
+		std::vector<uint32_t> parameters;
+	};
+
+	struct Layout
+	{
+		std::vector<Slot> slots;                // one per Parameter
+		std::vector<RootParameter> rootParameters;
+		uint32_t rootDWords;
+		int tableRootIndex;                     // -1 without a table
+	};
+
+	inline uint32_t dwordCount(Kind kind, uint32_t size)
+	{
+		return kind == Kind::Constants ? (size + 3) / 4 : kind == Kind::RootCbv ? 2 : 1;
+	}
+
+	// Returns false when the per-draw parameters do not fit as root constants and root CBVs.
+	// Constants come first in the root signature, then root CBVs, then the table.
+	inline bool choose(const Parameter* params, size_t count, Layout& layout, uint32_t maxConstantBytes = DefaultMaxConstantBytes)
+	{
+		layout.slots.assign(count, Slot{ Kind::Table, 0, 0 });
+		layout.rootParameters.clear();
+		layout.rootDWords = 0;
+		layout.tableRootIndex = -1;
+
+		std::vector<uint32_t> perDraw;
+		bool hasTable = false;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (params[i].perDraw)
+				perDraw.push_back(i);
+			else
+				hasTable = true;
+		}
+		// Smallest first: they save the most calls per DWORD of root signature
+		std::stable_sort(perDraw.begin(), perDraw.end(), [&](uint32_t a, uint32_t b) { return params[a].size < params[b].size; });
+
+		// Everything not yet placed still needs a root CBV
+		uint32_t used = hasTable ? 1 : 0;
+		uint32_t reserved = static_cast<uint32_t>(perDraw.size()) * 2;
+		for (uint32_t i : perDraw)
+		{
+			reserved -= 2;
+			uint32_t constants = dwordCount(Kind::Constants, params[i].size);
+			if (params[i].size <= maxConstantBytes && used + constants + reserved <= MaxRootDWords)
+			{
+				layout.slots[i].kind = Kind::Constants;
+				used += constants;
+			}
+			else if (used + 2 + reserved <= MaxRootDWords)
+			{
+				layout.slots[i].kind = Kind::RootCbv;
+				used += 2;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		for (Kind kind : { Kind::Constants, Kind::RootCbv })
+		{
+			for (uint32_t i : perDraw)
+			{
+				if (layout.slots[i].kind != kind)
+					continue;
+				layout.slots[i].rootIndex = static_cast<uint32_t>(layout.rootParameters.size());
+				layout.rootParameters.push_back({ kind, { i } });
+			}
+		}
+		if (hasTable)
+		{
+			layout.tableRootIndex = static_cast<int>(layout.rootParameters.size());
+			RootParameter table = { Kind::Table, {} };
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (params[i].perDraw)
+					continue;
+				layout.slots[i] = { Kind::Table, static_cast<uint32_t>(layout.tableRootIndex), static_cast<uint32_t>(table.parameters.size()) };
+				table.parameters.push_back(i);
+			}
+			layout.rootParameters.push_back(table);
+		}
+		layout.rootDWords = used;
+		return true;
+	}
+
+	// Records the bindings of a Layout. Call reset() once per command list.
+	class Binder
+	{
+		struct Bound
+		{
+			bool valid;
+			bool hasData;                       // data holds the constants, or the data behind the CBV
+			uint64_t value;                     // CBV address or table handle
+			size_t dataOffset;                  // in mData
+		};
+
+		const Layout* mLayout = nullptr;
+		const Parameter* mParams = nullptr;
+		FrameAllocator* mAllocator = nullptr;
+		std::vector<Bound> mBound;              // per root parameter
+		std::vector<uint8_t> mData;
+		CommandCapture::Writer mStream;
+
+	public:
+		// allocator provides the memory of root CBVs and may be null when the layout has none.
+		// streamCapacity bounds the bytes recorded between reset() calls.
+		void init(const Layout& layout, const Parameter* params, FrameAllocator* allocator, size_t streamCapacity = DefaultStreamBytes)
+		{
+			mLayout = &layout;
+			mParams = params;
+			mAllocator = allocator;
+			mBound.assign(layout.rootParameters.size(), Bound{ false, false, 0, 0 });
+			size_t dataSize = 0;
+			for (size_t i = 0; i < layout.rootParameters.size(); ++i)
+			{
+				auto& root = layout.rootParameters[i];
+				mBound[i].dataOffset = dataSize;
+				if (root.kind != Kind::Table)
+					dataSize += params[root.parameters[0]].size;
+			}
+			mData.resize(dataSize);
+			mStream.init(streamCapacity);
+		}
+
+		// Forgets what is bound, as a new command list starts with empty root arguments
+		void reset()
+		{
+			for (auto& bound : mBound)
+				bound.valid = false;
+			mStream.reset();
+		}
+
+		// Binds the data of a per-draw parameter (Parameter::size bytes).
+		// Returns false when the CBV memory or the stream is exhausted.
+		bool set(uint32_t param, const void* data)
+		{
+			const Slot& slot = mLayout->slots[param];
+			uint32_t size = mParams[param].size;
+			Bound& bound = mBound[slot.rootIndex];
+			uint8_t* boundData = mData.data() + bound.dataOffset;
+			if (bound.valid && bound.hasData && memcmp(boundData, data, size) == 0)
+				return true;
+			if (slot.kind == Kind::Constants)
+			{
+				// Whole DWORDs, the last one zero padded
+				uint32_t constants[MaxRootDWords] = {};
+				memcpy(constants, data, size);
+				mStream.SetGraphicsRoot32BitConstants(slot.rootIndex, dwordCount(Kind::Constants, size), constants, 0);
+			}
+			else if (slot.kind == Kind::RootCbv)
+			{
+				auto cb = mAllocator ? mAllocator->allocate(size) : FrameAllocator::Allocation{};
+				if (!cb.data)
+					return false;
+				memcpy(cb.data, data, size);
+				mStream.SetGraphicsRootConstantBufferView(slot.rootIndex, cb.gpuAddress);
+			}
+			else
+			{
+				return false;                   // table entries are bound with setTable()
+			}
+			if (mStream.droppedCount())
+				return false;
+			bound.valid = true;
+			bound.hasData = true;
+			memcpy(boundData, data, size);
+			return true;
+		}
+
+		// Binds a root CBV to existing constants
+		void setAddress(uint32_t param, uint64_t gpuAddress)
+		{
+			const Slot& slot = mLayout->slots[param];
+			Bound& bound = mBound[slot.rootIndex];
+			if (bound.valid && !bound.hasData && bound.value == gpuAddress)
+				return;
+			mStream.SetGraphicsRootConstantBufferView(slot.rootIndex, gpuAddress);
+			bound.valid = true;
+			bound.hasData = false;
+			bound.value = gpuAddress;
+		}
+
+		// Binds the descriptor table (GPU descriptor handle of its first entry)
+		void setTable(uint64_t gpuDescriptorHandle)
+		{
+			if (mLayout->tableRootIndex < 0)
+				return;
+			Bound& bound = mBound[mLayout->tableRootIndex];
+			if (bound.valid && bound.value == gpuDescriptorHandle)
+				return;
+			mStream.SetGraphicsRootDescriptorTable(static_cast<uint32_t>(mLayout->tableRootIndex), gpuDescriptorHandle);
+			bound.valid = true;
+			bound.value = gpuDescriptorHandle;
+		}
+
+		void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+		{
+			mStream.DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+		}
+
+		// The calls since reset(); droppedCount() counts those that did not fit
+		const CommandCapture::Writer& stream() const
+		{
+			return mStream;
+		}
+	};
+
+	// Replay target counting the root argument calls and their argument bytes, and the draws
+	struct CallCounter : CommandCapture::NullTarget
+	{
+		uint64_t calls = 0;
+		uint64_t draws = 0;
+		uint64_t bytes = 0;
+
+		void SetGraphicsRoot32BitConstants(uint32_t, uint32_t count, const void*, uint32_t)
+		{
+			calls++;
+			bytes += count * 4;
+		}
+
+		void SetGraphicsRootConstantBufferView(uint32_t, uint64_t)
+		{
+			calls++;
+			bytes += 8;
+		}
+
+		void SetGraphicsRootDescriptorTable(uint32_t, uint64_t)
+		{
+			calls++;
+			bytes += 8;
+		}
+
+		void DrawIndexedInstanced(uint32_t, uint32_t, uint32_t, int32_t, uint32_t)
+		{
+			draws++;
+		}
+	};
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+// Stand-in for a command queue and its fence, for tuning frame pacing without a GPU.
+// execute() adds GPU time to the work since the last signal(); signal() queues that
+// work with a fence value. A worker thread runs the queue in order: each batch
+// starts when it is signaled or when the one before it ends, whichever is later,
+// and takes its GPU time, so the timeline does not drift with sleep precision.
+// The queue also counts the time it was actually idle, to check estimates against.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class SimulatedQueue
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Batch
+	{
+		uint64_t fenceValue;
+		Clock::duration cost;
+		Clock::time_point signaled;
+	};
+
+	std::mutex mMutex;
+	std::condition_variable mChanged;
+	std::deque<Batch> mBatches;
+	Clock::duration mPending{ 0 };      // executed since the last signal()
+	uint64_t mCompleted = 0;
+	Clock::time_point mEnd;             // of the last batch run
+	Clock::duration mIdle{ 0 };
+	Clock::duration mBusy{ 0 };
+	bool mQuit = false;
+	std::thread mThread;
+
+public:
+	SimulatedQueue()
+	{
+		mEnd = Clock::now();
+		mThread = std::thread([this] { run(); });
+	}
+	SimulatedQueue(const SimulatedQueue&) = delete;
+	SimulatedQueue& operator=(const SimulatedQueue&) = delete;
+	// Runs the batches already signaled
+	~SimulatedQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mChanged.notify_all();
+		mThread.join();
+	}
+
+	void execute(double gpuMicroseconds)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(gpuMicroseconds));
+	}
+
+	void signal(uint64_t fenceValue)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mBatches.push_back({ fenceValue, mPending, Clock::now() });
+			mPending = Clock::duration(0);
+		}
+		mChanged.notify_all();
+	}
+
+	uint64_t completedValue()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mCompleted;
+	}
+
+	void waitForValue(uint64_t fenceValue)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mChanged.wait(lock, [&] { return mCompleted >= fenceValue; });
+	}
+
+	// Microseconds between batches and running them, since construction or resetTimes()
+	double idleMicroseconds()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return std::chrono::duration<double, std::micro>(mIdle).count();
+	}
+
+	double busyMicroseconds()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return std::chrono::duration<double, std::micro>(mBusy).count();
+	}
+
+	void resetTimes()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mIdle = mBusy = Clock::duration(0);
+		auto now = Clock::now();
+		if (mEnd < now)
+			mEnd = now;
+	}
+
+private:
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		for (;;)
+		{
+			mChanged.wait(lock, [&] { return mQuit || !mBatches.empty(); });
+			if (mBatches.empty())
+				return;
+			Batch batch = mBatches.front();
+			mBatches.pop_front();
+			auto start = batch.signaled > mEnd ? batch.signaled : mEnd;
+			mIdle += start - mEnd;
+			mBusy += batch.cost;
+			mEnd = start + batch.cost;
+			lock.unlock();
+			std::this_thread::sleep_until(mEnd);
+			lock.lock();
+			mCompleted = batch.fenceValue;
+			mChanged.notify_all();
+		}
+	}
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+// Offline-style texture cooking: RGBA8 DDS in, block-compressed DX10 DDS out.
+// Replaces the texconv step for BC formats. Mip levels missing from the source
+// are generated first (MipGenerator, box filter). The output header carries a
+// hash of the source texels and the cook settings in its reserved words, so an
+// up-to-date output is detected without touching the source timestamps and is
+// not cooked again. The header is written first, so an output also has to hold
+// exactly the texels its header describes: a cook cut short is cooked again.
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include "BCCompressor.h"
+#include "DDSTexture.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+
+namespace TextureCook
+{
+	enum class Result
+	{
+		Cooked,
+		UpToDate,
+		SourceNotFound,
+		UnsupportedFormat,
+		WriteFailed,
+	};
+
+	static const uint32_t CookMarker = 0x4B4F4F43; // "COOK"
+	static const uint32_t CookVersion = 1;
+
+	namespace detail
+	{
+		inline void hash(uint64_t& h, const void* data, size_t size)
+		{
+			// FNV-1a
+			auto* p = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; ++i)
+				h = (h ^ p[i]) * 0x100000001B3ull;
+		}
+
+		inline bool isRGBA8(uint32_t format, bool& bgra)
+		{
+			bgra = format == DDS::FormatB8G8R8A8Unorm || format == DDS::FormatB8G8R8A8UnormSrgb;
+			return bgra || format == DDS::FormatR8G8B8A8Unorm || format == DDS::FormatR8G8B8A8UnormSrgb;
+		}
+
+		inline uint32_t settings(uint32_t format, BC::Quality quality)
+		{
+			return format | (static_cast<uint32_t>(quality) << 16) | (CookVersion << 24);
+		}
+
+		template<class Char>
+		bool isUpToDate(const Char* fileName, uint64_t sourceHash, uint32_t settings)
+		{
+			MappedFile file;
+			if (!file.open(fileName) || file.size() < 4 + sizeof(DDS::Header))
+				return false;
+			DDS::Header header;
+			memcpy(&header, file.data() + 4, sizeof(header));
+			if (header.reserved1[0] != CookMarker ||
+				header.reserved1[1] != static_cast<uint32_t>(sourceHash) ||
+				header.reserved1[2] != static_cast<uint32_t>(sourceHash >> 32) ||
+				header.reserved1[3] != settings)
+				return false;
+			// The size the header implies
+			DDS::TextureDesc desc;
+			std::vector<DDS::Subresource> subresources;
+			if (!DDS::parse(file.data(), file.size(), desc, subresources) || subresources.empty())
+				return false;
+			auto& last = subresources.back();
+			return last.data + last.slicePitch * last.depth == reinterpret_cast<const uint8_t*>(file.data()) + file.size();
+		}
+	};
+
+	// Compresses every subresource of srcFileName to format and saves it as dstFileName,
+	// unless dstFileName was already cooked from the same texels with the same settings.
+	template<class Char>
+	Result cook(const Char* srcFileName, const Char* dstFileName, uint32_t format, BC::Quality quality = BC::Quality::Normal,
+		unsigned int threadCount = 0)
+	{
+		DDS::File source;
+		if (!source.open(srcFileName))
+			return Result::SourceNotFound;
+		DDS::TextureDesc desc = source.desc();
+		bool bgra;
+		if (!BC::isSupported(format) || !detail::isRGBA8(desc.format, bgra) || desc.dimension != DDS::DimensionTexture2D)
+			return Result::UnsupportedFormat;
+
+		uint64_t sourceHash = 0xCBF29CE484222325ull;
+		uint32_t shape[] = { desc.format, desc.width, desc.height, desc.arraySize, desc.mipLevels, desc.cubemap ? 1u : 0u };
+		detail::hash(sourceHash, shape, sizeof(shape));
+		for (auto& s : source.subresources())
+			detail::hash(sourceHash, s.data, s.slicePitch);
+		uint32_t settings = detail::settings(format, quality);
+		if (detail::isUpToDate(dstFileName, sourceHash, settings))
+			return Result::UpToDate;
+
+		// Levels to compress: the file's own, or a generated chain for single-level files
+		struct Level
+		{
+			const uint8_t* data;
+			size_t rowPitch;
+			uint32_t width, height;
+		};
+		std::vector<Level> levels;
+		std::vector<uint8_t> generated;
+		DDS::TextureDesc outDesc = desc;
+		if (desc.mipLevels == 1 && (desc.width > 1 || desc.height > 1))
+		{
+			outDesc.mipLevels = MipGenerator::fullMipCount(desc.width, desc.height);
+			DDS::TextureDesc chainDesc = desc;
+			chainDesc.arraySize = 1;
+			chainDesc.mipLevels = outDesc.mipLevels;
+			std::vector<DDS::Footprint> footprints;
+			generated.resize(static_cast<size_t>(DDS::computeFootprints(chainDesc, footprints)) * desc.arraySize);
+			size_t sliceSize = generated.size() / desc.arraySize;
+			for (uint32_t slice = 0; slice < desc.arraySize; ++slice)
+			{
+				auto& s = source.subresource(slice);
+				uint8_t* base = generated.data() + slice * sliceSize;
+				MipGenerator::generate(desc.format, s.data, s.rowSize, desc.width, desc.height, base,
+					footprints.data(), outDesc.mipLevels, MipGenerator::Filter::Box, threadCount);
+				for (auto& f : footprints)
+					levels.push_back({ base + f.offset, f.rowPitch, f.width, f.height });
+			}
+		}
+		else
+		{
+			for (auto& s : source.subresources())
+				levels.push_back({ s.data, s.rowSize, s.width, s.height });
+		}
+
+		outDesc.format = format;
+		DDS::Header header;
+		DDS::HeaderDXT10 dx10;
+		DDS::makeHeaders(outDesc, header, dx10);
+		header.reserved1[0] = CookMarker;
+		header.reserved1[1] = static_cast<uint32_t>(sourceHash);
+		header.reserved1[2] = static_cast<uint32_t>(sourceHash >> 32);
+		header.reserved1[3] = settings;
+
+		std::vector<uint8_t> data;
+		for (auto& level : levels)
+		{
+			uint32_t rowSize = 0, rowCount = 0;
+			DDS::surfaceInfo(format, level.width, level.height, rowSize, rowCount);
+			size_t offset = data.size();
+			data.resize(offset + static_cast<size_t>(rowSize) * rowCount);
+			BC::compress(format, level.data, level.rowPitch, level.width, level.height, bgra,
+				data.data() + offset, rowSize, quality, threadCount);
+		}
+
+		std::ofstream file(dstFileName, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return Result::WriteFailed;
+		file.write(reinterpret_cast<const char*>(&DDS::Magic), sizeof(DDS::Magic));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(&dx10), sizeof(dx10));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		return file ? Result::Cooked : Result::WriteFailed;
+	}
+};
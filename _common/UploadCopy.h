@@ -0,0 +1,154 @@
+#pragma once
+
+// Row-pitch-aware copy into upload heaps.
+// Upload heaps are write-combined: every partially written 64-byte line costs a
+// separate bus transaction, and reading back from them is very slow. Copies of
+// StreamThreshold bytes or more write rows with non-temporal stores (AVX2 when
+// the compiler targets it, SSE2 otherwise), and the row padding up to the next
+// 64-byte boundary, within the row pitch, is written along with the data, so
+// WC buffers are flushed as full lines. D3D12 footprints start every row on a
+// 256-byte boundary, so the rows themselves start whole lines. Smaller copies,
+// and other architectures, take memcpy per row.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define UPLOAD_COPY_SSE2 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define UPLOAD_COPY_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace UploadCopy
+{
+	// Below this many bytes streaming loses to memcpy when the destination is
+	// still in the cache, by up to 5x for rows of a few hundred bytes
+	static const size_t StreamThreshold = 512 * 1024;
+
+	// Layout of one side of a copy, the same fields as D3D12_MEMCPY_DEST / D3D12_SUBRESOURCE_DATA
+	struct Layout
+	{
+		void* data;
+		size_t rowPitch;
+		size_t slicePitch;
+	};
+
+	struct ConstLayout
+	{
+		const void* data;
+		size_t rowPitch;
+		size_t slicePitch;
+	};
+
+	inline void copyRowsScalar(const Layout& dest, const ConstLayout& src, size_t rowSize, uint32_t rowCount, uint32_t sliceCount)
+	{
+		for (uint32_t z = 0; z < sliceCount; ++z)
+		{
+			auto* d = static_cast<uint8_t*>(dest.data) + z * dest.slicePitch;
+			auto* s = static_cast<const uint8_t*>(src.data) + z * src.slicePitch;
+			for (uint32_t y = 0; y < rowCount; ++y)
+				memcpy(d + y * dest.rowPitch, s + y * src.rowPitch, rowSize);
+		}
+	}
+
+#if UPLOAD_COPY_SSE2
+	namespace detail
+	{
+		// Copies size bytes to a 16-byte aligned dest, of which the first padEnd
+		// (a multiple of 16, at least size) may be written. Bytes past size are
+		// padding: the last partial 16 bytes are written whole and zeros follow up
+		// to the next 64-byte boundary, as far as padEnd allows. Otherwise the
+		// tail is written with regular stores to stay inside the buffer.
+		inline void streamRow(uint8_t* d, const uint8_t* s, size_t size, size_t padEnd)
+		{
+			size_t i = 0;
+#if UPLOAD_COPY_AVX2
+			if (!(reinterpret_cast<uintptr_t>(d) & 31))
+			{
+				for (; i + 64 <= size; i += 64)
+				{
+					__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+					__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + 32));
+					_mm256_stream_si256(reinterpret_cast<__m256i*>(d + i), a);
+					_mm256_stream_si256(reinterpret_cast<__m256i*>(d + i + 32), b);
+				}
+			}
+#endif
+			for (; i + 64 <= size; i += 64)
+			{
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 16));
+				__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 32));
+				__m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 48));
+				_mm_stream_si128(reinterpret_cast<__m128i*>(d + i), a);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 16), b);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 32), c);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 48), e);
+			}
+			for (; i + 16 <= size; i += 16)
+				_mm_stream_si128(reinterpret_cast<__m128i*>(d + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)));
+			if (i < size)
+			{
+				if (i + 16 > padEnd)
+				{
+					memcpy(d + i, s + i, size - i);
+					return;
+				}
+				// Never read past the source row
+				alignas(16) uint8_t tail[16] = {};
+				memcpy(tail, s + i, size - i);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(d + i), _mm_load_si128(reinterpret_cast<const __m128i*>(tail)));
+				i += 16;
+			}
+			for (; (reinterpret_cast<uintptr_t>(d + i) & 63) && i + 16 <= padEnd; i += 16)
+				_mm_stream_si128(reinterpret_cast<__m128i*>(d + i), _mm_setzero_si128());
+		}
+	};
+#endif
+
+	// copyRows() with streaming stores whatever the size.
+	// Streaming needs dest rows 16-byte aligned, which D3D12 footprints always are
+	// (D3D12_TEXTURE_DATA_PITCH_ALIGNMENT); anything else takes the scalar path.
+	// Issues a store fence before returning, so the data is visible once the
+	// command list referencing it is submitted.
+	inline void copyRowsStreamed(const Layout& dest, const ConstLayout& src, size_t rowSize, uint32_t rowCount, uint32_t sliceCount = 1)
+	{
+#if UPLOAD_COPY_SSE2
+		bool aligned = !(reinterpret_cast<uintptr_t>(dest.data) & 15) && !(dest.rowPitch & 15) &&
+			(sliceCount <= 1 || !(dest.slicePitch & 15));
+		if (!aligned || rowSize < 64)
+		{
+			copyRowsScalar(dest, src, rowSize, rowCount, sliceCount);
+			return;
+		}
+		for (uint32_t z = 0; z < sliceCount; ++z)
+		{
+			auto* d = static_cast<uint8_t*>(dest.data) + z * dest.slicePitch;
+			auto* s = static_cast<const uint8_t*>(src.data) + z * src.slicePitch;
+			for (uint32_t y = 0; y < rowCount; ++y)
+			{
+				// The last row of the copy may end exactly at the end of the buffer
+				bool last = z + 1 == sliceCount && y + 1 == rowCount;
+				detail::streamRow(d + y * dest.rowPitch, s + y * src.rowPitch, rowSize, last ? rowSize : dest.rowPitch);
+			}
+		}
+		_mm_sfence();
+#else
+		copyRowsScalar(dest, src, rowSize, rowCount, sliceCount);
+#endif
+	}
+
+	// Copies rowCount rows of rowSize bytes in each of sliceCount slices:
+	// copyRowsStreamed() from StreamThreshold bytes, memcpy per row below.
+	inline void copyRows(const Layout& dest, const ConstLayout& src, size_t rowSize, uint32_t rowCount, uint32_t sliceCount = 1)
+	{
+		if (rowSize * rowCount * sliceCount < StreamThreshold)
+			copyRowsScalar(dest, src, rowSize, rowCount, sliceCount);
+		else
+			copyRowsStreamed(dest, src, rowSize, rowCount, sliceCount);
+	}
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+// Upload ring for staging data (copy sources of CopyBufferRegion / CopyTextureRegion).
+// One persistently mapped buffer is handed out front to back; everything allocated
+// before close(fenceValue) is retired together once that fence value completes, so
+// upload memory stays bounded however much content streams through it.
+// Allocations larger than half the ring, or made while the ring is full, get a
+// dedicated buffer that is released by fence the same way.
+// Buffers are created and released through callbacks, so the bookkeeping does not
+// depend on D3D12 (Resource is ID3D12Resource* in the samples).
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+template<class Resource>
+class UploadRing
+{
+public:
+	// Buffers are sized in multiples of the largest supported alignment
+	static const uint64_t MaxAlignment = 64 * 1024;
+
+	struct Buffer
+	{
+		Resource resource;
+		void* data;                 // mapped for the buffer's lifetime
+		uint64_t gpuAddress;
+		uint64_t size;
+	};
+
+	struct Allocation
+	{
+		Resource resource;
+		void* data;                 // nullptr when no buffer could be created
+		uint64_t offset;            // from the start of resource
+		uint64_t gpuAddress;
+	};
+
+	// Fills buffer with a mapped upload buffer of size bytes
+	using CreateBuffer = std::function<bool(uint64_t size, Buffer& buffer)>;
+	using ReleaseBuffer = std::function<void(Buffer& buffer)>;
+
+private:
+	struct Retired
+	{
+		uint64_t fenceValue;
+		uint64_t end;               // ring position
+		std::vector<Buffer> overflow;
+	};
+
+	CreateBuffer mCreate;
+	ReleaseBuffer mRelease;
+	Buffer mRing = {};
+	// Positions only grow; the buffer offset is position % mRing.size
+	uint64_t mHead = 0;
+	uint64_t mTail = 0;             // start of the oldest allocation in flight
+	std::vector<Buffer> mOverflow;  // dedicated buffers since the last close()
+	std::deque<Retired> mRetired;
+	uint64_t mOverflowSize = 0;
+
+public:
+	UploadRing() = default;
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+	// The GPU must be done with every allocation
+	~UploadRing()
+	{
+		clear();
+	}
+
+	bool init(uint64_t capacity, CreateBuffer create, ReleaseBuffer release)
+	{
+		clear();
+		mCreate = create;
+		mRelease = release;
+		capacity = (capacity + MaxAlignment - 1) & ~(MaxAlignment - 1);
+		return mCreate(capacity, mRing);
+	}
+
+	// alignment is a power of two up to MaxAlignment
+	// (256 for buffer copies, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT for textures)
+	Allocation allocate(uint64_t size, uint64_t alignment = 256)
+	{
+		uint64_t capacity = mRing.size;
+		if (size > 0 && size <= capacity / 2)
+		{
+			uint64_t begin = (mHead + alignment - 1) & ~(alignment - 1);
+			if (begin % capacity + size > capacity)
+				begin = (begin / capacity + 1) * capacity;  // Skip to the start of the buffer
+			if (begin + size - mTail <= capacity)
+			{
+				mHead = begin + size;
+				uint64_t offset = begin % capacity;
+				return { mRing.resource, static_cast<uint8_t*>(mRing.data) + offset, offset, mRing.gpuAddress + offset };
+			}
+		}
+
+		// Too large for the ring, or the ring is full until the GPU catches up
+		Buffer buffer = {};
+		if (!mCreate(size, buffer))
+			return {};
+		mOverflow.push_back(buffer);
+		mOverflowSize += buffer.size;
+		return { buffer.resource, buffer.data, 0, buffer.gpuAddress };
+	}
+
+	// Allocations made so far are in use until fenceValue completes
+	void close(uint64_t fenceValue)
+	{
+		if (!mRetired.empty() && mRetired.back().fenceValue == fenceValue)
+		{
+			auto& last = mRetired.back();
+			last.end = mHead;
+			last.overflow.insert(last.overflow.end(), mOverflow.begin(), mOverflow.end());
+		}
+		else
+		{
+			mRetired.push_back({ fenceValue, mHead, mOverflow });
+		}
+		mOverflow.clear();
+	}
+
+	// Frees everything closed with a fence value not greater than completedValue
+	void reclaim(uint64_t completedValue)
+	{
+		while (!mRetired.empty() && mRetired.front().fenceValue <= completedValue)
+		{
+			auto& retired = mRetired.front();
+			mTail = retired.end;
+			for (auto& buffer : retired.overflow)
+			{
+				mOverflowSize -= buffer.size;
+				mRelease(buffer);
+			}
+			mRetired.pop_front();
+		}
+	}
+
+	uint64_t capacity() const
+	{
+		return mRing.size;
+	}
+
+	// Ring bytes in flight
+	uint64_t used() const
+	{
+		return mHead - mTail;
+	}
+
+	// Bytes in dedicated buffers not yet released
+	uint64_t overflowSize() const
+	{
+		return mOverflowSize;
+	}
+
+private:
+	void clear()
+	{
+		close(~0ull);
+		reclaim(~0ull);
+		if (mRing.data && mRelease)
+			mRelease(mRing);
+		mRing = {};
+		mHead = mTail = 0;
+	}
+};